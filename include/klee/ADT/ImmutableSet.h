@@ -57,7 +57,7 @@ namespace klee {
     const value_type &max() const { 
       return elts.max(); 
     }
-    size_t size() { 
+    size_t size() const { 
       return elts.size(); 
     }
 
@@ -0,0 +1,177 @@
+//===-- PersistentVector.h --------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_PERSISTENTVECTOR_H
+#define KLEE_PERSISTENTVECTOR_H
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+
+namespace klee {
+
+/// Append-only vector whose elements are kept in a radix tree with nodes
+/// shared between copies of the vector. Copying a vector copies its root,
+/// an append clones the nodes on the path to the last element that are
+/// shared with other vectors (nodes owned by a single vector are updated
+/// in place), so copies that append different elements share their common
+/// prefix.
+template <typename T> class PersistentVector {
+  static constexpr unsigned Bits = 5;
+  static constexpr unsigned Fanout = 1u << Bits;
+  static constexpr unsigned Mask = Fanout - 1;
+
+  struct Node {};
+  struct Inner : Node {
+    std::array<std::shared_ptr<Node>, Fanout> children;
+  };
+  struct Leaf : Node {
+    std::array<T, Fanout> values;
+  };
+
+  std::shared_ptr<Node> root;
+  /// The number of levels of inner nodes above the leaves
+  unsigned height = 0;
+  std::size_t count = 0;
+
+  static unsigned slot(std::size_t index, unsigned level) {
+    return (index >> (Bits * level)) & Mask;
+  }
+
+  std::size_t capacity() const {
+    return std::size_t(1) << (Bits * (height + 1));
+  }
+
+  /// Get a node for writing, creating it if it does not exist and cloning
+  /// it if it is shared.
+  template <typename N> static N *writable(std::shared_ptr<Node> &node) {
+    if (!node)
+      node = std::make_shared<N>();
+    else if (node.use_count() > 1)
+      node = std::make_shared<N>(*static_cast<N *>(node.get()));
+    return static_cast<N *>(node.get());
+  }
+
+  const Leaf *leaf(std::size_t index) const {
+    const Node *node = root.get();
+    for (unsigned level = height; level > 0; --level)
+      node = static_cast<const Inner *>(node)->children[slot(index, level)].get();
+    return static_cast<const Leaf *>(node);
+  }
+
+public:
+  class const_iterator {
+    friend class PersistentVector;
+
+    const PersistentVector *vector = nullptr;
+    std::size_t index = 0;
+    /// The values of the leaf of index, null at the end
+    const T *values = nullptr;
+
+    const_iterator(const PersistentVector *vector, std::size_t index)
+        : vector(vector), index(index) {
+      if (index < vector->count)
+        values = vector->leaf(index)->values.data();
+    }
+
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const T *;
+    using reference = const T &;
+
+    const_iterator() = default;
+
+    reference operator*() const { return values[index & Mask]; }
+    pointer operator->() const { return &values[index & Mask]; }
+
+    const_iterator &operator++() {
+      ++index;
+      if ((index & Mask) == 0)
+        values = index < vector->count ? vector->leaf(index)->values.data()
+                                       : nullptr;
+      return *this;
+    }
+    const_iterator operator++(int) {
+      const_iterator old = *this;
+      ++*this;
+      return old;
+    }
+
+    bool operator==(const const_iterator &rhs) const {
+      return index == rhs.index;
+    }
+    bool operator!=(const const_iterator &rhs) const {
+      return index != rhs.index;
+    }
+  };
+
+  PersistentVector() = default;
+  template <typename InputIt> PersistentVector(InputIt first, InputIt last) {
+    for (; first != last; ++first)
+      push_back(*first);
+  }
+
+  std::size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+
+  const T &operator[](std::size_t index) const {
+    assert(index < count && "index out of bounds");
+    return leaf(index)->values[index & Mask];
+  }
+  const T &back() const { return (*this)[count - 1]; }
+
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, count); }
+
+  void push_back(const T &value) {
+    if (root && count == capacity()) {
+      auto inner = std::make_shared<Inner>();
+      inner->children[0] = std::move(root);
+      root = std::move(inner);
+      ++height;
+    }
+
+    std::shared_ptr<Node> *node = &root;
+    for (unsigned level = height; level > 0; --level)
+      node = &writable<Inner>(*node)->children[slot(count, level)];
+    writable<Leaf>(*node)->values[slot(count, 0)] = value;
+    ++count;
+  }
+
+  void clear() {
+    root.reset();
+    height = 0;
+    count = 0;
+  }
+
+  bool operator==(const PersistentVector &rhs) const {
+    if (count != rhs.count)
+      return false;
+    if (root == rhs.root)
+      return true;
+    for (auto it = begin(), rit = rhs.begin(), ie = end(); it != ie;
+         ++it, ++rit) {
+      if (!(*it == *rit))
+        return false;
+    }
+    return true;
+  }
+  bool operator!=(const PersistentVector &rhs) const {
+    return !(*this == rhs);
+  }
+};
+
+} // namespace klee
+
+#endif /* KLEE_PERSISTENTVECTOR_H */
@@ -0,0 +1,299 @@
+//===-- SetTrie.h -----------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SETTRIE_H
+#define KLEE_SETTRIE_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace klee {
+
+/// A map of sets to values that finds the subsets and the supersets of a
+/// set (a set-trie, see Savnik, "Index Data Structure for Fast Subset and
+/// Superset Queries", CD-ARES 2013). The sets are paths of sorted elements
+/// from the root, and each node keeps a signature of the elements below it,
+/// a bit per hash of an element, so that the superset search skips the
+/// subtrees that cannot contain the remaining elements.
+///
+/// The number of sets may be bounded, the sets used least recently are
+/// evicted by a clock. The nodes visited by the searches are counted, to
+/// measure their cost.
+template <class K, class V, class Hash = std::hash<K>> class SetTrie {
+  struct Node {
+    K element;
+    Node *parent;
+    /// Sorted by the element
+    std::vector<std::unique_ptr<Node>> children;
+    /// The bits of the elements of the descendants
+    uint64_t below = 0;
+    /// The index of the entry of the set that ends here, or -1
+    int64_t entry = -1;
+
+    Node(const K &element, Node *parent) : element(element), parent(parent) {}
+
+    uint64_t getSignature() const { return getBit(element) | below; }
+  };
+
+  struct Entry {
+    /// The node where the set ends, null if the entry is free
+    Node *node;
+    V value;
+    /// Whether the set was used since the clock passed it
+    bool referenced;
+  };
+
+  Node root;
+  std::vector<Entry> entries;
+  std::vector<size_t> freeEntries;
+  size_t capacity;
+  size_t hand = 0;
+  uint64_t visitedNodes = 0;
+  uint64_t evictions = 0;
+
+  static uint64_t getBit(const K &element) {
+    return uint64_t(1) << (Hash()(element) % 64);
+  }
+
+  /// The child with the element, or the position where it belongs
+  static typename std::vector<std::unique_ptr<Node>>::iterator
+  findChild(Node *n, const K &element) {
+    return std::lower_bound(
+        n->children.begin(), n->children.end(), element,
+        [](const std::unique_ptr<Node> &child, const K &element) {
+          return child->element < element;
+        });
+  }
+
+  Node *find(const std::set<K> &set) {
+    Node *n = &root;
+    ++visitedNodes;
+    for (const K &element : set) {
+      auto it = findChild(n, element);
+      if (it == n->children.end() || !((*it)->element == element))
+        return nullptr;
+      n = it->get();
+      ++visitedNodes;
+    }
+    return n;
+  }
+
+  V *use(Node *n) {
+    Entry &entry = entries[n->entry];
+    entry.referenced = true;
+    return &entry.value;
+  }
+
+  /// Remove the set of the entry and the nodes left without sets
+  void evict(size_t index);
+
+  template <class Predicate>
+  V *findSubset(Node *n, typename std::set<K>::const_iterator begin,
+                typename std::set<K>::const_iterator end, const Predicate &p);
+  template <class Predicate>
+  V *findSuperset(Node *n, const std::vector<K> &elements,
+                  const std::vector<uint64_t> &signatures, size_t i,
+                  const Predicate &p);
+
+public:
+  /// \param capacity - The number of sets kept, or 0 if unbounded.
+  explicit SetTrie(size_t capacity = 0) : root(K(), nullptr),
+                                          capacity(capacity) {}
+  SetTrie(const SetTrie &) = delete;
+  SetTrie &operator=(const SetTrie &) = delete;
+
+  void clear();
+
+  /// Map the set to the value, evicting a set if the trie is full. Returns
+  /// the value that the set had or that the evicted set had, or V().
+  V insert(const std::set<K> &set, const V &value);
+
+  /// The value of the set, null if it is not in the trie
+  V *lookup(const std::set<K> &set) {
+    Node *n = find(set);
+    return n && n->entry >= 0 ? use(n) : nullptr;
+  }
+
+  /// The value of the first subset of the set for which the predicate holds
+  template <class Predicate>
+  V *findSubset(const std::set<K> &set, const Predicate &p) {
+    return findSubset(&root, set.begin(), set.end(), p);
+  }
+
+  /// The value of the first superset of the set for which the predicate
+  /// holds
+  template <class Predicate>
+  V *findSuperset(const std::set<K> &set, const Predicate &p);
+
+  size_t size() const { return entries.size() - freeEntries.size(); }
+  /// The number of nodes visited by the lookups and the searches
+  uint64_t getVisitedNodes() const { return visitedNodes; }
+  uint64_t getEvictions() const { return evictions; }
+};
+
+template <class K, class V, class Hash>
+void SetTrie<K, V, Hash>::clear() {
+  root.children.clear();
+  root.below = 0;
+  root.entry = -1;
+  entries.clear();
+  freeEntries.clear();
+  hand = 0;
+}
+
+template <class K, class V, class Hash>
+V SetTrie<K, V, Hash>::insert(const std::set<K> &set, const V &value) {
+  if (Node *n = find(set)) {
+    if (n->entry >= 0) {
+      V *old = use(n);
+      V removed = *old;
+      *old = value;
+      return removed;
+    }
+  }
+
+  V removed = V();
+  if (capacity && size() >= capacity) {
+    // the clock clears the references it passes and evicts the first set
+    // that was not used since it passed it last
+    for (;; hand = (hand + 1) % entries.size()) {
+      Entry &entry = entries[hand];
+      if (!entry.node)
+        continue;
+      if (!entry.referenced)
+        break;
+      entry.referenced = false;
+    }
+    removed = entries[hand].value;
+    evict(hand);
+    hand = (hand + 1) % entries.size();
+  }
+
+  // the signatures of the suffixes of the set
+  std::vector<uint64_t> signatures(set.size() + 1, 0);
+  std::vector<const K *> elements;
+  for (const K &element : set)
+    elements.push_back(&element);
+  for (size_t i = set.size(); i > 0; --i)
+    signatures[i - 1] = signatures[i] | getBit(*elements[i - 1]);
+
+  Node *n = &root;
+  for (size_t i = 0; i < elements.size(); ++i) {
+    n->below |= signatures[i];
+    auto it = findChild(n, *elements[i]);
+    if (it == n->children.end() || !((*it)->element == *elements[i]))
+      it = n->children.insert(
+          it, std::unique_ptr<Node>(new Node(*elements[i], n)));
+    n = it->get();
+  }
+
+  size_t index = entries.size();
+  if (!freeEntries.empty()) {
+    index = freeEntries.back();
+    freeEntries.pop_back();
+    entries[index] = {n, value, true};
+  } else {
+    entries.push_back({n, value, true});
+  }
+  n->entry = index;
+  return removed;
+}
+
+template <class K, class V, class Hash>
+void SetTrie<K, V, Hash>::evict(size_t index) {
+  Entry &entry = entries[index];
+  Node *n = entry.node;
+  n->entry = -1;
+  entry.node = nullptr;
+  entry.value = V();
+  freeEntries.push_back(index);
+  ++evictions;
+
+  // remove the nodes that no set ends at or passes through
+  while (n != &root && n->children.empty() && n->entry < 0) {
+    Node *parent = n->parent;
+    parent->children.erase(findChild(parent, n->element));
+    n = parent;
+  }
+  for (; n; n = n->parent) {
+    n->below = 0;
+    for (const std::unique_ptr<Node> &child : n->children)
+      n->below |= child->getSignature();
+  }
+}
+
+template <class K, class V, class Hash>
+template <class Predicate>
+V *SetTrie<K, V, Hash>::findSubset(Node *n,
+                                   typename std::set<K>::const_iterator begin,
+                                   typename std::set<K>::const_iterator end,
+                                   const Predicate &p) {
+  ++visitedNodes;
+  if (n->entry >= 0 && p(entries[n->entry].value))
+    return use(n);
+
+  // the children whose elements are in the rest of the set, in order
+  auto child = n->children.begin(), childEnd = n->children.end();
+  for (auto it = begin; it != end && child != childEnd; ++it) {
+    if ((*child)->element < *it)
+      child = findChild(n, *it);
+    if (child == childEnd)
+      break;
+    if ((*child)->element == *it) {
+      auto next = it;
+      if (V *result = findSubset(child->get(), ++next, end, p))
+        return result;
+      ++child;
+    }
+  }
+  return nullptr;
+}
+
+template <class K, class V, class Hash>
+template <class Predicate>
+V *SetTrie<K, V, Hash>::findSuperset(Node *n, const std::vector<K> &elements,
+                                     const std::vector<uint64_t> &signatures,
+                                     size_t i, const Predicate &p) {
+  ++visitedNodes;
+  if (i == elements.size() && n->entry >= 0 && p(entries[n->entry].value))
+    return use(n);
+
+  for (const std::unique_ptr<Node> &child : n->children) {
+    // the elements below a child are greater than its element
+    if (i < elements.size() && elements[i] < child->element)
+      break;
+    if ((child->getSignature() & signatures[i]) != signatures[i])
+      continue;
+    size_t next = i < elements.size() && child->element == elements[i] ? i + 1
+                                                                        : i;
+    if (V *result = findSuperset(child.get(), elements, signatures, next, p))
+      return result;
+  }
+  return nullptr;
+}
+
+template <class K, class V, class Hash>
+template <class Predicate>
+V *SetTrie<K, V, Hash>::findSuperset(const std::set<K> &set,
+                                     const Predicate &p) {
+  std::vector<K> elements(set.begin(), set.end());
+  std::vector<uint64_t> signatures(elements.size() + 1, 0);
+  for (size_t i = elements.size(); i > 0; --i)
+    signatures[i - 1] = signatures[i] | getBit(elements[i - 1]);
+  return findSuperset(&root, elements, signatures, 0, p);
+}
+
+} // namespace klee
+
+#endif /* KLEE_SETTRIE_H */
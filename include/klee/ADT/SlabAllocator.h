@@ -0,0 +1,147 @@
+//===-- SlabAllocator.h -----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_SLABALLOCATOR_H
+#define KLEE_SLABALLOCATOR_H
+
+#include <cstddef>
+#include <new>
+
+// Objects carved from slabs are invisible to ASan, so it gets every object
+// from the global operator new instead.
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define KLEE_SLAB_ALLOCATOR_DISABLED
+#endif
+#endif
+#if defined(__SANITIZE_ADDRESS__)
+#define KLEE_SLAB_ALLOCATOR_DISABLED
+#endif
+
+namespace klee {
+
+/// Allocator of many small objects of a few sizes, like the nodes of
+/// expressions. Objects are carved from large slabs in size classes of
+/// Granularity bytes, and a freed object is kept in a free list of its class
+/// for the next allocation of the class. Slabs are not returned to the
+/// system before release(), getFreeSize() tells how much of them can be
+/// reused. Objects larger than MaxSize come from the global operator new.
+///
+/// Objects are aligned to Granularity bytes. The allocator is constructed
+/// at compile time and never destroyed, so global allocators can be used
+/// by objects that outlive the other globals.
+class SlabAllocator {
+public:
+  static constexpr std::size_t Granularity = 8;
+  static constexpr std::size_t MaxSize = 256;
+  static constexpr std::size_t SlabSize = std::size_t(64) << 10;
+
+private:
+  static constexpr std::size_t NumClasses = MaxSize / Granularity;
+
+  struct FreeObject {
+    FreeObject *next;
+  };
+  struct Slab {
+    Slab *next;
+  };
+
+  FreeObject *freeLists[NumClasses] = {};
+  /// All slabs, the first one is being carved
+  Slab *slabs = nullptr;
+  char *current = nullptr;
+  char *end = nullptr;
+  std::size_t reservedSize = 0;
+  std::size_t usedSize = 0;
+
+  static std::size_t getClass(std::size_t size) {
+    return size ? (size - 1) / Granularity : 0;
+  }
+
+  void push(std::size_t sizeClass, void *p) {
+    auto *object = static_cast<FreeObject *>(p);
+    object->next = freeLists[sizeClass];
+    freeLists[sizeClass] = object;
+  }
+
+  void addSlab() {
+    // the rest of the current slab is an object of its size class
+    if (current != end)
+      push(getClass(end - current), current);
+
+    auto *slab = static_cast<Slab *>(::operator new(SlabSize));
+    slab->next = slabs;
+    slabs = slab;
+    current = reinterpret_cast<char *>(slab) + Granularity;
+    end = reinterpret_cast<char *>(slab) + SlabSize;
+    reservedSize += SlabSize - Granularity;
+  }
+
+public:
+  constexpr SlabAllocator() = default;
+  SlabAllocator(const SlabAllocator &) = delete;
+  SlabAllocator &operator=(const SlabAllocator &) = delete;
+
+  void *allocate(std::size_t size) {
+#ifndef KLEE_SLAB_ALLOCATOR_DISABLED
+    if (size <= MaxSize) {
+      std::size_t sizeClass = getClass(size);
+      usedSize += (sizeClass + 1) * Granularity;
+      if (FreeObject *object = freeLists[sizeClass]) {
+        freeLists[sizeClass] = object->next;
+        return object;
+      }
+      std::size_t rounded = (sizeClass + 1) * Granularity;
+      if (static_cast<std::size_t>(end - current) < rounded)
+        addSlab();
+      void *p = current;
+      current += rounded;
+      return p;
+    }
+#endif
+    return ::operator new(size);
+  }
+
+  /// Free an object, `size` is the size it was allocated with.
+  void deallocate(void *p, std::size_t size) {
+#ifndef KLEE_SLAB_ALLOCATOR_DISABLED
+    if (size <= MaxSize) {
+      std::size_t sizeClass = getClass(size);
+      usedSize -= (sizeClass + 1) * Granularity;
+      push(sizeClass, p);
+      return;
+    }
+#endif
+    ::operator delete(p);
+  }
+
+  /// Return all slabs to the system, their objects must have been freed.
+  void release() {
+    while (slabs) {
+      Slab *next = slabs->next;
+      ::operator delete(slabs);
+      slabs = next;
+    }
+    for (FreeObject *&list : freeLists)
+      list = nullptr;
+    current = end = nullptr;
+    reservedSize = usedSize = 0;
+  }
+
+  /// The bytes of the slabs
+  std::size_t getReservedSize() const { return reservedSize; }
+  /// The bytes of the slabs taken by live objects
+  std::size_t getUsedSize() const { return usedSize; }
+  /// The bytes of the slabs free for new objects
+  std::size_t getFreeSize() const { return reservedSize - usedSize; }
+};
+
+} // namespace klee
+
+#endif /* KLEE_SLABALLOCATOR_H */
@@ -50,6 +50,18 @@ public:
                                const char *suffix) = 0;
 
   virtual std::string dumpPath(const ExecutionState& state) = 0;
+
+  /// Counters of the output, saved by checkpoints so that a resumed run
+  /// continues the numbering of the test cases.
+  struct OutputCounters {
+    std::uint64_t numTotalTests = 0;
+    std::uint64_t numGeneratedTests = 0;
+    std::uint64_t pathsCompleted = 0;
+    std::uint64_t pathsExplored = 0;
+  };
+
+  virtual OutputCounters getOutputCounters() const { return {}; }
+  virtual void setOutputCounters(const OutputCounters &counters) {}
 };
 
 class Interpreter {
@@ -140,6 +152,10 @@ public:
   // for the search. use null to reset.
   virtual void useSeeds(const std::vector<struct KTest *> *seeds) = 0;
 
+  // supply a checkpoint written by an earlier run to continue from instead
+  // of starting at the entry point. use an empty path to reset.
+  virtual void setResumeCheckpoint(const std::string &path) = 0;
+
   virtual void runFunctionAsMain(llvm::Function *f,
                                  int argc,
                                  char **argv,
@@ -14,6 +14,7 @@
 #include "klee/Expr/ArrayExprHash.h" // For klee::ArrayHashFn
 
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -59,6 +60,13 @@ public:
                            Expr::Width _domain = Expr::Int32,
                            Expr::Width _range = Expr::Int8);
 
+  /// Create a symbolic Array object that is distinct from all symbolic
+  /// arrays of the cache, its name is the prefix followed by a number.
+  ///
+  /// The numbers of a prefix start at 1 and names that are already used
+  /// (e.g. by arrays loaded from a checkpoint) are skipped.
+  const Array *CreateFreshArray(const std::string &prefix, uint64_t _size);
+
 private:
   typedef std::unordered_set<const Array *, klee::ArrayHashFn,
                              klee::EquivArrayCmpFn>
@@ -66,6 +74,8 @@ private:
   ArrayHashMap cachedSymbolicArrays;
   typedef std::vector<const Array *> ArrayPtrVec;
   ArrayPtrVec concreteArrays;
+  /// The last number used by CreateFreshArray for each prefix
+  std::unordered_map<std::string, unsigned> freshArrayIds;
 };
 }
 
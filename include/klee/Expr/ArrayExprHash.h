@@ -16,6 +16,7 @@
 
 #include <map>
 #include <unordered_map>
+#include <vector>
 
 namespace klee {
   
@@ -70,6 +71,9 @@ protected:
   
   ArrayHash      _array_hash;
   UpdateNodeHash _update_node_hash;  
+  /// The hashed update nodes are kept alive, so that their addresses are not
+  /// reused by other nodes while the hash refers to them
+  std::vector<ref<UpdateNode>> _update_nodes;
 };
 
 
@@ -127,7 +131,11 @@ void ArrayExprHash<T>::hashUpdateNodeExpr(const UpdateNode* un, T& exp)
 #endif
   
   assert(un);
-  _update_node_hash[un] = exp;
+  auto inserted = _update_node_hash.emplace(un, exp);
+  if (inserted.second)
+    _update_nodes.emplace_back(const_cast<UpdateNode *>(un));
+  else
+    inserted.first->second = exp;
 }
 
 }
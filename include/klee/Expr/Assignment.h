@@ -27,6 +27,10 @@ namespace klee {
     uint8_t get(unsigned index) const;
     std::map<uint32_t, uint8_t> asMap() const;
     std::vector<uint8_t> asVector() const;
+    /// The values indexed by the array index, null if a range is skipped
+    const std::vector<uint8_t> *getDense() const {
+      return skipRanges.empty() ? &values : nullptr;
+    }
     void dump() const;
   };
 
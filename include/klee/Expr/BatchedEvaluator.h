@@ -0,0 +1,110 @@
+//===-- BatchedEvaluator.h --------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_BATCHEDEVALUATOR_H
+#define KLEE_BATCHEDEVALUATOR_H
+
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/Expr.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace klee {
+
+/// Evaluates expressions for a batch of assignments at once. The values of a
+/// term under all the assignments are stored next to each other, so every
+/// operation is a loop over the batch that the compiler vectorizes, and the
+/// bytes of the arrays are stored the same way, a row of the batch per
+/// index. The terms are evaluated once for all the expressions evaluated by
+/// the evaluator.
+class BatchedEvaluator {
+public:
+  /// A bit per assignment of the batch
+  typedef std::uint64_t lanes_ty;
+  static constexpr unsigned MaxBatchSize = 64;
+
+private:
+  struct Term {
+    /// The values of the term start at values[offset]
+    std::size_t offset;
+    /// The assignments for which the value is undefined
+    lanes_ty undefined;
+  };
+
+  std::vector<const Assignment *> assignments;
+  unsigned size;
+  lanes_ty all;
+
+  std::vector<std::uint64_t> values;
+  std::unordered_map<const Expr *, Term> terms;
+  /// The evaluated expressions, they keep their terms alive
+  std::vector<ref<Expr>> evaluated;
+  /// The rows of the array bytes read at a constant index
+  std::unordered_map<const Array *, std::unordered_map<std::uint64_t, Term>>
+      rows;
+  /// The bytes of the arrays read at a symbolic index, per assignment
+  std::unordered_map<const Array *, std::vector<std::vector<std::uint8_t>>>
+      arrays;
+
+  Term allocate(lanes_ty undefined);
+  Term evaluateTerm(const ref<Expr> &e);
+  Term evaluateRead(const ReadExpr &re);
+  Term evaluateRow(const Array *array, std::uint64_t index);
+  std::uint8_t getByte(const Array *array, std::uint64_t index, unsigned lane);
+
+public:
+  explicit BatchedEvaluator(const std::vector<const Assignment *> &assignments);
+
+  unsigned getSize() const { return size; }
+
+  /// Evaluate the expression for all the assignments. The value for the
+  /// i-th assignment is values[i] if the i-th bit of the result is set.
+  /// Values are undefined where Assignment::evaluate does not return a
+  /// constant, i.e. when a zero is divided by, and also for terms wider than
+  /// 64 bits.
+  lanes_ty evaluate(const ref<Expr> &e, const std::uint64_t *&values);
+
+  /// The assignments that satisfy all the expressions, like
+  /// Assignment::satisfies.
+  template <typename ForwardIterator>
+  lanes_ty satisfies(ForwardIterator begin, ForwardIterator end);
+};
+
+template <typename ForwardIterator>
+BatchedEvaluator::lanes_ty BatchedEvaluator::satisfies(ForwardIterator begin,
+                                                       ForwardIterator end) {
+  lanes_ty remaining = all, undefined = 0;
+  for (ForwardIterator it = begin; it != end && remaining; ++it) {
+    const std::uint64_t *results;
+    lanes_ty defined = evaluate(*it, results);
+    for (unsigned i = 0; i < size; ++i) {
+      lanes_ty lane = lanes_ty(1) << i;
+      if (!(defined & lane))
+        undefined |= lane;
+      else if (!results[i])
+        remaining &= ~lane;
+    }
+  }
+
+  // the undefined results are left to the assignments
+  for (unsigned i = 0; i < size; ++i) {
+    lanes_ty lane = lanes_ty(1) << i;
+    if ((remaining & undefined & lane) &&
+        !assignments[i]->satisfies(begin, end))
+      remaining &= ~lane;
+  }
+  return remaining;
+}
+
+} // namespace klee
+
+#endif /* KLEE_BATCHEDEVALUATOR_H */
@@ -0,0 +1,55 @@
+//===-- ConstraintBounds.h --------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_CONSTRAINTBOUNDS_H
+#define KLEE_CONSTRAINTBOUNDS_H
+
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprHashMap.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace klee {
+
+/// An interval [min, max] of unsigned values.
+struct UnsignedRange {
+  uint64_t min;
+  uint64_t max;
+
+  static UnsignedRange full(Expr::Width width);
+};
+
+/// The bounds on subexpressions that appear syntactically in constraints,
+/// such as x < 10 or !(x <s 0). Constraints are added one by one, so the
+/// bounds of a path are extended as the path grows.
+class ConstraintBounds {
+  ExprHashMap<UnsignedRange> unsignedBounds;
+  ExprHashMap<std::pair<int64_t, int64_t>> signedBounds;
+  /// The number of added constraints
+  std::size_t constraintCount = 0;
+
+  void addConstraint(const ref<Expr> &constraint, bool negated);
+  void addUnsignedBound(const ref<Expr> &e, uint64_t min, uint64_t max);
+  void addSignedBound(const ref<Expr> &e, int64_t min, int64_t max);
+
+public:
+  void add(const ref<Expr> &constraint);
+
+  std::size_t getConstraintCount() const { return constraintCount; }
+
+  /// Narrow the range of values of e by the bounds of e. The result is
+  /// empty (min > max) if the bounds contradict the range.
+  UnsignedRange restrict(const ref<Expr> &e, UnsignedRange range) const;
+};
+
+} // namespace klee
+
+#endif /* KLEE_CONSTRAINTBOUNDS_H */
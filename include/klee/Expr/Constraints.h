@@ -10,18 +10,27 @@
 #ifndef KLEE_CONSTRAINTS_H
 #define KLEE_CONSTRAINTS_H
 
+#include "klee/ADT/PersistentVector.h"
 #include "klee/Expr/Expr.h"
 
+#include <memory>
+#include <vector>
+
 namespace klee {
 
+class ConstraintBounds;
+class IndependentFactors;
+class SimplificationCache;
+
 /// Resembles a set of constraints that can be passed around
 ///
+/// Copies of a set share the constraints they have in common, so copying
+/// the constraints of a state when it forks is cheap.
 class ConstraintSet {
   friend class ConstraintManager;
 
 public:
-  using constraints_ty = std::vector<ref<Expr>>;
-  using iterator = constraints_ty::iterator;
+  using constraints_ty = PersistentVector<ref<Expr>>;
   using const_iterator = constraints_ty::const_iterator;
 
   using constraint_iterator = const_iterator;
@@ -31,17 +40,38 @@ public:
   constraint_iterator end() const;
   size_t size() const noexcept;
 
-  explicit ConstraintSet(constraints_ty cs) : constraints(std::move(cs)) {}
+  explicit ConstraintSet(const std::vector<ref<Expr>> &cs)
+      : constraints(cs.begin(), cs.end()) {}
   ConstraintSet() = default;
 
   void push_back(const ref<Expr> &e);
 
+  /// The constraints split into independent factors. The factors are
+  /// extended by the constraints added since the last call and shared by
+  /// the copies of the set.
+  const IndependentFactors &getIndependentFactors() const;
+
+  /// The bounds on subexpressions implied by the constraints, extended and
+  /// shared like the independent factors.
+  const ConstraintBounds &getBounds() const;
+
   bool operator==(const ConstraintSet &b) const {
     return constraints == b.constraints;
   }
 
 private:
+  /// The expressions simplified by ConstraintManager::simplifyExpr with
+  /// these constraints, extended and shared like the independent factors.
+  SimplificationCache &getSimplificationCache() const;
+
+  /// Extend a cache of these constraints by the ones added since it was
+  /// last used, first copying it if a copy of the set still shares it.
+  template <typename T> T &extendCache(std::shared_ptr<T> &cache) const;
+
   constraints_ty constraints;
+  mutable std::shared_ptr<SimplificationCache> simplificationCache;
+  mutable std::shared_ptr<IndependentFactors> independentFactors;
+  mutable std::shared_ptr<ConstraintBounds> bounds;
 };
 
 class ExprVisitor;
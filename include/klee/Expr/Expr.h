@@ -12,6 +12,7 @@
 
 #include "klee/ADT/Bits.h"
 #include "klee/ADT/Ref.h"
+#include "klee/ADT/SlabAllocator.h"
 #include "llvm/ADT/APFloat.h"
 #include "llvm/ADT/APInt.h"
 #include "llvm/ADT/DenseSet.h"
@@ -19,6 +20,7 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <memory>
 #include <sstream>
 #include <set>
 #include <vector>
@@ -40,6 +42,21 @@ template<class T> class ref;
 
 extern llvm::cl::OptionCategory ExprCat;
 
+/// Allocator of the nodes of expressions and update lists
+extern SlabAllocator exprAllocator;
+
+/// What is known about the value of an expression of at most 64 bits under
+/// any assignment: the bits known to be zero and one, and an unsigned
+/// interval containing the value. Wider expressions know nothing.
+struct ExprBounds {
+  uint64_t knownZero;
+  uint64_t knownOne;
+  uint64_t min;
+  uint64_t max;
+
+  bool isConstant() const { return min == max; }
+};
+
 /// Class representing symbolic expressions.
 /**
 
@@ -91,6 +108,13 @@ Todo: Shouldn't bool \c Xor just be written as not equal?
 class Expr {
 public:
   static unsigned count;
+  /// Whether newly allocated expressions are hash-consed: an expression is
+  /// looked up in a table of the live hash-consed expressions and an equal
+  /// one is returned instead if it exists. Equal hash-consed expressions
+  /// are then the same object and compare by their addresses.
+  static bool hashConsing;
+  /// The number of expressions in the table of hash-consed expressions
+  static unsigned hashConsedCount;
   static const unsigned MAGIC_HASH_CONSTANT = 39;
 
   /// The type of an expression is simply its width, in bits. 
@@ -185,6 +209,14 @@ public:
 protected:  
   unsigned hashValue;
 
+private:
+  /// Computed by the first getBounds()
+  mutable std::unique_ptr<const ExprBounds> bounds;
+
+  ExprBounds computeBounds() const;
+
+protected:
+
   /// Compares `b` to `this` Expr and determines how they are ordered
   /// (ignoring their kid expressions - i.e. those returned by `getKid()`).
   ///
@@ -209,9 +241,36 @@ protected:
   /// `<` and `>` are binary relations that express the partial order.
   virtual int compareContents(const Expr &b) const = 0;
 
+  /// Returns the hash-consed expression equal to `e` if hash-consing is
+  /// enabled, `e` otherwise. Called by `alloc()` after computing the hash.
+  template <typename T> static ref<T> hashCons(const ref<T> &e) {
+    if (!hashConsing)
+      return e;
+    return ref<T>(static_cast<T *>(lookupOrInsert(e.get())));
+  }
+
+private:
+  /// Finds an expression of the same kind, width and contents as `e` whose
+  /// kids are the kids of `e` (by address) in the table of hash-consed
+  /// expressions, or inserts `e` if there is none.
+  static Expr *lookupOrInsert(Expr *e);
+  /// Removes this expression from the table of hash-consed expressions.
+  void removeHashConsed();
+
 public:
+  static void *operator new(std::size_t size) {
+    return exprAllocator.allocate(size);
+  }
+  static void operator delete(void *p, std::size_t size) {
+    exprAllocator.deallocate(p, size);
+  }
+
   Expr() { Expr::count++; }
-  virtual ~Expr() { Expr::count--; } 
+  virtual ~Expr() {
+    Expr::count--;
+    if (hashConsedCount)
+      removeHashConsed();
+  }
 
   virtual Kind getKind() const = 0;
   virtual Width getWidth() const = 0;
@@ -250,6 +309,14 @@ public:
   // but using those children. 
   virtual ref<Expr> rebuild(ref<Expr> kids[/* getNumKids() */]) const = 0;
 
+  /// The known bits and the interval of the values of this expression,
+  /// computed from the kids once per node.
+  const ExprBounds &getBounds() const {
+    if (!bounds)
+      bounds.reset(new ExprBounds(computeBounds()));
+    return *bounds;
+  }
+
   /// isZero - Is this a constant zero.
   bool isZero() const;
   
@@ -423,7 +490,7 @@ public:
   static ref<Expr> alloc(const ref<Expr> &src) {
     ref<Expr> r(new NotOptimizedExpr(src));
     r->computeHash();
-    return r;
+    return hashCons(r);
   }
   
   static ref<Expr> create(ref<Expr> src);
@@ -483,6 +550,13 @@ public:
   UpdateNode() = delete;
   ~UpdateNode() = default;
 
+  static void *operator new(std::size_t size) {
+    return exprAllocator.allocate(size);
+  }
+  static void operator delete(void *p, std::size_t size) {
+    exprAllocator.deallocate(p, size);
+  }
+
   unsigned computeHash();
 };
 
@@ -585,7 +659,7 @@ public:
   static ref<Expr> alloc(const UpdateList &updates, const ref<Expr> &index) {
     ref<Expr> r(new ReadExpr(updates, index));
     r->computeHash();
-    return r;
+    return hashCons(r);
   }
   
   static ref<Expr> create(const UpdateList &updates, ref<Expr> i);
@@ -630,7 +704,7 @@ public:
                          const ref<Expr> &f) {
     ref<Expr> r(new SelectExpr(c, t, f));
     r->computeHash();
-    return r;
+    return hashCons(r);
   }
   
   static ref<Expr> create(ref<Expr> c, ref<Expr> t, ref<Expr> f);
@@ -693,7 +767,7 @@ public:
   static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) {
     ref<Expr> c(new ConcatExpr(l, r));
     c->computeHash();
-    return c;
+    return hashCons(c);
   }
   
   static ref<Expr> create(const ref<Expr> &l, const ref<Expr> &r);
@@ -769,7 +843,7 @@ public:
   static ref<Expr> alloc(const ref<Expr> &e, unsigned o, Width w) {
     ref<Expr> r(new ExtractExpr(e, o, w));
     r->computeHash();
-    return r;
+    return hashCons(r);
   }
   
   /// Creates an ExtractExpr with the given bit offset and width
@@ -820,7 +894,7 @@ public:
   static ref<Expr> alloc(const ref<Expr> &e) {
     ref<Expr> r(new NotExpr(e));
     r->computeHash();
-    return r;
+    return hashCons(r);
   }
   
   static ref<Expr> create(const ref<Expr> &e);
@@ -897,7 +971,7 @@ public:                                                          \
     static ref<Expr> alloc(const ref<Expr> &e, Width w) {        \
       ref<Expr> r(new _class_kind ## Expr(e, w));                \
       r->computeHash();                                          \
-      return r;                                                  \
+      return hashCons(r);                                        \
     }                                                            \
     static ref<Expr> create(const ref<Expr> &e, Width w);        \
     Kind getKind() const { return _class_kind; }                 \
@@ -930,7 +1004,7 @@ CAST_EXPR_CLASS(ZExt)
     static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) {           \
       ref<Expr> res(new _class_kind##Expr(l, r));                              \
       res->computeHash();                                                      \
-      return res;                                                              \
+      return hashCons(res);                                                    \
     }                                                                          \
     static ref<Expr> create(const ref<Expr> &l, const ref<Expr> &r);           \
     Width getWidth() const { return left->getWidth(); }                        \
@@ -979,7 +1053,7 @@ ARITHMETIC_EXPR_CLASS(AShr)
     static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) {           \
       ref<Expr> res(new _class_kind##Expr(l, r));                              \
       res->computeHash();                                                      \
-      return res;                                                              \
+      return hashCons(res);                                                    \
     }                                                                          \
     static ref<Expr> create(const ref<Expr> &l, const ref<Expr> &r);           \
     Kind getKind() const { return _class_kind; }                               \
@@ -1022,6 +1096,12 @@ private:
 
   ConstantExpr(const llvm::APInt &v) : value(v) {}
 
+  /// Returns the shared constant of the given value if it is a small
+  /// constant (one of 0 to 255 and -16 to -1) of a common width (bool, 8,
+  /// 16, 32 or 64 bits), null otherwise. Shared constants are created on
+  /// their first use and live until exit.
+  static const ref<ConstantExpr> *getSmallConstant(uint64_t v, Width w);
+
 public:
   ~ConstantExpr() {}
 
@@ -1082,9 +1162,14 @@ public:
   void toMemory(void *address);
 
   static ref<ConstantExpr> alloc(const llvm::APInt &v) {
+    if (v.getBitWidth() <= 64) {
+      if (const ref<ConstantExpr> *small =
+              getSmallConstant(v.getZExtValue(), v.getBitWidth()))
+        return *small;
+    }
     ref<ConstantExpr> r(new ConstantExpr(v));
     r->computeHash();
-    return r;
+    return hashCons(r);
   }
 
   static ref<ConstantExpr> alloc(const llvm::APFloat &f) {
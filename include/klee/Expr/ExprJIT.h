@@ -0,0 +1,162 @@
+//===-- ExprJIT.h -----------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_EXPRJIT_H
+#define KLEE_EXPRJIT_H
+
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/BatchedEvaluator.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprHashMap.h"
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <vector>
+
+namespace llvm {
+class ExecutionEngine;
+class LLVMContext;
+class Module;
+} // namespace llvm
+
+namespace klee {
+
+/// Evaluates expressions under assignments like Assignment::evaluate, but
+/// compiles the expressions that are evaluated often to native code with the
+/// MCJIT. The compiled code is cached by the structure of the expression, the
+/// other expressions are interpreted.
+///
+/// The number of cached expressions may be bounded, the least recently used
+/// ones are evicted with their modules. The engine keeps the code of the
+/// evicted modules, so it is replaced with all the cached code once it keeps
+/// as much code of evicted modules as the cache holds.
+class ExprJIT {
+  /// The compiled function, it returns the value of the expression for the
+  /// bytes of the arrays of the expression and sets `undefined` if the value
+  /// is not a constant, i.e. when a zero is divided by.
+  typedef std::uint64_t (*function_ty)(const std::uint8_t *const *bytes,
+                                       const std::uint64_t *sizes,
+                                       std::uint8_t *undefined);
+
+  struct Entry {
+    unsigned evaluations = 0;
+    function_ty function = nullptr;
+    /// The module of the function, owned by the engine
+    llvm::Module *module = nullptr;
+    /// The arrays of the expression in the order of the arguments
+    std::vector<const Array *> arrays;
+    /// The position of the expression in the recently used list
+    std::list<ref<Expr>>::iterator position;
+  };
+
+  unsigned threshold;
+  unsigned capacity;
+  std::unique_ptr<llvm::LLVMContext> context;
+  llvm::ExecutionEngine *executionEngine = nullptr;
+  ExprHashMap<Entry> entries;
+  /// The cached expressions, the most recently used first
+  std::list<ref<Expr>> recentlyUsed;
+  unsigned compiledCount = 0;
+  /// The number of functions evicted since the engine was created
+  unsigned evictedFunctions = 0;
+
+  /// The arguments of the compiled functions
+  std::vector<const std::uint8_t *> bytes;
+  std::vector<std::uint64_t> sizes;
+  std::vector<std::vector<std::uint8_t>> expanded;
+
+  void createEngine();
+  void evict();
+  /// Compile the expression, false if it cannot be compiled
+  bool compile(const ref<Expr> &e, Entry &entry);
+  /// Count `count` evaluations of the expression and compile it once it is
+  /// hot. \return the entry of the compiled expression, null if it is not
+  /// compiled
+  Entry *lookup(const ref<Expr> &e, unsigned count);
+  /// Run the compiled expression, false if its value is undefined
+  bool run(const Entry &entry, const Assignment &a, std::uint64_t &value);
+
+public:
+  /// Compile the expressions once they are evaluated `threshold` times, and
+  /// keep at most `capacity` expressions (0 for unbounded)
+  ExprJIT(unsigned threshold, unsigned capacity);
+  ~ExprJIT();
+
+  ExprJIT(const ExprJIT &) = delete;
+  ExprJIT &operator=(const ExprJIT &) = delete;
+
+  /// Same as a.evaluate(e)
+  ref<Expr> evaluate(const Assignment &a, const ref<Expr> &e);
+
+  /// Same as a.satisfies(begin, end)
+  template <typename InputIterator>
+  bool satisfies(const Assignment &a, InputIterator begin, InputIterator end);
+
+  /// Same as BatchedEvaluator(assignments).satisfies(begin, end), the
+  /// compiled expressions are run for each assignment and the others are
+  /// evaluated for the batch.
+  template <typename ForwardIterator>
+  BatchedEvaluator::lanes_ty
+  satisfies(const std::vector<const Assignment *> &assignments,
+            ForwardIterator begin, ForwardIterator end);
+};
+
+template <typename InputIterator>
+bool ExprJIT::satisfies(const Assignment &a, InputIterator begin,
+                        InputIterator end) {
+  for (; begin != end; ++begin) {
+    std::uint64_t value;
+    Entry *entry = lookup(*begin, 1);
+    if (entry && run(*entry, a, value)) {
+      if (!value)
+        return false;
+    } else if (!a.evaluate(*begin)->isTrue()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename ForwardIterator>
+BatchedEvaluator::lanes_ty
+ExprJIT::satisfies(const std::vector<const Assignment *> &assignments,
+                   ForwardIterator begin, ForwardIterator end) {
+  assert(assignments.size() <= BatchedEvaluator::MaxBatchSize);
+  BatchedEvaluator::lanes_ty remaining =
+      assignments.size() == BatchedEvaluator::MaxBatchSize
+          ? ~BatchedEvaluator::lanes_ty(0)
+          : (BatchedEvaluator::lanes_ty(1) << assignments.size()) - 1;
+  std::vector<ref<Expr>> interpreted;
+  for (; begin != end && remaining; ++begin) {
+    Entry *entry = lookup(*begin, assignments.size());
+    if (!entry) {
+      interpreted.push_back(*begin);
+      continue;
+    }
+    for (unsigned i = 0; i < assignments.size(); ++i) {
+      BatchedEvaluator::lanes_ty lane = BatchedEvaluator::lanes_ty(1) << i;
+      if (!(remaining & lane))
+        continue;
+      std::uint64_t value;
+      if (run(*entry, *assignments[i], value)
+              ? !value
+              : !assignments[i]->evaluate(*begin)->isTrue())
+        remaining &= ~lane;
+    }
+  }
+  if (remaining && !interpreted.empty())
+    remaining &= BatchedEvaluator(assignments)
+                     .satisfies(interpreted.begin(), interpreted.end());
+  return remaining;
+}
+
+} // namespace klee
+
+#endif /* KLEE_EXPRJIT_H */
@@ -0,0 +1,39 @@
+//===-- ExprStats.h ---------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_EXPRSTATS_H
+#define KLEE_EXPRSTATS_H
+
+#include "klee/Statistics/Statistic.h"
+
+namespace klee {
+namespace stats {
+
+  /// Allocations of expressions that found an equal hash-consed expression
+  extern Statistic exprHashConsHits;
+  /// Allocations of expressions that were inserted as hash-consed
+  extern Statistic exprHashConsMisses;
+  /// Bytes of the expressions freed because of hash-consing hits
+  extern Statistic exprHashConsBytesSaved;
+  /// Simplifications with constraints that were found in the cache of the
+  /// constraint set
+  extern Statistic simplificationCacheHits;
+  /// Simplifications with constraints that were not cached
+  extern Statistic simplificationCacheMisses;
+  /// Expressions compiled to native code
+  extern Statistic exprJITCompilations;
+  /// Evaluations of expressions by the compiled code
+  extern Statistic exprJITEvaluations;
+  /// Expressions evicted from the cache of the expression JIT
+  extern Statistic exprJITEvictions;
+
+}
+}
+
+#endif /* KLEE_EXPRSTATS_H */
@@ -0,0 +1,143 @@
+//===-- IndependentSet.h ----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_INDEPENDENTSET_H
+#define KLEE_INDEPENDENTSET_H
+
+#include "klee/Expr/Expr.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace klee {
+
+template <class T> class DenseSet {
+  typedef std::set<T> set_ty;
+  set_ty s;
+
+public:
+  DenseSet() {}
+
+  void add(T x) { s.insert(x); }
+  void add(T start, T end) {
+    for (; start < end; start++)
+      s.insert(start);
+  }
+
+  // returns true iff set is changed by addition
+  bool add(const DenseSet &b) {
+    bool modified = false;
+    for (typename set_ty::const_iterator it = b.s.begin(), ie = b.s.end();
+         it != ie; ++it) {
+      if (modified || !s.count(*it)) {
+        modified = true;
+        s.insert(*it);
+      }
+    }
+    return modified;
+  }
+
+  bool intersects(const DenseSet &b) const {
+    for (typename set_ty::const_iterator it = s.begin(), ie = s.end();
+         it != ie; ++it)
+      if (b.s.count(*it))
+        return true;
+    return false;
+  }
+
+  typename set_ty::const_iterator begin() const { return s.begin(); }
+  typename set_ty::const_iterator end() const { return s.end(); }
+
+  void print(llvm::raw_ostream &os) const {
+    bool first = true;
+    os << "{";
+    for (typename set_ty::const_iterator it = s.begin(), ie = s.end();
+         it != ie; ++it) {
+      if (first) {
+        first = false;
+      } else {
+        os << ",";
+      }
+      os << *it;
+    }
+    os << "}";
+  }
+};
+
+template <class T>
+inline llvm::raw_ostream &operator<<(llvm::raw_ostream &os,
+                                     const DenseSet<T> &dis) {
+  dis.print(os);
+  return os;
+}
+
+/// The array elements that a set of expressions reads
+class IndependentElementSet {
+public:
+  typedef std::map<const Array *, DenseSet<unsigned>> elements_ty;
+  elements_ty elements;                 // Represents individual elements of array accesses (arr[1])
+  std::set<const Array*> wholeObjects;  // Represents symbolically accessed arrays (arr[x])
+  std::vector<ref<Expr> > exprs;        // All expressions that are associated with this factor
+                                        // Although order doesn't matter, we use a vector to match
+                                        // the ConstraintManager constructor that will eventually
+                                        // be invoked.
+
+  IndependentElementSet() {}
+  IndependentElementSet(ref<Expr> e);
+
+  void print(llvm::raw_ostream &os) const;
+
+  // more efficient when this is the smaller set
+  bool intersects(const IndependentElementSet &b) const;
+
+  // returns true iff set is changed by addition
+  bool add(const IndependentElementSet &b);
+};
+
+inline llvm::raw_ostream &operator<<(llvm::raw_ostream &os,
+                                     const IndependentElementSet &ies) {
+  ies.print(os);
+  return os;
+}
+
+/// The constraints of a constraint set split into independent factors,
+/// no two factors read a common array element. Constraints are added one by
+/// one and merge the factors they depend on, so the factors of a path are
+/// extended as the path grows. The factors are immutable and shared by the
+/// copies of the partition.
+class IndependentFactors {
+public:
+  typedef std::vector<std::shared_ptr<const IndependentElementSet>>
+      factors_ty;
+
+private:
+  factors_ty factors;
+  /// The number of added constraints
+  std::size_t constraintCount = 0;
+
+public:
+  void add(const ref<Expr> &constraint);
+
+  std::size_t getConstraintCount() const { return constraintCount; }
+  const factors_ty &getFactors() const { return factors; }
+
+  /// Collect the constraints the expression depends on, in the order of the
+  /// factors, and return the elements read by them and by the expression.
+  IndependentElementSet
+  getIndependentConstraints(const ref<Expr> &expr,
+                            std::vector<ref<Expr>> &result) const;
+};
+
+} // namespace klee
+
+#endif /* KLEE_INDEPENDENTSET_H */
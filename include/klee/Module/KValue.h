@@ -30,40 +30,64 @@ namespace klee {
   class KValue {
   public:
     ref<Expr> value;
+
+  private:
+    /// The segment, null for plain values (values in VALUES_SEGMENT), so
+    /// that they do not need an expression for their segment
     ref<Expr> pointerSegment;
 
+    static ref<Expr> normalizeSegment(const ref<Expr> &segment) {
+      if (segment.isNull())
+        return segment;
+      if (ConstantExpr *CE = dyn_cast<ConstantExpr>(segment))
+        if (CE->isZero())
+          return nullptr;
+      return segment;
+    }
+
   public:
     KValue() {}
     KValue(const KValue &other) : value(other.value), pointerSegment(other.pointerSegment) {}
-    KValue(ref<Expr> value)
-      : value(value), pointerSegment(ConstantExpr::alloc(VALUES_SEGMENT, value->getWidth())) {}
-    KValue(ref<ConstantExpr> value)
-      : value(value), pointerSegment(ConstantExpr::alloc(VALUES_SEGMENT, value->getWidth())) {}
+    KValue(ref<Expr> value) : value(value) {}
+    KValue(ref<ConstantExpr> value) : value(value) {}
+    /// A null segment makes a plain value
     KValue(ref<Expr> segment, ref<Expr> offset)
-      : value(offset), pointerSegment(segment) {}
+      : value(offset), pointerSegment(normalizeSegment(segment)) {}
     KValue(SpecialSegment segment, const ref<Expr> &offset)
-        : value(offset), pointerSegment(ConstantExpr::alloc(segment, value->getWidth())) {}
+        : value(offset),
+          pointerSegment(segment == VALUES_SEGMENT
+                             ? nullptr
+                             : ConstantExpr::alloc(segment, value->getWidth())) {}
 
     KValue& operator=(const KValue &other) = default;
 
     ref<Expr> getValue() const { return value; }
     ref<Expr> getOffset() const { return value; }
-    ref<Expr> getSegment() const { return pointerSegment; }
+    ref<Expr> getSegment() const {
+      if (pointerSegment.isNull() && !value.isNull())
+        return ConstantExpr::alloc(VALUES_SEGMENT, getWidth());
+      return pointerSegment;
+    }
+
+    /// Checks if this is a plain value, i.e., its segment is zero
+    bool isPlain() const { return pointerSegment.isNull(); }
 
     ref<Expr> createIsZero() const {
+      if (isPlain())
+        return Expr::createIsZero(getOffset());
       return AndExpr::create(Expr::createIsZero(getSegment()),
                              Expr::createIsZero(getOffset()));
     }
 
     /// Checks if both segment and offset are ConstantExpr and if yes, if they contain zero value
     bool isZero() const {
-      ConstantExpr *segment = dyn_cast<ConstantExpr>(pointerSegment);
       ConstantExpr *offset = dyn_cast<ConstantExpr>(value);
-      return (segment && offset && segment->isZero() && offset->isZero());
+      return isPlain() && offset && offset->isZero();
     }
 
     bool isConstant() const {
-      return isa<ConstantExpr>(value) && isa<ConstantExpr>(pointerSegment);
+      return isa<ConstantExpr>(value) &&
+             (isPlain() || isa<ConstantExpr>(pointerSegment));
     }
 
     Expr::Width getWidth() const {
@@ -71,32 +95,30 @@ namespace klee {
     }
     
     KValue ZExt(Expr::Width w) const {
+      if (isPlain())
+        return KValue(ZExtExpr::create(value, w));
       return KValue(ZExtExpr::create(pointerSegment, w),
                     ZExtExpr::create(value, w));
     }
 
     KValue SExt(Expr::Width w) const {
+      if (isPlain())
+        return KValue(SExtExpr::create(value, w));
       return KValue(SExtExpr::create(pointerSegment, w),
                     SExtExpr::create(value, w));
     }
 
 #define _op_seg_different(op) \
-     KValue op(const KValue &other) const { \
-      if (getSegment().get()->isZero() && other.getSegment().get()->isZero()) { \
-        return KValue(op##Expr::create(value, other.value)); \
-      } else { \
-        KValue retval = KValue(op##Expr::create(value, other.value)); \
-        if (getSegment().get()->isZero()) { \
-          retval.pointerSegment = other.getSegment(); \
-        } else { \
-          retval.pointerSegment = getSegment(); \
-        } \
-        return retval; \
-      } \
+    KValue op(const KValue &other) const { \
+      KValue retval = KValue(op##Expr::create(value, other.value)); \
+      retval.pointerSegment = isPlain() ? other.pointerSegment : pointerSegment; \
+      return retval; \
     }
 #define _op_seg_same(op) \
     KValue op(const KValue &other) const { \
-      return KValue(op##Expr::create(pointerSegment, other.pointerSegment), \
+      if (isPlain() && other.isPlain()) \
+        return KValue(op##Expr::create(value, other.value)); \
+      return KValue(op##Expr::create(getSegment(), other.getSegment()), \
                     op##Expr::create(value, other.value)); \
     }
 #define _op_seg_zero(op) \
@@ -110,7 +132,9 @@ namespace klee {
     _op_seg_same(Sub);
     KValue Mul(const KValue &other) const {
       // multiplying pointers doesn't make sense, but we must ensure that identity 1*x==x works
-      return KValue(AddExpr::create(pointerSegment, other.pointerSegment),
+      if (isPlain() && other.isPlain())
+        return KValue(MulExpr::create(value, other.value));
+      return KValue(AddExpr::create(getSegment(), other.getSegment()),
                     MulExpr::create(value, other.value));
     }
 
@@ -128,11 +152,12 @@ namespace klee {
 
 #define _op_seg_cmp_lexicographic(cmp) \
     KValue cmp(const KValue &other) const { \
-      if (isa<ConstantExpr>(value) && isa<ConstantExpr>(other.value)) { \
+      if (!(isPlain() && other.isPlain()) && \
+          isa<ConstantExpr>(value) && isa<ConstantExpr>(other.value)) { \
         return KValue(SelectExpr::create( \
-              EqExpr::create(pointerSegment, other.pointerSegment), \
+              EqExpr::create(getSegment(), other.getSegment()), \
               cmp##Expr::create(value, other.value), \
-              cmp##Expr::create(pointerSegment, other.pointerSegment))); \
+              cmp##Expr::create(getSegment(), other.getSegment()))); \
       } else { \
         return KValue(cmp##Expr::create(value, other.value)); \
       } \
@@ -152,23 +177,31 @@ namespace klee {
     }
 
     KValue Eq(const KValue &other) const {
+      if (isPlain() && other.isPlain())
+        return KValue(EqExpr::create(value, other.value));
       return KValue(AndExpr::create(
-                      EqExpr::create(pointerSegment, other.pointerSegment),
+                      EqExpr::create(getSegment(), other.getSegment()),
                       EqExpr::create(value, other.value)));
     }
 
     KValue Ne(const KValue &other) const {
+      if (isPlain() && other.isPlain())
+        return KValue(NeExpr::create(value, other.value));
       return KValue(OrExpr::create(
-                      NeExpr::create(pointerSegment, other.pointerSegment),
+                      NeExpr::create(getSegment(), other.getSegment()),
                       NeExpr::create(value, other.value)));
     }
 
     KValue Select(const KValue &b1, const KValue &b2) const {
-      return KValue(SelectExpr::create(value, b1.pointerSegment, b2.pointerSegment),
+      if (b1.isPlain() && b2.isPlain())
+        return KValue(SelectExpr::create(value, b1.value, b2.value));
+      return KValue(SelectExpr::create(value, b1.getSegment(), b2.getSegment()),
                     SelectExpr::create(value, b1.value, b2.value));
     }
 
     KValue Extract(unsigned bitOff, Expr::Width width) const {
+      if (isPlain())
+        return KValue(ExtractExpr::create(value, bitOff, width));
       return KValue(ExtractExpr::create(pointerSegment, bitOff, width),
                     ExtractExpr::create(value, bitOff, width));
     }
@@ -177,22 +210,23 @@ namespace klee {
     static KValue concatValues(const T &input) {
       std::vector<ref<Expr> > segments;
       std::vector<ref<Expr> > values;
+      bool plain = true;
       for (const KValue& item : input) {
+        plain &= item.isPlain();
         segments.push_back(item.getSegment());
         values.push_back(item.getValue());
       }
+      if (plain)
+        return KValue(ConcatExpr::createN(values.size(), values.data()));
       return KValue(ConcatExpr::createN(segments.size(), segments.data()),
                     ConcatExpr::createN(values.size(), values.data()));
     }
   };
 
   inline llvm::raw_ostream &operator<<(llvm::raw_ostream &os, const KValue &kvalue) {
-    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(kvalue.pointerSegment)) {
-      if (CE->isZero()) {
-        return os << kvalue.value;
-      }
-    }
-    return os << kvalue.pointerSegment << ':' << kvalue.value;
+    if (kvalue.isPlain())
+      return os << kvalue.value;
+    return os << kvalue.getSegment() << ':' << kvalue.value;
   }
 }
 
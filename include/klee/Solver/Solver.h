@@ -21,6 +21,7 @@ namespace klee {
   class ConstraintSet;
   class Expr;
   class SolverImpl;
+  class Statistic;
 
   /// Collection of meta data that a solver can have access to. This is
   /// independent of the actual constraints but can be used as a two-way
@@ -250,6 +251,27 @@ namespace klee {
   ///
   /// \param s - The underlying solver to use.
   Solver *createIndependentSolver(Solver *s);
+
+  /// createNarrowingSolver - Create a solver which will rewrite comparisons
+  /// of terms that provably fit in fewer bits than their width, like the
+  /// segments of pointers, to comparisons of narrower terms before
+  /// propagating the query to the underlying solver.
+  ///
+  /// \param s - The underlying solver to use.
+  Solver *createNarrowingSolver(Solver *s);
+
+  /// createPersistentCachingSolver - Create a solver which will reuse the
+  /// results of queries stored in the file at the given path, also by other
+  /// processes, before propagating the query to the underlying solver. The
+  /// queries are matched by their structure, regardless of the names of
+  /// their arrays.
+  ///
+  /// \param s - The underlying solver to use.
+  /// \param path - The file storing the results.
+  /// \param size - The number of bytes of results stored in a new file, the
+  /// oldest results are overwritten.
+  Solver *createPersistentCachingSolver(Solver *s, const std::string &path,
+                                        uint64_t size);
   
   /// createKQueryLoggingSolver - Create a solver which will forward all queries
   /// after writing them to the given path in .kquery format.
@@ -268,7 +290,33 @@ namespace klee {
   /// fails.
   Solver *createDummySolver();
 
-  // Create a solver based on the supplied ``CoreSolverType``.
+  /// createPortfolioSolver - Create a solver which will solve the queries
+  /// with the first of the given solvers in a forked process, and race the
+  /// other ones against it in forked processes on the queries it does not
+  /// solve within the threshold, taking the first result.
+  ///
+  /// \param solvers - The solvers to use, owned by the portfolio.
+  /// \param wins - The statistic of each solver incremented when it solves a
+  /// query first, or null.
+  /// \param threshold - The time after which the solvers race.
+  Solver *createPortfolioSolver(std::vector<Solver *> solvers,
+                                std::vector<Statistic *> wins,
+                                time::Span threshold);
+
+  /// createWorkerSolver - Create a solver which will solve the queries with
+  /// the given solver in worker processes, restarting the workers that crash
+  /// or time out.
+  ///
+  /// \param s - The solver the workers are forked with, which is not used to
+  /// solve queries in this process.
+  /// \param workers - The number of workers kept running.
+  /// \param memoryLimit - The bytes a worker may allocate, or 0 if unlimited.
+  Solver *createWorkerSolver(Solver *s, unsigned workers,
+                             uint64_t memoryLimit);
+
+  // Create a solver based on the supplied ``CoreSolverType``, racing it with
+  // the solvers of --solver-portfolio if given, and solving in worker
+  // processes if --solver-workers is given.
   Solver *createCoreSolver(CoreSolverType cst);
 }
 
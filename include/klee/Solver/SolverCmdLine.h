@@ -30,6 +30,12 @@ extern llvm::cl::opt<bool> UseBranchCache;
 
 extern llvm::cl::opt<bool> UseIndependentSolver;
 
+extern llvm::cl::opt<bool> UseNarrowingSolver;
+
+extern llvm::cl::opt<std::string> PersistentQueryCache;
+
+extern llvm::cl::opt<unsigned> PersistentQueryCacheSize;
+
 extern llvm::cl::opt<bool> DebugValidateSolver;
 
 extern llvm::cl::opt<std::string> MinQueryTimeToLog;
@@ -66,6 +72,16 @@ extern llvm::cl::opt<CoreSolverType> CoreSolverToUse;
 
 extern llvm::cl::opt<CoreSolverType> DebugCrossCheckCoreSolverWith;
 
+extern llvm::cl::list<CoreSolverType> SolverPortfolio;
+
+extern llvm::cl::opt<std::string> SolverPortfolioThreshold;
+
+extern llvm::cl::opt<unsigned> Z3IncrementalSolvers;
+
+extern llvm::cl::opt<unsigned> SolverWorkers;
+
+extern llvm::cl::opt<unsigned> SolverWorkerMemory;
+
 #ifdef ENABLE_METASMT
 
 enum MetaSMTBackendType {
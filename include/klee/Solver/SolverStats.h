@@ -23,9 +23,19 @@ namespace stats {
   extern Statistic queryCacheMisses;
   extern Statistic queryCexCacheHits;
   extern Statistic queryCexCacheMisses;
+  extern Statistic queryCexCacheEvictions;
+  extern Statistic queryCexCacheNodeVisits;
   extern Statistic queryConstructs;
   extern Statistic queryCounterexamples;
+  extern Statistic queryNarrowedComparisons;
+  extern Statistic queryPersistentCacheHits;
+  extern Statistic queryPersistentCacheMisses;
+  extern Statistic queryPortfolioRaces;
+  extern Statistic queryPortfolioWinsMetaSMT;
+  extern Statistic queryPortfolioWinsSTP;
+  extern Statistic queryPortfolioWinsZ3;
   extern Statistic queryTime;
+  extern Statistic solverWorkerRestarts;
   
 #ifdef KLEE_ARRAY_DEBUG
   extern Statistic arrayHashTime;
@@ -51,6 +51,7 @@ namespace klee {
     ~StatisticManager();
 
     void useIndexedStats(unsigned totalIndices);
+    bool hasIndexedStats() const { return indexedStats != nullptr; }
 
     StatisticRecord *getContext();
     void setContext(StatisticRecord *sr); /* null to reset */
@@ -63,6 +64,7 @@ namespace klee {
     void registerStatistic(Statistic &s);
     void incrementStatistic(Statistic &s, uint64_t addend);
     uint64_t getValue(const Statistic &s) const;
+    void setValue(const Statistic &s, uint64_t value);
     void incrementIndexedValue(const Statistic &s, unsigned index, 
                                uint64_t addend) const;
     uint64_t getIndexedValue(const Statistic &s, unsigned index) const;
@@ -133,6 +135,10 @@ namespace klee {
     return globalStats[s.id];
   }
 
+  inline void StatisticManager::setValue(const Statistic &s, uint64_t value) {
+    globalStats[s.id] = value;
+  }
+
   inline void StatisticManager::incrementIndexedValue(const Statistic &s, 
                                                       unsigned index,
                                                       uint64_t addend) const {
@@ -13,15 +13,41 @@
 #include "Memory.h"
 #include "TimingSolver.h"
 
+#include "klee/Expr/Constraints.h"
 #include "klee/Expr/Expr.h"
 #include "klee/Module/KValue.h"
 #include "klee/Statistics/TimerStatIncrementer.h"
+#include "klee/Support/OptionCategories.h"
 
 #include "CoreStats.h"
 
+#include "llvm/Support/CommandLine.h"
 
+#include <algorithm>
+#include <set>
+
+using namespace llvm;
 using namespace klee;
 
+namespace {
+  cl::opt<unsigned>
+  SegmentEnumerationLimit("segment-enumeration-limit",
+                          cl::desc("Number of segments of a symbolic pointer "
+                                   "found by model enumeration before the "
+                                   "remaining live segments are checked one by "
+                                   "one (default=16)"),
+                          cl::init(16),
+                          cl::cat(SolvingCat));
+
+  cl::opt<unsigned>
+  SegmentIntervalLimit("segment-interval-limit",
+                       cl::desc("Maximal number of intervals used to describe "
+                                "the set of live segments in a resolution "
+                                "query (default=32)"),
+                       cl::init(32),
+                       cl::cat(SolvingCat));
+}
+
 ///
 
 void AddressSpace::bindObject(const MemoryObject *mo, ObjectState *os) {
@@ -32,6 +58,13 @@ void AddressSpace::bindObject(const MemoryObject *mo, ObjectState *os) {
     segmentMap = segmentMap.replace(std::make_pair(mo->segment, mo));
 }
 
+void AddressSpace::bindSharedObject(const MemoryObject *mo, ObjectState *os) {
+  os->copyOnWriteOwner = 0;
+  objects = objects.replace(std::make_pair(mo, os));
+  if (mo->segment != 0)
+    segmentMap = segmentMap.replace(std::make_pair(mo->segment, mo));
+}
+
 void AddressSpace::unbindObject(const MemoryObject *mo) {
   if (mo->segment != 0)
     segmentMap = segmentMap.remove(mo->segment);
@@ -59,16 +92,18 @@ ObjectState *AddressSpace::getWriteable(const MemoryObject *mo,
   return newObjectState.get();
 }
 
-bool AddressSpace::resolveInConcreteMap(const uint64_t& segment, uint64_t &address) const {
-  auto found = std::find_if(concreteAddressMap.begin(),concreteAddressMap.end(),
-                            [segment](std::pair<const uint64_t&, const uint64_t&> value) {
-                              return value.second == segment;
-                            });
-  if (found != concreteAddressMap.end()) {
-    address = found->first;
-    return true;
+uint64_t AddressSpace::getOwnedObjectsSize() const {
+  uint64_t size = 0;
+  for (const auto &object : objects) {
+    const ObjectState *os = object.second.get();
+    if (isOwned(os))
+      size += os->getApproximateSize();
   }
-  return false;
+  return size;
+}
+
+bool AddressSpace::resolveInConcreteMap(const uint64_t& segment, uint64_t &address) const {
+  return concreteAddressMap.findAddress(segment, address);
 }
 
 bool AddressSpace::resolveOneConstantSegment(const KValue &pointer,
@@ -206,19 +241,164 @@ bool AddressSpace::resolve(ExecutionState &state,
                                           KValue(zeroSegment, pointer.getValue()),
                                           rl, maxResolutions, timeout))
     return true;
-  // TODO inefficient
-  for (const SegmentMap::value_type &res : segmentMap) {
-    if (timeout && timeout < timer.delta())
+
+  return resolveSymbolicSegment(state, solver, pointer.getSegment(), rl,
+                                maxResolutions, timeout, timer.delta());
+}
+
+/// Collect the constants a segment expression can evaluate to when it is
+/// a (nested) select over constants, as produced e.g. by merged phi nodes.
+/// \return false if some leaf of the expression is not a constant
+static bool collectSegmentLeaves(const ref<Expr> &segment,
+                                 std::set<uint64_t> &leaves) {
+  if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(segment)) {
+    if (CE->getWidth() > Expr::Int64)
+      return false;
+    leaves.insert(CE->getZExtValue());
+    return true;
+  }
+  if (const SelectExpr *SE = dyn_cast<SelectExpr>(segment))
+    return collectSegmentLeaves(SE->trueExpr, leaves) &&
+           collectSegmentLeaves(SE->falseExpr, leaves);
+  return false;
+}
+
+/// Build an expression stating that segment lies in one of the given
+/// (sorted) segment ids. Runs of consecutive ids are described as intervals
+/// and if there are too many of them, the smallest gaps are merged, i.e.,
+/// the result may over-approximate the set by ids that are not live.
+static ref<Expr> createSegmentRangeCheck(const ref<Expr> &segment,
+                                         const std::vector<uint64_t> &ids) {
+  assert(!ids.empty());
+  // indices i such that ids[i] and ids[i + 1] are not adjacent
+  std::vector<size_t> gaps;
+  for (size_t i = 0; i + 1 < ids.size(); ++i) {
+    if (ids[i + 1] != ids[i] + 1)
+      gaps.push_back(i);
+  }
+
+  unsigned limit = std::max(1u, SegmentIntervalLimit.getValue());
+  if (gaps.size() >= limit) {
+    // keep only the largest gaps as interval boundaries
+    std::sort(gaps.begin(), gaps.end(), [&ids](size_t a, size_t b) {
+      return ids[a + 1] - ids[a] > ids[b + 1] - ids[b];
+    });
+    gaps.resize(limit - 1);
+    std::sort(gaps.begin(), gaps.end());
+  }
+
+  Expr::Width width = segment->getWidth();
+  ref<Expr> result = ConstantExpr::create(0, Expr::Bool);
+  size_t start = 0;
+  for (size_t i = 0; i <= gaps.size(); ++i) {
+    size_t end = i < gaps.size() ? gaps[i] : ids.size() - 1;
+    ref<Expr> check;
+    if (ids[start] == ids[end]) {
+      check = EqExpr::create(ConstantExpr::create(ids[start], width), segment);
+    } else {
+      check = AndExpr::create(
+          UleExpr::create(ConstantExpr::create(ids[start], width), segment),
+          UleExpr::create(segment, ConstantExpr::create(ids[end], width)));
+    }
+    result = OrExpr::create(result, check);
+    start = end + 1;
+  }
+  return result;
+}
+
+bool AddressSpace::resolveSymbolicSegment(ExecutionState &state,
+                                          TimingSolver *solver,
+                                          const ref<Expr> &segment,
+                                          ResolutionList &rl,
+                                          unsigned maxResolutions,
+                                          time::Span timeout,
+                                          time::Span elapsed) const {
+  const WallTimer timer;
+  auto timedOut = [&]() {
+    return timeout && timeout < elapsed + timer.delta();
+  };
+  auto addSegment = [&](uint64_t id) {
+    const auto &pair = *objects.lookup(segmentMap.lookup(id)->second);
+    rl.emplace_back(pair.first, pair.second.get());
+    return maxResolutions && rl.size() >= maxResolutions;
+  };
+
+  // Candidates are the live segments, or only those syntactically
+  // reachable from the segment expression.
+  std::vector<uint64_t> candidates;
+  std::set<uint64_t> leaves;
+  bool syntactic = collectSegmentLeaves(segment, leaves);
+  if (syntactic) {
+    ++stats::segmentResolutionsSyntactic;
+    for (uint64_t id : leaves) {
+      if (id != 0 && segmentMap.lookup(id))
+        candidates.push_back(id);
+    }
+  } else {
+    candidates.reserve(segmentMap.size());
+    for (const SegmentMap::value_type &res : segmentMap)
+      candidates.push_back(res.first);
+  }
+
+  if (candidates.empty())
+    return false;
+
+  std::set<uint64_t> found;
+  if (!syntactic) {
+    // Enumerate models of the segment restricted to the live segments
+    // and exclude every segment found so far. Each round costs one
+    // feasibility check and one getValue query (which is usually answered
+    // from the counterexample cache filled by the former), and the search
+    // ends with a single infeasible query when all targets have been found.
+    ref<Expr> live = createSegmentRangeCheck(segment, candidates);
+    ref<Expr> excluded = ConstantExpr::create(1, Expr::Bool);
+    unsigned enumerated = 0;
+    while (enumerated < SegmentEnumerationLimit) {
+      if (timedOut())
+        return true;
+
+      ref<Expr> cond = AndExpr::create(live, excluded);
+      bool mayBeTrue;
+      if (!solver->mayBeTrue(state.constraints, cond, mayBeTrue,
+                             state.queryMetaData))
+        return true;
+      if (!mayBeTrue)
+        return false;
+
+      ConstraintSet extended(state.constraints);
+      ConstraintManager cm(extended);
+      cm.addConstraint(cond);
+      ref<ConstantExpr> value;
+      if (!solver->getValue(extended, segment, value, state.queryMetaData))
+        return true;
+
+      ++enumerated;
+      ++stats::segmentResolutionsEnumerated;
+      uint64_t id = value->getZExtValue();
+      excluded = AndExpr::create(
+          excluded, NeExpr::create(value, segment));
+      found.insert(id);
+      // the range check may admit segments that are not live
+      if (segmentMap.lookup(id) && addSegment(id))
+        return true;
+    }
+  }
+
+  // Too many targets to enumerate (or syntactic candidates), check the
+  // remaining candidates one by one.
+  for (uint64_t id : candidates) {
+    if (found.count(id))
+      continue;
+    if (timedOut())
       return true;
-    ref<Expr> segmentExpr = ConstantExpr::create(res.first, pointer.getWidth());
-    ref<Expr> expr = EqExpr::create(pointer.getSegment(), segmentExpr);
-    if (!solver->mayBeTrue(state.constraints, expr, mayBeTrue,
+    ref<Expr> segmentExpr = ConstantExpr::create(id, segment->getWidth());
+    bool mayBeTrue;
+    if (!solver->mayBeTrue(state.constraints,
+                           EqExpr::create(segmentExpr, segment), mayBeTrue,
                            state.queryMetaData))
       return true;
-    if (mayBeTrue) {
-      const auto &pair = *objects.lookup(res.second);
-      rl.emplace_back(pair.first, pair.second.get());
-    }
+    if (mayBeTrue && addSegment(id))
+      return true;
   }
   return false;
 }
@@ -250,10 +430,12 @@ void AddressSpace::resolveAddressWithOffset(const ExecutionState &state,
   if (!value)
     return;
 
-  for (const auto pair: concreteAddressMap) {
-    const auto& resolvedAddress = pair.first;
-    const auto& resolvedSegment = pair.second;
-    const auto *res = segmentMap.lookup(resolvedSegment);
+  std::vector<ConcreteAddressMap::Entry> candidates;
+  concreteAddressMap.findObjects(value->getZExtValue(), candidates);
+
+  for (const auto &entry : candidates) {
+    const auto& resolvedAddress = entry.address;
+    const auto *res = segmentMap.lookup(entry.segment);
 
     if (!res)
       continue;
@@ -298,11 +480,7 @@ void AddressSpace::copyOutConcretes(const SegmentAddressMap &resolved,
 
       if (!os->readOnly || ignoreReadOnly) {
         if (address) {
-          auto &concreteStore = os->offsetPlane->concreteStore;
-          concreteStore.resize(os->offsetPlane->sizeBound,
-                               os->offsetPlane->initialValue);
-
-          memcpy(address, concreteStore.data(), concreteStore.size());
+          os->offsetPlane->copyConcreteStoreTo(address);
         }
       }
     }
@@ -334,8 +512,7 @@ bool AddressSpace::copyInConcrete(const MemoryObject *mo, const ObjectState *os,
                                   ExecutionState &state,
                                   TimingSolver *solver) {
   auto address = reinterpret_cast<uint8_t*>(resolvedAddress);
-  auto &concreteStoreR = os->offsetPlane->concreteStore;
-  if (memcmp(address, concreteStoreR.data(), concreteStoreR.size())!=0) {
+  if (!os->offsetPlane->concreteStoreEquals(address)) {
     if (os->readOnly) {
       return false;
     } else {
@@ -348,10 +525,10 @@ bool AddressSpace::copyInConcrete(const MemoryObject *mo, const ObjectState *os,
 
 void AddressSpace::writeToWOS(ExecutionState &state, TimingSolver *solver,
                               const uint8_t *address, ObjectState *wos) const {
-  auto &concreteStoreW = wos->offsetPlane->concreteStore;
-  memcpy(concreteStoreW.data(), address, concreteStoreW.size());
+  wos->offsetPlane->copyConcreteStoreFrom(address);
 
-  if (concreteStoreW.size() == Context::get().getPointerWidth() / 8) {
+  if (wos->offsetPlane->getConcreteStoreSize() ==
+      Context::get().getPointerWidth() / 8) {
     KValue written = wos->read(0, Context::get().getPointerWidth());
 
     ResolutionList rl;
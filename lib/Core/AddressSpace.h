@@ -10,6 +10,7 @@
 #ifndef KLEE_ADDRESSSPACE_H
 #define KLEE_ADDRESSSPACE_H
 
+#include "ConcreteAddressMap.h"
 #include "Memory.h"
 
 #include "klee/Expr/Expr.h"
@@ -38,7 +39,6 @@ namespace klee {
   typedef ImmutableMap<const MemoryObject *, ref<ObjectState>, MemoryObjectLT>
       MemoryMap;
   typedef ImmutableMap<uint64_t, const MemoryObject*> SegmentMap;
-  typedef std::map</*address*/ const uint64_t, /*segment*/ const uint64_t> ConcreteAddressMap;
   typedef std::map</*segment*/ const uint64_t, /*address*/ const uint64_t> SegmentAddressMap;
   typedef std::map</*segment*/ const uint64_t, /*symbolic array*/ ref<Expr>> RemovedObjectsMap;
 
@@ -131,11 +131,31 @@ namespace klee {
                                 unsigned maxResolutions=0,
                                 time::Span timeout=time::Span()) const;
 
+  private:
+    /// Resolve a pointer with a symbolic segment to the objects its segment
+    /// may refer to. The feasible segments are enumerated by the solver
+    /// instead of checking every live segment, see resolve().
+    ///
+    /// \param elapsed time already spent on this resolution
+    /// \return true iff the resolution is incomplete
+    bool resolveSymbolicSegment(ExecutionState &state,
+                                TimingSolver *solver,
+                                const ref<Expr> &segment,
+                                ResolutionList &rl,
+                                unsigned maxResolutions,
+                                time::Span timeout,
+                                time::Span elapsed) const;
+
+  public:
     /***/
 
     /// Add a binding to the address space.
     void bindObject(const MemoryObject *mo, ObjectState *os);
 
+    /// Add a binding of an object state that is bound in other address
+    /// spaces as well, none of them owns it afterwards.
+    void bindSharedObject(const MemoryObject *mo, ObjectState *os);
+
     /// Remove a binding from the address space.
     void unbindObject(const MemoryObject *mo);
 
@@ -154,6 +174,17 @@ namespace klee {
     /// \return A writeable ObjectState (\a os or a copy).
     ObjectState *getWriteable(const MemoryObject *mo, const ObjectState *os);
 
+    /// \return true iff os is owned by this address space, i.e., it is not
+    /// shared with other address spaces
+    bool isOwned(const ObjectState *os) const {
+      return os->copyOnWriteOwner == cowKey;
+    }
+
+    /// Approximate memory in bytes taken by the object states owned by
+    /// this address space, i.e., the states not shared with other address
+    /// spaces.
+    uint64_t getOwnedObjectsSize() const;
+
     /// Copy the concrete values of all managed ObjectStates into the
     /// actual system memory location they were allocated at.
     void copyOutConcretes(const SegmentAddressMap &resolved,
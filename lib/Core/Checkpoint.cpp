@@ -0,0 +1,694 @@
+//===-- Checkpoint.cpp ----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Checkpoint.h"
+
+#include "AddressSpace.h"
+#include "ExecutionState.h"
+#include "Memory.h"
+#include "MemoryManager.h"
+#include "StatsTracker.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Module/Cell.h"
+#include "klee/Module/InstructionInfoTable.h"
+#include "klee/Module/KInstruction.h"
+#include "klee/Module/KModule.h"
+#include "klee/Statistics/Statistics.h"
+
+#include "llvm/IR/GlobalValue.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/IR/Module.h"
+
+using namespace klee;
+using namespace llvm;
+
+namespace {
+  /// Tags of the objects that are written once
+  enum Tag { Null = 0, Reference = 1, Definition = 2 };
+
+  /// Kinds of the allocation sites of memory objects
+  enum AllocSiteKind { NoAllocSite = 0, InstructionSite = 1, GlobalSite = 2 };
+
+  /// Kinds of the unwinding information of states
+  enum UnwindingKind { NoUnwinding = 0, SearchPhase = 1, CleanupPhase = 2 };
+}
+
+/***/
+
+CheckpointWriter::CheckpointWriter(std::ostream &os, const KModule &kmodule)
+    : StateWriter(os), kmodule(kmodule) {
+  for (const auto &kf : kmodule.functions) {
+    functions.emplace(kf.get(), functions.size());
+    for (unsigned i = 0; i < kf->numInstructions; ++i)
+      instructions.emplace(kf->instructions[i], instructions.size() + 1);
+  }
+}
+
+void CheckpointWriter::writeInstruction(const KInstruction *ki) {
+  writeInt(ki ? instructions.at(ki) : 0);
+}
+
+void CheckpointWriter::writeInstruction(const llvm::Instruction *inst) {
+  writeInstruction(
+      inst ? kmodule.getKInstruction(const_cast<llvm::Instruction *>(inst))
+           : nullptr);
+}
+
+void CheckpointWriter::writeAllocSite(const llvm::Value *allocSite) {
+  if (const auto *inst = dyn_cast_or_null<llvm::Instruction>(allocSite)) {
+    writeInt(InstructionSite);
+    writeInstruction(inst);
+  } else if (const auto *gv = dyn_cast_or_null<GlobalValue>(allocSite)) {
+    writeInt(GlobalSite);
+    writeString(gv->getName().str());
+  } else {
+    // other sites are only used to describe the objects in messages
+    writeInt(NoAllocSite);
+  }
+}
+
+void CheckpointWriter::writeArray(const Array *array) {
+  if (!array) {
+    writeInt(Null);
+    return;
+  }
+  auto it = arrays.find(array);
+  if (it != arrays.end()) {
+    writeInt(Reference);
+    writeInt(it->second);
+    return;
+  }
+
+  writeInt(Definition);
+  writeString(array->name);
+  writeInt(array->size);
+  writeInt(array->domain);
+  writeInt(array->range);
+  writeInt(array->constantValues.size());
+  for (const auto &value : array->constantValues)
+    writeExpr(value);
+  arrays.emplace(array, arrays.size());
+}
+
+void CheckpointWriter::writeMemoryObject(const MemoryObject *mo) {
+  if (!mo) {
+    writeInt(Null);
+    return;
+  }
+  auto it = objects.find(mo);
+  if (it != objects.end()) {
+    writeInt(Reference);
+    writeInt(it->second);
+    return;
+  }
+
+  writeInt(Definition);
+  writeInt(mo->id);
+  writeInt(mo->segment);
+  writeExpr(mo->size);
+  writeInt(mo->allocatedSize);
+  writeString(mo->name);
+  writeInt(mo->isLocal);
+  writeInt(mo->isGlobal);
+  writeInt(mo->isFixed);
+  writeInt(mo->isUserSpecified);
+  writeAllocSite(mo->allocSite);
+  objects.emplace(mo, objects.size());
+}
+
+void CheckpointWriter::writeObjectState(const ObjectState *os) {
+  auto it = objectStates.find(os);
+  if (it != objectStates.end()) {
+    writeInt(Reference);
+    writeInt(it->second);
+    return;
+  }
+
+  writeInt(Definition);
+  writeMemoryObject(os->getObject());
+  os->serialize(*this);
+  objectStates.emplace(os, numObjectStates++);
+  if (transient)
+    transientObjectStates.push_back(os);
+}
+
+void CheckpointWriter::forgetTransient() {
+  for (const ObjectState *os : transientObjectStates)
+    objectStates.erase(os);
+  transientObjectStates.clear();
+  StateWriter::forgetTransient();
+}
+
+void CheckpointWriter::writeModuleInfo() {
+  writeInt(functions.size());
+  writeInt(instructions.size());
+}
+
+void CheckpointWriter::writeStatistics() {
+  // the indices of the statistics of the instructions are the ids of
+  // their infos, those are written as the positions of the instructions
+  std::vector<const KInstruction *> positions(instructions.size());
+  for (const auto &ki : instructions)
+    positions[ki.second - 1] = ki.first;
+
+  bool indexed = theStatisticManager->hasIndexedStats();
+  writeInt(theStatisticManager->getNumStatistics());
+  writeInt(indexed);
+  for (unsigned i = 0; i < theStatisticManager->getNumStatistics(); ++i) {
+    const Statistic &s = theStatisticManager->getStatistic(i);
+    writeString(s.getName());
+    writeInt(s.getValue());
+    if (!indexed)
+      continue;
+
+    std::vector<std::pair<uint64_t, uint64_t>> values;
+    for (uint64_t position = 0; position < positions.size(); ++position) {
+      uint64_t value = theStatisticManager->getIndexedValue(
+          s, positions[position]->info->id);
+      if (value)
+        values.emplace_back(position, value);
+    }
+    writeInt(values.size());
+    for (const auto &value : values) {
+      writeInt(value.first);
+      writeInt(value.second);
+    }
+  }
+}
+
+void CheckpointWriter::writeState(const ExecutionState &state) {
+  assert(state.openMergeStack.empty() && "cannot write merged states");
+
+  writeInt(state.getID());
+  writeInt(state.stack.size());
+  for (const StackFrame &sf : state.stack) {
+    writeInt(functions.at(sf.kf));
+    writeInstruction(sf.caller);
+    writeInt(sf.allocas.size());
+    for (const MemoryObject *mo : sf.allocas)
+      writeMemoryObject(mo);
+    for (unsigned i = 0; i < sf.kf->numRegisters; ++i)
+      writeKValue(sf.getLocal(i));
+    writeMemoryObject(sf.varargs);
+  }
+  writeInstruction(state.pc);
+  writeInstruction(state.prevPC);
+  writeInt(state.incomingBBIndex);
+  writeInt(state.depth);
+
+  const AddressSpace &addressSpace = state.addressSpace;
+  writeInt(addressSpace.objects.size());
+  for (const auto &object : addressSpace.objects) {
+    writeMemoryObject(object.first);
+    writeObjectState(object.second.get());
+  }
+  writeInt(addressSpace.segmentMap.size());
+  for (const auto &entry : addressSpace.segmentMap) {
+    writeInt(entry.first);
+    writeMemoryObject(entry.second);
+  }
+  // the addresses are only valid in this process, the reader looks up the
+  // segments among the addresses of its own run
+  writeInt(addressSpace.concreteAddressMap.size());
+  for (const auto &entry : addressSpace.concreteAddressMap)
+    writeInt(entry.second.segment);
+  writeInt(addressSpace.removedObjectsMap.size());
+  for (const auto &entry : addressSpace.removedObjectsMap) {
+    writeInt(entry.first);
+    writeExpr(entry.second);
+  }
+
+  writeInt(state.constraints.size());
+  for (const auto &constraint : state.constraints)
+    writeExpr(constraint);
+
+  writeInt(state.coveredLines->size());
+  for (const auto &file : *state.coveredLines) {
+    writeString(*file.first);
+    writeInt(file.second.size());
+    for (std::uint32_t line : file.second)
+      writeInt(line);
+  }
+
+  writeInt(state.symbolics.size());
+  for (const auto &symbolic : state.symbolics) {
+    writeMemoryObject(symbolic.first.get());
+    writeArray(symbolic.second);
+  }
+
+  uint64_t numPreferences = 0;
+  for (auto it = state.cexPreferences.begin(), ie = state.cexPreferences.end();
+       it != ie; ++it)
+    ++numPreferences;
+  writeInt(numPreferences);
+  for (const auto &preference : state.cexPreferences)
+    writeExpr(preference);
+
+  writeInt(state.arrayNames.size());
+  for (const auto &name : state.arrayNames)
+    writeString(name);
+
+  writeInt(state.nondetValues.size());
+  for (const auto &nondet : state.nondetValues) {
+    writeKValue(nondet.value);
+    writeInt(nondet.isSigned);
+    writeInstruction(nondet.kinstruction);
+    writeString(nondet.name);
+  }
+  writeInstruction(state.lastLoopHead);
+  writeInt(state.lastLoopHeadId);
+  writeInstruction(state.lastLoopCheck);
+  writeInstruction(state.lastLoopFail);
+
+  writeInt(state.steppedInstructions);
+  writeInt(state.instsSinceCovNew);
+  writeInt(state.coveredNew);
+  writeInt(state.forkDisabled);
+
+  const UnwindingInformation *unwinding = state.unwindingInformation.get();
+  if (!unwinding) {
+    writeInt(NoUnwinding);
+  } else if (const auto *sui =
+                 dyn_cast<SearchPhaseUnwindingInformation>(unwinding)) {
+    writeInt(SearchPhase);
+    writeExpr(sui->exceptionObject);
+    writeInt(sui->unwindingProgress);
+    writeMemoryObject(sui->serializedLandingpad);
+  } else {
+    const auto *cui = cast<CleanupPhaseUnwindingInformation>(unwinding);
+    writeInt(CleanupPhase);
+    writeExpr(cui->exceptionObject);
+    writeExpr(cui->selectorValue);
+    writeInt(cui->catchingStackIndex);
+  }
+}
+
+/***/
+
+CheckpointReader::CheckpointReader(std::istream &is, KModule &kmodule,
+                                   MemoryManager &memory,
+                                   ArrayCache &arrayCache,
+                                   StatsTracker *statsTracker,
+                                   const AddressSpace &initial)
+    : StateReader(is), kmodule(kmodule), memory(memory),
+      arrayCache(arrayCache), statsTracker(statsTracker), initial(initial) {
+  for (const auto &kf : kmodule.functions) {
+    for (unsigned i = 0; i < kf->numInstructions; ++i) {
+      instructions.emplace_back(kf.get(), i);
+      const std::string &file = kf->instructions[i]->info->file;
+      files.emplace(file, &file);
+    }
+  }
+}
+
+bool CheckpointReader::readModuleInfo() {
+  uint64_t numFunctions = readInt();
+  uint64_t numInstructions = readInt();
+  return good() && numFunctions == kmodule.functions.size() &&
+         numInstructions == instructions.size();
+}
+
+void CheckpointReader::readStatistics() {
+  uint64_t numStatistics = readInt();
+  bool indexed = readInt();
+  for (; numStatistics > 0 && good(); --numStatistics) {
+    // statistics that this build does not have are skipped
+    Statistic *s = theStatisticManager->getStatisticByName(readString());
+    uint64_t value = readInt();
+    if (s)
+      theStatisticManager->setValue(*s, value);
+    if (!indexed)
+      continue;
+
+    for (uint64_t count = readInt(); count > 0 && good(); --count) {
+      uint64_t position = readInt();
+      uint64_t value = readInt();
+      if (position >= instructions.size()) {
+        fail();
+        break;
+      }
+      if (s && theStatisticManager->hasIndexedStats()) {
+        const auto &ki = instructions[position];
+        theStatisticManager->setIndexedValue(
+            *s, ki.first->instructions[ki.second]->info->id, value);
+      }
+    }
+  }
+}
+
+KInstIterator CheckpointReader::readInstruction() {
+  uint64_t id = readInt();
+  if (id == 0)
+    return KInstIterator();
+  if (id > instructions.size()) {
+    fail();
+    return KInstIterator();
+  }
+  const auto &position = instructions[id - 1];
+  return KInstIterator(position.first->instructions + position.second);
+}
+
+const llvm::Instruction *CheckpointReader::readLLVMInstruction() {
+  KInstIterator ki = readInstruction();
+  return ki ? ki->inst : nullptr;
+}
+
+KFunction *CheckpointReader::readFunction() {
+  uint64_t index = readInt();
+  if (index >= kmodule.functions.size()) {
+    fail();
+    return nullptr;
+  }
+  return kmodule.functions[index].get();
+}
+
+const llvm::Value *CheckpointReader::readAllocSite() {
+  switch (readInt()) {
+  case NoAllocSite:
+    return nullptr;
+  case InstructionSite:
+    return readLLVMInstruction();
+  case GlobalSite: {
+    const GlobalValue *gv = kmodule.module->getNamedValue(readString());
+    if (!gv)
+      fail();
+    return gv;
+  }
+  default:
+    fail();
+    return nullptr;
+  }
+}
+
+const Array *CheckpointReader::readArray() {
+  // A placeholder keeps the update lists well-formed once the stream is
+  // broken, the callers are expected to check good() when done.
+  if (!brokenArray)
+    brokenArray = arrayCache.CreateArray("broken_checkpoint_arr", 0);
+
+  switch (readInt()) {
+  case Null:
+    return nullptr;
+  case Reference: {
+    uint64_t id = readInt();
+    if (id >= arrays.size()) {
+      fail();
+      return brokenArray;
+    }
+    return arrays[id];
+  }
+  case Definition:
+    break;
+  default:
+    fail();
+    return brokenArray;
+  }
+
+  std::string name = readString();
+  uint64_t size = readInt();
+  Expr::Width domain = readInt();
+  Expr::Width range = readInt();
+  std::vector<ref<ConstantExpr>> values(readInt());
+  for (ref<ConstantExpr> &value : values) {
+    value = dyn_cast<ConstantExpr>(readExpr());
+    if (value.isNull() || value->getWidth() != range)
+      fail();
+  }
+  if (!good() || (!values.empty() && values.size() != size))
+    fail();
+  if (!good())
+    return brokenArray;
+
+  const Array *array =
+      values.empty()
+          ? arrayCache.CreateArray(name, size, nullptr, nullptr, domain, range)
+          : arrayCache.CreateArray(name, size, &values[0],
+                                   &values[0] + values.size(), domain, range);
+  arrays.push_back(array);
+  return array;
+}
+
+MemoryObject *CheckpointReader::readMemoryObject() {
+  switch (readInt()) {
+  case Null:
+    return nullptr;
+  case Reference: {
+    uint64_t id = readInt();
+    if (id >= objects.size()) {
+      fail();
+      return nullptr;
+    }
+    return objects[id].get();
+  }
+  case Definition:
+    break;
+  default:
+    fail();
+    return nullptr;
+  }
+
+  unsigned id = readInt();
+  uint64_t segment = readInt();
+  ref<Expr> size = readExpr();
+  uint64_t allocatedSize = readInt();
+  std::string name = readString();
+  bool isLocal = readInt();
+  bool isGlobal = readInt();
+  bool isFixed = readInt();
+  bool isUserSpecified = readInt();
+  const llvm::Value *allocSite = readAllocSite();
+  if (!good() || size.isNull())
+    return nullptr;
+
+  MemoryObject *mo = nullptr;
+  if (const auto *res = initial.segmentMap.lookup(segment)) {
+    // the objects allocated before resuming must be the same as in the
+    // run that wrote the checkpoint
+    mo = const_cast<MemoryObject *>(res->second);
+    if (mo->allocSite != allocSite || mo->allocatedSize != allocatedSize) {
+      fail();
+      return nullptr;
+    }
+  } else {
+    mo = memory.allocateAt(segment, size, allocatedSize, isLocal, isGlobal,
+                           isFixed, allocSite);
+    mo->id = id;
+  }
+  mo->setName(name);
+  mo->isGlobal = isGlobal;
+  mo->isUserSpecified = isUserSpecified;
+  objects.emplace_back(mo);
+  return mo;
+}
+
+ObjectState *CheckpointReader::readObjectState(bool &shared) {
+  shared = true;
+  switch (readInt()) {
+  case Reference: {
+    uint64_t id = readInt();
+    if (id >= objectStates.size()) {
+      fail();
+      return nullptr;
+    }
+    return objectStates[id].get();
+  }
+  case Definition:
+    break;
+  default:
+    fail();
+    return nullptr;
+  }
+
+  shared = false;
+  const MemoryObject *mo = readMemoryObject();
+  if (!mo)
+    return nullptr;
+  objectStates.emplace_back(new ObjectState(mo, *this));
+  return objectStates.back().get();
+}
+
+/// Delete a state that was not read completely.
+static void deleteBrokenState(ExecutionState *state) {
+  if (!state)
+    return;
+  // the allocas of the broken frames may be missing
+  for (StackFrame &sf : state->stack)
+    sf.allocas.clear();
+  delete state;
+}
+
+ExecutionState *CheckpointReader::readState() {
+  std::uint32_t id = readInt();
+  uint64_t numFrames = readInt();
+  if (!good() || numFrames == 0) {
+    fail();
+    return nullptr;
+  }
+
+  ExecutionState *state = nullptr;
+  for (uint64_t i = 0; i < numFrames; ++i) {
+    KFunction *kf = readFunction();
+    KInstIterator caller = readInstruction();
+    if (!good())
+      break;
+
+    if (!state) {
+      state = new ExecutionState(kf);
+      state->id = id;
+    } else {
+      state->pushFrame(caller, kf);
+    }
+    if (statsTracker)
+      statsTracker->framePushed(*state, state->stack.size() > 1
+                                            ? &state->stack.end()[-2]
+                                            : nullptr);
+
+    StackFrame &sf = state->stack.back();
+    for (uint64_t numAllocas = readInt(); numAllocas > 0 && good();
+         --numAllocas)
+      sf.allocas.push_back(readMemoryObject());
+    for (unsigned reg = 0; reg < kf->numRegisters; ++reg)
+      sf.getWriteableLocal(reg) = Cell(readKValue());
+    sf.varargs = readMemoryObject();
+  }
+  if (!good()) {
+    deleteBrokenState(state);
+    return nullptr;
+  }
+  state->pc = readInstruction();
+  state->prevPC = readInstruction();
+  state->incomingBBIndex = readInt();
+  state->depth = readInt();
+
+  AddressSpace &addressSpace = state->addressSpace;
+  for (uint64_t count = readInt(); count > 0 && good(); --count) {
+    const MemoryObject *mo = readMemoryObject();
+    bool shared;
+    ObjectState *os = readObjectState(shared);
+    if (!mo || !os) {
+      fail();
+      break;
+    }
+    if (shared)
+      addressSpace.bindSharedObject(mo, os);
+    else
+      addressSpace.bindObject(mo, os);
+  }
+  addressSpace.segmentMap = SegmentMap();
+  for (uint64_t count = readInt(); count > 0 && good(); --count) {
+    uint64_t segment = readInt();
+    const MemoryObject *mo = readMemoryObject();
+    if (mo)
+      addressSpace.segmentMap = addressSpace.segmentMap.replace({segment, mo});
+  }
+  for (uint64_t count = readInt(); count > 0 && good(); --count) {
+    uint64_t segment = readInt(), address;
+    const auto *res = initial.segmentMap.lookup(segment);
+    // objects that got their addresses in external calls get new ones
+    // in the next call
+    if (res && initial.resolveInConcreteMap(segment, address))
+      addressSpace.concreteAddressMap.emplace(address, res->second);
+  }
+  for (uint64_t count = readInt(); count > 0 && good(); --count) {
+    uint64_t segment = readInt();
+    addressSpace.removedObjectsMap.emplace(segment, readExpr());
+  }
+
+  std::vector<ref<Expr>> constraints(readInt());
+  for (ref<Expr> &constraint : constraints)
+    constraint = readExpr();
+  state->constraints = ConstraintSet(std::move(constraints));
+
+  for (uint64_t count = readInt(); count > 0 && good(); --count) {
+    auto it = files.find(readString());
+    if (it == files.end()) {
+      fail();
+      break;
+    }
+    std::set<std::uint32_t> &lines =
+        (*state->coveredLines.getWriteable())[it->second];
+    for (uint64_t numLines = readInt(); numLines > 0 && good(); --numLines)
+      lines.insert(readInt());
+  }
+
+  for (uint64_t count = readInt(); count > 0 && good(); --count) {
+    const MemoryObject *mo = readMemoryObject();
+    const Array *array = readArray();
+    if (!mo || !array) {
+      fail();
+      break;
+    }
+    state->addSymbolic(mo, array);
+  }
+
+  for (uint64_t count = readInt(); count > 0 && good(); --count)
+    state->cexPreferences = state->cexPreferences.insert(readExpr());
+
+  for (uint64_t count = readInt(); count > 0 && good(); --count)
+    state->arrayNames = state->arrayNames.insert(readString());
+
+  for (uint64_t count = readInt(); count > 0 && good(); --count) {
+    KValue value = readKValue();
+    bool isSigned = readInt();
+    KInstruction *ki = readInstruction();
+    std::string name = readString();
+    state->addNondetValue(value, isSigned, ki, name);
+  }
+  state->lastLoopHead = const_cast<llvm::Instruction *>(readLLVMInstruction());
+  state->lastLoopHeadId = readInt();
+  state->lastLoopCheck = const_cast<llvm::Instruction *>(readLLVMInstruction());
+  state->lastLoopFail = const_cast<llvm::Instruction *>(readLLVMInstruction());
+
+  state->steppedInstructions = readInt();
+  state->instsSinceCovNew = readInt();
+  state->coveredNew = readInt();
+  state->forkDisabled = readInt();
+
+  switch (readInt()) {
+  case NoUnwinding:
+    break;
+  case SearchPhase: {
+    ref<ConstantExpr> exceptionObject = dyn_cast<ConstantExpr>(readExpr());
+    std::size_t unwindingProgress = readInt();
+    MemoryObject *landingpad = readMemoryObject();
+    if (exceptionObject.isNull()) {
+      fail();
+      break;
+    }
+    auto sui = std::make_unique<SearchPhaseUnwindingInformation>(
+        exceptionObject, unwindingProgress);
+    sui->serializedLandingpad = landingpad;
+    state->unwindingInformation = std::move(sui);
+    break;
+  }
+  case CleanupPhase: {
+    ref<ConstantExpr> exceptionObject = dyn_cast<ConstantExpr>(readExpr());
+    ref<ConstantExpr> selectorValue = dyn_cast<ConstantExpr>(readExpr());
+    std::size_t catchingStackIndex = readInt();
+    if (exceptionObject.isNull() || selectorValue.isNull()) {
+      fail();
+      break;
+    }
+    state->unwindingInformation =
+        std::make_unique<CleanupPhaseUnwindingInformation>(
+            exceptionObject, selectorValue, catchingStackIndex);
+    break;
+  }
+  default:
+    fail();
+  }
+
+  if (!good() || !state->pc) {
+    fail();
+    deleteBrokenState(state);
+    return nullptr;
+  }
+  return state;
+}
@@ -0,0 +1,134 @@
+//===-- Checkpoint.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_CHECKPOINT_H
+#define KLEE_CHECKPOINT_H
+
+#include "StateSerializer.h"
+
+#include "klee/ADT/Ref.h"
+#include "klee/Module/KInstIterator.h"
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace llvm {
+  class Instruction;
+  class Value;
+}
+
+namespace klee {
+  class AddressSpace;
+  class ArrayCache;
+  class ExecutionState;
+  struct KFunction;
+  struct KInstruction;
+  class KModule;
+  class MemoryManager;
+  class MemoryObject;
+  class ObjectState;
+  class StatsTracker;
+
+  /// Writes execution states to a checkpoint of the whole run.
+  ///
+  /// Unlike spilled states, checkpoints are read by another process, so
+  /// arrays are written by their contents, memory objects by their
+  /// segments and properties, and functions and instructions by their
+  /// positions in the module. Every memory object and object state is
+  /// written once, object states shared by several states stay shared.
+  class CheckpointWriter : public StateWriter {
+    std::unordered_map<const KFunction *, uint64_t> functions;
+    /// Positions of the instructions in the functions of the module, the
+    /// ids of their infos differ between runs
+    std::unordered_map<const KInstruction *, uint64_t> instructions;
+    std::unordered_map<const Array *, uint64_t> arrays;
+    std::unordered_map<const MemoryObject *, uint64_t> objects;
+    std::unordered_map<const ObjectState *, uint64_t> objectStates;
+    /// The number of object states written so far
+    uint64_t numObjectStates = 0;
+    /// The object states written since beginTransient
+    std::vector<const ObjectState *> transientObjectStates;
+    const KModule &kmodule;
+
+    void writeInstruction(const KInstruction *ki);
+    void writeInstruction(const llvm::Instruction *inst);
+    void writeAllocSite(const llvm::Value *allocSite);
+    void writeMemoryObject(const MemoryObject *mo);
+    void writeObjectState(const ObjectState *os);
+
+  public:
+    CheckpointWriter(std::ostream &os, const KModule &kmodule);
+
+    void writeArray(const Array *array) override;
+    void forgetTransient() override;
+
+    /// Write the shape of the module, the reader checks that it runs the
+    /// same module.
+    void writeModuleInfo();
+    /// Write the values of all statistics, including the statistics of
+    /// the instructions if they are kept.
+    void writeStatistics();
+
+    /// Write a state, it may not be spilled or take part in a merge. The
+    /// written states may not release their objects before the writer is
+    /// done, as they are shared by their addresses, unless they were
+    /// written between beginTransient and forgetTransient.
+    void writeState(const ExecutionState &state);
+  };
+
+  /// Reads the states of a checkpoint written by CheckpointWriter.
+  class CheckpointReader : public StateReader {
+    /// (function, index) of the instructions by their positions
+    std::vector<std::pair<KFunction *, unsigned>> instructions;
+    /// Source file names of the module by their contents
+    std::unordered_map<std::string, const std::string *> files;
+    std::vector<const Array *> arrays;
+    std::vector<ref<MemoryObject>> objects;
+    std::vector<ref<ObjectState>> objectStates;
+    const Array *brokenArray = nullptr;
+
+    KModule &kmodule;
+    MemoryManager &memory;
+    ArrayCache &arrayCache;
+    StatsTracker *statsTracker;
+    /// The address space of the initial state of this run, its objects
+    /// (globals and arguments) are used for the objects at their segments
+    const AddressSpace &initial;
+
+    KInstIterator readInstruction();
+    const llvm::Instruction *readLLVMInstruction();
+    KFunction *readFunction();
+    const llvm::Value *readAllocSite();
+    MemoryObject *readMemoryObject();
+    ObjectState *readObjectState(bool &shared);
+
+  public:
+    CheckpointReader(std::istream &is, KModule &kmodule, MemoryManager &memory,
+                     ArrayCache &arrayCache, StatsTracker *statsTracker,
+                     const AddressSpace &initial);
+
+    const Array *readArray() override;
+
+    /// \return true if the module info written by the checkpoint matches
+    /// the module of this run
+    bool readModuleInfo();
+    /// Set the statistics to the values written by the checkpoint.
+    void readStatistics();
+
+    /// Read a state written by CheckpointWriter::writeState.
+    /// \return the state, null if the checkpoint is malformed or does not
+    /// match this run
+    ExecutionState *readState();
+  };
+
+} // namespace klee
+
+#endif /* KLEE_CHECKPOINT_H */
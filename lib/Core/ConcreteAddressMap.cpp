@@ -0,0 +1,119 @@
+//===-- ConcreteAddressMap.cpp --------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "ConcreteAddressMap.h"
+
+#include "Memory.h"
+
+#include "klee/Expr/Expr.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace klee;
+
+bool ConcreteAddressMap::emplace(uint64_t address, const MemoryObject *mo) {
+  uint64_t end = std::numeric_limits<uint64_t>::max();
+  if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(mo->size)) {
+    // zero-sized objects still own the address they start at
+    uint64_t size = std::max<uint64_t>(CE->getZExtValue(), 1);
+    if (address + size > address)
+      end = address + size;
+  }
+
+  Entry entry{address, mo->segment, end};
+  if (!byAddress.emplace(address, entry).second)
+    return false;
+  bySegment.emplace(mo->segment, address);
+  nodes.push_back(Node{entry, end, None, None, 1});
+  root = insert(root, nodes.size() - 1);
+  return true;
+}
+
+bool ConcreteAddressMap::findAddress(uint64_t segment,
+                                     uint64_t &address) const {
+  auto it = bySegment.find(segment);
+  if (it == bySegment.end())
+    return false;
+  address = it->second;
+  return true;
+}
+
+void ConcreteAddressMap::update(unsigned n) {
+  Node &node = nodes[n];
+  node.height = 1 + std::max(height(node.left), height(node.right));
+  node.maxEnd =
+      std::max(node.entry.end, std::max(maxEnd(node.left), maxEnd(node.right)));
+}
+
+unsigned ConcreteAddressMap::rotateLeft(unsigned n) {
+  unsigned right = nodes[n].right;
+  nodes[n].right = nodes[right].left;
+  nodes[right].left = n;
+  update(n);
+  update(right);
+  return right;
+}
+
+unsigned ConcreteAddressMap::rotateRight(unsigned n) {
+  unsigned left = nodes[n].left;
+  nodes[n].left = nodes[left].right;
+  nodes[left].right = n;
+  update(n);
+  update(left);
+  return left;
+}
+
+unsigned ConcreteAddressMap::balance(unsigned n) {
+  update(n);
+  unsigned left = nodes[n].left, right = nodes[n].right;
+  if (height(left) > height(right) + 1) {
+    if (height(nodes[left].left) < height(nodes[left].right))
+      nodes[n].left = rotateLeft(left);
+    return rotateRight(n);
+  }
+  if (height(right) > height(left) + 1) {
+    if (height(nodes[right].right) < height(nodes[right].left))
+      nodes[n].right = rotateRight(right);
+    return rotateLeft(n);
+  }
+  return n;
+}
+
+unsigned ConcreteAddressMap::insert(unsigned n, unsigned fresh) {
+  if (n == None)
+    return fresh;
+  if (nodes[fresh].entry.address < nodes[n].entry.address) {
+    unsigned left = insert(nodes[n].left, fresh);
+    nodes[n].left = left;
+  } else {
+    unsigned right = insert(nodes[n].right, fresh);
+    nodes[n].right = right;
+  }
+  return balance(n);
+}
+
+void ConcreteAddressMap::collect(unsigned n, uint64_t address,
+                                 std::vector<Entry> &result) const {
+  // no object in the subtree reaches the address
+  if (n == None || nodes[n].maxEnd <= address)
+    return;
+  const Node &node = nodes[n];
+  collect(node.left, address, result);
+  if (node.entry.address > address)
+    return;
+  if (node.entry.end > address)
+    result.push_back(node.entry);
+  collect(node.right, address, result);
+}
+
+void ConcreteAddressMap::findObjects(uint64_t address,
+                                     std::vector<Entry> &result) const {
+  collect(root, address, result);
+}
@@ -0,0 +1,93 @@
+//===-- ConcreteAddressMap.h ------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_CONCRETEADDRESSMAP_H
+#define KLEE_CONCRETEADDRESSMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+namespace klee {
+  class MemoryObject;
+
+  /// Bidirectional map between the concrete addresses at which objects
+  /// were made visible to the outside world (external calls, globals,
+  /// fixed objects) and their segments.
+  ///
+  /// Segments are looked up in a hash map. The objects are also kept in an
+  /// interval tree: an AVL tree ordered by address whose nodes know the
+  /// largest end below them. Both inserting an object and finding the
+  /// objects that may contain an address then take logarithmic time (plus
+  /// the number of objects found), however insertions and lookups mix.
+  class ConcreteAddressMap {
+  public:
+    struct Entry {
+      uint64_t address;
+      uint64_t segment;
+      /// One past the last address that may belong to the object,
+      /// UINT64_MAX if the size of the object is not constant.
+      uint64_t end;
+    };
+
+  private:
+    /// address -> entry; only the first object at an address is kept
+    std::map<uint64_t, Entry> byAddress;
+    /// segment -> address of the first entry with the segment
+    std::unordered_map<uint64_t, uint64_t> bySegment;
+
+    struct Node {
+      Entry entry;
+      /// the largest end of the entries in the subtree of the node
+      uint64_t maxEnd;
+      unsigned left, right, height;
+    };
+    static const unsigned None = ~0u;
+
+    /// The interval tree, its nodes referred to by their index so that the
+    /// map copies like a value.
+    std::vector<Node> nodes;
+    unsigned root = None;
+
+    unsigned height(unsigned n) const { return n == None ? 0 : nodes[n].height; }
+    uint64_t maxEnd(unsigned n) const { return n == None ? 0 : nodes[n].maxEnd; }
+    void update(unsigned n);
+    unsigned rotateLeft(unsigned n);
+    unsigned rotateRight(unsigned n);
+    unsigned balance(unsigned n);
+    unsigned insert(unsigned n, unsigned fresh);
+    void collect(unsigned n, uint64_t address,
+                 std::vector<Entry> &result) const;
+
+  public:
+    typedef std::map<uint64_t, Entry>::const_iterator iterator;
+
+    /// Record that object mo is visible at address.
+    /// \return false if there already is an object at address
+    bool emplace(uint64_t address, const MemoryObject *mo);
+
+    /// Looks up the (first) address of the given segment.
+    /// \param[out] address found address for the segment
+    /// \return true iff the segment has an address
+    bool findAddress(uint64_t segment, uint64_t &address) const;
+
+    /// Collects, in increasing order of addresses, the entries of objects
+    /// that may contain the given address.
+    void findObjects(uint64_t address, std::vector<Entry> &result) const;
+
+    iterator begin() const { return byAddress.begin(); }
+    iterator end() const { return byAddress.end(); }
+    size_t size() const { return byAddress.size(); }
+    bool empty() const { return byAddress.empty(); }
+  };
+} // End klee namespace
+
+#endif /* KLEE_CONCRETEADDRESSMAP_H */
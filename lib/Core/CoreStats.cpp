@@ -12,6 +12,8 @@
 using namespace klee;
 
 Statistic stats::allocations("Allocations", "Alloc");
+Statistic stats::boundsCheckQueriesAvoided("BoundsCheckQueriesAvoided",
+                                           "BCavoid");
 Statistic stats::coveredInstructions("CoveredInstructions", "Icov");
 Statistic stats::falseBranches("FalseBranches", "Bf");
 Statistic stats::forkTime("ForkTime", "Ftime");
@@ -21,8 +23,17 @@ Statistic stats::instructionTime("InstructionTimes", "Itime");
 Statistic stats::instructions("Instructions", "I");
 Statistic stats::minDistToReturn("MinDistToReturn", "Rdist");
 Statistic stats::minDistToUncovered("MinDistToUncovered", "UCdist");
+Statistic stats::objectBytesCopied("ObjectBytesCopied", "OBcopied");
+Statistic stats::objectBytesShared("ObjectBytesShared", "OBshared");
+Statistic stats::queriesDecidedByBounds("QueriesDecidedByBounds", "QBdec");
 Statistic stats::resolveTime("ResolveTime", "Rtime");
+Statistic stats::segmentResolutionsEnumerated("SegmentResolutionsEnumerated",
+                                              "SRenum");
+Statistic stats::segmentResolutionsSyntactic("SegmentResolutionsSyntactic",
+                                             "SRsynt");
 Statistic stats::solverTime("SolverTime", "Stime");
+Statistic stats::stateSpills("StateSpills", "Spills");
 Statistic stats::states("States", "States");
 Statistic stats::trueBranches("TrueBranches", "Bt");
 Statistic stats::uncoveredInstructions("UncoveredInstructions", "Iuncov");
+Statistic stats::updateListRebases("UpdateListRebases", "ULrebase");
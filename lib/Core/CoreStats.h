@@ -16,6 +16,23 @@ namespace klee {
 namespace stats {
 
   extern Statistic allocations;
+
+  /// The number of solver queries saved by deciding (parts of) bounds
+  /// checks of memory accesses without the solver.
+  extern Statistic boundsCheckQueriesAvoided;
+
+  /// The number of validity queries decided by the known bits and the
+  /// intervals of the expressions without the solver.
+  extern Statistic queriesDecidedByBounds;
+
+  /// The number of bytes of object contents (including their masks)
+  /// cloned when a shared page was written.
+  extern Statistic objectBytesCopied;
+
+  /// The number of bytes of object contents (including their masks)
+  /// shared instead of copied when an object was copied.
+  extern Statistic objectBytesShared;
+
   extern Statistic resolveTime;
   extern Statistic instructions;
   extern Statistic instructionTime;
@@ -27,6 +44,18 @@ namespace stats {
   extern Statistic forkTime;
   extern Statistic solverTime;
 
+  /// The number of segments of symbolic pointers found by enumerating
+  /// models of the segment expression.
+  extern Statistic segmentResolutionsEnumerated;
+
+  /// The number of symbolic segments resolved using the constants they
+  /// are syntactically built from.
+  extern Statistic segmentResolutionsSyntactic;
+
+  /// The number of update lists folded into the concrete stores of their
+  /// objects because they grew too long.
+  extern Statistic updateListRebases;
+
   /// The number of process forks.
   extern Statistic forks;
 
@@ -34,6 +63,10 @@ namespace stats {
   /// isn't normally up-to-date.
   extern Statistic states;
 
+  /// The number of times a state was spilled to disk instead of being
+  /// terminated over the memory cap.
+  extern Statistic stateSpills;
+
   /// Instruction level statistic tracking the minimum intraprocedural
   /// distance to an uncovered instruction; this is only periodically
   /// updated.
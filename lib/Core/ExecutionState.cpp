@@ -48,25 +48,8 @@ std::uint32_t ExecutionState::nextID = 1;
 
 StackFrame::StackFrame(KInstIterator _caller, KFunction *_kf)
   : caller(_caller), kf(_kf), callPathNode(0), 
-    minDistToUncoveredOnReturn(0), varargs(0) {
-  locals = new Cell[kf->numRegisters];
-}
-
-StackFrame::StackFrame(const StackFrame &s) 
-  : caller(s.caller),
-    kf(s.kf),
-    callPathNode(s.callPathNode),
-    allocas(s.allocas),
-    minDistToUncoveredOnReturn(s.minDistToUncoveredOnReturn),
-    varargs(s.varargs) {
-  locals = new Cell[s.kf->numRegisters];
-  for (unsigned i=0; i<s.kf->numRegisters; i++)
-    locals[i] = s.locals[i];
-}
-
-StackFrame::~StackFrame() { 
-  delete[] locals; 
-}
+    locals(new std::vector<Cell>(kf->numRegisters)),
+    minDistToUncoveredOnReturn(0), varargs(0) {}
 
 /***/
 
@@ -121,7 +104,7 @@ ExecutionState *ExecutionState::branch() {
   auto *falseState = new ExecutionState(*this);
   falseState->setID();
   falseState->coveredNew = false;
-  falseState->coveredLines.clear();
+  falseState->coveredLines.reset();
 
   return falseState;
 }
@@ -161,14 +144,13 @@ void ExecutionState::removeAlloca(const MemoryObject *mo) {
   }
 }
 
-ExecutionState::NondetValue&
-ExecutionState::addNondetValue(const KValue &kval, bool isSigned, const std::string& name) {
-    nondetValues.emplace_back(kval, isSigned, name);
-    return nondetValues.back();
+void ExecutionState::addNondetValue(const KValue &kval, bool isSigned,
+                                    KInstruction *ki, const std::string &name) {
+  nondetValues.push_back(NondetValue(kval, isSigned, ki, name));
 }
 
 void ExecutionState::addSymbolic(const MemoryObject *mo, const Array *array) {
-  symbolics.emplace_back(ref<const MemoryObject>(mo), array);
+  symbolics.push_back(std::make_pair(ref<const MemoryObject>(mo), array));
 }
 
 /**/
@@ -318,13 +300,13 @@ bool ExecutionState::merge(const ExecutionState &b) {
     StackFrame &af = *itA;
     const StackFrame &bf = *itB;
     for (unsigned i=0; i<af.kf->numRegisters; i++) {
-      ref<Expr> &av = af.locals[i].value;
-      const ref<Expr> &bv = bf.locals[i].value;
+      ref<Expr> av = af.getLocal(i).value;
+      const ref<Expr> &bv = bf.getLocal(i).value;
       if (!av || !bv) {
         // if one is null then by implication (we are at same pc)
         // we cannot reuse this local, so just ignore
       } else {
-        av = SelectExpr::create(inA, av, bv);
+        af.getWriteableLocal(i).value = SelectExpr::create(inA, av, bv);
       }
     }
   }
@@ -380,7 +362,7 @@ void ExecutionState::dumpStack(llvm::raw_ostream &out) const {
       if (ai->hasName())
         out << ai->getName().str() << "=";
 
-      ref<Expr> value = sf.locals[sf.kf->getArgRegister(index++)].value;
+      ref<Expr> value = sf.getLocal(sf.kf->getArgRegister(index++)).value;
       if (isa_and_nonnull<ConstantExpr>(value)) {
         out << value;
       } else {
@@ -395,6 +377,17 @@ void ExecutionState::dumpStack(llvm::raw_ostream &out) const {
   }
 }
 
+std::uint64_t ExecutionState::getApproximateMemoryUsage() const {
+  std::uint64_t size = sizeof(*this) + addressSpace.getOwnedObjectsSize();
+  for (const StackFrame &sf : stack) {
+    size += sizeof(sf) + sf.kf->numRegisters * sizeof(Cell) +
+            sf.allocas.size() * sizeof(sf.allocas[0]);
+  }
+  size += constraints.size() * sizeof(ref<Expr>);
+  size += symbolics.size() * sizeof(symbolics[0]);
+  return size;
+}
+
 void ExecutionState::addConstraint(ref<Expr> e) {
   ConstraintManager c(constraints);
   c.addConstraint(e);
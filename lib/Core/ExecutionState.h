@@ -14,10 +14,12 @@
 #include "MergeHandler.h"
 
 #include "klee/ADT/ImmutableSet.h"
+#include "klee/ADT/PersistentVector.h"
 #include "klee/ADT/TreeStream.h"
 #include "klee/Core/ConcreteValue.h"
 #include "klee/Expr/Constraints.h"
 #include "klee/Expr/Expr.h"
+#include "klee/Module/Cell.h"
 #include "klee/Module/KInstIterator.h"
 #include "klee/Solver/Solver.h"
 #include "klee/System/Time.h"
@@ -30,7 +32,6 @@
 namespace klee {
 class Array;
 class CallPathNode;
-struct Cell;
 struct KFunction;
 struct KInstruction;
 class MemoryObject;
@@ -39,13 +40,49 @@ struct InstructionInfo;
 
 llvm::raw_ostream &operator<<(llvm::raw_ostream &os, const MemoryMap &mm);
 
+/// Shared pointer with copy-on-write support
+///
+/// Copies share the object until one of them writes it, a null pointer
+/// reads as a default constructed object.
+template <typename T>
+class cow_shared_ptr {
+  std::shared_ptr<T> ptr{nullptr};
+
+public:
+  cow_shared_ptr() = default;
+  cow_shared_ptr(T *p) : ptr(p) {}
+
+  const T *get() const { return ptr.get(); }
+
+  const T &operator*() const {
+    static const T empty{};
+    return ptr ? *ptr : empty;
+  }
+  const T *operator->() const { return &**this; }
+
+  T *getWriteable() {
+    // an object is shared as long as another copy points to it, so that
+    // neither of them writes the object of the other
+    if (!ptr)
+      ptr = std::make_shared<T>();
+    else if (ptr.use_count() > 1)
+      ptr = std::make_shared<T>(*ptr);
+    return ptr.get();
+  }
+
+  void reset() { ptr.reset(); }
+  void swap(cow_shared_ptr &other) { ptr.swap(other.ptr); }
+};
+
 struct StackFrame {
   KInstIterator caller;
   KFunction *kf;
   CallPathNode *callPathNode;
 
   std::vector<const MemoryObject *> allocas;
-  Cell *locals;
+  /// The values of the registers, shared with the copies of the frame
+  /// until one of them writes a register
+  cow_shared_ptr<std::vector<Cell>> locals;
 
   /// Minimum distance to an uncovered instruction once the function
   /// returns. This is not a good place for this but is used to
@@ -62,38 +99,9 @@ struct StackFrame {
   MemoryObject *varargs;
 
   StackFrame(KInstIterator caller, KFunction *kf);
-  StackFrame(const StackFrame &s);
-  ~StackFrame();
-};
 
-/// Shared pointer with copy-on-write support
-template <typename T>
-class cow_shared_ptr {
-  std::shared_ptr<T> ptr{nullptr};
-  // am I the owner of the copy?
-  bool owner{false};
-
-public:
-  cow_shared_ptr() = default;
-  cow_shared_ptr(T *p) : ptr(p) {}
-  cow_shared_ptr(cow_shared_ptr&&) = delete;
-  cow_shared_ptr(const cow_shared_ptr& rhs)
-      : ptr(rhs.ptr), owner(false) {}
-
-  const T *get() const { return ptr.get(); }
-
-  T *getWriteable() {
-    if (owner)
-      return ptr.get();
-    // create a copy of the object and claim the ownership
-    if (ptr) {
-      ptr.reset(new T(*get()));
-    } else {
-      ptr.reset(new T());
-    }
-    owner = true;
-    return ptr.get();
-  }
+  const Cell &getLocal(unsigned reg) const { return (*locals)[reg]; }
+  Cell &getWriteableLocal(unsigned reg) { return (*locals.getWriteable())[reg]; }
 };
 
 /// Contains information related to unwinding (Itanium ABI/2-Phase unwinding)
@@ -215,7 +223,7 @@ public:
 
     bool isSigned{false};
     KInstruction *kinstruction{nullptr};
-    const std::string name{};
+    std::string name{};
     // when an instruction that creates a nondet value is called
     // several times, we can assign a sequential number to each
     // of the values here
@@ -227,8 +235,7 @@ public:
     //bool hasConcreteValue() const { return concreteValue.hasValue(); }
   };
 
-  // FIXME: wouldn't unique_ptr be more efficient (no ref<> copying)
-  std::vector<NondetValue> nondetValues;
+  PersistentVector<NondetValue> nondetValues;
   // FIXME: this is a hack to be able to generate termination witnesses for SV-COMP
   llvm::Instruction *lastLoopHead{nullptr};
   size_t lastLoopHeadId{0};
@@ -275,23 +282,22 @@ public:
   TreeOStream symPathOS;
 
   /// @brief Set containing which lines in which files are covered by this state
-  std::map<const std::string *, std::set<std::uint32_t>> coveredLines;
+  cow_shared_ptr<std::map<const std::string *, std::set<std::uint32_t>>>
+      coveredLines;
 
   /// @brief Pointer to the process tree of the current state
   /// Copies of ExecutionState should not copy ptreeNode
   PTreeNode *ptreeNode = nullptr;
 
   /// @brief Ordered list of symbolics: used to generate test cases.
-  //
-  // FIXME: Move to a shared list structure (not critical).
-  std::vector<std::pair<ref<const MemoryObject>, const Array *>> symbolics;
+  PersistentVector<std::pair<ref<const MemoryObject>, const Array *>> symbolics;
 
   /// @brief A set of boolean expressions
   /// the user has requested be true of a counterexample.
   ImmutableSet<ref<Expr>> cexPreferences;
 
   /// @brief Set of used array names for this state.  Used to avoid collisions.
-  std::set<std::string> arrayNames;
+  ImmutableSet<std::string> arrayNames;
 
   /// @brief The objects handling the klee_open_merge calls this state ran through
   std::vector<ref<MergeHandler>> openMergeStack;
@@ -348,11 +354,17 @@ public:
   bool merge(const ExecutionState &b);
   void dumpStack(llvm::raw_ostream &out) const;
 
+  /// Approximate memory in bytes that would be freed by terminating this
+  /// state: the object states it owns, its stack, constraints and
+  /// symbolics. Expressions, object states and pages shared with other
+  /// states are not counted.
+  std::uint64_t getApproximateMemoryUsage() const;
+
   std::uint32_t getID() const { return id; };
   void setID() { id = nextID++; };
 
-  NondetValue& addNondetValue(const KValue &expr, bool isSigned,
-                              const std::string& name);
+  void addNondetValue(const KValue &expr, bool isSigned, KInstruction *ki,
+                      const std::string &name);
 };
 
 struct ExecutionStateIDCompare {
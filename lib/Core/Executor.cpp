@@ -9,6 +9,7 @@
 
 #include "Executor.h"
 
+#include "Checkpoint.h"
 #include "Context.h"
 #include "CoreStats.h"
 #include "ExecutionState.h"
@@ -17,10 +18,12 @@
 #include "ImpliedValue.h"
 #include "Memory.h"
 #include "MemoryManager.h"
+#include "OffsetRange.h"
 #include "PTree.h"
 #include "Searcher.h"
 #include "SeedInfo.h"
 #include "SpecialFunctionHandler.h"
+#include "StateSpiller.h"
 #include "StatsTracker.h"
 #include "TimingSolver.h"
 #include "UserSearcher.h"
@@ -368,6 +371,28 @@ cl::opt<bool> MaxMemoryInhibit(
     cl::init(true),
     cl::cat(TerminationCat));
 
+cl::opt<bool> SpillStates(
+    "spill-states",
+    cl::desc("Spill states to disk instead of terminating them when above "
+             "memory cap (see -max-memory), they are loaded back when "
+             "selected (default=false)"),
+    cl::init(false),
+    cl::cat(TerminationCat));
+
+cl::opt<std::string> SpillDirectory(
+    "spill-dir",
+    cl::desc("Directory for the states spilled by -spill-states "
+             "(default=spilled-states in the output directory)"),
+    cl::cat(TerminationCat));
+
+cl::opt<std::string> CheckpointInterval(
+    "checkpoint-interval",
+    cl::desc("Write a checkpoint of the run to the output directory at "
+             "this interval and when the run is halted with states left, "
+             "see --resume-from.  Set to 0s to disable (default=0s)"),
+    cl::init("0s"),
+    cl::cat(TerminationCat));
+
 cl::opt<unsigned> RuntimeMaxStackFrames(
     "max-stack-frames",
     cl::desc("Terminate a state after this many stack frames.  Set to 0 to "
@@ -490,6 +515,12 @@ Executor::Executor(LLVMContext &ctx, const InterpreterOptions &opts,
         setHaltExecution(true);
       }));
 
+  const time::Span checkpointInterval{CheckpointInterval};
+  if (checkpointInterval) timers.add(
+        std::make_unique<Timer>(checkpointInterval, [&]{
+        checkpointDue = true;
+      }));
+
   coreSolverTimeout = time::Span{MaxCoreSolverTime};
   if (coreSolverTimeout) UseForkedCoreSolver = true;
   Solver *coreSolver = klee::createCoreSolver(CoreSolverToUse);
@@ -662,7 +693,7 @@ MemoryObject *Executor::addExternalObject(ExecutionState &state, void *addr,
                                           uint64_t specialSegment) {
   auto mo = memory->allocateFixed(size, nullptr, specialSegment);
   state.addressSpace.concreteAddressMap.emplace(
-      reinterpret_cast<uint64_t>(addr), mo->segment);
+      reinterpret_cast<uint64_t>(addr), mo);
   ObjectState *os = bindObjectInState(state, mo, false);
   for(unsigned i = 0; i < size; i++)
     os->write8(i, (uint8_t)mo->segment, ((uint8_t*)addr)[i]);
@@ -873,9 +904,10 @@ void Executor::initializeGlobalObjects(ExecutionState &state) {
         unsigned id = 0;
         auto name = v.getName().str();
         auto uniqueName = name;
-        while (!state.arrayNames.insert(uniqueName).second) {
+        while (state.arrayNames.count(uniqueName)) {
           uniqueName = name + "_" + llvm::utostr(++id);
         }
+        state.arrayNames = state.arrayNames.insert(uniqueName);
         const Array *array = arrayCache.CreateArray(uniqueName, size);
         bindObjectInState(state, mo, false, array);
         state.addSymbolic(mo, array);
@@ -892,7 +924,7 @@ void Executor::initializeGlobalObjects(ExecutionState &state) {
 
       initializedMOs.emplace(mo->segment, reinterpret_cast<uint64_t>(address));
       state.addressSpace.concreteAddressMap.emplace(
-          reinterpret_cast<uint64_t>(address), mo->getSegment());
+          reinterpret_cast<uint64_t>(address), mo);
       state.addressSpace.segmentMap.replace({mo->getSegment(), mo});
 
       initializeGlobalObject(state, os, v.getInitializer(), 0);
@@ -1231,7 +1263,7 @@ Executor::StatePair Executor::fork(ExecutionState &current, ref<Expr> condition,
       }
       if (swapInfo) {
         std::swap(trueState->coveredNew, falseState->coveredNew);
-        std::swap(trueState->coveredLines, falseState->coveredLines);
+        trueState->coveredLines.swap(falseState->coveredLines);
       }
     }
 
@@ -1317,8 +1349,8 @@ const Cell& Executor::eval(KInstruction *ki, unsigned index,
     return kmodule->constantTable[index];
   } else {
     unsigned index = vnumber;
-    StackFrame &sf = state.stack.back();
-    return sf.locals[index];
+    const StackFrame &sf = state.stack.back();
+    return sf.getLocal(index);
   }
 }
 
@@ -3513,6 +3545,9 @@ void Executor::updateStates(ExecutionState *current) {
     if (it3 != seedMap.end())
       seedMap.erase(it3);
     processTree->remove(es->ptreeNode);
+    std::vector<ref<const MemoryObject>> spilledObjects;
+    if (stateSpiller)
+      spilledObjects = stateSpiller->discard(*es);
     delete es;
   }
   removedStates.clear();
@@ -3590,6 +3625,18 @@ void Executor::bindModuleConstants() {
   }
 }
 
+/// The value of a state for the coverage, used to pick the states that are
+/// terminated when over the memory cap. States that covered new code are
+/// worth more, the more new lines they covered.
+static double getCoverageValue(const ExecutionState &state) {
+  double value = 1;
+  if (state.coveredNew)
+    value += 1;
+  for (const auto &file : *state.coveredLines)
+    value += file.second.size();
+  return value;
+}
+
 bool Executor::checkMemoryUsage() {
   if (!MaxMemory) return true;
 
@@ -3599,8 +3646,12 @@ bool Executor::checkMemoryUsage() {
   if ((stats::instructions & 0xFFFFU) != 0) // every 65536 instructions
     return true;
 
-  // check memory limit
-  const auto mallocUsage = util::GetTotalMallocUsage() >> 20U;
+  // check memory limit, the free memory of the expression allocator is
+  // reused by new expressions
+  const std::size_t mallocSize = util::GetTotalMallocUsage();
+  const std::size_t exprFreeSize = exprAllocator.getFreeSize();
+  const auto mallocUsage =
+      (mallocSize > exprFreeSize ? mallocSize - exprFreeSize : 0) >> 20U;
   const auto mmapUsage = memory->getUsedDeterministicSize() >> 20U;
   const auto totalUsage = mallocUsage + mmapUsage;
   atMemoryLimit = totalUsage > MaxMemory; // inhibit forking
@@ -3611,22 +3662,66 @@ bool Executor::checkMemoryUsage() {
   if (totalUsage <= MaxMemory + 100)
     return true;
 
-  // just guess at how many to kill
+  // Spill or terminate the states that free the most memory per unit of
+  // coverage value first, until they free the memory over the cap.
   const auto numStates = states.size();
+  struct Candidate {
+    ExecutionState *state;
+    std::uint64_t size;
+    double score;
+  };
+  std::vector<Candidate> candidates;
+  candidates.reserve(numStates);
+  for (ExecutionState *state : states) {
+    std::uint64_t size = state->getApproximateMemoryUsage();
+    candidates.push_back({state, size, size / getCoverageValue(*state)});
+  }
+  std::sort(candidates.begin(), candidates.end(),
+            [](const Candidate &a, const Candidate &b) {
+              if (a.score != b.score)
+                return a.score > b.score;
+              return a.state->getID() < b.state->getID();
+            });
+
+  const std::uint64_t excess = (totalUsage - MaxMemory) << 20U;
+  std::uint64_t freed = 0;
+
+  // States in seed mode are not selected by the searcher, so they are
+  // never spilled.
+  if (stateSpiller && seedMap.empty()) {
+    unsigned spilled = 0;
+    for (const Candidate &candidate : candidates) {
+      if (freed >= excess)
+        break;
+      ExecutionState &state = *candidate.state;
+      if (stateSpiller->isSpilled(state) || !state.openMergeStack.empty())
+        continue;
+      std::uint64_t size = stateSpiller->spill(state);
+      if (size == 0)
+        break;
+      freed += size;
+      ++spilled;
+    }
+    if (spilled > 0)
+      klee_message("spilled %u states to disk (over memory cap: %luMB)",
+                   spilled, totalUsage);
+    if (freed >= excess)
+      return true;
+  }
+
+  // just guess at how many to kill
   auto toKill = std::max(1UL, numStates - numStates * MaxMemory / totalUsage);
   klee_warning("killing %lu states (over memory cap: %luMB)", toKill, totalUsage);
 
-  // randomly select states for early termination
-  std::vector<ExecutionState *> arr(states.begin(), states.end()); // FIXME: expensive
-  for (unsigned i = 0, N = arr.size(); N && i < toKill; ++i, --N) {
-    unsigned idx = theRNG.getInt32() % N;
-    // Make two pulls to try and not hit a state that
-    // covered new code.
-    if (arr[idx]->coveredNew)
-      idx = theRNG.getInt32() % N;
-
-    std::swap(arr[idx], arr[N - 1]);
-    terminateStateEarly(*arr[N - 1], "Memory limit exceeded.", StateTerminationType::OutOfMemory);
+  for (unsigned i = 0; i < candidates.size() && toKill > 0 && freed < excess;
+       ++i) {
+    // spilled states do not take much memory anymore
+    if (stateSpiller && stateSpiller->isSpilled(*candidates[i].state))
+      continue;
+    freed += candidates[i].size;
+    --toKill;
+    terminateStateEarly(*candidates[i].state, "Memory limit exceeded.",
+                        StateTerminationType::OutOfMemory);
   }
 
   return false;
@@ -3644,16 +3739,156 @@ void Executor::doDumpStates() {
   updateStates(nullptr);
 }
 
-void Executor::run(ExecutionState &initialState) {
+static const char checkpointMagic[] = "KLEE checkpoint 1";
+
+void Executor::writeCheckpoint() {
+  for (const ExecutionState *state : states) {
+    if (!state->openMergeStack.empty()) {
+      // try again once the merge is closed
+      klee_warning_once(0, "postponing checkpoint while states are merged");
+      return;
+    }
+  }
+  checkpointDue = false;
+
+  const std::string path = interpreterHandler->getOutputFilename("checkpoint");
+  const std::string tmpPath = path + ".tmp";
+  {
+    std::ofstream os(tmpPath, std::ios::binary | std::ios::trunc);
+    CheckpointWriter writer(os, *kmodule);
+    writer.writeBytes(checkpointMagic, sizeof(checkpointMagic));
+    writer.writeModuleInfo();
+    writer.writeBytes(&theRNG, sizeof(theRNG));
+    writer.writeInt(ExecutionState::nextID);
+    writer.writeInt(MemoryObject::getNextID());
+    writer.writeInt(memory->getLastSegment());
+
+    // The spilled states are loaded one at a time after the states in
+    // memory, and spilled again once they were written. The writer shares
+    // what it wrote by address, so it forgets what it wrote for a spilled
+    // state before the state releases it.
+    std::vector<ExecutionState *> spilled;
+    writer.writeInt(states.size());
+    for (ExecutionState *state : states) {
+      if (stateSpiller && stateSpiller->isSpilled(*state))
+        spilled.push_back(state);
+      else
+        writer.writeState(*state);
+    }
+    for (ExecutionState *state : spilled) {
+      stateSpiller->restore(*state);
+      writer.beginTransient();
+      writer.writeState(*state);
+      writer.forgetTransient();
+      stateSpiller->spill(*state);
+    }
+    processTree->serialize(writer);
+
+    const auto counters = interpreterHandler->getOutputCounters();
+    writer.writeInt(counters.numTotalTests);
+    writer.writeInt(counters.numGeneratedTests);
+    writer.writeInt(counters.pathsCompleted);
+    writer.writeInt(counters.pathsExplored);
+    writer.writeStatistics();
+
+    os.flush();
+    if (!writer.good()) {
+      klee_warning("unable to write checkpoint to %s", tmpPath.c_str());
+      os.close();
+      llvm::sys::fs::remove(tmpPath);
+      return;
+    }
+  }
+
+  // replace the previous checkpoint only once the new one is complete
+  if (std::error_code ec = llvm::sys::fs::rename(tmpPath, path)) {
+    klee_warning("unable to write checkpoint to %s: %s", path.c_str(),
+                 ec.message().c_str());
+    return;
+  }
+  klee_message("wrote checkpoint of %zu states to %s", states.size(),
+               path.c_str());
+}
+
+std::vector<ExecutionState *>
+Executor::resumeFromCheckpoint(const ExecutionState &initialState) {
+  std::ifstream is(resumeCheckpoint, std::ios::binary);
+  if (!is)
+    klee_error("unable to open checkpoint %s", resumeCheckpoint.c_str());
+
+  CheckpointReader reader(is, *kmodule, *memory, arrayCache, statsTracker,
+                          initialState.addressSpace);
+  char magic[sizeof(checkpointMagic)] = {};
+  reader.readBytes(magic, sizeof(magic));
+  if (!reader.good() || std::memcmp(magic, checkpointMagic, sizeof(magic)))
+    klee_error("%s is not a checkpoint", resumeCheckpoint.c_str());
+  if (!reader.readModuleInfo())
+    klee_error("checkpoint %s was written for a different module",
+               resumeCheckpoint.c_str());
+
+  reader.readBytes(&theRNG, sizeof(theRNG));
+  const std::uint32_t nextStateID = reader.readInt();
+  const int nextObjectID = reader.readInt();
+  const uint64_t lastSegment = reader.readInt();
+
+  std::vector<ExecutionState *> resumed;
+  std::map<std::uint32_t, ExecutionState *> statesByID;
+  for (uint64_t numStates = reader.readInt(); numStates > 0 && reader.good();
+       --numStates) {
+    ExecutionState *state = reader.readState();
+    if (!state)
+      break;
+    resumed.push_back(state);
+    statesByID[state->getID()] = state;
+  }
+  if (reader.good())
+    processTree = std::make_unique<PTree>(reader, statesByID);
+
+  InterpreterHandler::OutputCounters counters;
+  counters.numTotalTests = reader.readInt();
+  counters.numGeneratedTests = reader.readInt();
+  counters.pathsCompleted = reader.readInt();
+  counters.pathsExplored = reader.readInt();
+  reader.readStatistics();
+
+  if (!reader.good() || resumed.size() != statesByID.size() ||
+      std::any_of(resumed.begin(), resumed.end(),
+                  [](const ExecutionState *state) { return !state->ptreeNode; }))
+    klee_error("checkpoint %s is malformed or does not match this run",
+               resumeCheckpoint.c_str());
+  interpreterHandler->setOutputCounters(counters);
+
+  // spilled states were written after the states in memory
+  std::sort(resumed.begin(), resumed.end(), ExecutionStateIDCompare());
+
+  ExecutionState::nextID = nextStateID;
+  MemoryObject::setNextID(std::max(nextObjectID, MemoryObject::getNextID()));
+  memory->setLastSegment(std::max(lastSegment, memory->getLastSegment()));
+
+  // the recorded paths of the resumed states start at the checkpoint
+  for (ExecutionState *state : resumed) {
+    if (pathWriter)
+      state->pathOS = pathWriter->open();
+    if (symPathWriter)
+      state->symPathOS = symPathWriter->open();
+  }
+
+  klee_message("resumed %zu states from %s", resumed.size(),
+               resumeCheckpoint.c_str());
+  return resumed;
+}
+
+void Executor::run(const std::vector<ExecutionState *> &initialStates) {
   bindModuleConstants();
 
   // Delay init till now so that ticks don't accrue during optimization and such.
   timers.reset();
 
-  states.insert(&initialState);
+  states.insert(initialStates.begin(), initialStates.end());
 
   if (usingSeeds) {
-    std::vector<SeedInfo> &v = seedMap[&initialState];
+    assert(initialStates.size() == 1 && "seeding a resumed run");
+    std::vector<SeedInfo> &v = seedMap[initialStates.front()];
     
     for (std::vector<KTest*>::const_iterator it = usingSeeds->begin(), 
            ie = usingSeeds->end(); it != ie; ++it)
@@ -3723,6 +3958,8 @@ void Executor::run(ExecutionState &initialState) {
   // main interpreter loop
   while (!states.empty() && !haltExecution) {
     ExecutionState &state = searcher->selectState();
+    if (stateSpiller)
+      stateSpiller->restore(state);
     KInstruction *ki = state.pc;
     stepInstruction(state);
 
@@ -3737,8 +3974,15 @@ void Executor::run(ExecutionState &initialState) {
       // update searchers when states were terminated early due to memory pressure
       updateStates(nullptr);
     }
+
+    if (checkpointDue && !states.empty())
+      writeCheckpoint();
   }
 
+  // keep the states of an interrupted run
+  if (haltExecution && !states.empty() && time::Span{CheckpointInterval})
+    writeCheckpoint();
+
   delete searcher;
   searcher = nullptr;
 
@@ -4053,6 +4297,9 @@ void Executor::terminateStateOnExit(ExecutionState &state) {
 
 void Executor::terminateStateEarly(ExecutionState &state, const Twine &message,
                                    StateTerminationType terminationType) {
+  if (stateSpiller)
+    stateSpiller->restore(state);
+
   if (ExitOnErrorType.empty() &&
       ((terminationType <= StateTerminationType::EXECERR &&
        shouldWriteTest(state)) ||
@@ -4526,7 +4773,7 @@ void Executor::callExternalFunction(ExecutionState &state,
     os << "calling external: " << callable->getName().str() << "(";
     for (unsigned i=0; i<arguments.size(); i++) {
       if (arguments[i].value->isZero()) {
-        os << "segment: " << arguments[i].pointerSegment;
+        os << "segment: " << arguments[i].getSegment();
       } else {
         os << "value/address: " << arguments[i].value;
       }
@@ -4605,10 +4852,8 @@ ref<Expr> Executor::replaceReadWithSymbolic(ExecutionState &state,
   // create a new fresh location, assert it is equal to concrete value in e
   // and return it.
   
-  static unsigned id;
-  const Array *array =
-      arrayCache.CreateArray("rrws_arr" + llvm::utostr(++id),
-                             Expr::getMinBytesForWidth(e->getWidth()));
+  const Array *array = arrayCache.CreateFreshArray(
+      "rrws_arr", Expr::getMinBytesForWidth(e->getWidth()));
   ref<Expr> res = Expr::createTempRead(array, e->getWidth());
   ref<Expr> eq = NotOptimizedExpr::create(EqExpr::create(e, res));
   llvm::errs() << "Making symbolic: " << eq << "\n";
@@ -4753,6 +4998,61 @@ void Executor::executeMemoryWrite(ExecutionState &state,
                                   const KValue &value) {
   executeMemoryOperation(state, true, address, value, 0);
 }
+bool Executor::mustBeInBounds(ExecutionState &state, const MemoryObject *mo,
+                              ref<Expr> segment, ref<Expr> offset,
+                              unsigned bytes, bool &result) {
+  ref<Expr> isEqualSegment = EqExpr::create(mo->getSegmentExpr(), segment);
+  ref<Expr> isOffsetInBounds = mo->getBoundsCheckOffset(offset, bytes);
+  isOffsetInBounds = optimizer.optimizeExpr(isOffsetInBounds, true);
+
+  // the bounds of a check may decide it whatever the constraints are
+  for (ref<Expr> *check : {&isEqualSegment, &isOffsetInBounds}) {
+    const ExprBounds &bounds = (*check)->getBounds();
+    if (!isa<ConstantExpr>(*check) && bounds.isConstant()) {
+      ++stats::queriesDecidedByBounds;
+      *check = ConstantExpr::create(bounds.min, Expr::Bool);
+    }
+  }
+
+  // The segment check folds to a constant for constant segments, the offset
+  // check may be decided by the range of the offset when the size is
+  // constant. Each check decided here saves a query compared to checking
+  // both parts separately.
+  if (!isa<ConstantExpr>(isOffsetInBounds) && isa<ConstantExpr>(mo->size)) {
+    uint64_t size = cast<ConstantExpr>(mo->size)->getZExtValue();
+    if (size >= bytes) {
+      UnsignedRange range =
+          OffsetRangeEvaluator(state.constraints).evaluate(offset);
+      if (range.max <= size - bytes)
+        isOffsetInBounds = ConstantExpr::create(1, Expr::Bool);
+      else if (range.min > size - bytes)
+        isOffsetInBounds = ConstantExpr::create(0, Expr::Bool);
+    }
+  }
+
+  unsigned decided = 0;
+  for (const ref<Expr> &check : {isEqualSegment, isOffsetInBounds}) {
+    if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(check)) {
+      ++decided;
+      if (CE->isFalse()) {
+        stats::boundsCheckQueriesAvoided += 2;
+        result = false;
+        return true;
+      }
+    }
+  }
+
+  // both parts are checked by one query
+  stats::boundsCheckQueriesAvoided += std::max(decided, 1u);
+  if (decided == 2) {
+    result = true;
+    return true;
+  }
+  return solver->mustBeTrue(state.constraints,
+                            AndExpr::create(isEqualSegment, isOffsetInBounds),
+                            result, state.queryMetaData);
+}
+
 void Executor::executeMemoryOperation(ExecutionState &state,
                                       bool isWrite,
                                       KValue address,
@@ -4809,26 +5109,17 @@ void Executor::executeMemoryOperation(ExecutionState &state,
       offset = address.getOffset();
     }
 
-    ref<Expr> isEqualSegment = EqExpr::create(mo->getSegmentExpr(), segment);
-
-    ref<Expr> isOffsetInBounds = mo->getBoundsCheckOffset(offset, bytes);
-    isOffsetInBounds = optimizer.optimizeExpr(isOffsetInBounds, true);
-
-    bool inBoundsOffset;
-    bool inBoundsSegment;
+    bool inBounds;
     solver->setTimeout(coreSolverTimeout);
-    bool successSegment = solver->mustBeTrue(
-        state.constraints, isEqualSegment, inBoundsSegment, state.queryMetaData);
-    bool success = solver->mustBeTrue(
-        state.constraints, isOffsetInBounds, inBoundsOffset, state.queryMetaData);
+    bool success = mustBeInBounds(state, mo, segment, offset, bytes, inBounds);
     solver->setTimeout(time::Span());
-    if (!success || !successSegment) {
+    if (!success) {
       state.pc = state.prevPC;
       terminateStateOnSolverError(state, "Query timed out (bounds check).");
       return;
     }
 
-    if (inBoundsSegment && inBoundsOffset) {
+    if (inBounds) {
       const ObjectState *os = op.second;
       if (isWrite) {
         if (os->readOnly) {
@@ -4837,6 +5128,7 @@ void Executor::executeMemoryOperation(ExecutionState &state,
         } else {
           ObjectState *wos = state.addressSpace.getWriteable(mo, os);
           wos->write(offset, value);
+          wos->rebaseUpdateLists();
         }          
       } else {
         KValue result = os->read(offset, type);
@@ -4885,6 +5177,7 @@ void Executor::executeMemoryOperation(ExecutionState &state,
           ObjectState *wos = bound->addressSpace.getWriteable(mo, os);
           // TODO segment
           wos->write(addressOptim.getOffset(), value);
+          wos->rebaseUpdateLists();
         }
       } else {
         KValue result = os->read(addressOptim.getOffset(), type);
@@ -4919,9 +5212,10 @@ KValue Executor::createNondetValue(ExecutionState &state,
   // or if that fails try adding a unique identifier.
   unsigned id = 0;
   std::string uniqueName = name;
-  while (!state.arrayNames.insert(uniqueName).second) {
+  while (state.arrayNames.count(uniqueName)) {
     uniqueName = name + "_" + llvm::utostr(++id);
   }
+  state.arrayNames = state.arrayNames.insert(uniqueName);
 
   KValue kval;
   const Array *array = arrayCache.CreateArray(uniqueName, size);
@@ -4930,9 +5224,8 @@ KValue Executor::createNondetValue(ExecutionState &state,
   if (isPointer) {
     assert(!isSigned && "Got signed pointer");
     std::string offName = uniqueName + "_off";
-    bool had = state.arrayNames.insert(offName).second;
-    assert(had && "Already had a unique name");
-    (void)had;
+    assert(!state.arrayNames.count(offName) && "Already had a unique name");
+    state.arrayNames = state.arrayNames.insert(offName);
 
     const Array *offarray
         = arrayCache.CreateArray(offName, Context::get().getPointerWidth());
@@ -4942,8 +5235,7 @@ KValue Executor::createNondetValue(ExecutionState &state,
     kval = expr;
   }
 
-  auto& nv = state.addNondetValue(kval, isSigned, name);
-  nv.kinstruction = kinst;
+  state.addNondetValue(kval, isSigned, kinst, name);
 
   return kval;
 }
@@ -4958,9 +5250,10 @@ void Executor::executeMakeSymbolic(ExecutionState &state,
     // or if that fails try adding a unique identifier.
     unsigned id = 0;
     std::string uniqueName = name;
-    while (!state.arrayNames.insert(uniqueName).second) {
+    while (state.arrayNames.count(uniqueName)) {
       uniqueName = name + "_" + llvm::utostr(++id);
     }
+    state.arrayNames = state.arrayNames.insert(uniqueName);
     // TODO fix seeding fo symbolic sizes
     unsigned size = 0;
     if (ConstantExpr *CE = dyn_cast<ConstantExpr>(mo->size)) {
@@ -5138,8 +5431,23 @@ void Executor::runFunctionAsMain(Function *f,
   
   initializeGlobals(*state);
 
-  processTree = std::make_unique<PTree>(state);
-  run(*state);
+  std::vector<ExecutionState *> initialStates;
+  if (resumeCheckpoint.empty()) {
+    processTree = std::make_unique<PTree>(state);
+    initialStates.push_back(state);
+  } else {
+    // the initial state only provided the objects that are allocated
+    // before the run (globals and arguments) at their segments
+    initialStates = resumeFromCheckpoint(*state);
+    delete state;
+  }
+  if (SpillStates)
+    stateSpiller = std::make_unique<StateSpiller>(
+        SpillDirectory.empty()
+            ? interpreterHandler->getOutputFilename("spilled-states")
+            : SpillDirectory.getValue());
+  run(initialStates);
+  stateSpiller = nullptr;
   processTree = nullptr;
 
   // hack to clear memory objects
@@ -5361,7 +5669,7 @@ Executor::getTestVector(const ExecutionState &state) {
 
 void Executor::getCoveredLines(const ExecutionState &state,
                                std::map<const std::string*, std::set<unsigned> > &res) {
-  res = state.coveredLines;
+  res = *state.coveredLines;
 }
 
 void Executor::doImpliedValueConcretization(ExecutionState &state,
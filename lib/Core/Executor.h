@@ -76,6 +76,7 @@ namespace klee {
   class Searcher;
   class SeedInfo;
   class SpecialFunctionHandler;
+  class StateSpiller;
   struct StackFrame;
   class StatsTracker;
   class TimingSolver;
@@ -119,6 +120,18 @@ private:
   TimerGroup timers;
   std::unique_ptr<PTree> processTree;
 
+  /// Holds the states spilled to disk over the memory cap (see
+  /// --spill-states), null if spilling is disabled.
+  std::unique_ptr<StateSpiller> stateSpiller;
+
+  /// The checkpoint to resume the run from (see --resume-from), empty if
+  /// the run starts at the entry point.
+  std::string resumeCheckpoint;
+
+  /// Set by the checkpoint timer (see --checkpoint-interval), the
+  /// checkpoint is written once the current instruction is done.
+  bool checkpointDue = false;
+
   /// Used to track states that have been added during the current
   /// instructions step. 
   /// \invariant \ref addedStates is a subset of \ref states. 
@@ -224,7 +237,18 @@ private:
 
   void executeInstruction(ExecutionState &state, KInstruction *ki);
 
-  void run(ExecutionState &initialState);
+  void run(const std::vector<ExecutionState *> &initialStates);
+
+  /// Write all states together with the process tree, statistics and
+  /// output counters to the checkpoint file in the output directory.
+  void writeCheckpoint();
+
+  /// Read the states of the checkpoint to resume from, and restore the
+  /// process tree, statistics and output counters.
+  /// \param initialState the initial state of this run, its objects are
+  /// used for the objects of the checkpoint with the same segments
+  std::vector<ExecutionState *>
+  resumeFromCheckpoint(const ExecutionState &initialState);
 
   // Given a concrete object in our [klee's] address space, add it to 
   // objects checked code can reference.
@@ -340,6 +364,17 @@ private:
   void executeMemoryWrite(ExecutionState &state,
                           const KValue &address,
                           const KValue &value);
+  /// Check that an access of the given number of bytes at segment and
+  /// offset must lie within the memory object. The parts of the check that
+  /// can be decided syntactically or by a range analysis of the offset are
+  /// decided without the solver, the rest is sent as a single query.
+  ///
+  /// \param[out] result true iff the access must be in bounds
+  /// \return false iff the solver failed
+  bool mustBeInBounds(ExecutionState &state, const MemoryObject *mo,
+                      ref<Expr> segment, ref<Expr> offset, unsigned bytes,
+                      bool &result);
+
   // do address resolution / object binding / out of bounds checking
   // and perform the operation
   void executeMemoryOperation(ExecutionState &state,
@@ -394,12 +429,12 @@ private:
   Cell& getArgumentCell(ExecutionState &state,
                         KFunction *kf,
                         unsigned index) {
-    return state.stack.back().locals[kf->getArgRegister(index)];
+    return state.stack.back().getWriteableLocal(kf->getArgRegister(index));
   }
 
   Cell& getDestCell(ExecutionState &state,
                     KInstruction *target) {
-    return state.stack.back().locals[target->dest];
+    return state.stack.back().getWriteableLocal(target->dest);
   }
 
   void bindLocal(KInstruction *target,
@@ -560,6 +595,10 @@ public:
     usingSeeds = seeds;
   }
 
+  void setResumeCheckpoint(const std::string &path) override {
+    resumeCheckpoint = path;
+  }
+
   void runFunctionAsMain(llvm::Function *f, int argc, char **argv,
                          char **envp) override;
 
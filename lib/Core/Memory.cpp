@@ -10,8 +10,10 @@
 #include "Memory.h"
 
 #include "Context.h"
+#include "CoreStats.h"
 #include "ExecutionState.h"
 #include "MemoryManager.h"
+#include "StateSerializer.h"
 
 #include "klee/Expr/ArrayCache.h"
 #include "klee/Expr/Expr.h"
@@ -37,6 +39,22 @@ namespace {
                     cl::desc("Use constant arrays instead of updates when possible (default=true)\n"),
                     cl::init(true),
                     cl::cat(SolvingCat));
+
+  cl::opt<unsigned> RebaseUpdateLists(
+      "rebase-update-lists",
+      cl::desc("Drop the updates no read can see from the update list of "
+               "an object, and fold its writes of constants into a constant "
+               "array, once the list has grown by more than this since it "
+               "was last rebased (default=256, 0=off)"),
+      cl::init(256),
+      cl::cat(SolvingCat));
+
+  cl::opt<unsigned> RebaseMaxObjectSize(
+      "rebase-max-object-size",
+      cl::desc("Do not rebase update lists of objects larger than this, "
+               "rebasing marks every byte of the object (default=4096)"),
+      cl::init(4096),
+      cl::cat(SolvingCat));
 }
 
 /***/
@@ -97,9 +115,8 @@ ObjectStatePlane::ObjectStatePlane(const ObjectState *parent)
     symbolic(false),
     initialValue(0) {
   if (!UseConstantArrays) {
-    static unsigned id = 0;
     const Array *array =
-        parent->getArrayCache()->CreateArray("tmp_arr" + llvm::utostr(++id), sizeBound);
+        parent->getArrayCache()->CreateFreshArray("tmp_arr", sizeBound);
     updates = UpdateList(array, 0);
   }
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(parent->getObject()->size)) {
@@ -130,8 +147,82 @@ ObjectStatePlane::ObjectStatePlane(const ObjectState *parent, const ObjectStateP
     sizeBound(os.sizeBound),
     initialized(os.initialized),
     symbolic(os.symbolic),
-    initialValue(os.initialValue) {
+    initialValue(os.initialValue),
+    rebasedLength(os.rebasedLength) {
   assert(!os.parent->readOnly && "no need to copy read only object?");
+  stats::objectBytesShared += concreteStore.getSizeInBytes() +
+                              concreteMask.getSizeInBytes() +
+                              unflushedMask.getSizeInBytes();
+}
+
+static void writeBits(StateWriter &writer, const PagedBitArray &bits) {
+  std::vector<uint8_t> bytes((bits.size() + 7) / 8);
+  for (unsigned i = 0; i < bits.size(); ++i) {
+    if (bits.get(i))
+      bytes[i / 8] |= 1 << (i % 8);
+  }
+  writer.writeInt(bits.size());
+  writer.writeBytes(bytes.data(), bytes.size());
+}
+
+static void readBits(StateReader &reader, PagedBitArray &bits) {
+  unsigned size = reader.readInt();
+  std::vector<uint8_t> bytes((size + 7) / 8);
+  reader.readBytes(bytes.data(), bytes.size());
+  bits.resize(size);
+  for (unsigned i = 0; i < size; ++i) {
+    if ((bytes[i / 8] >> (i % 8)) & 1)
+      bits.set(i);
+  }
+}
+
+ObjectStatePlane::ObjectStatePlane(const ObjectState *parent,
+                                   StateReader &reader)
+  : parent(parent),
+    updates(nullptr, nullptr) {
+  sizeBound = reader.readInt();
+  initialized = reader.readInt();
+  symbolic = reader.readInt();
+  initialValue = reader.readInt();
+
+  std::vector<uint8_t> bytes(reader.readInt());
+  reader.readBytes(bytes.data(), bytes.size());
+  concreteStore.resize(bytes.size());
+  concreteStore.copyFrom(bytes.data(), 0, bytes.size());
+  readBits(reader, concreteMask);
+  readBits(reader, unflushedMask);
+
+  for (uint64_t count = reader.readInt(); count > 0 && reader.good();
+       --count) {
+    uint64_t index = reader.readInt();
+    knownSymbolics.set(index, reader.readExpr());
+  }
+  updates = reader.readUpdateList();
+}
+
+void ObjectStatePlane::serialize(StateWriter &writer) const {
+  writer.writeInt(sizeBound);
+  writer.writeInt(initialized);
+  writer.writeInt(symbolic);
+  writer.writeInt(initialValue);
+
+  std::vector<uint8_t> bytes(concreteStore.size());
+  concreteStore.copyTo(bytes.data(), 0, bytes.size());
+  writer.writeInt(bytes.size());
+  writer.writeBytes(bytes.data(), bytes.size());
+  writeBits(writer, concreteMask);
+  writeBits(writer, unflushedMask);
+
+  std::vector<std::pair<uint64_t, ref<Expr>>> known;
+  knownSymbolics.forEach([&known](uint64_t index, const ref<Expr> &e) {
+    known.emplace_back(index, e);
+  });
+  writer.writeInt(known.size());
+  for (const auto &byte : known) {
+    writer.writeInt(byte.first);
+    writer.writeExpr(byte.second);
+  }
+  writer.writeUpdateList(updates);
 }
 
 /***/
@@ -158,19 +249,27 @@ const UpdateList &ObjectStatePlane::getUpdates() const {
     for (unsigned i = 0, e = sizeBound; i != e; ++i)
       Contents[i] = ConstantExpr::create(0, Expr::Int8);
 
-    // Pull off as many concrete writes as we can.
+    // Pull off as many concrete writes as we can: those before the first
+    // write at a symbolic offset, unless an earlier write of a symbolic
+    // value to the same offset is kept.
     unsigned Begin = 0, End = Writes.size();
+    std::vector<bool> Kept(sizeBound);
+    std::vector< std::pair< ref<Expr>, ref<Expr> > > Remaining;
     for (; Begin != End; ++Begin) {
       // Push concrete writes into the constant array.
       ConstantExpr *Index = dyn_cast<ConstantExpr>(Writes[Begin].first);
       if (!Index)
         break;
 
+      uint64_t Offset = Index->getZExtValue();
       ConstantExpr *Value = dyn_cast<ConstantExpr>(Writes[Begin].second);
-      if (!Value)
-        break;
+      if (!Value || Kept[Offset]) {
+        Kept[Offset] = true;
+        Remaining.push_back(Writes[Begin]);
+        continue;
+      }
 
-      Contents[Index->getZExtValue()] = Value;
+      Contents[Offset] = Value;
     }
 
     static unsigned id = 0;
@@ -186,6 +285,8 @@ const UpdateList &ObjectStatePlane::getUpdates() const {
     updates = UpdateList(array, 0);
 
     // Apply the remaining (non-constant) writes.
+    for (const auto &Write : Remaining)
+      updates.extend(Write.first, Write.second);
     for (; Begin != End; ++Begin)
       updates.extend(Writes[Begin].first, Writes[Begin].second);
   }
@@ -207,12 +308,73 @@ void ObjectStatePlane::flushToConcreteStore(TimingSolver *solver,
       } else {
         uint8_t value;
         ce->toMemory(&value);
-        concreteStore[i] = value;
+        concreteStore.set(i, value);
       }
     }
   }
 }
 
+uint64_t ObjectStatePlane::getApproximateSize() const {
+  return sizeof(*this) + concreteStore.getOwnedSizeInBytes() +
+         concreteMask.getOwnedSizeInBytes() +
+         unflushedMask.getOwnedSizeInBytes();
+}
+
+bool ObjectStatePlane::rebase() {
+  if (RebaseUpdateLists == 0 || !updates.head)
+    return false;
+  unsigned length = updates.head->getSize();
+  if (length <= RebaseUpdateLists + rebasedLength)
+    return false;
+  if (!isa<ConstantExpr>(parent->getObject()->size) ||
+      sizeBound > RebaseMaxObjectSize)
+    return false;
+
+  // the updates a read may still see, the most recent first: a write at a
+  // constant offset hides the older writes at that offset, and once every
+  // offset is written that way, all older writes and the array
+  std::vector<bool> written(sizeBound);
+  unsigned numWritten = 0;
+  std::vector<const UpdateNode *> live;
+  for (const UpdateNode *un = updates.head.get();
+       un && numWritten < sizeBound; un = un->next.get()) {
+    if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(un->index)) {
+      uint64_t index = CE->getZExtValue();
+      if (index < sizeBound) {
+        if (written[index])
+          continue;
+        written[index] = true;
+        ++numWritten;
+      }
+    }
+    live.push_back(un);
+  }
+  rebasedLength = live.size();
+  if (live.size() == length)
+    return false;
+
+  // the array is replaced by a lazily created constant array (see
+  // getUpdates), into which the writes of constants at constant offsets
+  // below the first write at a symbolic offset are folded
+  UpdateList rebased(nullptr, nullptr);
+  const Array *root = updates.root;
+  if (root && numWritten < sizeBound) {
+    if (root->isConstantArray()) {
+      for (unsigned i = 0; i < sizeBound; ++i) {
+        if (!written[i] && i < root->constantValues.size())
+          rebased.extend(ConstantExpr::create(i, Expr::Int32),
+                         root->constantValues[i]);
+      }
+    } else {
+      rebased = UpdateList(root, nullptr);
+    }
+  }
+  for (auto it = live.rbegin(), ie = live.rend(); it != ie; ++it)
+    rebased.extend((*it)->index, (*it)->value);
+  updates = rebased;
+  return true;
+}
+
 void ObjectStatePlane::makeConcrete() {
   concreteMask.resize(0);
   unflushedMask.resize(0);
@@ -240,7 +402,7 @@ isByteUnflushed(i) => (isByteConcrete(i) || isByteKnownSymbolic(i))
 
 void ObjectStatePlane::flushForRead() const {
   // TODO: iterate only over the offsets for which we have information
-  // (SparseVector may be, well, sparse...)
+  // (knownSymbolics may be, well, sparse...)
   for (unsigned offset = 0; offset < sizeBound; offset++) {
     if (isByteUnflushed(offset)) {
       if (isByteConcrete(offset)) {
@@ -346,6 +508,19 @@ uint8_t ObjectStatePlane::getConcreteValue(unsigned offset) const {
   return initialValue;
 }
 
+void ObjectStatePlane::copyConcreteStoreTo(uint8_t *address) {
+  concreteStore.resize(sizeBound, initialValue);
+  concreteStore.copyTo(address, 0, concreteStore.size());
+}
+
+bool ObjectStatePlane::concreteStoreEquals(const uint8_t *address) const {
+  return concreteStore.equals(address, 0, concreteStore.size());
+}
+
+void ObjectStatePlane::copyConcreteStoreFrom(const uint8_t *address) {
+  concreteStore.copyFrom(address, 0, concreteStore.size());
+}
+
 /***/
 
 ref<Expr> ObjectStatePlane::read8(unsigned offset) const {
@@ -399,7 +574,7 @@ void ObjectStatePlane::write8(unsigned offset, uint8_t value) {
     sizeBound = offset + 1;
   if (concreteStore.size() <= offset)
     concreteStore.resize(sizeBound, initialValue);
-  concreteStore[offset] = value;
+  concreteStore.set(offset, value);
   setKnownSymbolic(offset, 0);
 
   markByteConcrete(offset);
@@ -627,6 +802,16 @@ ObjectState::ObjectState(const ObjectState &os, const MemoryObject *mo)
     object = mo;
 }
 
+ObjectState::ObjectState(const MemoryObject *mo, StateReader &reader)
+  : copyOnWriteOwner(0),
+    object(mo),
+    readOnly(reader.readInt()),
+    segmentPlane(nullptr),
+    offsetPlane(new ObjectStatePlane(this, reader)) {
+  if (reader.readInt())
+    segmentPlane = new ObjectStatePlane(this, reader);
+}
+
 ObjectState::~ObjectState() {
   if (segmentPlane)
     delete segmentPlane;
@@ -719,6 +904,28 @@ void ObjectState::write(ref<Expr> offset, const KValue& value) {
   offsetPlane->write(offset, value.getOffset());
 }
 
+uint64_t ObjectState::getApproximateSize() const {
+  uint64_t size = sizeof(*this) + offsetPlane->getApproximateSize();
+  if (segmentPlane)
+    size += segmentPlane->getApproximateSize();
+  return size;
+}
+
+void ObjectState::rebaseUpdateLists() {
+  if (offsetPlane->rebase())
+    ++stats::updateListRebases;
+  if (segmentPlane && segmentPlane->rebase())
+    ++stats::updateListRebases;
+}
+
+void ObjectState::serialize(StateWriter &writer) const {
+  writer.writeInt(readOnly);
+  offsetPlane->serialize(writer);
+  writer.writeInt(segmentPlane != nullptr);
+  if (segmentPlane)
+    segmentPlane->serialize(writer);
+}
+
 void ObjectState::initializeToZero() {
   offsetPlane->initializeToZero();
 }
@@ -11,9 +11,10 @@
 #define KLEE_MEMORY_H
 
 #include "Context.h"
+#include "PagedArray.h"
+#include "PersistentRadixTree.h"
 #include "TimingSolver.h"
 
-#include "klee/ADT/BitArray.h"
 #include "klee/Module/KValue.h"
 
 #include "llvm/ADT/Optional.h"
@@ -34,6 +35,8 @@ class ArrayCache;
 class ExecutionState;
 class MemoryManager;
 class Solver;
+class StateReader;
+class StateWriter;
 
 class MemoryObject {
   friend class STPBuilder;
@@ -126,6 +129,10 @@ public:
 
   ~MemoryObject();
 
+  /// The id the next memory object gets, saved and restored by checkpoints
+  static int getNextID() { return counter; }
+  static void setNextID(int id) { counter = id; }
+
   /// Get an identifying string for this allocation.
   void getAllocInfo(std::string &result) const;
 
@@ -223,65 +230,6 @@ private:
   }
 };
 
-// up to some offset this container is implemented
-// as a vector and from some offset as a map
-// (leveraging the assumption that large offsets will
-// be sparse). Threshold is the maximal number of elements
-// in the vector.
-// This class is specialized for our needs, it is not generic...
-template <typename T, const size_t Threshold = (1 << 18)>
-class SparseVector {
-    std::vector<T> _vector;
-    std::unordered_map<size_t, T> _map;
-
-public:
-    const T& operator[](size_t n) const {
-        if (n < Threshold) {
-            assert(n < _vector.size());
-            assert(_vector[n].get() != nullptr && "Use has() before");
-            return _vector[n];
-        } else {
-            auto it = _map.find(n);
-            if (it == _map.end()) {
-                assert(false && "Cannot happen, must use has() before");
-                abort();
-            }
-            assert(it->second.get() != nullptr);
-            return it->second;
-        }
-    }
-
-    void set(size_t n, const T& val) {
-        if (n < Threshold) {
-            if (_vector.size() <= n) {
-              if (val.get() == nullptr) {
-                return;
-              }
-              // make sure the access will be valid
-              _vector.resize(n + 1);
-            }
-
-            assert(_vector.size() > n);
-            _vector[n] = val;
-        } else {
-            if (val.get() == nullptr) {
-                _map.erase(n);
-            } else
-                _map[n] = val;
-        }
-    }
-
-    void clear() {
-        _vector.clear();
-        _map.clear();
-    }
-
-    bool has(size_t n) const {
-        return (_vector.size() > n && _vector[n].get())
-               || (_map.find(n) != _map.end());
-    }
-};
-
 class ObjectStatePlane {
 private:
   friend class AddressSpace;
@@ -290,21 +238,25 @@ private:
   /// @brief Required by klee::ref-managed objects
   class ReferenceCounter _refCount;
 
-  ref<const ObjectState> parent;
+  /// The object state that owns this plane (not a reference, the planes
+  /// are owned by the object state)
+  const ObjectState *parent;
 
-  /// @brief Holds all known concrete bytes
-  std::vector<uint8_t> concreteStore;
+  /// @brief Holds all known concrete bytes, pages of the store and the
+  /// masks are shared with copies of the plane until they are written
+  PagedArray<uint8_t> concreteStore;
 
   /// @brief concreteMask[byte] is set if byte is known to be concrete
-  BitArray concreteMask;
+  PagedBitArray concreteMask;
 
   /// knownSymbolics[byte] holds the symbolic expression for byte,
-  /// if byte is known to be symbolic
-  SparseVector<ref<Expr>> knownSymbolics;
+  /// if byte is known to be symbolic, the nodes of the tree are shared
+  /// with copies of the plane until written
+  PersistentRadixTree<ref<Expr>> knownSymbolics;
 
   /// unflushedMask[byte] is set if byte is unflushed
   /// mutable because may need flushed during read of const
-  mutable BitArray unflushedMask;
+  mutable PagedBitArray unflushedMask;
 
   // mutable because we may need flush during read of const
   mutable UpdateList updates;
@@ -317,6 +269,10 @@ public:
 
   uint8_t initialValue;
 
+private:
+  /// The length of the update list after it was last rebased
+  unsigned rebasedLength = 0;
+
 public:
   /// Create a new object state for the given memory object with concrete
   /// contents. The initial contents are undefined, it is the callers
@@ -328,6 +284,9 @@ public:
   ObjectStatePlane(const ObjectState *parent, const Array *array);
 
   ObjectStatePlane(const ObjectState *parent, const ObjectStatePlane &os);
+
+  /// Create a plane with the contents written by serialize.
+  ObjectStatePlane(const ObjectState *parent, StateReader &reader);
   ~ObjectStatePlane() = default;
 
   /// Make contents all concrete and zero
@@ -356,6 +315,41 @@ public:
   void flushToConcreteStore(TimingSolver *solver,
                             const ExecutionState &state);
 
+  /// Approximate memory in bytes taken by the contents of this plane, pages
+  /// shared with other planes are not counted.
+  uint64_t getApproximateSize() const;
+
+  /// Rebuild the update list once it grew by more than
+  /// --rebase-update-lists since the last rebase. The writes hidden by a
+  /// later write at the same constant offset are dropped, and so are all
+  /// writes, also at symbolic offsets, older than writes at every offset.
+  /// The writes of constants below the first remaining write at a symbolic
+  /// offset are folded into a new constant array. The flushes between
+  /// writes at symbolic offsets then add at most one update per byte. The
+  /// writes at symbolic offsets that may still be read are kept, as their
+  /// bytes could only be described by reads of the old list. No array or
+  /// constraint is added to the state.
+  /// \return true if the plane was rebased
+  bool rebase();
+
+  /// Number of bytes held in the concrete store.
+  unsigned getConcreteStoreSize() const { return concreteStore.size(); }
+
+  /// Copy the concrete store (extended to the whole object) to the given
+  /// address.
+  void copyConcreteStoreTo(uint8_t *address);
+
+  /// \return true iff the concrete store equals the bytes at the given
+  /// address
+  bool concreteStoreEquals(const uint8_t *address) const;
+
+  /// Overwrite the concrete store by the bytes at the given address.
+  void copyConcreteStoreFrom(const uint8_t *address);
+
+  /// Write the contents of this plane, the arrays of the update list are
+  /// written as pointers (see StateWriter).
+  void serialize(StateWriter &writer) const;
+
 private:
   const UpdateList &getUpdates() const;
 
@@ -420,6 +414,10 @@ public:
   ObjectState(const ObjectState &os);
   // Copy for realloc
   ObjectState(const ObjectState &os, const MemoryObject *mo);
+
+  /// Create an object state for the given memory object with the
+  /// contents written by serialize.
+  ObjectState(const MemoryObject *mo, StateReader &reader);
   ~ObjectState();
 
   const MemoryObject *getObject() const { return object.get(); }
@@ -443,6 +441,18 @@ public:
     offsetPlane->flushToConcreteStore(solver, state);
   }
 
+  /// Approximate memory in bytes taken by this object state, pages shared
+  /// with other object states are not counted.
+  uint64_t getApproximateSize() const;
+
+  /// Rebase the update lists that grew too long (see
+  /// ObjectStatePlane::rebase).
+  void rebaseUpdateLists();
+
+  /// Write the contents of this object state, the memory object is not
+  /// written.
+  void serialize(StateWriter &writer) const;
+
   KValue read(ref<Expr> offset, Expr::Width width) const;
   KValue read(unsigned offset, Expr::Width width) const;
   KValue read8(unsigned offset) const;
@@ -18,6 +18,7 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/MathExtras.h"
 
+#include <algorithm>
 #include <inttypes.h>
 #include <sys/mman.h>
 
@@ -307,6 +308,17 @@ MemoryObject *MemoryManager::allocateFixed(uint64_t size,
   return res;
 }
 
+MemoryObject *MemoryManager::allocateAt(uint64_t segment, ref<Expr> size,
+                                        uint64_t allocatedSize, bool isLocal,
+                                        bool isGlobal, bool isFixed,
+                                        const llvm::Value *allocSite) {
+  MemoryObject *res = new MemoryObject(segment, size, allocatedSize, isLocal,
+                                       isGlobal, isFixed, allocSite, this);
+  lastSegment = std::max(lastSegment, segment);
+  objects.insert(res);
+  return res;
+}
+
 void MemoryManager::deallocate(const MemoryObject *mo) { assert(0); }
 
 void MemoryManager::markFreed(MemoryObject *mo) {
@@ -119,6 +119,11 @@ public:
                          const llvm::Value *allocSite, size_t alignment);
   MemoryObject *allocateFixed(uint64_t size, const llvm::Value *allocSite,
                               uint64_t specialSegment = 0);
+  /// Create a memory object with the given segment, used to recreate the
+  /// objects of a run resumed from a checkpoint.
+  MemoryObject *allocateAt(uint64_t segment, ref<Expr> size,
+                           uint64_t allocatedSize, bool isLocal, bool isGlobal,
+                           bool isFixed, const llvm::Value *allocSite);
   void deallocate(const MemoryObject *mo);
   void markFreed(MemoryObject *mo);
   ArrayCache *getArrayCache() const { return arrayCache; }
@@ -127,6 +132,11 @@ public:
   }
 
   uint64_t getLastSegment() const { return lastSegment; }
+  /// Continue numbering segments after the given one.
+  void setLastSegment(uint64_t segment) {
+    assert(segment >= lastSegment && "segments would be reused");
+    lastSegment = segment;
+  }
 
   /*
    * Returns the size used by deterministic allocation in bytes
@@ -0,0 +1,166 @@
+//===-- OffsetRange.cpp ---------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "OffsetRange.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace klee;
+
+static int64_t signedMax(Expr::Width width) {
+  return width >= 64 ? std::numeric_limits<int64_t>::max()
+                     : (int64_t(1) << (width - 1)) - 1;
+}
+
+UnsignedRange OffsetRangeEvaluator::evaluate(const ref<Expr> &e) {
+  Expr::Width width = e->getWidth();
+  if (width > 64)
+    return UnsignedRange::full(64);
+
+  auto it = ranges.find(e);
+  if (it != ranges.end())
+    return it->second;
+
+  UnsignedRange range = evaluateStructure(e);
+  const ExprBounds &known = e->getBounds();
+  range.min = std::max(range.min, known.min);
+  range.max = std::min(range.max, known.max);
+  range = bounds.restrict(e, range);
+
+  // contradicting bounds mean an infeasible path, stay conservative
+  if (range.min > range.max)
+    range = UnsignedRange::full(width);
+  ranges.emplace(e, range);
+  return range;
+}
+
+UnsignedRange OffsetRangeEvaluator::evaluateStructure(const ref<Expr> &e) {
+  Expr::Width width = e->getWidth();
+  UnsignedRange full = UnsignedRange::full(width);
+
+  switch (e->getKind()) {
+  case Expr::Constant: {
+    uint64_t value = cast<ConstantExpr>(e)->getZExtValue();
+    return {value, value};
+  }
+
+  case Expr::ZExt:
+    return evaluate(e->getKid(0));
+
+  case Expr::SExt: {
+    const ref<Expr> &kid = e->getKid(0);
+    UnsignedRange range = evaluate(kid);
+    // values without the sign bit are extended by zeros
+    if (range.max <= (uint64_t)signedMax(kid->getWidth()))
+      return range;
+    return full;
+  }
+
+  case Expr::Extract: {
+    const ExtractExpr *ee = cast<ExtractExpr>(e);
+    if (ee->offset != 0)
+      return full;
+    UnsignedRange range = evaluate(ee->expr);
+    if (range.max <= full.max)
+      return range;
+    return full;
+  }
+
+  case Expr::Concat: {
+    const ConcatExpr *ce = cast<ConcatExpr>(e);
+    Expr::Width shift = ce->getRight()->getWidth();
+    UnsignedRange left = evaluate(ce->getLeft());
+    UnsignedRange right = evaluate(ce->getRight());
+    return {(left.min << shift) | right.min, (left.max << shift) | right.max};
+  }
+
+  case Expr::Select: {
+    const SelectExpr *se = cast<SelectExpr>(e);
+    UnsignedRange t = evaluate(se->trueExpr);
+    UnsignedRange f = evaluate(se->falseExpr);
+    return {std::min(t.min, f.min), std::max(t.max, f.max)};
+  }
+
+  case Expr::Add: {
+    UnsignedRange left = evaluate(e->getKid(0));
+    UnsignedRange right = evaluate(e->getKid(1));
+    uint64_t max;
+    if (__builtin_add_overflow(left.max, right.max, &max) || max > full.max)
+      return full;
+    return {left.min + right.min, max};
+  }
+
+  case Expr::Sub: {
+    UnsignedRange left = evaluate(e->getKid(0));
+    UnsignedRange right = evaluate(e->getKid(1));
+    if (left.min < right.max)
+      return full;
+    return {left.min - right.max, left.max - right.min};
+  }
+
+  case Expr::Mul: {
+    UnsignedRange left = evaluate(e->getKid(0));
+    UnsignedRange right = evaluate(e->getKid(1));
+    uint64_t max;
+    if (__builtin_mul_overflow(left.max, right.max, &max) || max > full.max)
+      return full;
+    return {left.min * right.min, max};
+  }
+
+  case Expr::UDiv: {
+    UnsignedRange left = evaluate(e->getKid(0));
+    UnsignedRange right = evaluate(e->getKid(1));
+    if (right.min == 0)
+      return full;
+    return {left.min / right.max, left.max / right.min};
+  }
+
+  case Expr::URem: {
+    UnsignedRange left = evaluate(e->getKid(0));
+    UnsignedRange right = evaluate(e->getKid(1));
+    // the remainder of a division by zero is the dividend
+    if (right.min == 0)
+      return {0, left.max};
+    if (left.max < right.min)
+      return left;
+    return {0, std::min(left.max, right.max - 1)};
+  }
+
+  case Expr::And: {
+    UnsignedRange left = evaluate(e->getKid(0));
+    UnsignedRange right = evaluate(e->getKid(1));
+    return {0, std::min(left.max, right.max)};
+  }
+
+  case Expr::Shl: {
+    const ConstantExpr *CE = dyn_cast<ConstantExpr>(e->getKid(1));
+    if (!CE || CE->getZExtValue() >= width)
+      return full;
+    uint64_t shift = CE->getZExtValue();
+    UnsignedRange range = evaluate(e->getKid(0));
+    if ((range.max << shift) >> shift != range.max ||
+        (range.max << shift) > full.max)
+      return full;
+    return {range.min << shift, range.max << shift};
+  }
+
+  case Expr::LShr: {
+    const ConstantExpr *CE = dyn_cast<ConstantExpr>(e->getKid(1));
+    if (!CE || CE->getZExtValue() >= width)
+      return full;
+    uint64_t shift = CE->getZExtValue();
+    UnsignedRange range = evaluate(e->getKid(0));
+    return {range.min >> shift, range.max >> shift};
+  }
+
+  default:
+    return full;
+  }
+}
@@ -0,0 +1,42 @@
+//===-- OffsetRange.h -------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_OFFSETRANGE_H
+#define KLEE_OFFSETRANGE_H
+
+#include "klee/Expr/ConstraintBounds.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprHashMap.h"
+
+namespace klee {
+
+/// Over-approximates the unsigned values an expression (typically the offset
+/// of a memory access) may take without calling the solver. The structure of
+/// the expression is used together with the bounds on its subexpressions
+/// collected from the path constraints by the constraint set. The ranges of
+/// the evaluated subexpressions are remembered by the evaluator.
+class OffsetRangeEvaluator {
+  const ConstraintBounds &bounds;
+  ExprHashMap<UnsignedRange> ranges;
+
+  UnsignedRange evaluateStructure(const ref<Expr> &e);
+
+public:
+  explicit OffsetRangeEvaluator(const ConstraintSet &constraints)
+      : bounds(constraints.getBounds()) {}
+
+  /// Get an interval containing all values e may take under the
+  /// constraints. Expressions wider than 64 bits get the full range.
+  UnsignedRange evaluate(const ref<Expr> &e);
+};
+
+} // namespace klee
+
+#endif /* KLEE_OFFSETRANGE_H */
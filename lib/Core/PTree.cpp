@@ -10,6 +10,7 @@
 #include "PTree.h"
 
 #include "ExecutionState.h"
+#include "StateSerializer.h"
 
 #include "klee/Expr/Expr.h"
 #include "klee/Expr/ExprPPrinter.h"
@@ -36,6 +37,39 @@ PTree::PTree(ExecutionState *initialState)
   initialState->ptreeNode = root.getPointer();
 }
 
+PTree::PTree(StateReader &reader,
+             const std::map<std::uint32_t, ExecutionState *> &states) {
+  // nodes still to be read (in preorder) and where to link them
+  std::vector<std::pair<PTreeNode *, PTreeNodePtr *>> pending{
+      {nullptr, &root}};
+  while (!pending.empty() && reader.good()) {
+    PTreeNode *parent = pending.back().first;
+    PTreeNodePtr *link = pending.back().second;
+    pending.pop_back();
+
+    uint64_t children = reader.readInt();
+    if (children == 0) {
+      auto it = states.find(reader.readInt());
+      if (it == states.end() || it->second->ptreeNode) {
+        reader.fail();
+        break;
+      }
+      *link = PTreeNodePtr(new PTreeNode(parent, it->second));
+      continue;
+    }
+    if (children > 3) {
+      reader.fail();
+      break;
+    }
+    PTreeNode *node = new PTreeNode(parent, nullptr);
+    *link = PTreeNodePtr(node);
+    if (children & 2)
+      pending.emplace_back(node, &node->right);
+    if (children & 1)
+      pending.emplace_back(node, &node->left);
+  }
+}
+
 void PTree::attach(PTreeNode *node, ExecutionState *leftState,
                    ExecutionState *rightState, BranchType reason) {
   assert(node && !node->left.getPointer() && !node->right.getPointer());
@@ -128,8 +162,31 @@ void PTree::dump(llvm::raw_ostream &os) {
   delete pp;
 }
 
+void PTree::serialize(StateWriter &writer) const {
+  // leaves are written as 0 and the id of the state, inner nodes as the
+  // set of their children (1 for left, 2 for right), in preorder
+  std::vector<const PTreeNode *> stack{root.getPointer()};
+  while (!stack.empty()) {
+    const PTreeNode *n = stack.back();
+    stack.pop_back();
+    if (n->state) {
+      writer.writeInt(0);
+      writer.writeInt(n->state->getID());
+      continue;
+    }
+    const PTreeNode *left = n->left.getPointer();
+    const PTreeNode *right = n->right.getPointer();
+    writer.writeInt((left ? 1 : 0) | (right ? 2 : 0));
+    if (right)
+      stack.push_back(right);
+    if (left)
+      stack.push_back(left);
+  }
+}
+
 PTreeNode::PTreeNode(PTreeNode *parent, ExecutionState *state) : parent{parent}, state{state} {
-  state->ptreeNode = this;
+  if (state)
+    state->ptreeNode = this;
   left = PTreeNodePtr(nullptr);
   right = PTreeNodePtr(nullptr);
 }
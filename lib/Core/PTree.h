@@ -15,9 +15,13 @@
 #include "klee/Support/ErrorHandling.h"
 #include "llvm/ADT/PointerIntPair.h"
 
+#include <map>
+
 namespace klee {
   class ExecutionState;
   class PTreeNode;
+  class StateReader;
+  class StateWriter;
   /* PTreeNodePtr is used by the Random Path Searcher object to efficiently
   record which PTreeNode belongs to it. PTree is a global structure that
   captures all  states, whereas a Random Path Searcher might only care about
@@ -46,12 +50,19 @@ namespace klee {
   public:
     PTreeNodePtr root;
     explicit PTree(ExecutionState *initialState);
+    /// Create a tree of the shape written by serialize, the leaves are
+    /// looked up by the ids of their states.
+    PTree(StateReader &reader,
+          const std::map<std::uint32_t, ExecutionState *> &states);
     ~PTree() = default;
 
     void attach(PTreeNode *node, ExecutionState *leftState,
                 ExecutionState *rightState, BranchType reason);
     void remove(PTreeNode *node);
     void dump(llvm::raw_ostream &os);
+    /// Write the shape of the tree and the ids of the states in its leaves,
+    /// the tags of the random path searchers are not written.
+    void serialize(StateWriter &writer) const;
     std::uint8_t getNextId() {
       std::uint8_t id = 1 << registeredIds++;
       if (registeredIds > PtrBitCount) {
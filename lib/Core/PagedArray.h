@@ -0,0 +1,211 @@
+//===-- PagedArray.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_PAGEDARRAY_H
+#define KLEE_PAGEDARRAY_H
+
+#include "CoreStats.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace klee {
+
+  /// Array of elements stored in fixed-size pages that are shared between
+  /// copies of the array and cloned only when written. Copying an array
+  /// copies the page table, so the cost of modifying a copy is proportional
+  /// to the number of pages written instead of the size of the array.
+  ///
+  /// Only the last page is shorter than PageSize, small arrays therefore
+  /// occupy a single page of their size.
+  template <typename T>
+  class PagedArray {
+  public:
+    static constexpr unsigned PageBits = 12;
+    static constexpr unsigned PageSize = 1u << PageBits;
+
+  private:
+    typedef std::vector<T> Page;
+
+    std::vector<std::shared_ptr<Page>> pages;
+    unsigned _size = 0;
+
+    static unsigned pageOf(unsigned index) { return index >> PageBits; }
+    static unsigned indexInPage(unsigned index) {
+      return index & (PageSize - 1);
+    }
+
+    /// Get the page for writing, cloning it if it is shared.
+    Page &writablePage(unsigned page) {
+      std::shared_ptr<Page> &p = pages[page];
+      if (p.use_count() > 1) {
+        p = std::make_shared<Page>(*p);
+        stats::objectBytesCopied += p->size() * sizeof(T);
+      }
+      return *p;
+    }
+
+  public:
+    unsigned size() const { return _size; }
+    bool empty() const { return _size == 0; }
+
+    const T &operator[](unsigned index) const {
+      assert(index < _size && "index out of bounds");
+      return (*pages[pageOf(index)])[indexInPage(index)];
+    }
+
+    void set(unsigned index, const T &value) {
+      assert(index < _size && "index out of bounds");
+      const Page &page = *pages[pageOf(index)];
+      // do not clone pages by writes that do not change them
+      if (page[indexInPage(index)] == value)
+        return;
+      writablePage(pageOf(index))[indexInPage(index)] = value;
+    }
+
+    void resize(unsigned newSize, const T &value = T()) {
+      if (newSize == _size)
+        return;
+      if (newSize == 0) {
+        clear();
+        return;
+      }
+
+      unsigned lastPage = pageOf(newSize - 1);
+      pages.resize(std::min<size_t>(pages.size(), lastPage + 1));
+      // adjust the last page we keep, then append new pages
+      if (!pages.empty()) {
+        unsigned back = pages.size() - 1;
+        unsigned length =
+            back == lastPage ? indexInPage(newSize - 1) + 1 : PageSize;
+        if (pages[back]->size() != length)
+          writablePage(back).resize(length, value);
+      }
+      while (pages.size() <= lastPage) {
+        unsigned length =
+            pages.size() == lastPage ? indexInPage(newSize - 1) + 1 : PageSize;
+        pages.push_back(std::make_shared<Page>(length, value));
+      }
+      _size = newSize;
+    }
+
+    void clear() {
+      pages.clear();
+      _size = 0;
+    }
+
+    /// Copy count elements starting at index begin to dest.
+    void copyTo(T *dest, unsigned begin, unsigned count) const {
+      assert(begin + count <= _size && "range out of bounds");
+      while (count > 0) {
+        const Page &page = *pages[pageOf(begin)];
+        unsigned length =
+            std::min<unsigned>(count, page.size() - indexInPage(begin));
+        std::copy_n(page.begin() + indexInPage(begin), length, dest);
+        dest += length;
+        begin += length;
+        count -= length;
+      }
+    }
+
+    /// Overwrite count elements starting at index begin by src, pages that
+    /// would not change are left shared.
+    void copyFrom(const T *src, unsigned begin, unsigned count) {
+      assert(begin + count <= _size && "range out of bounds");
+      while (count > 0) {
+        unsigned page = pageOf(begin);
+        unsigned length =
+            std::min<unsigned>(count, pages[page]->size() - indexInPage(begin));
+        if (!equals(src, begin, length))
+          std::copy_n(src, length,
+                      writablePage(page).begin() + indexInPage(begin));
+        src += length;
+        begin += length;
+        count -= length;
+      }
+    }
+
+    /// \return true iff count elements starting at index begin equal
+    /// the elements at src
+    bool equals(const T *src, unsigned begin, unsigned count) const {
+      assert(begin + count <= _size && "range out of bounds");
+      while (count > 0) {
+        const Page &page = *pages[pageOf(begin)];
+        unsigned length =
+            std::min<unsigned>(count, page.size() - indexInPage(begin));
+        if (!std::equal(src, src + length,
+                        page.begin() + indexInPage(begin)))
+          return false;
+        src += length;
+        begin += length;
+        count -= length;
+      }
+      return true;
+    }
+
+    /// Size in bytes of the contents of this array.
+    uint64_t getSizeInBytes() const { return uint64_t(_size) * sizeof(T); }
+
+    /// Size in bytes of the pages not shared with other arrays.
+    uint64_t getOwnedSizeInBytes() const {
+      uint64_t size = 0;
+      for (const std::shared_ptr<Page> &p : pages)
+        if (p.use_count() == 1)
+          size += p->size() * sizeof(T);
+      return size;
+    }
+  };
+
+  /// Bit array with the interface of BitArray stored in a PagedArray.
+  class PagedBitArray {
+    PagedArray<uint32_t> words;
+    unsigned _size = 0;
+
+    static unsigned length(unsigned size) { return (size + 31) / 32; }
+
+  public:
+    unsigned size() const { return _size; }
+
+    void resize(unsigned newSize, bool value = false) {
+      unsigned oldSize = _size;
+      words.resize(length(newSize), value ? ~0u : 0u);
+      _size = newSize;
+      // bits of the last old word that were not in use
+      for (unsigned i = oldSize; i < std::min(newSize, length(oldSize) * 32);
+           i++)
+        set(i, value);
+    }
+
+    bool get(unsigned idx) const { return (words[idx / 32] >> (idx & 0x1F)) & 1; }
+    void set(unsigned idx) {
+      words.set(idx / 32, words[idx / 32] | (1u << (idx & 0x1F)));
+    }
+    void unset(unsigned idx) {
+      words.set(idx / 32, words[idx / 32] & ~(1u << (idx & 0x1F)));
+    }
+    void set(unsigned idx, bool value) {
+      if (value)
+        set(idx);
+      else
+        unset(idx);
+    }
+
+    /// Size in bytes of the contents of this array.
+    uint64_t getSizeInBytes() const { return words.getSizeInBytes(); }
+
+    /// Size in bytes of the pages not shared with other arrays.
+    uint64_t getOwnedSizeInBytes() const { return words.getOwnedSizeInBytes(); }
+  };
+
+} // namespace klee
+
+#endif /* KLEE_PAGEDARRAY_H */
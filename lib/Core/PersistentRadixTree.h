@@ -0,0 +1,183 @@
+//===-- PersistentRadixTree.h -----------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_PERSISTENTRADIXTREE_H
+#define KLEE_PERSISTENTRADIXTREE_H
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+
+namespace klee {
+
+  /// Map from unsigned keys to smart pointers implemented as a radix tree
+  /// whose nodes are shared between copies of the tree. Copying a tree
+  /// copies its root, a write clones the nodes on the path to the written
+  /// key that are shared with other trees (nodes owned by a single tree are
+  /// updated in place). The tree is only as high as needed for the largest
+  /// key, so a few keys at high offsets occupy a few small nodes.
+  ///
+  /// A null value of T means that the key is not in the map, so T must be
+  /// a smart pointer like ref<Expr>.
+  template <typename T>
+  class PersistentRadixTree {
+    static constexpr unsigned Bits = 5;
+    static constexpr unsigned Fanout = 1u << Bits;
+    static constexpr unsigned Mask = Fanout - 1;
+
+    struct Node {
+      /// The number of non-empty slots
+      unsigned count = 0;
+    };
+    struct Inner : Node {
+      std::array<std::shared_ptr<Node>, Fanout> children;
+    };
+    struct Leaf : Node {
+      std::array<T, Fanout> values;
+    };
+
+    std::shared_ptr<Node> root;
+    /// The number of levels of inner nodes above the leaves
+    unsigned height = 0;
+
+    static unsigned slot(uint64_t key, unsigned level) {
+      return (key >> (Bits * level)) & Mask;
+    }
+
+    uint64_t capacity() const { return uint64_t(1) << (Bits * (height + 1)); }
+
+    /// Get the node in the given slot for writing, creating it if it does
+    /// not exist and cloning it if it is shared.
+    template <typename N>
+    static N *writable(std::shared_ptr<Node> &node) {
+      if (!node)
+        node = std::make_shared<N>();
+      else if (node.use_count() > 1)
+        node = std::make_shared<N>(*static_cast<N *>(node.get()));
+      return static_cast<N *>(node.get());
+    }
+
+    template <typename F>
+    static void forEach(const Node *node, unsigned level, uint64_t prefix,
+                        F &f) {
+      if (level == 0) {
+        const Leaf *leaf = static_cast<const Leaf *>(node);
+        for (unsigned s = 0; s < Fanout; ++s) {
+          if (leaf->values[s].get())
+            f(prefix | s, leaf->values[s]);
+        }
+        return;
+      }
+      const Inner *inner = static_cast<const Inner *>(node);
+      for (unsigned s = 0; s < Fanout; ++s) {
+        if (inner->children[s])
+          forEach(inner->children[s].get(), level - 1,
+                  prefix | (uint64_t(s) << (Bits * level)), f);
+      }
+    }
+
+    /// Remove key from the subtree in node of the given level.
+    /// \return true if the subtree became empty
+    static bool erase(std::shared_ptr<Node> &node, uint64_t key,
+                      unsigned level) {
+      unsigned s = slot(key, level);
+      if (level == 0) {
+        Leaf *leaf = writable<Leaf>(node);
+        leaf->values[s] = T();
+        --leaf->count;
+      } else {
+        Inner *inner = writable<Inner>(node);
+        if (erase(inner->children[s], key, level - 1)) {
+          inner->children[s].reset();
+          --inner->count;
+        }
+      }
+      return node->count == 0;
+    }
+
+  public:
+    /// \return the value of key, null if key is not in the map
+    const T *lookup(uint64_t key) const {
+      if (!root || key >= capacity())
+        return nullptr;
+      const Node *node = root.get();
+      for (unsigned level = height; level > 0; --level) {
+        node = static_cast<const Inner *>(node)->children[slot(key, level)].get();
+        if (!node)
+          return nullptr;
+      }
+      const T &value = static_cast<const Leaf *>(node)->values[slot(key, 0)];
+      return value.get() ? &value : nullptr;
+    }
+
+    bool has(uint64_t key) const { return lookup(key) != nullptr; }
+
+    const T &operator[](uint64_t key) const {
+      const T *value = lookup(key);
+      if (!value) {
+        assert(false && "Cannot happen, must use has() before");
+        abort();
+      }
+      return *value;
+    }
+
+    /// Set the value of key, a null value removes key from the map.
+    void set(uint64_t key, const T &value) {
+      if (value.get() == nullptr) {
+        if (has(key) && erase(root, key, height)) {
+          root.reset();
+          height = 0;
+        }
+        return;
+      }
+
+      while (key >= capacity()) {
+        if (root) {
+          auto inner = std::make_shared<Inner>();
+          inner->children[0] = std::move(root);
+          inner->count = 1;
+          root = std::move(inner);
+        }
+        ++height;
+      }
+
+      std::shared_ptr<Node> *node = &root;
+      for (unsigned level = height; level > 0; --level) {
+        Inner *inner = writable<Inner>(*node);
+        node = &inner->children[slot(key, level)];
+        if (!*node)
+          ++inner->count;
+      }
+      Leaf *leaf = writable<Leaf>(*node);
+      T &slotValue = leaf->values[slot(key, 0)];
+      if (slotValue.get() == nullptr)
+        ++leaf->count;
+      slotValue = value;
+    }
+
+    /// Call f(key, value) for all keys in the map in increasing order.
+    template <typename F>
+    void forEach(F f) const {
+      if (root)
+        forEach(root.get(), height, 0, f);
+    }
+
+    void clear() {
+      root.reset();
+      height = 0;
+    }
+
+    bool empty() const { return !root; }
+  };
+
+} // namespace klee
+
+#endif /* KLEE_PERSISTENTRADIXTREE_H */
@@ -931,7 +931,7 @@ void SpecialFunctionHandler::handleDefineFixedObject(ExecutionState &state,
 
   MemoryObject *mo = executor.memory->allocateFixed(size, state.prevPC->inst);
   executor.bindObjectInState(state, mo, false);
-  state.addressSpace.concreteAddressMap.emplace(address, mo->segment);
+  state.addressSpace.concreteAddressMap.emplace(address, mo);
   state.addressSpace.segmentMap.insert(std::make_pair(mo->segment, mo));
   mo->isUserSpecified = true; // XXX hack;
 }
@@ -990,7 +990,7 @@ void SpecialFunctionHandler::handleMakeSymbolic(ExecutionState &state,
         "Incorrect number of arguments to klee_make_symbolic(void*, size_t, char*)");
     return;
   }
-  bool isZero = arguments[2].pointerSegment->isZero() && arguments[2].value->isZero();
+  bool isZero = arguments[2].isZero();
   name = isZero ? "" : readStringAtAddress(state, arguments[2]);
 
   if (name.length() == 0) {
@@ -1041,8 +1041,7 @@ void SpecialFunctionHandler::putConcreteValue(ExecutionState& state,
   // bind the new concrete value
   executor.bindLocal(target, state, expr);
   // store it in the vector of nondets, so that we have them in the test output
-  auto& nnv = state.addNondetValue(KValue(expr), isSigned, name);
-  nnv.kinstruction = target;
+  state.addNondetValue(KValue(expr), isSigned, target, name);
 }
 
 void SpecialFunctionHandler::handleVerifierNondetType(ExecutionState &state,
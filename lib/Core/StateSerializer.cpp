@@ -0,0 +1,325 @@
+//===-- StateSerializer.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "StateSerializer.h"
+
+#include "llvm/ADT/APInt.h"
+
+#include <cassert>
+
+using namespace klee;
+
+namespace {
+  /// Tags of the (possibly shared) expressions and update nodes
+  enum Tag { Null = 0, Reference = 1, Definition = 2 };
+}
+
+/***/
+
+void StateWriter::writeInt(uint64_t value) {
+  do {
+    uint8_t byte = value & 0x7f;
+    value >>= 7;
+    if (value)
+      byte |= 0x80;
+    os.put(byte);
+  } while (value);
+}
+
+void StateWriter::writeBytes(const void *data, size_t size) {
+  os.write(static_cast<const char *>(data), size);
+}
+
+void StateWriter::writeString(const std::string &s) {
+  writeInt(s.size());
+  writeBytes(s.data(), s.size());
+}
+
+void StateWriter::writeExpr(const ref<Expr> &e) {
+  if (e.isNull()) {
+    writeInt(Null);
+    return;
+  }
+  auto it = exprs.find(e.get());
+  if (it != exprs.end()) {
+    writeInt(Reference);
+    writeInt(it->second);
+    return;
+  }
+
+  writeInt(Definition);
+  writeInt(e->getKind());
+  switch (e->getKind()) {
+  case Expr::Constant: {
+    const llvm::APInt &value = cast<ConstantExpr>(e)->getAPValue();
+    writeInt(value.getBitWidth());
+    for (unsigned i = 0; i < value.getNumWords(); ++i)
+      writeInt(value.getRawData()[i]);
+    break;
+  }
+  case Expr::Read:
+    writeUpdateList(cast<ReadExpr>(e)->updates);
+    break;
+  case Expr::Extract:
+    writeInt(cast<ExtractExpr>(e)->offset);
+    writeInt(e->getWidth());
+    break;
+  case Expr::ZExt:
+  case Expr::SExt:
+    writeInt(e->getWidth());
+    break;
+  default:
+    break;
+  }
+  for (unsigned i = 0; i < e->getNumKids(); ++i)
+    writeExpr(e->getKid(i));
+
+  // the reader numbers expressions once it created them
+  exprs.emplace(e.get(), numExprs++);
+  if (transient)
+    transientExprs.push_back(e.get());
+}
+
+void StateWriter::writeKValue(const KValue &value) {
+  // the segments of plain values are not expressions of the value, so
+  // they are not written by their addresses
+  writeExpr(value.isPlain() ? ref<Expr>() : value.getSegment());
+  writeExpr(value.getOffset());
+}
+
+void StateWriter::writeUpdateList(const UpdateList &updates) {
+  writeArray(updates.root);
+
+  // Update lists of an object share their tails, so only the nodes that
+  // were not written yet are written, oldest first.
+  std::vector<const UpdateNode *> fresh;
+  const UpdateNode *un = updates.head.get();
+  for (; un && !updateNodes.count(un); un = un->next.get())
+    fresh.push_back(un);
+
+  if (un) {
+    writeInt(Reference);
+    writeInt(updateNodes[un]);
+  } else {
+    writeInt(Null);
+  }
+  writeInt(fresh.size());
+  for (auto it = fresh.rbegin(), ie = fresh.rend(); it != ie; ++it) {
+    writeExpr((*it)->index);
+    writeExpr((*it)->value);
+    updateNodes.emplace(*it, numUpdateNodes++);
+    if (transient)
+      transientUpdateNodes.push_back(*it);
+  }
+}
+
+void StateWriter::beginTransient() {
+  assert(!transient && "transient values are already being written");
+  transient = true;
+}
+
+void StateWriter::forgetTransient() {
+  assert(transient && "no transient values are being written");
+  for (const Expr *e : transientExprs)
+    exprs.erase(e);
+  for (const UpdateNode *un : transientUpdateNodes)
+    updateNodes.erase(un);
+  transientExprs.clear();
+  transientUpdateNodes.clear();
+  transient = false;
+}
+
+/***/
+
+uint64_t StateReader::readInt() {
+  uint64_t value = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    int byte = is.get();
+    if (byte == std::istream::traits_type::eof()) {
+      failed = true;
+      return 0;
+    }
+    value |= uint64_t(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return value;
+  }
+  failed = true;
+  return 0;
+}
+
+void StateReader::readBytes(void *data, size_t size) {
+  if (!is.read(static_cast<char *>(data), size))
+    failed = true;
+}
+
+std::string StateReader::readString() {
+  std::string s(readInt(), '\0');
+  if (!failed)
+    readBytes(&s[0], s.size());
+  return s;
+}
+
+ref<Expr> StateReader::readExpr() {
+  // A placeholder keeps the callers going once the stream is broken,
+  // they are expected to check good() when done.
+  const ref<Expr> broken = ConstantExpr::alloc(0, Expr::Bool);
+  if (failed)
+    return broken;
+
+  switch (readInt()) {
+  case Null:
+    return nullptr;
+  case Reference: {
+    uint64_t id = readInt();
+    if (id >= exprs.size()) {
+      failed = true;
+      return broken;
+    }
+    return exprs[id];
+  }
+  case Definition:
+    break;
+  default:
+    failed = true;
+    return broken;
+  }
+
+  ref<Expr> e;
+  switch (readInt()) {
+  case Expr::Constant: {
+    unsigned width = readInt();
+    std::vector<uint64_t> words((width + 63) / 64);
+    for (uint64_t &word : words)
+      word = readInt();
+    if (width == 0) {
+      failed = true;
+      return broken;
+    }
+    e = ConstantExpr::alloc(llvm::APInt(width, words));
+    break;
+  }
+  case Expr::Read: {
+    UpdateList updates = readUpdateList();
+    ref<Expr> index = readExpr();
+    e = ReadExpr::alloc(updates, index);
+    break;
+  }
+  case Expr::Extract: {
+    unsigned offset = readInt();
+    Expr::Width width = readInt();
+    e = ExtractExpr::alloc(readExpr(), offset, width);
+    break;
+  }
+  case Expr::ZExt: {
+    Expr::Width width = readInt();
+    e = ZExtExpr::alloc(readExpr(), width);
+    break;
+  }
+  case Expr::SExt: {
+    Expr::Width width = readInt();
+    e = SExtExpr::alloc(readExpr(), width);
+    break;
+  }
+  case Expr::NotOptimized:
+    e = NotOptimizedExpr::alloc(readExpr());
+    break;
+  case Expr::Not:
+    e = NotExpr::alloc(readExpr());
+    break;
+  case Expr::Select: {
+    ref<Expr> cond = readExpr();
+    ref<Expr> trueExpr = readExpr();
+    ref<Expr> falseExpr = readExpr();
+    e = SelectExpr::alloc(cond, trueExpr, falseExpr);
+    break;
+  }
+  case Expr::Concat: {
+    ref<Expr> left = readExpr();
+    ref<Expr> right = readExpr();
+    e = ConcatExpr::alloc(left, right);
+    break;
+  }
+
+#define BINARY_EXPR_CASE(T)                                                    \
+  case Expr::T: {                                                              \
+    ref<Expr> left = readExpr();                                               \
+    ref<Expr> right = readExpr();                                              \
+    e = T##Expr::alloc(left, right);                                           \
+    break;                                                                     \
+  }
+
+    BINARY_EXPR_CASE(Add);
+    BINARY_EXPR_CASE(Sub);
+    BINARY_EXPR_CASE(Mul);
+    BINARY_EXPR_CASE(UDiv);
+    BINARY_EXPR_CASE(SDiv);
+    BINARY_EXPR_CASE(URem);
+    BINARY_EXPR_CASE(SRem);
+    BINARY_EXPR_CASE(And);
+    BINARY_EXPR_CASE(Or);
+    BINARY_EXPR_CASE(Xor);
+    BINARY_EXPR_CASE(Shl);
+    BINARY_EXPR_CASE(LShr);
+    BINARY_EXPR_CASE(AShr);
+    BINARY_EXPR_CASE(Eq);
+    BINARY_EXPR_CASE(Ne);
+    BINARY_EXPR_CASE(Ult);
+    BINARY_EXPR_CASE(Ule);
+    BINARY_EXPR_CASE(Ugt);
+    BINARY_EXPR_CASE(Uge);
+    BINARY_EXPR_CASE(Slt);
+    BINARY_EXPR_CASE(Sle);
+    BINARY_EXPR_CASE(Sgt);
+    BINARY_EXPR_CASE(Sge);
+#undef BINARY_EXPR_CASE
+
+  default:
+    failed = true;
+    return broken;
+  }
+
+  if (failed)
+    return broken;
+  exprs.push_back(e);
+  return e;
+}
+
+KValue StateReader::readKValue() {
+  ref<Expr> segment = readExpr();
+  ref<Expr> offset = readExpr();
+  return KValue(segment, offset);
+}
+
+UpdateList StateReader::readUpdateList() {
+  const Array *root = readArray();
+
+  ref<UpdateNode> head;
+  switch (readInt()) {
+  case Null:
+    break;
+  case Reference: {
+    uint64_t id = readInt();
+    if (id < updateNodes.size())
+      head = updateNodes[id];
+    else
+      failed = true;
+    break;
+  }
+  default:
+    failed = true;
+  }
+
+  for (uint64_t count = readInt(); count > 0 && !failed; --count) {
+    ref<Expr> index = readExpr();
+    ref<Expr> value = readExpr();
+    head = new UpdateNode(head, index, value);
+    updateNodes.push_back(head);
+  }
+  return UpdateList(root, head);
+}
@@ -0,0 +1,108 @@
+//===-- StateSerializer.h ---------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_STATESERIALIZER_H
+#define KLEE_STATESERIALIZER_H
+
+#include "klee/Expr/Expr.h"
+#include "klee/Module/KValue.h"
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace klee {
+
+  /// Writes integers, expressions and values to a binary stream.
+  ///
+  /// Expressions are written as a DAG: every expression and update node
+  /// is written once, later occurrences refer to it by the order in which
+  /// it was written. Arrays (and any other object that outlives the
+  /// states) are written as pointers, so only the process that wrote the
+  /// stream can read it back, unless a subclass writes them by contents.
+  class StateWriter {
+    std::ostream &os;
+    std::unordered_map<const Expr *, uint64_t> exprs;
+    std::unordered_map<const UpdateNode *, uint64_t> updateNodes;
+    /// The numbers of the expressions and update nodes written so far, the
+    /// maps above may have forgotten some of them
+    uint64_t numExprs = 0;
+    uint64_t numUpdateNodes = 0;
+    /// The expressions and update nodes written since beginTransient
+    std::vector<const Expr *> transientExprs;
+    std::vector<const UpdateNode *> transientUpdateNodes;
+
+  protected:
+    bool transient = false;
+
+  public:
+    explicit StateWriter(std::ostream &os) : os(os) {}
+    virtual ~StateWriter() = default;
+
+    /// Write an unsigned integer in a variable-length encoding.
+    void writeInt(uint64_t value);
+    void writeBytes(const void *data, size_t size);
+    void writeString(const std::string &s);
+    void writePointer(const void *p) {
+      writeInt(reinterpret_cast<uintptr_t>(p));
+    }
+
+    /// Write an expression, which may be null.
+    void writeExpr(const ref<Expr> &e);
+    void writeKValue(const KValue &value);
+    void writeUpdateList(const UpdateList &updates);
+    virtual void writeArray(const Array *array) { writePointer(array); }
+
+    /// Start writing values that are released before the writer is done.
+    virtual void beginTransient();
+    /// Forget what was written since beginTransient, so that its addresses
+    /// may be reused by other values. Later occurrences of the forgotten
+    /// values are written again.
+    virtual void forgetTransient();
+
+    bool good() const { return os.good(); }
+  };
+
+  /// Reads the streams written by StateWriter.
+  class StateReader {
+    std::istream &is;
+    std::vector<ref<Expr>> exprs;
+    std::vector<ref<UpdateNode>> updateNodes;
+    bool failed = false;
+
+  public:
+    explicit StateReader(std::istream &is) : is(is) {}
+    virtual ~StateReader() = default;
+
+    uint64_t readInt();
+    void readBytes(void *data, size_t size);
+    std::string readString();
+    template <typename T> T *readPointer() {
+      return reinterpret_cast<T *>(static_cast<uintptr_t>(readInt()));
+    }
+
+    ref<Expr> readExpr();
+    KValue readKValue();
+    UpdateList readUpdateList();
+    virtual const Array *readArray() { return readPointer<const Array>(); }
+
+    /// Mark the stream as malformed, used by the readers of the objects
+    /// in it when they find inconsistent data.
+    void fail() { failed = true; }
+
+    /// \return false if the stream ended early or was malformed
+    bool good() const { return !failed && is.good(); }
+  };
+
+} // namespace klee
+
+#endif /* KLEE_STATESERIALIZER_H */
@@ -0,0 +1,160 @@
+//===-- StateSpiller.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "StateSpiller.h"
+
+#include "CoreStats.h"
+#include "ExecutionState.h"
+#include "Memory.h"
+#include "StateSerializer.h"
+
+#include "klee/Module/Cell.h"
+#include "klee/Module/KModule.h"
+#include "klee/Support/ErrorHandling.h"
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/FileSystem.h"
+
+#include <fstream>
+
+using namespace klee;
+
+StateSpiller::StateSpiller(std::string directory)
+    : directory(std::move(directory)) {
+  if (std::error_code ec = llvm::sys::fs::create_directories(this->directory))
+    klee_error("unable to create directory for spilled states %s: %s",
+               this->directory.c_str(), ec.message().c_str());
+}
+
+StateSpiller::~StateSpiller() {
+  for (const auto &state : spilled)
+    llvm::sys::fs::remove(state.second.path);
+  llvm::sys::fs::remove(directory);
+}
+
+uint64_t StateSpiller::spill(ExecutionState &state) {
+  assert(!isSpilled(state) && "state is already spilled");
+  uint64_t size = state.getApproximateMemoryUsage();
+
+  std::vector<ObjectPair> owned;
+  for (const auto &object : state.addressSpace.objects) {
+    if (state.addressSpace.isOwned(object.second.get()))
+      owned.emplace_back(object.first, object.second.get());
+  }
+
+  std::string path =
+      directory + "/state" + llvm::utostr(state.getID()) + ".spill";
+  {
+    std::ofstream file(path, std::ios::binary);
+    StateWriter writer(file);
+    writer.writeInt(owned.size());
+    for (const auto &object : owned) {
+      writer.writePointer(object.first);
+      object.second->serialize(writer);
+    }
+    writer.writeInt(state.constraints.size());
+    for (const auto &constraint : state.constraints)
+      writer.writeExpr(constraint);
+    writer.writeInt(state.stack.size());
+    for (const StackFrame &sf : state.stack) {
+      for (unsigned i = 0; i < sf.kf->numRegisters; ++i)
+        writer.writeKValue(sf.getLocal(i));
+    }
+    writer.writeInt(state.nondetValues.size());
+    for (const auto &nondet : state.nondetValues)
+      writer.writeKValue(nondet.value);
+
+    file.flush();
+    if (!writer.good()) {
+      klee_warning_once(this, "unable to spill states to %s",
+                        directory.c_str());
+      file.close();
+      llvm::sys::fs::remove(path);
+      return 0;
+    }
+  }
+
+  // the state may not be touched until it is restored
+  SpilledState &entry = spilled[&state];
+  entry.path = path;
+  for (const auto &object : owned) {
+    entry.objects.emplace_back(object.first);
+    state.addressSpace.objects = state.addressSpace.objects.remove(object.first);
+  }
+  state.constraints = ConstraintSet();
+  for (StackFrame &sf : state.stack)
+    sf.locals.reset();
+  PersistentVector<ExecutionState::NondetValue> nondetValues;
+  for (ExecutionState::NondetValue nondet : state.nondetValues) {
+    nondet.value = KValue();
+    nondetValues.push_back(nondet);
+  }
+  state.nondetValues = nondetValues;
+
+  ++stats::stateSpills;
+  return size;
+}
+
+void StateSpiller::restore(ExecutionState &state) {
+  auto it = spilled.find(&state);
+  if (it == spilled.end())
+    return;
+  SpilledState &entry = it->second;
+
+  std::ifstream file(entry.path, std::ios::binary);
+  StateReader reader(file);
+  uint64_t numObjects = reader.readInt();
+  for (uint64_t i = 0; i < numObjects && reader.good(); ++i) {
+    const MemoryObject *mo = reader.readPointer<const MemoryObject>();
+    state.addressSpace.bindObject(mo, new ObjectState(mo, reader));
+  }
+
+  std::vector<ref<Expr>> constraints(reader.readInt());
+  for (ref<Expr> &constraint : constraints)
+    constraint = reader.readExpr();
+  state.constraints = ConstraintSet(std::move(constraints));
+
+  if (reader.readInt() != state.stack.size())
+    klee_error("spilled state %u does not match %s", state.getID(),
+               entry.path.c_str());
+  for (StackFrame &sf : state.stack) {
+    auto *locals = new std::vector<Cell>(sf.kf->numRegisters);
+    for (Cell &cell : *locals)
+      cell = Cell(reader.readKValue());
+    sf.locals = locals;
+  }
+  if (reader.readInt() != state.nondetValues.size())
+    klee_error("spilled state %u does not match %s", state.getID(),
+               entry.path.c_str());
+  PersistentVector<ExecutionState::NondetValue> nondetValues;
+  for (ExecutionState::NondetValue nondet : state.nondetValues) {
+    nondet.value = reader.readKValue();
+    nondetValues.push_back(nondet);
+  }
+  state.nondetValues = nondetValues;
+
+  if (!reader.good())
+    klee_error("unable to restore spilled state %u from %s", state.getID(),
+               entry.path.c_str());
+
+  file.close();
+  llvm::sys::fs::remove(entry.path);
+  spilled.erase(it);
+}
+
+std::vector<ref<const MemoryObject>>
+StateSpiller::discard(const ExecutionState &state) {
+  auto it = spilled.find(&state);
+  if (it == spilled.end())
+    return {};
+  std::vector<ref<const MemoryObject>> objects = std::move(it->second.objects);
+  llvm::sys::fs::remove(it->second.path);
+  spilled.erase(it);
+  return objects;
+}
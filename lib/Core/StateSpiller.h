@@ -0,0 +1,73 @@
+//===-- StateSpiller.h ------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_STATESPILLER_H
+#define KLEE_STATESPILLER_H
+
+#include "klee/ADT/Ref.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace klee {
+  class ExecutionState;
+  class MemoryObject;
+
+  /// Moves the memory-heavy parts of execution states to files in a
+  /// directory and loads them back when the states are selected again.
+  ///
+  /// A spilled state keeps its stack frames, position, process tree node
+  /// and everything the searchers look at, so it stays where it is while
+  /// the object states it owns, its constraints and the values of its
+  /// locals and nondet values are on disk. Objects shared with other
+  /// states stay in memory.
+  class StateSpiller {
+    struct SpilledState {
+      std::string path;
+      /// The memory objects of the spilled object states, kept alive while
+      /// their contents are on disk
+      std::vector<ref<const MemoryObject>> objects;
+    };
+
+    std::string directory;
+    std::unordered_map<const ExecutionState *, SpilledState> spilled;
+
+  public:
+    explicit StateSpiller(std::string directory);
+    ~StateSpiller();
+
+    StateSpiller(const StateSpiller &) = delete;
+    StateSpiller &operator=(const StateSpiller &) = delete;
+
+    /// Write the spillable parts of state to a file and release them.
+    /// \return the approximate number of bytes released, 0 if the state
+    /// could not be written
+    uint64_t spill(ExecutionState &state);
+
+    /// Load the spilled parts of state back, does nothing if the state is
+    /// not spilled.
+    void restore(ExecutionState &state);
+
+    /// Forget a spilled state that is going to be deleted.
+    /// \return the memory objects of the spilled object states, they must be
+    /// kept alive until the state is deleted (it unbinds its allocas)
+    std::vector<ref<const MemoryObject>> discard(const ExecutionState &state);
+
+    bool isSpilled(const ExecutionState &state) const {
+      return spilled.count(&state) != 0;
+    }
+
+    std::size_t getNumSpilled() const { return spilled.size(); }
+  };
+
+} // namespace klee
+
+#endif /* KLEE_STATESPILLER_H */
@@ -25,6 +25,17 @@ using namespace llvm;
 
 /***/
 
+/// Decide a validity query by the bounds of its expression, which hold
+/// under any constraints.
+static bool isDecidedByBounds(const ref<Expr> &expr, bool &isTrue) {
+  const ExprBounds &bounds = expr->getBounds();
+  if (!bounds.isConstant())
+    return false;
+  ++stats::queriesDecidedByBounds;
+  isTrue = bounds.min;
+  return true;
+}
+
 bool TimingSolver::evaluate(const ConstraintSet &constraints, ref<Expr> expr,
                             Solver::Validity &result,
                             SolverQueryMetaData &metaData) {
@@ -33,6 +44,11 @@ bool TimingSolver::evaluate(const ConstraintSet &constraints, ref<Expr> expr,
     result = CE->isTrue() ? Solver::True : Solver::False;
     return true;
   }
+  bool isTrue;
+  if (isDecidedByBounds(expr, isTrue)) {
+    result = isTrue ? Solver::True : Solver::False;
+    return true;
+  }
 
   TimerStatIncrementer timer(stats::solverTime);
 
@@ -53,6 +69,8 @@ bool TimingSolver::mustBeTrue(const ConstraintSet &constraints, ref<Expr> expr,
     result = CE->isTrue() ? true : false;
     return true;
   }
+  if (isDecidedByBounds(expr, result))
+    return true;
 
   TimerStatIncrementer timer(stats::solverTime);
 
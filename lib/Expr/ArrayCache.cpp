@@ -44,4 +44,16 @@ ArrayCache::CreateArray(const std::string &_name, uint64_t _size,
     return array;
   }
 }
+
+const Array *ArrayCache::CreateFreshArray(const std::string &prefix,
+                                          uint64_t _size) {
+  unsigned &id = freshArrayIds[prefix];
+  while (true) {
+    size_t numArrays = cachedSymbolicArrays.size();
+    const Array *array = CreateArray(prefix + std::to_string(++id), _size);
+    // a cache hit means the name is taken
+    if (cachedSymbolicArrays.size() > numArrays)
+      return array;
+  }
+}
 }
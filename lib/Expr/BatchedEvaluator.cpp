@@ -0,0 +1,336 @@
+//===-- BatchedEvaluator.cpp ----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/BatchedEvaluator.h"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace klee;
+
+namespace {
+
+std::uint64_t getMask(Expr::Width width) {
+  return width >= 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << width) - 1;
+}
+
+std::int64_t signExtend(std::uint64_t value, Expr::Width width) {
+  unsigned shift = 64 - width;
+  return static_cast<std::int64_t>(value << shift) >> shift;
+}
+
+/// The lanes of the batch whose value is not zero
+BatchedEvaluator::lanes_ty getNonZero(const std::uint64_t *values,
+                                      unsigned size) {
+  BatchedEvaluator::lanes_ty lanes = 0;
+  for (unsigned i = 0; i < size; ++i)
+    lanes |= BatchedEvaluator::lanes_ty(values[i] != 0) << i;
+  return lanes;
+}
+
+} // namespace
+
+BatchedEvaluator::BatchedEvaluator(
+    const std::vector<const Assignment *> &assignments)
+    : assignments(assignments), size(assignments.size()) {
+  assert(size && size <= MaxBatchSize && "invalid batch size");
+  all = size == 64 ? ~lanes_ty(0) : (lanes_ty(1) << size) - 1;
+}
+
+BatchedEvaluator::Term BatchedEvaluator::allocate(lanes_ty undefined) {
+  Term term{values.size(), undefined & all};
+  values.resize(values.size() + size);
+  return term;
+}
+
+BatchedEvaluator::lanes_ty
+BatchedEvaluator::evaluate(const ref<Expr> &e, const std::uint64_t *&result) {
+  evaluated.push_back(e);
+  Term term = evaluateTerm(e);
+  result = &values[term.offset];
+  return all & ~term.undefined;
+}
+
+std::uint8_t BatchedEvaluator::getByte(const Array *array, std::uint64_t index,
+                                       unsigned lane) {
+  if (array->isConstantArray() && index < array->constantValues.size())
+    return array->constantValues[index]->getZExtValue(8);
+
+  auto it = arrays.find(array);
+  if (it == arrays.end()) {
+    std::vector<std::vector<std::uint8_t>> bytes(size);
+    for (unsigned i = 0; i < size; ++i)
+      if (const CompactArrayModel *model =
+              assignments[i]->getBindingsOrNull(array))
+        bytes[i] = model->asVector();
+    it = arrays.emplace(array, std::move(bytes)).first;
+  }
+  const std::vector<std::uint8_t> &bytes = it->second[lane];
+  return index < bytes.size() ? bytes[index] : 0;
+}
+
+BatchedEvaluator::Term BatchedEvaluator::evaluateRow(const Array *array,
+                                                     std::uint64_t index) {
+  auto &arrayRows = rows[array];
+  auto it = arrayRows.find(index);
+  if (it != arrayRows.end())
+    return it->second;
+
+  Term term = allocate(0);
+  std::uint64_t *row = &values[term.offset];
+  for (unsigned i = 0; i < size; ++i)
+    row[i] = getByte(array, index, i);
+  arrayRows.emplace(index, term);
+  return term;
+}
+
+BatchedEvaluator::Term BatchedEvaluator::evaluateRead(const ReadExpr &re) {
+  const Array *array = re.updates.root;
+  if (array->getRange() != Expr::Int8)
+    return allocate(all);
+
+  Term index = evaluateTerm(re.index);
+  lanes_ty undefined = index.undefined;
+
+  // the updates from the oldest to the newest one
+  std::vector<std::pair<Term, Term>> updates;
+  for (const UpdateNode *un = re.updates.head.get(); un; un = un->next.get())
+    updates.emplace_back(evaluateTerm(un->index), evaluateTerm(un->value));
+
+  Term result;
+  auto *CE = dyn_cast<ConstantExpr>(re.index);
+  if (CE && CE->getWidth() <= 64) {
+    Term row = evaluateRow(array, CE->getZExtValue());
+    result = allocate(undefined);
+    std::copy(&values[row.offset], &values[row.offset] + size,
+              &values[result.offset]);
+  } else {
+    result = allocate(undefined);
+    const std::uint64_t *indices = &values[index.offset];
+    std::uint64_t *bytes = &values[result.offset];
+    for (unsigned i = 0; i < size; ++i)
+      bytes[i] = getByte(array, indices[i], i);
+  }
+
+  std::uint64_t *bytes = &values[result.offset];
+  const std::uint64_t *indices = &values[index.offset];
+  for (auto it = updates.rbegin(), ie = updates.rend(); it != ie; ++it) {
+    const std::uint64_t *updateIndices = &values[it->first.offset];
+    const std::uint64_t *updateValues = &values[it->second.offset];
+    for (unsigned i = 0; i < size; ++i)
+      bytes[i] = updateIndices[i] == indices[i] ? updateValues[i] : bytes[i];
+    result.undefined |= it->first.undefined | it->second.undefined;
+  }
+  return result;
+}
+
+BatchedEvaluator::Term BatchedEvaluator::evaluateTerm(const ref<Expr> &e) {
+  auto cached = terms.find(e.get());
+  if (cached != terms.end())
+    return cached->second;
+
+  const Expr::Width width = e->getWidth();
+  const std::uint64_t mask = getMask(width);
+  Term result;
+
+  if (width > 64) {
+    result = allocate(all);
+  } else if (auto *CE = dyn_cast<ConstantExpr>(e)) {
+    result = allocate(0);
+    std::fill(&values[result.offset], &values[result.offset] + size,
+              CE->getZExtValue());
+  } else if (auto *re = dyn_cast<ReadExpr>(e)) {
+    result = evaluateRead(*re);
+  } else {
+    unsigned numKids = e->getNumKids();
+    Term kids[3];
+    lanes_ty undefined = 0;
+    for (unsigned i = 0; i < numKids; ++i) {
+      if (e->getKid(i)->getWidth() > 64) {
+        kids[i] = allocate(all);
+      } else {
+        kids[i] = evaluateTerm(e->getKid(i));
+      }
+      undefined |= kids[i].undefined;
+    }
+    if (e->getKind() == Expr::Select) {
+      // only the selected value decides whether the result is defined
+      const std::uint64_t *cond = &values[kids[0].offset];
+      lanes_ty selected = getNonZero(cond, size);
+      undefined = kids[0].undefined | (kids[1].undefined & selected) |
+                  (kids[2].undefined & ~selected);
+    }
+
+    result = allocate(undefined);
+    std::uint64_t *r = &values[result.offset];
+    const std::uint64_t *a = numKids > 0 ? &values[kids[0].offset] : nullptr;
+    const std::uint64_t *b = numKids > 1 ? &values[kids[1].offset] : nullptr;
+    const std::uint64_t *c = numKids > 2 ? &values[kids[2].offset] : nullptr;
+    const unsigned n = size;
+    Expr::Width kidWidth = numKids ? e->getKid(0)->getWidth() : width;
+
+    // nothing to compute, and the kids may be wider than 64 bits
+    if (undefined == all) {
+      terms.emplace(e.get(), result);
+      return result;
+    }
+
+    switch (e->getKind()) {
+    case Expr::NotOptimized:
+      for (unsigned i = 0; i < n; ++i)
+        r[i] = a[i];
+      break;
+    case Expr::Select:
+      for (unsigned i = 0; i < n; ++i)
+        r[i] = a[i] ? b[i] : c[i];
+      break;
+    case Expr::Concat: {
+      Expr::Width shift = e->getKid(1)->getWidth();
+      for (unsigned i = 0; i < n; ++i)
+        r[i] = (a[i] << shift) | b[i];
+      break;
+    }
+    case Expr::Extract: {
+      unsigned offset = cast<ExtractExpr>(e)->offset;
+      for (unsigned i = 0; i < n; ++i)
+        r[i] = (a[i] >> offset) & mask;
+      break;
+    }
+    case Expr::ZExt:
+      for (unsigned i = 0; i < n; ++i)
+        r[i] = a[i];
+      break;
+    case Expr::SExt:
+      for (unsigned i = 0; i < n; ++i)
+        r[i] = static_cast<std::uint64_t>(signExtend(a[i], kidWidth)) & mask;
+      break;
+    case Expr::Add:
+      for (unsigned i = 0; i < n; ++i)
+        r[i] = (a[i] + b[i]) & mask;
+      break;
+    case Expr::Sub:
+      for (unsigned i = 0; i < n; ++i)
+        r[i] = (a[i] - b[i]) & mask;
+      break;
+    case Expr::Mul:
+      for (unsigned i = 0; i < n; ++i)
+        r[i] = (a[i] * b[i]) & mask;
+      break;
+    case Expr::UDiv:
+    case Expr::URem:
+    case Expr::SDiv:
+    case Expr::SRem: {
+      lanes_ty zero = all & ~getNonZero(b, n);
+      for (unsigned i = 0; i < n; ++i) {
+        if (!b[i]) {
+          r[i] = 0;
+          continue;
+        }
+        switch (e->getKind()) {
+        case Expr::UDiv:
+          r[i] = a[i] / b[i];
+          break;
+        case Expr::URem:
+          r[i] = a[i] % b[i];
+          break;
+        default: {
+          std::int64_t x = signExtend(a[i], width), y = signExtend(b[i], width);
+          bool div = e->getKind() == Expr::SDiv;
+          // the quotient of the smallest number and -1 wraps around
+          if (y == -1)
+            r[i] = div ? (0 - a[i]) & mask : 0;
+          else
+            r[i] = static_cast<std::uint64_t>(div ? x / y : x % y) & mask;
+        }
+        }
+      }
+      result.undefined |= zero;
+      break;
+    }
+    case Expr::Not:
+      for (unsigned i = 0; i < n; ++i)
+        r[i] = ~a[i] & mask;
+      break;
+    case Expr::And:
+      for (unsigned i = 0; i < n; ++i)
+        r[i] = a[i] & b[i];
+      break;
+    case Expr::Or:
+      for (unsigned i = 0; i < n; ++i)
+        r[i] = a[i] | b[i];
+      break;
+    case Expr::Xor:
+      for (unsigned i = 0; i < n; ++i)
+        r[i] = a[i] ^ b[i];
+      break;
+    case Expr::Shl:
+      for (unsigned i = 0; i < n; ++i)
+        r[i] = b[i] >= width ? 0 : (a[i] << b[i]) & mask;
+      break;
+    case Expr::LShr:
+      for (unsigned i = 0; i < n; ++i)
+        r[i] = b[i] >= width ? 0 : a[i] >> b[i];
+      break;
+    case Expr::AShr:
+      for (unsigned i = 0; i < n; ++i) {
+        std::int64_t x = signExtend(a[i], width);
+        r[i] = static_cast<std::uint64_t>(x >> (b[i] >= width ? width - 1
+                                                              : b[i])) &
+               mask;
+      }
+      break;
+    case Expr::Eq:
+      for (unsigned i = 0; i < n; ++i)
+        r[i] = a[i] == b[i];
+      break;
+    case Expr::Ne:
+      for (unsigned i = 0; i < n; ++i)
+        r[i] = a[i] != b[i];
+      break;
+    case Expr::Ult:
+      for (unsigned i = 0; i < n; ++i)
+        r[i] = a[i] < b[i];
+      break;
+    case Expr::Ule:
+      for (unsigned i = 0; i < n; ++i)
+        r[i] = a[i] <= b[i];
+      break;
+    case Expr::Ugt:
+      for (unsigned i = 0; i < n; ++i)
+        r[i] = a[i] > b[i];
+      break;
+    case Expr::Uge:
+      for (unsigned i = 0; i < n; ++i)
+        r[i] = a[i] >= b[i];
+      break;
+    case Expr::Slt:
+      for (unsigned i = 0; i < n; ++i)
+        r[i] = signExtend(a[i], kidWidth) < signExtend(b[i], kidWidth);
+      break;
+    case Expr::Sle:
+      for (unsigned i = 0; i < n; ++i)
+        r[i] = signExtend(a[i], kidWidth) <= signExtend(b[i], kidWidth);
+      break;
+    case Expr::Sgt:
+      for (unsigned i = 0; i < n; ++i)
+        r[i] = signExtend(a[i], kidWidth) > signExtend(b[i], kidWidth);
+      break;
+    case Expr::Sge:
+      for (unsigned i = 0; i < n; ++i)
+        r[i] = signExtend(a[i], kidWidth) >= signExtend(b[i], kidWidth);
+      break;
+    default:
+      result.undefined = all;
+      break;
+    }
+  }
+
+  terms.emplace(e.get(), result);
+  return result;
+}
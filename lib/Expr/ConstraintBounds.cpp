@@ -0,0 +1,167 @@
+//===-- ConstraintBounds.cpp ----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/ConstraintBounds.h"
+
+#include "klee/ADT/Bits.h"
+#include "klee/Support/IntEvaluation.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace klee;
+
+UnsignedRange UnsignedRange::full(Expr::Width width) {
+  if (width >= 64)
+    return {0, std::numeric_limits<uint64_t>::max()};
+  return {0, bits64::maxValueOfNBits(width)};
+}
+
+static int64_t signedMin(Expr::Width width) {
+  return width >= 64 ? std::numeric_limits<int64_t>::min()
+                     : -(int64_t(1) << (width - 1));
+}
+
+static int64_t signedMax(Expr::Width width) {
+  return width >= 64 ? std::numeric_limits<int64_t>::max()
+                     : (int64_t(1) << (width - 1)) - 1;
+}
+
+void ConstraintBounds::add(const ref<Expr> &constraint) {
+  addConstraint(constraint, false);
+  ++constraintCount;
+}
+
+void ConstraintBounds::addUnsignedBound(const ref<Expr> &e, uint64_t min,
+                                        uint64_t max) {
+  auto it = unsignedBounds.find(e);
+  if (it == unsignedBounds.end()) {
+    unsignedBounds.emplace(e, UnsignedRange{min, max});
+  } else {
+    it->second.min = std::max(it->second.min, min);
+    it->second.max = std::min(it->second.max, max);
+  }
+}
+
+void ConstraintBounds::addSignedBound(const ref<Expr> &e, int64_t min,
+                                      int64_t max) {
+  auto it = signedBounds.find(e);
+  if (it == signedBounds.end()) {
+    signedBounds.emplace(e, std::make_pair(min, max));
+  } else {
+    it->second.first = std::max(it->second.first, min);
+    it->second.second = std::min(it->second.second, max);
+  }
+}
+
+void ConstraintBounds::addConstraint(const ref<Expr> &constraint,
+                                     bool negated) {
+  switch (constraint->getKind()) {
+  case Expr::And:
+    if (!negated) {
+      addConstraint(constraint->getKid(0), false);
+      addConstraint(constraint->getKid(1), false);
+    }
+    return;
+  case Expr::Eq: {
+    const EqExpr *ee = cast<EqExpr>(constraint);
+    const ConstantExpr *CE = dyn_cast<ConstantExpr>(ee->left);
+    if (!CE || CE->getWidth() > 64)
+      return;
+    if (CE->getWidth() == Expr::Bool) {
+      // (false == x) is the canonical form of !x
+      if (CE->isFalse())
+        addConstraint(ee->right, !negated);
+    } else if (!negated) {
+      uint64_t value = CE->getZExtValue();
+      addUnsignedBound(ee->right, value, value);
+    }
+    return;
+  }
+  case Expr::Ult:
+  case Expr::Ule:
+  case Expr::Slt:
+  case Expr::Sle:
+    break;
+  default:
+    return;
+  }
+
+  // comparisons of a subexpression with a constant
+  const BinaryExpr *be = cast<BinaryExpr>(constraint);
+  Expr::Width width = be->left->getWidth();
+  if (width > 64)
+    return;
+  bool isSigned = constraint->getKind() == Expr::Slt ||
+                  constraint->getKind() == Expr::Sle;
+  bool isStrict = constraint->getKind() == Expr::Ult ||
+                  constraint->getKind() == Expr::Slt;
+
+  ref<Expr> e;
+  bool upper; // the constant bounds e from above
+  uint64_t value;
+  if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(be->right)) {
+    e = be->left;
+    upper = true;
+    value = CE->getZExtValue();
+  } else if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(be->left)) {
+    e = be->right;
+    upper = false;
+    value = CE->getZExtValue();
+  } else {
+    return;
+  }
+
+  // !(e < c) is (c <= e) and !(e <= c) is (c < e)
+  if (negated) {
+    upper = !upper;
+    isStrict = !isStrict;
+  }
+
+  if (isSigned) {
+    int64_t c = (int64_t)ints::sext(value, 64, width);
+    if (upper) {
+      if (isStrict && c == signedMin(width))
+        return;
+      addSignedBound(e, signedMin(width), isStrict ? c - 1 : c);
+    } else {
+      if (isStrict && c == signedMax(width))
+        return;
+      addSignedBound(e, isStrict ? c + 1 : c, signedMax(width));
+    }
+  } else {
+    UnsignedRange range = UnsignedRange::full(width);
+    if (upper) {
+      if (isStrict && value == 0)
+        return;
+      addUnsignedBound(e, range.min, isStrict ? value - 1 : value);
+    } else {
+      if (isStrict && value == range.max)
+        return;
+      addUnsignedBound(e, isStrict ? value + 1 : value, range.max);
+    }
+  }
+}
+
+UnsignedRange ConstraintBounds::restrict(const ref<Expr> &e,
+                                         UnsignedRange range) const {
+  auto ub = unsignedBounds.find(e);
+  if (ub != unsignedBounds.end()) {
+    range.min = std::max(range.min, ub->second.min);
+    range.max = std::min(range.max, ub->second.max);
+  }
+
+  auto sb = signedBounds.find(e);
+  if (sb != signedBounds.end() && sb->second.first >= 0) {
+    // non-negative signed bounds are unsigned bounds as well
+    range.min = std::max(range.min, (uint64_t)sb->second.first);
+    range.max = std::min(range.max, (uint64_t)sb->second.second);
+  }
+  return range;
+}
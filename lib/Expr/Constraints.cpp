@@ -9,14 +9,21 @@
 
 #include "klee/Expr/Constraints.h"
 
+#include "klee/Expr/ConstraintBounds.h"
+#include "klee/Expr/ExprHashMap.h"
+#include "klee/Expr/ExprStats.h"
 #include "klee/Expr/ExprVisitor.h"
+#include "klee/Expr/IndependentSet.h"
 #include "klee/Module/KModule.h"
 #include "klee/Support/OptionCategories.h"
 
 #include "llvm/IR/Function.h"
 #include "llvm/Support/CommandLine.h"
 
+#include <limits>
 #include <map>
+#include <utility>
+#include <vector>
 
 using namespace klee;
 
@@ -27,6 +34,13 @@ llvm::cl::opt<bool> RewriteEqualities(
                    "constant is added (default=true)"),
     llvm::cl::init(true),
     llvm::cl::cat(SolvingCat));
+
+llvm::cl::opt<unsigned> SimplificationCacheSize(
+    "simplification-cache-size",
+    llvm::cl::desc("Number of expressions simplified with the constraints of "
+                   "a path that are remembered by the path (default=4096)"),
+    llvm::cl::init(4096),
+    llvm::cl::cat(SolvingCat));
 } // namespace
 
 class ExprReplaceVisitor : public ExprVisitor {
@@ -70,6 +84,135 @@ public:
   }
 };
 
+namespace klee {
+/// The equalities of a constraint set and the expressions simplified with
+/// them. The cache is extended by the constraints added since it was last
+/// used, and a new constraint drops only the simplified expressions that
+/// read some of the array elements it reads, as it cannot rewrite the
+/// others.
+class SimplificationCache {
+  /// An element of an array, or the whole array if the index is Whole
+  typedef std::pair<const Array *, uint64_t> element_ty;
+  static constexpr uint64_t Whole = std::numeric_limits<uint64_t>::max();
+
+  struct Entry {
+    ref<Expr> simplified;
+    /// The elements read by the expression
+    std::vector<element_ty> elements;
+  };
+
+  std::map<ref<Expr>, ref<Expr>> equalities;
+  ExprHashMap<Entry> simplified;
+  /// The simplified expressions by the elements they read, ordered so that
+  /// the elements of an array are next to each other
+  std::map<element_ty, ExprHashSet> readers;
+  /// The number of added constraints
+  std::size_t constraintCount = 0;
+
+  /// The elements read by e, as collected for the independent factors
+  static std::vector<element_ty> getElements(const ref<Expr> &e);
+  void remove(const ref<Expr> &e);
+  void clear();
+
+public:
+  void add(const ref<Expr> &constraint);
+  ref<Expr> simplify(const ref<Expr> &e);
+
+  std::size_t getConstraintCount() const { return constraintCount; }
+};
+} // namespace klee
+
+constexpr uint64_t SimplificationCache::Whole;
+
+std::vector<SimplificationCache::element_ty>
+SimplificationCache::getElements(const ref<Expr> &e) {
+  IndependentElementSet elements(e);
+  std::vector<element_ty> result;
+  for (const Array *array : elements.wholeObjects)
+    result.emplace_back(array, Whole);
+  for (const auto &element : elements.elements)
+    for (unsigned index : element.second)
+      result.emplace_back(element.first, index);
+  return result;
+}
+
+void SimplificationCache::remove(const ref<Expr> &e) {
+  auto it = simplified.find(e);
+  if (it == simplified.end())
+    return;
+  for (const element_ty &element : it->second.elements) {
+    auto r = readers.find(element);
+    r->second.erase(e);
+    if (r->second.empty())
+      readers.erase(r);
+  }
+  simplified.erase(it);
+}
+
+void SimplificationCache::clear() {
+  simplified.clear();
+  readers.clear();
+}
+
+void SimplificationCache::add(const ref<Expr> &constraint) {
+  ++constraintCount;
+  if (const EqExpr *ee = dyn_cast<EqExpr>(constraint)) {
+    if (isa<ConstantExpr>(ee->left))
+      equalities.insert(std::make_pair(ee->right, ee->left));
+    else
+      equalities.insert(
+          std::make_pair(constraint, ConstantExpr::alloc(1, Expr::Bool)));
+  } else {
+    equalities.insert(
+        std::make_pair(constraint, ConstantExpr::alloc(1, Expr::Bool)));
+  }
+  if (simplified.empty())
+    return;
+
+  std::vector<element_ty> elements = getElements(constraint);
+  if (elements.empty()) {
+    clear();
+    return;
+  }
+  std::vector<ref<Expr>> stale;
+  for (const element_ty &element : elements) {
+    // an element is read by the readers of the element and of the whole
+    // array, a whole array by the readers of any of its elements
+    auto begin = readers.lower_bound(
+        {element.first, element.second == Whole ? 0 : element.second});
+    auto end = readers.upper_bound({element.first, element.second});
+    for (auto it = begin; it != end; ++it)
+      stale.insert(stale.end(), it->second.begin(), it->second.end());
+    if (element.second != Whole) {
+      auto whole = readers.find({element.first, Whole});
+      if (whole != readers.end())
+        stale.insert(stale.end(), whole->second.begin(), whole->second.end());
+    }
+  }
+  for (const ref<Expr> &e : stale)
+    remove(e);
+}
+
+ref<Expr> SimplificationCache::simplify(const ref<Expr> &e) {
+  auto it = simplified.find(e);
+  if (it != simplified.end()) {
+    ++stats::simplificationCacheHits;
+    return it->second.simplified;
+  }
+  ++stats::simplificationCacheMisses;
+
+  ExprReplaceVisitor2 visitor(equalities);
+  ref<Expr> result = visitor.visit(e);
+  if (simplified.size() >= SimplificationCacheSize)
+    clear();
+  Entry &entry = simplified[e];
+  entry.simplified = result;
+  entry.elements = getElements(e);
+  for (const element_ty &element : entry.elements)
+    readers[element].insert(e);
+  return result;
+}
+
 bool ConstraintManager::rewriteConstraints(ExprVisitor &visitor) {
   ConstraintSet old;
   bool changed = false;
@@ -86,33 +229,19 @@ bool ConstraintManager::rewriteConstraints(ExprVisitor &visitor) {
     }
   }
 
+  // keep the set that shares its constraints and factors with its copies
+  if (!changed)
+    std::swap(constraints, old);
   return changed;
 }
 
 ref<Expr> ConstraintManager::simplifyExpr(const ConstraintSet &constraints,
                                           const ref<Expr> &e) {
 
-  if (isa<ConstantExpr>(e))
+  if (isa<ConstantExpr>(e) || constraints.empty())
     return e;
 
-  std::map< ref<Expr>, ref<Expr> > equalities;
-
-  for (auto &constraint : constraints) {
-    if (const EqExpr *ee = dyn_cast<EqExpr>(constraint)) {
-      if (isa<ConstantExpr>(ee->left)) {
-        equalities.insert(std::make_pair(ee->right,
-                                         ee->left));
-      } else {
-        equalities.insert(
-            std::make_pair(constraint, ConstantExpr::alloc(1, Expr::Bool)));
-      }
-    } else {
-      equalities.insert(
-          std::make_pair(constraint, ConstantExpr::alloc(1, Expr::Bool)));
-    }
-  }
-
-  return ExprReplaceVisitor2(equalities).visit(e);
+  return constraints.getSimplificationCache().simplify(e);
 }
 
 void ConstraintManager::addConstraintInternal(const ref<Expr> &e) {
@@ -175,4 +304,34 @@ klee::ConstraintSet::constraint_iterator ConstraintSet::end() const {
 
 size_t ConstraintSet::size() const noexcept { return constraints.size(); }
 
-void ConstraintSet::push_back(const ref<Expr> &e) { constraints.push_back(e); }
+void ConstraintSet::push_back(const ref<Expr> &e) {
+  constraints.push_back(e);
+}
+
+template <typename T>
+T &ConstraintSet::extendCache(std::shared_ptr<T> &cache) const {
+  if (!cache)
+    cache = std::make_shared<T>();
+  std::size_t count = cache->getConstraintCount();
+  if (count == constraints.size())
+    return *cache;
+
+  // the copies of the set share the cache of their common constraints
+  if (cache.use_count() > 1)
+    cache = std::make_shared<T>(*cache);
+  for (std::size_t i = count, e = constraints.size(); i != e; ++i)
+    cache->add(constraints[i]);
+  return *cache;
+}
+
+const IndependentFactors &ConstraintSet::getIndependentFactors() const {
+  return extendCache(independentFactors);
+}
+
+SimplificationCache &ConstraintSet::getSimplificationCache() const {
+  return extendCache(simplificationCache);
+}
+
+const ConstraintBounds &ConstraintSet::getBounds() const {
+  return extendCache(bounds);
+}
@@ -11,6 +11,7 @@
 
 #include "klee/Config/Version.h"
 #include "klee/Expr/ExprPPrinter.h"
+#include "klee/Expr/ExprStats.h"
 #include "klee/Support/OptionCategories.h"
 // FIXME: We shouldn't need this once fast constant support moves into
 // Core. If we need to do arithmetic, we probably want to use APInt.
@@ -25,6 +26,7 @@
 #include "llvm/Support/raw_ostream.h"
 
 #include <sstream>
+#include <unordered_map>
 
 using namespace klee;
 using namespace llvm;
@@ -41,11 +43,85 @@ cl::opt<bool> ConstArrayOpt(
     cl::desc(
         "Enable an optimization involving all-constant arrays (default=false)"),
     cl::cat(klee::ExprCat));
+
+cl::opt<bool, true> HashConsExprs(
+    "hash-cons-exprs", cl::location(Expr::hashConsing), cl::init(false),
+    cl::desc("Keep a single copy of structurally equal expressions, which "
+             "are then compared by their addresses (default=false)"),
+    cl::cat(klee::ExprCat));
+
+/// The live hash-consed expressions by their hashes. It is never freed, as
+/// expressions may outlive it at exit otherwise.
+std::unordered_multimap<unsigned, Expr *> &getHashConsed() {
+  static auto *hashConsed = new std::unordered_multimap<unsigned, Expr *>();
+  return *hashConsed;
+}
+
+std::size_t getExprSize(Expr::Kind k) {
+  switch (k) {
+  case Expr::Constant: return sizeof(ConstantExpr);
+  case Expr::NotOptimized: return sizeof(NotOptimizedExpr);
+  case Expr::Read: return sizeof(ReadExpr);
+  case Expr::Select: return sizeof(SelectExpr);
+  case Expr::Concat: return sizeof(ConcatExpr);
+  case Expr::Extract: return sizeof(ExtractExpr);
+  case Expr::Not: return sizeof(NotExpr);
+  case Expr::ZExt:
+  case Expr::SExt: return sizeof(CastExpr);
+  default:
+    assert(Expr::BinaryKindFirst <= k && k <= Expr::BinaryKindLast &&
+           "invalid kind");
+    return sizeof(BinaryExpr);
+  }
+}
 }
 
 /***/
 
+SlabAllocator klee::exprAllocator;
+
 unsigned Expr::count = 0;
+bool Expr::hashConsing = false;
+unsigned Expr::hashConsedCount = 0;
+
+Expr *Expr::lookupOrInsert(Expr *e) {
+  auto &hashConsed = getHashConsed();
+  Kind kind = e->getKind();
+  unsigned numKids = e->getNumKids();
+  auto range = hashConsed.equal_range(e->hashValue);
+  for (auto it = range.first; it != range.second; ++it) {
+    Expr *other = it->second;
+    if (other->getKind() != kind || other->getWidth() != e->getWidth() ||
+        other->compareContents(*e))
+      continue;
+    bool sameKids = true;
+    for (unsigned i = 0; i < numKids && sameKids; ++i)
+      sameKids = other->getKid(i).get() == e->getKid(i).get();
+    if (!sameKids)
+      continue;
+    ++stats::exprHashConsHits;
+    stats::exprHashConsBytesSaved += getExprSize(kind);
+    return other;
+  }
+
+  ++stats::exprHashConsMisses;
+  hashConsed.emplace(e->hashValue, e);
+  ++hashConsedCount;
+  return e;
+}
+
+void Expr::removeHashConsed() {
+  // called from the destructor, so this may not call virtual methods
+  auto &hashConsed = getHashConsed();
+  auto range = hashConsed.equal_range(hashValue);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second == this) {
+      hashConsed.erase(it);
+      --hashConsedCount;
+      return;
+    }
+  }
+}
 
 ref<Expr> Expr::createTempRead(const Array *array, Expr::Width w) {
   UpdateList ul(array, 0);
@@ -127,6 +203,10 @@ ref<Expr> Expr::createTempRead(const Array *array, Expr::Width w) {
 }
 
 int Expr::compare(const Expr &b) const {
+  // equal hash-consed expressions end here
+  if (this == &b)
+    return 0;
+
   static ExprEquivSet equivs;
   int r = compare(b, equivs);
   equivs.clear();
@@ -371,6 +451,39 @@ void Expr::dump() const {
 
 /***/
 
+const ref<ConstantExpr> *ConstantExpr::getSmallConstant(uint64_t v, Width w) {
+  static const uint64_t positive = 256, negative = 16;
+  static ref<ConstantExpr> smallConstants[5][positive + negative];
+
+  unsigned row;
+  switch (w) {
+  case Expr::Bool: row = 0; break;
+  case Expr::Int8: row = 1; break;
+  case Expr::Int16: row = 2; break;
+  case Expr::Int32: row = 3; break;
+  case Expr::Int64: row = 4; break;
+  default: return nullptr;
+  }
+
+  uint64_t column;
+  if (v < positive) {
+    column = v;
+  } else {
+    // widths up to 8 bits have only positive constants
+    uint64_t allOnes = bits64::maxValueOfNBits(w);
+    if (allOnes - v >= negative)
+      return nullptr;
+    column = positive + (allOnes - v);
+  }
+
+  ref<ConstantExpr> &small = smallConstants[row][column];
+  if (small.isNull()) {
+    small = ref<ConstantExpr>(new ConstantExpr(llvm::APInt(w, v)));
+    small->computeHash();
+  }
+  return &small;
+}
+
 ref<Expr> ConstantExpr::fromMemory(void *address, Width width) {
   switch (width) {
   default: assert(0 && "invalid width");
@@ -0,0 +1,359 @@
+//===-- ExprBounds.cpp ----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/Expr.h"
+
+#include "klee/ADT/Bits.h"
+
+#include "llvm/Support/MathExtras.h"
+
+#include <algorithm>
+
+using namespace klee;
+
+namespace {
+
+/// Reads of constant arrays at more indices or through longer update lists
+/// are not bounded by the values
+const uint64_t MaxBoundedIndices = 1024;
+const unsigned MaxBoundedUpdates = 64;
+
+uint64_t getMask(Expr::Width width) { return bits64::maxValueOfNBits(width); }
+
+ExprBounds getUnknown(Expr::Width width) {
+  return {0, 0, 0, width > 64 ? ~uint64_t(0) : getMask(width)};
+}
+
+ExprBounds getConstant(uint64_t value, Expr::Width width) {
+  return {~value & getMask(width), value, value, value};
+}
+
+ExprBounds getBool(bool value) { return getConstant(value, Expr::Bool); }
+
+/// Either of the bounds
+ExprBounds join(const ExprBounds &a, const ExprBounds &b) {
+  return {a.knownZero & b.knownZero, a.knownOne & b.knownOne,
+          std::min(a.min, b.min), std::max(a.max, b.max)};
+}
+
+/// Make the known bits and the interval agree with each other
+ExprBounds normalize(ExprBounds b, Expr::Width width) {
+  const uint64_t mask = getMask(width);
+  b.knownZero &= mask;
+  b.knownOne &= mask & ~b.knownZero;
+  b.min = std::max(b.min, b.knownOne);
+  b.max = std::min(b.max, ~b.knownZero & mask);
+  if (b.min > b.max)
+    return getUnknown(width);
+
+  // the values of the interval share the bits above the highest bit in
+  // which its ends differ
+  uint64_t differing = b.min ^ b.max;
+  uint64_t prefix =
+      differing ? ~((uint64_t(2) << (63 - llvm::countLeadingZeros(differing))) -
+                    1)
+                : ~uint64_t(0);
+  prefix &= mask;
+  b.knownOne |= b.min & prefix;
+  b.knownZero |= ~b.min & prefix;
+  return b;
+}
+
+/// The known bits of a + b + carry, as computed by LLVM's KnownBits
+void addKnownBits(const ExprBounds &a, const ExprBounds &b, bool carry,
+                  uint64_t mask, uint64_t &knownZero, uint64_t &knownOne) {
+  uint64_t possibleSumZero = (~a.knownZero + ~b.knownZero + carry) & mask;
+  uint64_t possibleSumOne = (a.knownOne + b.knownOne + carry) & mask;
+  uint64_t carryKnownZero =
+      ~(possibleSumZero ^ a.knownZero ^ b.knownZero) & mask;
+  uint64_t carryKnownOne = (possibleSumOne ^ a.knownOne ^ b.knownOne) & mask;
+  uint64_t known = (a.knownZero | a.knownOne) & (b.knownZero | b.knownOne) &
+                   (carryKnownZero | carryKnownOne);
+  knownZero = ~possibleSumOne & known & mask;
+  knownOne = possibleSumOne & known & mask;
+}
+
+unsigned countTrailingKnownZeros(const ExprBounds &b) {
+  return llvm::countTrailingOnes(b.knownZero);
+}
+
+bool isNonNegative(const ExprBounds &b, Expr::Width width) {
+  return b.max <= getMask(width - 1);
+}
+
+/// Whether the operands of a comparison are equal, 0 or 1, or -1 if unknown
+int decideEq(const ExprBounds &a, const ExprBounds &b) {
+  if ((a.knownOne & b.knownZero) || (a.knownZero & b.knownOne) ||
+      a.max < b.min || b.max < a.min)
+    return 0;
+  if (a.isConstant() && b.isConstant())
+    return 1;
+  return -1;
+}
+
+/// Whether a < b (or a <= b), 0 or 1, or -1 if unknown
+int decideUlt(const ExprBounds &a, const ExprBounds &b, bool orEqual) {
+  if (orEqual ? a.max <= b.min : a.max < b.min)
+    return 1;
+  if (orEqual ? a.min > b.max : a.min >= b.max)
+    return 0;
+  return -1;
+}
+
+ExprBounds getDecided(int decided) {
+  return decided < 0 ? getUnknown(Expr::Bool) : getBool(decided);
+}
+
+ExprBounds getReadBounds(const ReadExpr &re) {
+  const Array *array = re.updates.root;
+  if (array->getRange() != Expr::Int8 || !array->isConstantArray())
+    return getUnknown(array->getRange());
+
+  // the bytes past the constant values are unconstrained
+  const ExprBounds &index = re.index->getBounds();
+  const std::size_t size = array->constantValues.size();
+  if (re.index->getWidth() > 64 || index.max >= size ||
+      index.max - index.min >= MaxBoundedIndices)
+    return getUnknown(Expr::Int8);
+  ExprBounds result = getConstant(
+      array->constantValues[index.min]->getZExtValue(8), Expr::Int8);
+  for (uint64_t i = index.min + 1; i <= index.max; ++i)
+    result = join(result,
+                  getConstant(array->constantValues[i]->getZExtValue(8),
+                              Expr::Int8));
+
+  unsigned updates = 0;
+  for (const UpdateNode *un = re.updates.head.get(); un; un = un->next.get()) {
+    if (++updates > MaxBoundedUpdates)
+      return getUnknown(Expr::Int8);
+    result = join(result, un->value->getBounds());
+  }
+  return result;
+}
+
+} // namespace
+
+ExprBounds Expr::computeBounds() const {
+  const Width width = getWidth();
+  if (width > 64)
+    return getUnknown(width);
+  const uint64_t mask = getMask(width);
+
+  if (const ConstantExpr *CE = dyn_cast<ConstantExpr>(this))
+    return getConstant(CE->getZExtValue(), width);
+  if (const ReadExpr *re = dyn_cast<ReadExpr>(this))
+    return normalize(getReadBounds(*re), width);
+
+  for (unsigned i = 0; i < getNumKids(); ++i)
+    if (getKid(i)->getWidth() > 64)
+      return getUnknown(width);
+
+  ExprBounds a = getNumKids() > 0 ? getKid(0)->getBounds() : ExprBounds();
+  ExprBounds b = getNumKids() > 1 ? getKid(1)->getBounds() : ExprBounds();
+  const Width kidWidth = getNumKids() > 0 ? getKid(0)->getWidth() : width;
+  ExprBounds result = getUnknown(width);
+
+  switch (getKind()) {
+  case NotOptimized:
+    result = a;
+    break;
+
+  case Select: {
+    const ExprBounds &c = getKid(2)->getBounds();
+    if (a.isConstant())
+      result = a.min ? b : c;
+    else
+      result = join(b, c);
+    break;
+  }
+
+  case Concat: {
+    Width shift = getKid(1)->getWidth();
+    result = {(a.knownZero << shift) | b.knownZero,
+              (a.knownOne << shift) | b.knownOne, (a.min << shift) | b.min,
+              (a.max << shift) | b.max};
+    break;
+  }
+
+  case Extract: {
+    unsigned offset = cast<ExtractExpr>(this)->offset;
+    result.knownZero = a.knownZero >> offset;
+    result.knownOne = a.knownOne >> offset;
+    if ((a.max >> offset) <= mask) {
+      result.min = a.min >> offset;
+      result.max = a.max >> offset;
+    }
+    break;
+  }
+
+  case ZExt:
+    result = a;
+    result.knownZero |= mask & ~getMask(kidWidth);
+    break;
+
+  case SExt: {
+    uint64_t extension = mask & ~getMask(kidWidth);
+    uint64_t sign = uint64_t(1) << (kidWidth - 1);
+    result.knownZero = a.knownZero | (a.knownZero & sign ? extension : 0);
+    result.knownOne = a.knownOne | (a.knownOne & sign ? extension : 0);
+    if (isNonNegative(a, kidWidth)) {
+      result.min = a.min;
+      result.max = a.max;
+    }
+    break;
+  }
+
+  case Add: {
+    addKnownBits(a, b, false, mask, result.knownZero, result.knownOne);
+    uint64_t max;
+    if (!__builtin_add_overflow(a.max, b.max, &max) && max <= mask) {
+      result.min = a.min + b.min;
+      result.max = max;
+    }
+    break;
+  }
+
+  case Sub: {
+    // a - b is a + ~b + 1
+    ExprBounds notB = {b.knownOne, b.knownZero, 0, mask};
+    addKnownBits(a, notB, true, mask, result.knownZero, result.knownOne);
+    if (a.min >= b.max) {
+      result.min = a.min - b.max;
+      result.max = a.max - b.min;
+    }
+    break;
+  }
+
+  case Mul: {
+    unsigned zeros = std::min<unsigned>(
+        width, countTrailingKnownZeros(a) + countTrailingKnownZeros(b));
+    result.knownZero = getMask(zeros);
+    uint64_t max;
+    if (!__builtin_mul_overflow(a.max, b.max, &max) && max <= mask) {
+      result.min = a.min * b.min;
+      result.max = max;
+    }
+    break;
+  }
+
+  case UDiv:
+    if (b.min) {
+      result.min = a.min / b.max;
+      result.max = a.max / b.min;
+    }
+    break;
+
+  case URem:
+    // the remainder of a division by zero is the dividend
+    if (b.min && a.max < b.min) {
+      result.min = a.min;
+      result.max = a.max;
+    } else {
+      result.max = b.min ? std::min(a.max, b.max - 1) : a.max;
+    }
+    break;
+
+  case Not:
+    result = {a.knownOne, a.knownZero, mask - a.max, mask - a.min};
+    break;
+
+  case And:
+    result.knownZero = a.knownZero | b.knownZero;
+    result.knownOne = a.knownOne & b.knownOne;
+    result.max = std::min(a.max, b.max);
+    break;
+
+  case Or:
+    result.knownZero = a.knownZero & b.knownZero;
+    result.knownOne = a.knownOne | b.knownOne;
+    result.min = std::max(a.min, b.min);
+    break;
+
+  case Xor:
+    result.knownZero = (a.knownZero & b.knownZero) | (a.knownOne & b.knownOne);
+    result.knownOne = (a.knownZero & b.knownOne) | (a.knownOne & b.knownZero);
+    break;
+
+  case Shl:
+    if (b.isConstant()) {
+      if (b.min >= width)
+        return getConstant(0, width);
+      unsigned shift = b.min;
+      result.knownZero = (a.knownZero << shift) | getMask(shift);
+      result.knownOne = a.knownOne << shift;
+      if ((a.max << shift >> shift) == a.max && (a.max << shift) <= mask) {
+        result.min = a.min << shift;
+        result.max = a.max << shift;
+      }
+    }
+    break;
+
+  case LShr:
+    // shifting right only decreases the value
+    result.max = a.max;
+    if (b.max < width)
+      result.min = a.min >> b.max;
+    if (b.isConstant()) {
+      if (b.min >= width)
+        return getConstant(0, width);
+      unsigned shift = b.min;
+      result.knownZero = (a.knownZero >> shift) | (mask & ~(mask >> shift));
+      result.knownOne = a.knownOne >> shift;
+      result.max = a.max >> shift;
+    }
+    break;
+
+  case AShr:
+    if (isNonNegative(a, width)) {
+      result.max = a.max;
+      if (b.max < width)
+        result.min = a.min >> b.max;
+    }
+    break;
+
+  case Eq:
+    result = getDecided(decideEq(a, b));
+    break;
+  case Ne: {
+    int decided = decideEq(a, b);
+    result = getDecided(decided < 0 ? decided : !decided);
+    break;
+  }
+  case Ult:
+    result = getDecided(decideUlt(a, b, false));
+    break;
+  case Ule:
+    result = getDecided(decideUlt(a, b, true));
+    break;
+  case Ugt:
+    result = getDecided(decideUlt(b, a, false));
+    break;
+  case Uge:
+    result = getDecided(decideUlt(b, a, true));
+    break;
+
+  // signed comparisons of non-negative values are unsigned ones
+  case Slt:
+  case Sle:
+  case Sgt:
+  case Sge:
+    if (isNonNegative(a, kidWidth) && isNonNegative(b, kidWidth)) {
+      Kind kind = getKind();
+      bool swapped = kind == Sgt || kind == Sge;
+      result = getDecided(decideUlt(swapped ? b : a, swapped ? a : b,
+                                    kind == Sle || kind == Sge));
+    }
+    break;
+
+  default:
+    break;
+  }
+
+  return normalize(result, width);
+}
@@ -0,0 +1,496 @@
+//===-- ExprJIT.cpp -------------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/ExprJIT.h"
+
+#include "klee/Expr/ExprStats.h"
+#include "klee/Support/ErrorHandling.h"
+
+#include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/ExecutionEngine/MCJIT.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/TargetSelect.h"
+
+#include <string>
+#include <unordered_map>
+
+using namespace klee;
+using namespace llvm;
+
+namespace {
+
+/// Emits the code computing an expression and whether it is undefined. The
+/// undefined flag of a term is null if the term is never undefined.
+class ExprCompiler {
+  IRBuilder<> &builder;
+  Argument *bytesArg, *sizesArg;
+  std::vector<const Array *> &arrays;
+
+  struct Compiled {
+    Value *value;
+    Value *undefined;
+  };
+  std::unordered_map<const Expr *, Compiled> compiled;
+  /// The bytes and the number of bytes of the arrays
+  std::unordered_map<const Array *, std::pair<Value *, Value *>> arrayValues;
+  std::unordered_map<const Array *, GlobalVariable *> constantArrays;
+
+  Type *getType(Expr::Width width) { return builder.getIntNTy(width); }
+  Value *either(Value *a, Value *b) {
+    if (!a)
+      return b;
+    if (!b)
+      return a;
+    return builder.CreateOr(a, b);
+  }
+
+  std::pair<Value *, Value *> getArray(const Array *array);
+  Value *compileRoot(const Array *array, Value *index);
+  bool compileRead(const ReadExpr &re, Compiled &result);
+  bool compileKids(const Expr &e, Compiled *kids);
+
+public:
+  ExprCompiler(IRBuilder<> &builder, Function *function,
+               std::vector<const Array *> &arrays)
+      : builder(builder), bytesArg(function->arg_begin()),
+        sizesArg(function->arg_begin() + 1), arrays(arrays) {}
+
+  /// False if the expression cannot be compiled
+  bool compile(const ref<Expr> &e, Value *&value, Value *&undefined);
+};
+
+std::pair<Value *, Value *> ExprCompiler::getArray(const Array *array) {
+  auto it = arrayValues.find(array);
+  if (it != arrayValues.end())
+    return it->second;
+
+  Value *slot = builder.getInt64(arrays.size());
+  arrays.push_back(array);
+  Type *bytePtrTy = builder.getInt8PtrTy();
+  Value *bytes = builder.CreateLoad(
+      bytePtrTy, builder.CreateInBoundsGEP(bytePtrTy, bytesArg, slot));
+  Value *size = builder.CreateLoad(
+      builder.getInt64Ty(),
+      builder.CreateInBoundsGEP(builder.getInt64Ty(), sizesArg, slot));
+  return arrayValues[array] = std::make_pair(bytes, size);
+}
+
+/// The byte of the array without updates, the bytes of the assignment past
+/// their end read as zero, the same as Assignment::evaluate
+Value *ExprCompiler::compileRoot(const Array *array, Value *index) {
+  std::pair<Value *, Value *> bytes = getArray(array);
+  Value *inBounds = builder.CreateICmpULT(index, bytes.second);
+  Value *safeIndex = builder.CreateSelect(inBounds, index, builder.getInt64(0));
+  Value *byte = builder.CreateLoad(
+      builder.getInt8Ty(),
+      builder.CreateGEP(builder.getInt8Ty(), bytes.first, safeIndex));
+  Value *value = builder.CreateSelect(inBounds, byte, builder.getInt8(0));
+  if (!array->isConstantArray() || array->constantValues.empty())
+    return value;
+
+  GlobalVariable *&constants = constantArrays[array];
+  ArrayType *arrayTy =
+      ArrayType::get(builder.getInt8Ty(), array->constantValues.size());
+  if (!constants) {
+    std::vector<llvm::Constant *> elements;
+    for (const ref<klee::ConstantExpr> &CE : array->constantValues)
+      elements.push_back(builder.getInt8(CE->getZExtValue(8)));
+    Module *module = builder.GetInsertBlock()->getModule();
+    constants = new GlobalVariable(*module, arrayTy, true,
+                                   GlobalValue::PrivateLinkage,
+                                   ConstantArray::get(arrayTy, elements));
+  }
+  Value *inConstants = builder.CreateICmpULT(
+      index, builder.getInt64(array->constantValues.size()));
+  Value *constantIndex =
+      builder.CreateSelect(inConstants, index, builder.getInt64(0));
+  Value *constant = builder.CreateLoad(
+      builder.getInt8Ty(),
+      builder.CreateInBoundsGEP(arrayTy, constants,
+                                {builder.getInt64(0), constantIndex}));
+  return builder.CreateSelect(inConstants, constant, value);
+}
+
+bool ExprCompiler::compileRead(const ReadExpr &re, Compiled &result) {
+  const Array *array = re.updates.root;
+  if (array->getDomain() > 64 || array->getRange() != Expr::Int8)
+    return false;
+
+  Value *index;
+  if (!compile(re.index, index, result.undefined))
+    return false;
+  index = builder.CreateZExt(index, builder.getInt64Ty());
+
+  std::vector<const UpdateNode *> updates;
+  for (const UpdateNode *un = re.updates.head.get(); un; un = un->next.get())
+    updates.push_back(un);
+
+  Value *value = compileRoot(array, index);
+  // The newest update at the index is read, and the read is undefined if an
+  // update index up to it is undefined.
+  Value *undefined = nullptr;
+  for (auto it = updates.rbegin(), ie = updates.rend(); it != ie; ++it) {
+    Value *updateIndex, *updateValue, *indexUndefined, *valueUndefined;
+    if (!compile((*it)->index, updateIndex, indexUndefined) ||
+        !compile((*it)->value, updateValue, valueUndefined))
+      return false;
+    Value *match = builder.CreateICmpEQ(
+        builder.CreateZExt(updateIndex, builder.getInt64Ty()), index);
+    value = builder.CreateSelect(match, updateValue, value);
+    if (valueUndefined || undefined)
+      undefined = builder.CreateSelect(
+          match, valueUndefined ? valueUndefined : builder.getFalse(),
+          undefined ? undefined : builder.getFalse());
+    undefined = either(indexUndefined, undefined);
+  }
+  result.value = value;
+  result.undefined = either(result.undefined, undefined);
+  return true;
+}
+
+bool ExprCompiler::compileKids(const Expr &e, Compiled *kids) {
+  for (unsigned i = 0; i < e.getNumKids(); ++i)
+    if (!compile(e.getKid(i), kids[i].value, kids[i].undefined))
+      return false;
+  return true;
+}
+
+bool ExprCompiler::compile(const ref<Expr> &e, Value *&value,
+                           Value *&undefined) {
+  auto it = compiled.find(e.get());
+  if (it != compiled.end()) {
+    value = it->second.value;
+    undefined = it->second.undefined;
+    return true;
+  }
+
+  const Expr::Width width = e->getWidth();
+  if (width > 64)
+    return false;
+
+  Compiled result{nullptr, nullptr};
+  Compiled kids[3] = {};
+  if (auto *CE = dyn_cast<klee::ConstantExpr>(e)) {
+    result.value = ConstantInt::get(builder.getContext(), CE->getAPValue());
+  } else if (auto *re = dyn_cast<ReadExpr>(e)) {
+    if (!compileRead(*re, result))
+      return false;
+  } else {
+    if (!compileKids(*e, kids))
+      return false;
+    Value *a = kids[0].value, *b = kids[1].value;
+    result.undefined = either(kids[0].undefined, kids[1].undefined);
+
+    switch (e->getKind()) {
+    case Expr::NotOptimized:
+      result.value = a;
+      break;
+    case Expr::Select:
+      result.value = builder.CreateSelect(a, b, kids[2].value);
+      // only the selected value decides whether the result is defined
+      result.undefined = kids[0].undefined;
+      if (kids[1].undefined || kids[2].undefined)
+        result.undefined = either(
+            result.undefined,
+            builder.CreateSelect(
+                a, kids[1].undefined ? kids[1].undefined : builder.getFalse(),
+                kids[2].undefined ? kids[2].undefined : builder.getFalse()));
+      break;
+    case Expr::Concat: {
+      Type *ty = getType(width);
+      result.value = builder.CreateOr(
+          builder.CreateShl(builder.CreateZExt(a, ty),
+                            e->getKid(1)->getWidth()),
+          builder.CreateZExt(b, ty));
+      break;
+    }
+    case Expr::Extract:
+      result.value = builder.CreateTrunc(
+          builder.CreateLShr(a, cast<ExtractExpr>(e)->offset),
+          getType(width));
+      break;
+    case Expr::ZExt:
+      result.value = builder.CreateZExtOrTrunc(a, getType(width));
+      break;
+    case Expr::SExt:
+      result.value = builder.CreateSExtOrTrunc(a, getType(width));
+      break;
+    case Expr::Add:
+      result.value = builder.CreateAdd(a, b);
+      break;
+    case Expr::Sub:
+      result.value = builder.CreateSub(a, b);
+      break;
+    case Expr::Mul:
+      result.value = builder.CreateMul(a, b);
+      break;
+    case Expr::UDiv:
+    case Expr::URem:
+    case Expr::SDiv:
+    case Expr::SRem: {
+      Type *ty = getType(width);
+      Value *zero = builder.CreateICmpEQ(b, ConstantInt::get(ty, 0));
+      // the division by zero or of the smallest number by -1 must not trap
+      Value *minusOne = builder.CreateICmpEQ(b, ConstantInt::get(ty, -1, true));
+      Value *safe = builder.CreateSelect(builder.CreateOr(zero, minusOne),
+                                         ConstantInt::get(ty, 1), b);
+      switch (e->getKind()) {
+      case Expr::UDiv:
+        result.value = builder.CreateUDiv(
+            a, builder.CreateSelect(zero, ConstantInt::get(ty, 1), b));
+        break;
+      case Expr::URem:
+        result.value = builder.CreateURem(
+            a, builder.CreateSelect(zero, ConstantInt::get(ty, 1), b));
+        break;
+      case Expr::SDiv:
+        result.value = builder.CreateSelect(minusOne, builder.CreateNeg(a),
+                                            builder.CreateSDiv(a, safe));
+        break;
+      default:
+        result.value = builder.CreateSelect(
+            minusOne, ConstantInt::get(ty, 0), builder.CreateSRem(a, safe));
+        break;
+      }
+      result.undefined = either(result.undefined, zero);
+      break;
+    }
+    case Expr::Not:
+      result.value = builder.CreateNot(a);
+      break;
+    case Expr::And:
+      result.value = builder.CreateAnd(a, b);
+      break;
+    case Expr::Or:
+      result.value = builder.CreateOr(a, b);
+      break;
+    case Expr::Xor:
+      result.value = builder.CreateXor(a, b);
+      break;
+    case Expr::Shl:
+    case Expr::LShr:
+    case Expr::AShr: {
+      // shifting by the width or more is poison in LLVM
+      Type *ty = getType(width);
+      Value *large = builder.CreateICmpUGE(b, ConstantInt::get(ty, width));
+      if (e->getKind() == Expr::AShr) {
+        result.value = builder.CreateAShr(
+            a,
+            builder.CreateSelect(large, ConstantInt::get(ty, width - 1), b));
+        break;
+      }
+      Value *amount = builder.CreateSelect(large, ConstantInt::get(ty, 0), b);
+      Value *shifted = e->getKind() == Expr::Shl
+                           ? builder.CreateShl(a, amount)
+                           : builder.CreateLShr(a, amount);
+      result.value =
+          builder.CreateSelect(large, ConstantInt::get(ty, 0), shifted);
+      break;
+    }
+    case Expr::Eq:
+      result.value = builder.CreateICmpEQ(a, b);
+      break;
+    case Expr::Ne:
+      result.value = builder.CreateICmpNE(a, b);
+      break;
+    case Expr::Ult:
+      result.value = builder.CreateICmpULT(a, b);
+      break;
+    case Expr::Ule:
+      result.value = builder.CreateICmpULE(a, b);
+      break;
+    case Expr::Ugt:
+      result.value = builder.CreateICmpUGT(a, b);
+      break;
+    case Expr::Uge:
+      result.value = builder.CreateICmpUGE(a, b);
+      break;
+    case Expr::Slt:
+      result.value = builder.CreateICmpSLT(a, b);
+      break;
+    case Expr::Sle:
+      result.value = builder.CreateICmpSLE(a, b);
+      break;
+    case Expr::Sgt:
+      result.value = builder.CreateICmpSGT(a, b);
+      break;
+    case Expr::Sge:
+      result.value = builder.CreateICmpSGE(a, b);
+      break;
+    default:
+      return false;
+    }
+  }
+
+  compiled.emplace(e.get(), result);
+  value = result.value;
+  undefined = result.undefined;
+  return true;
+}
+
+} // namespace
+
+ExprJIT::ExprJIT(unsigned threshold, unsigned capacity)
+    : threshold(threshold), capacity(capacity), context(new LLVMContext()) {
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmParser();
+  llvm::InitializeNativeTargetAsmPrinter();
+  createEngine();
+}
+
+ExprJIT::~ExprJIT() {
+  // the engine owns the modules
+  delete executionEngine;
+}
+
+void ExprJIT::createEngine() {
+  delete executionEngine;
+  evictedFunctions = 0;
+
+  std::string error;
+  // the engine needs a module, the compiled expressions are added later
+  auto module = std::make_unique<Module>("klee-expr-jit", *context);
+  executionEngine = EngineBuilder(std::move(module))
+                        .setErrorStr(&error)
+                        .setEngineKind(EngineKind::JIT)
+                        .create();
+  if (!executionEngine)
+    klee_warning("unable to make expression jit: %s, interpreting",
+                 error.c_str());
+}
+
+void ExprJIT::evict() {
+  auto it = entries.find(recentlyUsed.back());
+  if (it->second.module) {
+    executionEngine->removeModule(it->second.module);
+    delete it->second.module;
+    ++evictedFunctions;
+  }
+  entries.erase(it);
+  recentlyUsed.pop_back();
+  ++stats::exprJITEvictions;
+
+  // the engine frees the code of the removed modules only when it is deleted
+  if (evictedFunctions >= capacity) {
+    entries.clear();
+    recentlyUsed.clear();
+    createEngine();
+  }
+}
+
+bool ExprJIT::compile(const ref<Expr> &e, Entry &entry) {
+  if (!executionEngine)
+    return false;
+
+  std::string name = "klee_expr_" + std::to_string(compiledCount);
+  auto module = std::make_unique<Module>(name, *context);
+  module->setDataLayout(executionEngine->getDataLayout());
+  Type *bytePtrTy = Type::getInt8PtrTy(*context);
+  FunctionType *functionTy = FunctionType::get(
+      Type::getInt64Ty(*context),
+      {PointerType::getUnqual(bytePtrTy), Type::getInt64PtrTy(*context),
+       bytePtrTy},
+      false);
+  Function *function = Function::Create(
+      functionTy, GlobalValue::ExternalLinkage, name, module.get());
+  IRBuilder<> builder(BasicBlock::Create(*context, "entry", function));
+
+  std::vector<const Array *> arrays;
+  ExprCompiler compiler(builder, function, arrays);
+  Value *value, *undefined;
+  if (!compiler.compile(e, value, undefined))
+    return false;
+  builder.CreateStore(
+      undefined ? builder.CreateZExt(undefined, builder.getInt8Ty())
+                : builder.getInt8(0),
+      function->arg_begin() + 2);
+  builder.CreateRet(builder.CreateZExt(value, builder.getInt64Ty()));
+
+  entry.module = module.get();
+  executionEngine->addModule(std::move(module));
+  ++compiledCount;
+  entry.function = reinterpret_cast<function_ty>(
+      executionEngine->getFunctionAddress(name));
+  if (!entry.function)
+    return false;
+  entry.arrays = std::move(arrays);
+  ++stats::exprJITCompilations;
+  return true;
+}
+
+ExprJIT::Entry *ExprJIT::lookup(const ref<Expr> &e, unsigned count) {
+  if (isa<klee::ConstantExpr>(e))
+    return nullptr;
+
+  auto it = entries.find(e);
+  if (it == entries.end()) {
+    if (capacity && entries.size() >= capacity)
+      evict();
+    recentlyUsed.push_front(e);
+    it = entries.emplace(e, Entry()).first;
+    it->second.position = recentlyUsed.begin();
+  } else {
+    recentlyUsed.splice(recentlyUsed.begin(), recentlyUsed,
+                        it->second.position);
+  }
+
+  Entry &entry = it->second;
+  if (!entry.function) {
+    // the expressions that cannot be compiled stay at the threshold
+    if (entry.evaluations >= threshold)
+      return nullptr;
+    entry.evaluations += count;
+    if (entry.evaluations < threshold)
+      return nullptr;
+    entry.evaluations = threshold;
+    if (!compile(e, entry))
+      return nullptr;
+  }
+  return &entry;
+}
+
+bool ExprJIT::run(const Entry &entry, const Assignment &a,
+                  std::uint64_t &value) {
+  bytes.resize(entry.arrays.size());
+  sizes.resize(entry.arrays.size());
+  unsigned expandedCount = 0;
+  static const std::uint8_t none = 0;
+  for (unsigned i = 0; i < entry.arrays.size(); ++i) {
+    const CompactArrayModel *model = a.getBindingsOrNull(entry.arrays[i]);
+    const std::vector<std::uint8_t> *values =
+        model ? model->getDense() : nullptr;
+    if (model && !values) {
+      if (expanded.size() <= expandedCount)
+        expanded.resize(expandedCount + 1);
+      expanded[expandedCount] = model->asVector();
+      values = &expanded[expandedCount++];
+    }
+    bytes[i] = values && !values->empty() ? values->data() : &none;
+    sizes[i] = values ? values->size() : 0;
+  }
+
+  std::uint8_t undefined;
+  value = entry.function(bytes.data(), sizes.data(), &undefined);
+  ++stats::exprJITEvaluations;
+  return !undefined;
+}
+
+ref<Expr> ExprJIT::evaluate(const Assignment &a, const ref<Expr> &e) {
+  std::uint64_t value;
+  Entry *entry = lookup(e, 1);
+  if (entry && run(*entry, a, value))
+    return klee::ConstantExpr::create(value, e->getWidth());
+  return a.evaluate(e);
+}
@@ -0,0 +1,22 @@
+//===-- ExprStats.cpp -----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/ExprStats.h"
+
+using namespace klee;
+
+Statistic stats::exprHashConsHits("ExprHashConsHits", "EHChits");
+Statistic stats::exprHashConsMisses("ExprHashConsMisses", "EHCmisses");
+Statistic stats::exprHashConsBytesSaved("ExprHashConsBytesSaved", "EHCsaved");
+Statistic stats::simplificationCacheHits("SimplificationCacheHits", "SChits");
+Statistic stats::simplificationCacheMisses("SimplificationCacheMisses",
+                                           "SCmisses");
+Statistic stats::exprJITCompilations("ExprJITCompilations", "EJcomps");
+Statistic stats::exprJITEvaluations("ExprJITEvaluations", "EJevals");
+Statistic stats::exprJITEvictions("ExprJITEvictions", "EJevicts");
@@ -8,6 +8,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "klee/Expr/ExprUtil.h"
+#include "klee/Expr/Constraints.h"
 #include "klee/Expr/Expr.h"
 #include "klee/Expr/ExprHashMap.h"
 #include "klee/Expr/ExprVisitor.h"
@@ -141,3 +142,6 @@ template void klee::findSymbolicObjects<CA>(CA, CA, std::vector<const Array*> &)
 
 typedef std::set< ref<Expr> >::iterator B;
 template void klee::findSymbolicObjects<B>(B, B, std::vector<const Array*> &);
+
+typedef ConstraintSet::const_iterator C;
+template void klee::findSymbolicObjects<C>(C, C, std::vector<const Array*> &);
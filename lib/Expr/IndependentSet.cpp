@@ -0,0 +1,176 @@
+//===-- IndependentSet.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/IndependentSet.h"
+
+#include "klee/Expr/ExprUtil.h"
+
+using namespace klee;
+
+IndependentElementSet::IndependentElementSet(ref<Expr> e) {
+  exprs.push_back(e);
+  // Track all reads in the program.  Determines whether reads are
+  // concrete or symbolic.  If they are symbolic, "collapses" array
+  // by adding it to wholeObjects.  Otherwise, creates a mapping of
+  // the form Map<array, set<index>> which tracks which parts of the
+  // array are being accessed.
+  std::vector< ref<ReadExpr> > reads;
+  findReads(e, /* visitUpdates= */ true, reads);
+  for (unsigned i = 0; i != reads.size(); ++i) {
+    ReadExpr *re = reads[i].get();
+    const Array *array = re->updates.root;
+
+    // Reads of a constant array don't alias.
+    if (re->updates.root->isConstantArray() && !re->updates.head)
+      continue;
+
+    if (!wholeObjects.count(array)) {
+      if (ConstantExpr *CE = dyn_cast<ConstantExpr>(re->index)) {
+        // if index constant, then add to set of constraints operating
+        // on that array (actually, don't add constraint, just set index)
+        DenseSet<unsigned> &dis = elements[array];
+        dis.add((unsigned) CE->getZExtValue(32));
+      } else {
+        elements_ty::iterator it2 = elements.find(array);
+        if (it2!=elements.end())
+          elements.erase(it2);
+        wholeObjects.insert(array);
+      }
+    }
+  }
+}
+
+void IndependentElementSet::print(llvm::raw_ostream &os) const {
+  os << "{";
+  bool first = true;
+  for (std::set<const Array*>::iterator it = wholeObjects.begin(),
+         ie = wholeObjects.end(); it != ie; ++it) {
+    const Array *array = *it;
+
+    if (first) {
+      first = false;
+    } else {
+      os << ", ";
+    }
+
+    os << "MO" << array->name;
+  }
+  for (elements_ty::const_iterator it = elements.begin(), ie = elements.end();
+       it != ie; ++it) {
+    const Array *array = it->first;
+    const DenseSet<unsigned> &dis = it->second;
+
+    if (first) {
+      first = false;
+    } else {
+      os << ", ";
+    }
+
+    os << "MO" << array->name << " : " << dis;
+  }
+  os << "}";
+}
+
+bool IndependentElementSet::intersects(const IndependentElementSet &b) const {
+  // If there are any symbolic arrays in our query that b accesses
+  for (std::set<const Array*>::const_iterator it = wholeObjects.begin(),
+         ie = wholeObjects.end(); it != ie; ++it) {
+    const Array *array = *it;
+    if (b.wholeObjects.count(array) ||
+        b.elements.find(array) != b.elements.end())
+      return true;
+  }
+  for (elements_ty::const_iterator it = elements.begin(), ie = elements.end();
+       it != ie; ++it) {
+    const Array *array = it->first;
+    // if the array we access is symbolic in b
+    if (b.wholeObjects.count(array))
+      return true;
+    elements_ty::const_iterator it2 = b.elements.find(array);
+    // if any of the elements we access are also accessed by b
+    if (it2 != b.elements.end()) {
+      if (it->second.intersects(it2->second))
+        return true;
+    }
+  }
+  return false;
+}
+
+bool IndependentElementSet::add(const IndependentElementSet &b) {
+  for(unsigned i = 0; i < b.exprs.size(); i ++){
+    ref<Expr> expr = b.exprs[i];
+    exprs.push_back(expr);
+  }
+
+  bool modified = false;
+  for (std::set<const Array*>::const_iterator it = b.wholeObjects.begin(),
+         ie = b.wholeObjects.end(); it != ie; ++it) {
+    const Array *array = *it;
+    elements_ty::iterator it2 = elements.find(array);
+    if (it2!=elements.end()) {
+      modified = true;
+      elements.erase(it2);
+      wholeObjects.insert(array);
+    } else {
+      if (!wholeObjects.count(array)) {
+        modified = true;
+        wholeObjects.insert(array);
+      }
+    }
+  }
+  for (elements_ty::const_iterator it = b.elements.begin(),
+         ie = b.elements.end(); it != ie; ++it) {
+    const Array *array = it->first;
+    if (!wholeObjects.count(array)) {
+      elements_ty::iterator it2 = elements.find(array);
+      if (it2==elements.end()) {
+        modified = true;
+        elements.insert(*it);
+      } else {
+        // Now need to see if there are any (z=?)'s
+        if (it2->second.add(it->second))
+          modified = true;
+      }
+    }
+  }
+  return modified;
+}
+
+void IndependentFactors::add(const ref<Expr> &constraint) {
+  ++constraintCount;
+  IndependentElementSet current(constraint);
+  // The factors do not intersect each other, so the factors that intersect
+  // the constraint are exactly those that intersect the merged factor.
+  IndependentElementSet merged;
+  factors_ty kept;
+  for (const auto &factor : factors) {
+    if (current.intersects(*factor))
+      merged.add(*factor);
+    else
+      kept.push_back(factor);
+  }
+  merged.add(current);
+  kept.push_back(std::make_shared<const IndependentElementSet>(
+      std::move(merged)));
+  factors.swap(kept);
+}
+
+IndependentElementSet
+IndependentFactors::getIndependentConstraints(
+    const ref<Expr> &expr, std::vector<ref<Expr>> &result) const {
+  IndependentElementSet eltsClosure(expr);
+  IndependentElementSet queried(eltsClosure);
+  for (const auto &factor : factors) {
+    if (queried.intersects(*factor)) {
+      eltsClosure.add(*factor);
+      result.insert(result.end(), factor->exprs.begin(), factor->exprs.end());
+    }
+  }
+  return eltsClosure;
+}
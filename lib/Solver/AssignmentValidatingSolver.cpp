@@ -9,6 +9,7 @@
 
 #include "klee/Expr/Constraints.h"
 #include "klee/Expr/Assignment.h"
+#include "klee/Expr/BatchedEvaluator.h"
 #include "klee/Solver/Solver.h"
 #include "klee/Solver/SolverImpl.h"
 
@@ -58,6 +59,15 @@ bool AssignmentValidatingSolver::computeInitialValues(
   if (!hasSolution)
     return success;
 
+  // The common case of a valid assignment is checked by the batched
+  // evaluator, which evaluates the terms shared by the constraints once.
+  BatchedEvaluator evaluator({result.get()});
+  const std::uint64_t *value;
+  if (evaluator.satisfies(query.constraints.begin(),
+                          query.constraints.end()) &&
+      evaluator.evaluate(query.expr, value) && !*value)
+    return success;
+
   // Check computed assignment satisfies query
   for (const auto &constraint : query.constraints) {
     ref<Expr> constraintEvaluated = result->evaluate(constraint);
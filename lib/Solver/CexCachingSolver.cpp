@@ -9,10 +9,13 @@
 
 #include "klee/Solver/Solver.h"
 
-#include "klee/ADT/MapOfSets.h"
+#include "klee/ADT/SetTrie.h"
 #include "klee/Expr/Assignment.h"
+#include "klee/Expr/BatchedEvaluator.h"
 #include "klee/Expr/Constraints.h"
 #include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprHashMap.h"
+#include "klee/Expr/ExprJIT.h"
 #include "klee/Expr/ExprUtil.h"
 #include "klee/Expr/ExprVisitor.h"
 #include "klee/Support/OptionCategories.h"
@@ -23,6 +26,8 @@
 
 #include "llvm/Support/CommandLine.h"
 
+#include <map>
+
 using namespace klee;
 using namespace llvm;
 
@@ -45,11 +50,43 @@ cl::opt<bool>
                               "before asking the SMT solver (default=false)"),
                      cl::cat(SolvingCat));
 
+cl::opt<bool> CexCacheSubset(
+    "cex-cache-subset", cl::init(true),
+    cl::desc("Try the counterexamples of the subsets of a query, and whether "
+             "a subset is unsatisfiable, before asking the SMT solver "
+             "(default=true)"),
+    cl::cat(SolvingCat));
+
+cl::opt<unsigned> CexCacheSize(
+    "cex-cache-size", cl::init(0),
+    cl::desc("Number of queries whose counterexamples are cached, the least "
+             "recently used ones are evicted (default=0, unbounded)"),
+    cl::cat(SolvingCat));
+
 cl::opt<bool> CexCacheExperimental(
     "cex-cache-exp", cl::init(false),
     cl::desc("Optimization for validity queries (default=false)"),
     cl::cat(SolvingCat));
 
+cl::opt<bool> CexCacheJIT(
+    "cex-cache-jit", cl::init(false),
+    cl::desc("Compile the constraints that the counterexamples are often "
+             "tested against to native code (default=false)"),
+    cl::cat(SolvingCat));
+
+cl::opt<unsigned> CexCacheJITThreshold(
+    "cex-cache-jit-threshold", cl::init(256),
+    cl::desc("Compile a constraint once the counterexamples were tested "
+             "against it this many times (default=256)"),
+    cl::cat(SolvingCat));
+
+cl::opt<unsigned> CexCacheJITSize(
+    "cex-cache-jit-size", cl::init(4096),
+    cl::desc("Number of constraints whose tests are counted or whose code is "
+             "kept by -cex-cache-jit, the least recently used ones are "
+             "evicted (default=4096, 0 for unbounded)"),
+    cl::cat(SolvingCat));
+
 } // namespace
 
 ///
@@ -57,14 +94,20 @@ cl::opt<bool> CexCacheExperimental(
 typedef std::set< ref<Expr> > KeyType;
 
 class CexCachingSolver : public SolverImpl {
-  typedef std::set<std::shared_ptr<const Assignment> >
+  /// The assignments with the number of cached queries that have them
+  typedef std::map<std::shared_ptr<const Assignment>, unsigned>
           assignmentsTable_ty;
 
   Solver *solver;
   
-  MapOfSets<ref<Expr>, std::shared_ptr<const Assignment>> cache;
+  SetTrie<ref<Expr>, std::shared_ptr<const Assignment>, util::ExprHash> cache{
+      CexCacheSize};
   // memo table
   assignmentsTable_ty assignmentsTable;
+  /// The counters of the cache already added to the statistics
+  uint64_t visitedNodes = 0, evictions = 0;
+  /// Evaluates the hot constraints natively, null unless enabled
+  std::unique_ptr<ExprJIT> jit;
 
   bool searchForAssignment(KeyType &key, 
                            std::shared_ptr<const Assignment> &result);
@@ -80,9 +123,18 @@ class CexCachingSolver : public SolverImpl {
 
   bool getAssignment(const Query& query,
                      std::shared_ptr<const Assignment> &result);
+
+  void updateCacheStats();
+
+  ref<Expr> evaluate(const Assignment &a, const ref<Expr> &e) {
+    return jit ? jit->evaluate(a, e) : a.evaluate(e);
+  }
   
 public:
-  CexCachingSolver(Solver *_solver) : solver(_solver) {}
+  CexCachingSolver(Solver *_solver) : solver(_solver) {
+    if (CexCacheJIT)
+      jit.reset(new ExprJIT(CexCacheJITThreshold, CexCacheJITSize));
+  }
   ~CexCachingSolver();
   
   bool computeTruth(const Query&, bool &isValid);
@@ -106,13 +158,46 @@ struct NonNullAssignment {
   bool operator()(const std::shared_ptr<const Assignment>& a) const { return a!=0; }
 };
 
+/// Finds a null assignment or one that satisfies the key. The assignments
+/// are tested in batches, so a satisfying assignment may be found after the
+/// predicate has seen the following ones, it is returned in `satisfying`.
+/// With the expression JIT, the compiled constraints are run for each
+/// assignment of the batch.
 struct NullOrSatisfyingAssignment {
   KeyType &key;
-  
-  NullOrSatisfyingAssignment(KeyType &_key) : key(_key) {}
+  ExprJIT *jit;
+  mutable std::vector<std::shared_ptr<const Assignment>> batch;
+  mutable std::shared_ptr<const Assignment> satisfying;
+
+  NullOrSatisfyingAssignment(KeyType &_key, ExprJIT *jit)
+      : key(_key), jit(jit) {}
 
   bool operator()(const std::shared_ptr<const Assignment>& a) const {
-    return !a || a->satisfies(key.begin(), key.end()); 
+    if (!a)
+      return true;
+    batch.push_back(a);
+    return batch.size() == BatchedEvaluator::MaxBatchSize && flush();
+  }
+
+  /// Test the collected assignments, true iff one of them satisfies the key
+  bool flush() const {
+    if (batch.empty())
+      return false;
+    std::vector<const Assignment *> assignments;
+    for (const auto &a : batch)
+      assignments.push_back(a.get());
+    BatchedEvaluator::lanes_ty lanes =
+        jit ? jit->satisfies(assignments, key.begin(), key.end())
+            : BatchedEvaluator(assignments).satisfies(key.begin(), key.end());
+    // the first satisfying assignment, like a test of each one in turn
+    for (unsigned i = 0; i < batch.size(); ++i) {
+      if (lanes & (BatchedEvaluator::lanes_ty(1) << i)) {
+        satisfying = batch[i];
+        break;
+      }
+    }
+    batch.clear();
+    return lanes != 0;
   }
 };
 
@@ -139,7 +224,7 @@ bool CexCachingSolver::searchForAssignment(KeyType &key,
       lookup = cache.findSuperset(key, NonNullAssignment());
 
     // Otherwise, look for a subset which is unsatisfiable, see below.
-    if (!lookup) 
+    if (!lookup && CexCacheSubset)
       lookup = cache.findSubset(key, NullAssignment());
 
     // If either lookup succeeded, then we have a cached solution.
@@ -150,14 +235,18 @@ bool CexCachingSolver::searchForAssignment(KeyType &key,
 
     // Otherwise, iterate through the set of current assignments to see if one
     // of them satisfies the query.
+    NullOrSatisfyingAssignment satisfying(key, jit.get());
     for (assignmentsTable_ty::iterator it = assignmentsTable.begin(), 
            ie = assignmentsTable.end(); it != ie; ++it) {
-      std::shared_ptr<const Assignment> a = *it;
-      if (a->satisfies(key.begin(), key.end())) {
-        result = a;
+      if (satisfying(it->first)) {
+        result = satisfying.satisfying;
         return true;
       }
     }
+    if (satisfying.flush()) {
+      result = satisfying.satisfying;
+      return true;
+    }
   } else {
     // FIXME: Which order? one is sure to be better.
 
@@ -172,8 +261,14 @@ bool CexCachingSolver::searchForAssignment(KeyType &key,
     // assignment. While searching subsets, we also explicitly the solutions for
     // satisfiable subsets to see if they solve the current query and return
     // them if so. This is cheap and frequently succeeds.
-    if (!lookup) 
-      lookup = cache.findSubset(key, NullOrSatisfyingAssignment(key));
+    NullOrSatisfyingAssignment satisfying(key, jit.get());
+    if (!lookup && CexCacheSubset) {
+      lookup = cache.findSubset(key, satisfying);
+      if (!lookup && satisfying.flush())
+        lookup = &satisfying.satisfying;
+      else if (lookup && satisfying.satisfying)
+        lookup = &satisfying.satisfying;
+    }
 
     // If either lookup succeeded, then we have a cached solution.
     if (lookup) {
@@ -209,6 +304,7 @@ bool CexCachingSolver::lookupAssignment(const Query &query,
   }
 
   bool found = searchForAssignment(key, result);
+  updateCacheStats();
   if (found)
     ++stats::queryCexCacheHits;
   else ++stats::queryCexCacheMisses;
@@ -230,16 +326,30 @@ bool CexCachingSolver::getAssignment(const Query& query,
     
   if (hasSolution) {
     // Memoize the result.
-    assignmentsTable.insert(result);
+    ++assignmentsTable[result];
   } else {
     result = 0;
   }
   
-  cache.insert(key, result);
+  // the assignments are only tried while a cached query has them
+  if (std::shared_ptr<const Assignment> removed = cache.insert(key, result)) {
+    auto it = assignmentsTable.find(removed);
+    assert(it != assignmentsTable.end() && "cached assignment not counted");
+    if (!--it->second)
+      assignmentsTable.erase(it);
+  }
+  updateCacheStats();
 
   return true;
 }
 
+void CexCachingSolver::updateCacheStats() {
+  stats::queryCexCacheNodeVisits += cache.getVisitedNodes() - visitedNodes;
+  stats::queryCexCacheEvictions += cache.getEvictions() - evictions;
+  visitedNodes = cache.getVisitedNodes();
+  evictions = cache.getEvictions();
+}
+
 ///
 
 CexCachingSolver::~CexCachingSolver() {
@@ -253,7 +363,7 @@ bool CexCachingSolver::computeValidity(const Query& query,
   if (!getAssignment(query.withFalse(), a))
     return false;
   assert(a && "computeValidity() must have assignment");
-  ref<Expr> q = a->evaluate(query.expr);
+  ref<Expr> q = evaluate(*a, query.expr);
   assert(isa<ConstantExpr>(q) && 
          "assignment evaluation did not result in constant");
 
@@ -305,7 +415,7 @@ bool CexCachingSolver::computeValue(const Query& query,
   if (!getAssignment(query.withFalse(), a))
     return false;
   assert(a && "computeValue() must have assignment");
-  result = a->evaluate(query.expr);  
+  result = evaluate(*a, query.expr);  
   assert(isa<ConstantExpr>(result) && 
          "assignment evaluation did not result in constant");
   return true;
@@ -40,6 +40,14 @@ Solver *constructSolverChain(Solver *coreSolver,
                  baseSolverQuerySMT2LogPath.c_str());
   }
 
+  if (UseNarrowingSolver)
+    solver = createNarrowingSolver(solver);
+
+  if (!PersistentQueryCache.empty())
+    solver = createPersistentCachingSolver(
+        solver, PersistentQueryCache,
+        static_cast<uint64_t>(PersistentQueryCacheSize) * 1024 * 1024);
+
   if (UseAssignmentValidatingSolver)
     solver = createAssignmentValidatingSolver(solver);
 
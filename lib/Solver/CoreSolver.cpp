@@ -12,17 +12,19 @@
 #include "MetaSMTSolver.h"
 
 #include "klee/Solver/SolverCmdLine.h"
+#include "klee/Solver/SolverStats.h"
 #include "klee/Support/ErrorHandling.h"
 #include "klee/Solver/Solver.h"
 
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
 #include <string>
 
 namespace klee {
 
-Solver *createCoreSolver(CoreSolverType cst) {
+static Solver *createBackend(CoreSolverType cst) {
   switch (cst) {
   case STP_SOLVER:
 #ifdef ENABLE_STP
@@ -57,4 +59,48 @@ Solver *createCoreSolver(CoreSolverType cst) {
     llvm_unreachable("Unsupported CoreSolverType");
   }
 }
+
+static Statistic *getPortfolioWins(CoreSolverType cst) {
+  switch (cst) {
+  case STP_SOLVER:
+    return &stats::queryPortfolioWinsSTP;
+  case METASMT_SOLVER:
+    return &stats::queryPortfolioWinsMetaSMT;
+  case Z3_SOLVER:
+    return &stats::queryPortfolioWinsZ3;
+  default:
+    return nullptr;
+  }
+}
+
+static Solver *createRacingSolver(CoreSolverType cst) {
+  Solver *solver = createBackend(cst);
+  if (!solver || SolverPortfolio.empty())
+    return solver;
+
+  std::vector<Solver *> solvers{solver};
+  std::vector<Statistic *> wins{getPortfolioWins(cst)};
+  std::vector<CoreSolverType> types{cst};
+  for (CoreSolverType other : SolverPortfolio) {
+    if (std::find(types.begin(), types.end(), other) != types.end())
+      continue;
+    types.push_back(other);
+    if (Solver *s = createBackend(other)) {
+      solvers.push_back(s);
+      wins.push_back(getPortfolioWins(other));
+    }
+  }
+  if (solvers.size() == 1)
+    return solver;
+  return createPortfolioSolver(solvers, wins,
+                               time::Span(SolverPortfolioThreshold));
+}
+
+Solver *createCoreSolver(CoreSolverType cst) {
+  Solver *solver = createRacingSolver(cst);
+  if (!solver || !SolverWorkers || cst == DUMMY_SOLVER)
+    return solver;
+  return createWorkerSolver(solver, SolverWorkers,
+                            uint64_t(SolverWorkerMemory) << 20);
+}
 }
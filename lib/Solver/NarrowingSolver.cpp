@@ -0,0 +1,271 @@
+//===-- NarrowingSolver.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprHashMap.h"
+#include "klee/Expr/ExprVisitor.h"
+#include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverStats.h"
+
+#include "llvm/Support/MathExtras.h"
+
+#include <algorithm>
+#include <map>
+
+using namespace klee;
+
+namespace {
+
+/// Rewrites unsigned comparisons of pointer-width terms that provably fit
+/// in fewer bits to comparisons of the truncated terms. Segments are
+/// pointer-width, but they are small constants, or selects and extensions
+/// of them, so a segment comparison is encoded with a few bits instead of
+/// 64 by the core solver.
+class ComparisonNarrower : public ExprVisitor {
+  /// Upper bounds of the number of significant bits of the visited terms
+  ExprHashMap<unsigned> activeBits;
+  std::map<Expr::Width, ExprHashMap<ref<Expr>>> truncated;
+
+  unsigned getActiveBits(const ref<Expr> &e);
+  ref<Expr> truncate(const ref<Expr> &e, Expr::Width width);
+  ref<Expr> buildTruncated(const ref<Expr> &e, Expr::Width width);
+
+protected:
+  Action visitExprPost(const Expr &e) override;
+
+public:
+  ComparisonNarrower() : ExprVisitor(false) {}
+};
+
+unsigned ComparisonNarrower::getActiveBits(const ref<Expr> &e) {
+  Expr::Width width = e->getWidth();
+  if (auto *CE = dyn_cast<ConstantExpr>(e))
+    return CE->getAPValue().getActiveBits();
+
+  auto it = activeBits.find(e);
+  if (it != activeBits.end())
+    return it->second;
+
+  unsigned bits = width;
+  switch (e->getKind()) {
+  case Expr::ZExt:
+    bits = getActiveBits(e->getKid(0));
+    break;
+  case Expr::SExt: {
+    const ref<Expr> &src = e->getKid(0);
+    unsigned srcBits = getActiveBits(src);
+    // the sign bit is known to be clear
+    if (srcBits < src->getWidth())
+      bits = srcBits;
+    break;
+  }
+  case Expr::Select:
+    bits = std::max(getActiveBits(e->getKid(1)), getActiveBits(e->getKid(2)));
+    break;
+  case Expr::Concat: {
+    const ref<Expr> &lo = e->getKid(1);
+    unsigned hiBits = getActiveBits(e->getKid(0));
+    bits = hiBits ? hiBits + lo->getWidth() : getActiveBits(lo);
+    break;
+  }
+  case Expr::Extract: {
+    auto *EE = cast<ExtractExpr>(e);
+    unsigned srcBits = getActiveBits(EE->expr);
+    bits = srcBits > EE->offset ? std::min(width, srcBits - EE->offset) : 0;
+    break;
+  }
+  case Expr::And:
+    bits = std::min(getActiveBits(e->getKid(0)), getActiveBits(e->getKid(1)));
+    break;
+  case Expr::Or:
+  case Expr::Xor:
+    bits = std::max(getActiveBits(e->getKid(0)), getActiveBits(e->getKid(1)));
+    break;
+  case Expr::LShr:
+    if (auto *shift = dyn_cast<ConstantExpr>(e->getKid(1))) {
+      if (shift->getAPValue().ult(width)) {
+        unsigned srcBits = getActiveBits(e->getKid(0));
+        unsigned amount = shift->getZExtValue();
+        bits = srcBits > amount ? srcBits - amount : 0;
+      }
+    }
+    break;
+  default:
+    break;
+  }
+  if (width <= 64)
+    bits = std::min(bits, 64 - llvm::countLeadingZeros(e->getBounds().max));
+
+  activeBits.emplace(e, bits);
+  return bits;
+}
+
+ref<Expr> ComparisonNarrower::truncate(const ref<Expr> &e, Expr::Width width) {
+  if (e->getWidth() == width)
+    return e;
+  if (auto *CE = dyn_cast<ConstantExpr>(e))
+    return CE->Extract(0, width);
+
+  ExprHashMap<ref<Expr>> &cache = truncated[width];
+  auto it = cache.find(e);
+  if (it != cache.end())
+    return it->second;
+  ref<Expr> result = buildTruncated(e, width);
+  cache.emplace(e, result);
+  return result;
+}
+
+/// Build the lowest `width` bits of `e`. Truncation commutes with the
+/// bitwise operations and with modular arithmetic, so it is pushed to the
+/// leaves where it disappears in constants and extensions.
+ref<Expr> ComparisonNarrower::buildTruncated(const ref<Expr> &e,
+                                             Expr::Width width) {
+  switch (e->getKind()) {
+  case Expr::ZExt:
+  case Expr::SExt: {
+    const ref<Expr> &src = e->getKid(0);
+    if (src->getWidth() >= width)
+      return truncate(src, width);
+    return isa<ZExtExpr>(e) ? ZExtExpr::create(src, width)
+                            : SExtExpr::create(src, width);
+  }
+  case Expr::Select:
+    return SelectExpr::create(e->getKid(0), truncate(e->getKid(1), width),
+                              truncate(e->getKid(2), width));
+  case Expr::Concat: {
+    const ref<Expr> &lo = e->getKid(1);
+    if (lo->getWidth() >= width)
+      return truncate(lo, width);
+    return ConcatExpr::create(
+        truncate(e->getKid(0), width - lo->getWidth()), lo);
+  }
+  case Expr::Extract: {
+    auto *EE = cast<ExtractExpr>(e);
+    if (EE->offset == 0)
+      return truncate(EE->expr, width);
+    return ExtractExpr::create(EE->expr, EE->offset, width);
+  }
+  case Expr::Not:
+    return NotExpr::create(truncate(e->getKid(0), width));
+  case Expr::Add:
+  case Expr::Sub:
+  case Expr::Mul:
+  case Expr::And:
+  case Expr::Or:
+  case Expr::Xor: {
+    ref<Expr> kids[2] = {truncate(e->getKid(0), width),
+                         truncate(e->getKid(1), width)};
+    return e->rebuild(kids);
+  }
+  default:
+    return ExtractExpr::create(e, 0, width);
+  }
+}
+
+ExprVisitor::Action ComparisonNarrower::visitExprPost(const Expr &e) {
+  switch (e.getKind()) {
+  case Expr::Eq:
+  case Expr::Ult:
+  case Expr::Ule:
+    break;
+  default:
+    return Action::skipChildren();
+  }
+
+  const ref<Expr> &left = e.getKid(0), &right = e.getKid(1);
+  Expr::Width width = left->getWidth();
+  if (width == Expr::Bool)
+    return Action::skipChildren();
+  // both sides are below 2^bits, so their order and equality is decided by
+  // their lowest bits
+  unsigned bits =
+      std::max(1u, std::max(getActiveBits(left), getActiveBits(right)));
+  if (bits >= width)
+    return Action::skipChildren();
+
+  ++stats::queryNarrowedComparisons;
+  ref<Expr> kids[2] = {truncate(left, bits), truncate(right, bits)};
+  return Action::changeTo(e.rebuild(kids));
+}
+
+class NarrowingSolver : public SolverImpl {
+private:
+  Solver *solver;
+
+  /// The query with narrowed comparisons, `constraints` keeps the narrowed
+  /// constraints alive.
+  Query narrow(const Query &query, ConstraintSet &constraints);
+
+public:
+  NarrowingSolver(Solver *solver) : solver(solver) {}
+  ~NarrowingSolver() { delete solver; }
+
+  bool computeValidity(const Query &, Solver::Validity &result);
+  bool computeTruth(const Query &, bool &isValid);
+  bool computeValue(const Query &, ref<Expr> &result);
+  bool computeInitialValues(const Query &,
+                            std::shared_ptr<const Assignment> &result,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode();
+  char *getConstraintLog(const Query &);
+  void setCoreSolverTimeout(time::Span timeout);
+};
+
+Query NarrowingSolver::narrow(const Query &query,
+                              ConstraintSet &constraints) {
+  ComparisonNarrower narrower;
+  for (const auto &constraint : query.constraints)
+    constraints.push_back(narrower.visit(constraint));
+  return Query(constraints, narrower.visit(query.expr));
+}
+
+bool NarrowingSolver::computeValidity(const Query &query,
+                                      Solver::Validity &result) {
+  ConstraintSet constraints;
+  return solver->impl->computeValidity(narrow(query, constraints), result);
+}
+
+bool NarrowingSolver::computeTruth(const Query &query, bool &isValid) {
+  ConstraintSet constraints;
+  return solver->impl->computeTruth(narrow(query, constraints), isValid);
+}
+
+bool NarrowingSolver::computeValue(const Query &query, ref<Expr> &result) {
+  ConstraintSet constraints;
+  return solver->impl->computeValue(narrow(query, constraints), result);
+}
+
+bool NarrowingSolver::computeInitialValues(
+    const Query &query, std::shared_ptr<const Assignment> &result,
+    bool &hasSolution) {
+  ConstraintSet constraints;
+  return solver->impl->computeInitialValues(narrow(query, constraints), result,
+                                            hasSolution);
+}
+
+SolverImpl::SolverRunStatus NarrowingSolver::getOperationStatusCode() {
+  return solver->impl->getOperationStatusCode();
+}
+
+char *NarrowingSolver::getConstraintLog(const Query &query) {
+  ConstraintSet constraints;
+  return solver->impl->getConstraintLog(narrow(query, constraints));
+}
+
+void NarrowingSolver::setCoreSolverTimeout(time::Span timeout) {
+  solver->impl->setCoreSolverTimeout(timeout);
+}
+
+} // namespace
+
+Solver *klee::createNarrowingSolver(Solver *s) {
+  return new Solver(new NarrowingSolver(s));
+}
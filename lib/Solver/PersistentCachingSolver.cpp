@@ -0,0 +1,385 @@
+//===-- PersistentCachingSolver.cpp ---------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "QuerySerialization.h"
+
+#include "klee/Solver/Solver.h"
+
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverStats.h"
+#include "klee/Support/ErrorHandling.h"
+
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+
+/// A size-bounded map of byte strings in a memory-mapped file, shared by the
+/// processes that open the same file. The records are appended to a circular
+/// log that overwrites the oldest records, and a table of buckets of a few
+/// slots indexes them by the hash of their key. All accesses hold an
+/// exclusive lock of the file.
+class MappedStore {
+  static constexpr char Magic[8] = {'K', 'L', 'E', 'E', 'Q', 'C', '0', '2'};
+  static const unsigned Ways = 4;
+
+  struct Header {
+    char magic[8];
+    uint64_t dataSize;
+    uint64_t bucketCount;
+    /// The position after the newest record in the infinite log, which the
+    /// data region stores modulo its size
+    uint64_t end;
+  };
+
+  struct Slot {
+    uint64_t hash;
+    /// The position of the record in the log plus one, zero if empty
+    uint64_t position;
+  };
+
+  struct Record {
+    uint64_t hash;
+    uint32_t keySize;
+    uint32_t valueSize;
+  };
+
+  int fd = -1;
+  char *base = nullptr;
+  size_t mappedSize = 0;
+
+  Header *header() const { return reinterpret_cast<Header *>(base); }
+  Slot *getBucket(uint64_t hash) const {
+    Slot *slots = reinterpret_cast<Slot *>(base + sizeof(Header));
+    return slots + (hash % header()->bucketCount) * Ways;
+  }
+  char *getData() const {
+    return base + sizeof(Header) + header()->bucketCount * Ways * sizeof(Slot);
+  }
+  static uint64_t getRecordSize(size_t keySize, size_t valueSize) {
+    return (sizeof(Record) + keySize + valueSize + 7) & ~uint64_t(7);
+  }
+
+  /// The record of the slot, null if it was overwritten
+  const Record *getRecord(const Slot &slot) const;
+  bool matches(const Slot &slot, uint64_t hash, const std::string &key) const;
+
+  class Lock {
+    int fd;
+
+  public:
+    explicit Lock(int fd) : fd(fd) { flock(fd, LOCK_EX); }
+    ~Lock() { flock(fd, LOCK_UN); }
+  };
+
+public:
+  MappedStore() = default;
+  MappedStore(const MappedStore &) = delete;
+  MappedStore &operator=(const MappedStore &) = delete;
+  ~MappedStore();
+
+  /// Open the store, creating it with a data region of `dataSize` bytes if
+  /// the file is not a store yet. An existing store keeps its size.
+  bool open(const std::string &path, uint64_t dataSize);
+
+  bool lookup(uint64_t hash, const std::string &key, std::string &value);
+  void insert(uint64_t hash, const std::string &key, const std::string &value);
+};
+
+constexpr char MappedStore::Magic[8];
+
+MappedStore::~MappedStore() {
+  if (base)
+    munmap(base, mappedSize);
+  if (fd >= 0)
+    close(fd);
+}
+
+bool MappedStore::open(const std::string &path, uint64_t dataSize) {
+  fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    klee_warning("unable to open the persistent query cache %s: %s",
+                 path.c_str(), strerror(errno));
+    return false;
+  }
+
+  Lock lock(fd);
+  Header existing;
+  struct stat st;
+  if (fstat(fd, &st) < 0)
+    return false;
+  bool valid = static_cast<size_t>(st.st_size) >= sizeof(Header) &&
+               pread(fd, &existing, sizeof(existing), 0) == sizeof(existing) &&
+               !memcmp(existing.magic, Magic, sizeof(Magic)) &&
+               existing.bucketCount &&
+               static_cast<uint64_t>(st.st_size) ==
+                   sizeof(Header) + existing.bucketCount * Ways * sizeof(Slot) +
+                       existing.dataSize;
+
+  Header fresh;
+  memcpy(fresh.magic, Magic, sizeof(Magic));
+  fresh.dataSize = dataSize & ~uint64_t(7);
+  fresh.bucketCount = std::max<uint64_t>(64, dataSize / 512);
+  fresh.end = 0;
+  const Header &geometry = valid ? existing : fresh;
+  mappedSize = sizeof(Header) + geometry.bucketCount * Ways * sizeof(Slot) +
+               geometry.dataSize;
+
+  if (!valid) {
+    // a new store is empty, all the slots are zero
+    if (ftruncate(fd, 0) < 0 || ftruncate(fd, mappedSize) < 0 ||
+        pwrite(fd, &fresh, sizeof(fresh), 0) != sizeof(fresh)) {
+      klee_warning("unable to create the persistent query cache %s: %s",
+                   path.c_str(), strerror(errno));
+      return false;
+    }
+  }
+
+  void *mapped =
+      mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mapped == MAP_FAILED) {
+    klee_warning("unable to map the persistent query cache %s: %s",
+                 path.c_str(), strerror(errno));
+    return false;
+  }
+  base = static_cast<char *>(mapped);
+  return true;
+}
+
+const MappedStore::Record *MappedStore::getRecord(const Slot &slot) const {
+  if (!slot.position)
+    return nullptr;
+  uint64_t position = slot.position - 1;
+  const uint64_t dataSize = header()->dataSize;
+  // the writer overwrote the record once it got a whole region past it
+  if (position + dataSize < header()->end)
+    return nullptr;
+  uint64_t offset = position % dataSize;
+  if (offset + sizeof(Record) > dataSize)
+    return nullptr;
+  const Record *record = reinterpret_cast<const Record *>(getData() + offset);
+  if (offset + getRecordSize(record->keySize, record->valueSize) > dataSize)
+    return nullptr;
+  return record;
+}
+
+bool MappedStore::matches(const Slot &slot, uint64_t hash,
+                          const std::string &key) const {
+  if (slot.hash != hash)
+    return false;
+  const Record *record = getRecord(slot);
+  return record && record->hash == hash && record->keySize == key.size() &&
+         !memcmp(record + 1, key.data(), key.size());
+}
+
+bool MappedStore::lookup(uint64_t hash, const std::string &key,
+                         std::string &value) {
+  Lock lock(fd);
+  Slot *bucket = getBucket(hash);
+  for (unsigned i = 0; i < Ways; ++i) {
+    if (matches(bucket[i], hash, key)) {
+      const Record *record = getRecord(bucket[i]);
+      value.assign(reinterpret_cast<const char *>(record + 1) + key.size(),
+                   record->valueSize);
+      return true;
+    }
+  }
+  return false;
+}
+
+void MappedStore::insert(uint64_t hash, const std::string &key,
+                         const std::string &value) {
+  const uint64_t dataSize = header()->dataSize;
+  const uint64_t size = getRecordSize(key.size(), value.size());
+  // large records would evict too much
+  if (size > dataSize / 4)
+    return;
+
+  Lock lock(fd);
+  Slot *bucket = getBucket(hash);
+  // replace the same key, a free slot, or the oldest record of the bucket
+  Slot *slot = nullptr;
+  for (unsigned i = 0; i < Ways && !slot; ++i)
+    if (matches(bucket[i], hash, key) || !getRecord(bucket[i]))
+      slot = &bucket[i];
+  if (!slot) {
+    slot = bucket;
+    for (unsigned i = 1; i < Ways; ++i)
+      if (bucket[i].position < slot->position)
+        slot = &bucket[i];
+  }
+
+  // records do not wrap around the end of the data region
+  uint64_t position = header()->end;
+  if (position % dataSize + size > dataSize)
+    position += dataSize - position % dataSize;
+  header()->end = position + size;
+
+  char *data = getData() + position % dataSize;
+  Record record = {hash, static_cast<uint32_t>(key.size()),
+                   static_cast<uint32_t>(value.size())};
+  memcpy(data, &record, sizeof(record));
+  memcpy(data + sizeof(record), key.data(), key.size());
+  memcpy(data + sizeof(record) + key.size(), value.data(), value.size());
+  slot->hash = hash;
+  slot->position = position + 1;
+}
+
+uint64_t getHash(const std::string &key) {
+  // FNV-1a, the hash must be the same in all runs
+  uint64_t hash = 14695981039346656037ULL;
+  for (char c : key) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+class PersistentCachingSolver : public SolverImpl {
+  /// The kinds of the stored results, part of the keys
+  enum Operation : char { Validity, Truth, Value, InitialValues };
+
+  Solver *solver;
+  std::unique_ptr<MappedStore> store;
+
+  /// The key of the query, and the arrays of the query in the order of the
+  /// key
+  std::string getKey(Operation operation, const Query &query,
+                     std::vector<const Array *> &arrays);
+  bool lookup(Operation operation, const Query &query, std::string &value,
+              std::string &key, std::vector<const Array *> &arrays);
+
+public:
+  PersistentCachingSolver(Solver *solver, std::unique_ptr<MappedStore> store)
+      : solver(solver), store(std::move(store)) {}
+  ~PersistentCachingSolver() { delete solver; }
+
+  bool computeValidity(const Query &, Solver::Validity &result);
+  bool computeTruth(const Query &, bool &isValid);
+  bool computeValue(const Query &, ref<Expr> &result);
+  bool computeInitialValues(const Query &,
+                            std::shared_ptr<const Assignment> &result,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode();
+  char *getConstraintLog(const Query &);
+  void setCoreSolverTimeout(time::Span timeout);
+};
+
+std::string PersistentCachingSolver::getKey(Operation operation,
+                                            const Query &query,
+                                            std::vector<const Array *> &arrays) {
+  std::string key(1, operation);
+  QueryWriter writer(key);
+  writer.write(query);
+  arrays = std::move(writer.arrays);
+  return key;
+}
+
+bool PersistentCachingSolver::lookup(Operation operation, const Query &query,
+                                     std::string &value, std::string &key,
+                                     std::vector<const Array *> &arrays) {
+  key = getKey(operation, query, arrays);
+  if (store->lookup(getHash(key), key, value)) {
+    ++stats::queryPersistentCacheHits;
+    return true;
+  }
+  ++stats::queryPersistentCacheMisses;
+  return false;
+}
+
+bool PersistentCachingSolver::computeValidity(const Query &query,
+                                              Solver::Validity &result) {
+  std::string key, value;
+  std::vector<const Array *> arrays;
+  if (lookup(Validity, query, value, key, arrays) && value.size() == 1) {
+    result = static_cast<Solver::Validity>(value[0]);
+    return true;
+  }
+  if (!solver->impl->computeValidity(query, result))
+    return false;
+  store->insert(getHash(key), key, std::string(1, static_cast<char>(result)));
+  return true;
+}
+
+bool PersistentCachingSolver::computeTruth(const Query &query, bool &isValid) {
+  std::string key, value;
+  std::vector<const Array *> arrays;
+  if (lookup(Truth, query, value, key, arrays) && readTruth(value, isValid))
+    return true;
+  if (!solveAndWrite(*solver, SolverOperation::Truth, query, arrays, value))
+    return false;
+  store->insert(getHash(key), key, value);
+  return readTruth(value, isValid);
+}
+
+bool PersistentCachingSolver::computeValue(const Query &query,
+                                           ref<Expr> &result) {
+  std::string key, value;
+  std::vector<const Array *> arrays;
+  if (lookup(Value, query, value, key, arrays) && readValue(value, result))
+    return true;
+  if (!solveAndWrite(*solver, SolverOperation::Value, query, arrays, value))
+    return false;
+  store->insert(getHash(key), key, value);
+  return readValue(value, result);
+}
+
+bool PersistentCachingSolver::computeInitialValues(
+    const Query &query, std::shared_ptr<const Assignment> &result,
+    bool &hasSolution) {
+  // the model is stored as the bindings of the arrays in the order of the key
+  std::string key, value;
+  std::vector<const Array *> arrays;
+  if (lookup(InitialValues, query, value, key, arrays) &&
+      readInitialValues(value, arrays, result, hasSolution))
+    return true;
+  if (!solveAndWrite(*solver, SolverOperation::InitialValues, query, arrays,
+                     value))
+    return false;
+  store->insert(getHash(key), key, value);
+  return readInitialValues(value, arrays, result, hasSolution);
+}
+
+SolverImpl::SolverRunStatus PersistentCachingSolver::getOperationStatusCode() {
+  return solver->impl->getOperationStatusCode();
+}
+
+char *PersistentCachingSolver::getConstraintLog(const Query &query) {
+  return solver->impl->getConstraintLog(query);
+}
+
+void PersistentCachingSolver::setCoreSolverTimeout(time::Span timeout) {
+  solver->impl->setCoreSolverTimeout(timeout);
+}
+
+} // namespace
+
+Solver *klee::createPersistentCachingSolver(Solver *s, const std::string &path,
+                                            uint64_t size) {
+  auto store = std::make_unique<MappedStore>();
+  // the queries are solved without the cache if it cannot be opened
+  if (!store->open(path, size))
+    return s;
+  return new Solver(new PersistentCachingSolver(s, std::move(store)));
+}
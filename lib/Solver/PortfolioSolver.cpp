@@ -0,0 +1,287 @@
+//===-- PortfolioSolver.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "QuerySerialization.h"
+
+#include "klee/Solver/Solver.h"
+
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprUtil.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverStats.h"
+#include "klee/Statistics/Statistic.h"
+#include "klee/Support/ErrorHandling.h"
+
+#include "llvm/Support/Errno.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+
+/// A forked process solving a query with one of the solvers
+struct Worker {
+  unsigned solver;
+  pid_t pid;
+  int fd;
+  std::string output;
+};
+
+/// Solves queries with the first of its solvers in a forked process, and
+/// once a query takes longer than the threshold, races the other solvers
+/// against it in forked processes of their own. The first result is taken
+/// and the processes still running are killed. The results are passed from
+/// the processes as byte strings, the arrays of models in the order of
+/// findSymbolicObjects, with the increments of the statistics of the
+/// processes.
+class PortfolioSolver : public SolverImpl {
+  std::vector<Solver *> solvers;
+  std::vector<Statistic *> wins;
+  time::Span threshold;
+  time::Span timeout;
+  SolverRunStatus runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+
+  static std::vector<const Array *> getArrays(const Query &query);
+  /// Fork a process solving the query with the given solver
+  bool startWorker(unsigned solver, time::Span timeout,
+                   SolverOperation operation, const Query &query,
+                   const std::vector<const Array *> &arrays,
+                   std::vector<Worker> &workers);
+  /// Race the other solvers against the worker of the first one
+  bool race(std::vector<Worker> &workers, SolverOperation operation,
+            const Query &query, const std::vector<const Array *> &arrays,
+            std::string &result);
+  bool solve(SolverOperation operation, const Query &query,
+             const std::vector<const Array *> &arrays, std::string &result);
+
+public:
+  PortfolioSolver(std::vector<Solver *> solvers, std::vector<Statistic *> wins,
+                  time::Span threshold)
+      : solvers(std::move(solvers)), wins(std::move(wins)),
+        threshold(threshold) {}
+  ~PortfolioSolver() {
+    for (Solver *solver : solvers)
+      delete solver;
+  }
+
+  bool computeTruth(const Query &, bool &isValid);
+  bool computeValue(const Query &, ref<Expr> &result);
+  bool computeInitialValues(const Query &,
+                            std::shared_ptr<const Assignment> &result,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode() { return runStatusCode; }
+  char *getConstraintLog(const Query &query) {
+    return solvers.front()->impl->getConstraintLog(query);
+  }
+  void setCoreSolverTimeout(time::Span timeout) { this->timeout = timeout; }
+};
+
+// the output of a process starts with whether it succeeded, its status and
+// the increments of its statistics
+size_t getHeaderSize() { return 2 + StatIncrementsSize; }
+
+std::vector<const Array *> PortfolioSolver::getArrays(const Query &query) {
+  std::vector<ref<Expr>> exprs(query.constraints.begin(),
+                               query.constraints.end());
+  exprs.push_back(query.expr);
+  std::vector<const Array *> arrays;
+  findSymbolicObjects(exprs.begin(), exprs.end(), arrays);
+  return arrays;
+}
+
+bool PortfolioSolver::startWorker(unsigned solver, time::Span timeout,
+                                  SolverOperation operation,
+                                  const Query &query,
+                                  const std::vector<const Array *> &arrays,
+                                  std::vector<Worker> &workers) {
+  int fds[2];
+  if (pipe(fds) < 0)
+    return false;
+  fflush(stdout);
+  fflush(stderr);
+  pid_t pid = fork();
+  if (pid < 0) {
+    klee_warning("fork failed (for the solver portfolio) - %s",
+                 llvm::sys::StrError(errno).c_str());
+    close(fds[0]);
+    close(fds[1]);
+    return false;
+  }
+  if (pid == 0) {
+    close(fds[0]);
+    for (const Worker &worker : workers)
+      close(worker.fd);
+    std::vector<uint64_t> before = getForwardedStats();
+    Solver &s = *solvers[solver];
+    s.impl->setCoreSolverTimeout(timeout);
+    std::string solution;
+    std::string output(getHeaderSize(), 0);
+    output[0] = solveAndWrite(s, operation, query, arrays, solution);
+    output[1] = s.impl->getOperationStatusCode();
+    writeStatIncrements(before, &output[2]);
+    output += solution;
+    const char *data = output.data();
+    size_t size = output.size();
+    while (size) {
+      ssize_t written = write(fds[1], data, size);
+      if (written < 0 && errno == EINTR)
+        continue;
+      if (written <= 0)
+        break;
+      data += written;
+      size -= written;
+    }
+    _exit(0);
+  }
+  close(fds[1]);
+  workers.push_back({solver, pid, fds[0], std::string()});
+  return true;
+}
+
+bool PortfolioSolver::race(std::vector<Worker> &workers,
+                           SolverOperation operation, const Query &query,
+                           const std::vector<const Array *> &arrays,
+                           std::string &result) {
+  // wait for the first process that succeeds, or for all of them to fail,
+  // starting the other solvers once the first one reaches the threshold
+  int winner = -1;
+  unsigned running = 1;
+  bool raced = false;
+  time::Point start = time::getWallTime();
+  time::Point deadline = start + timeout;
+  std::vector<pollfd> fds;
+  runStatusCode = SOLVER_RUN_STATUS_TIMEOUT;
+  while (winner < 0 && running) {
+    time::Point now = time::getWallTime();
+    if (timeout && now >= deadline) {
+      runStatusCode = SOLVER_RUN_STATUS_TIMEOUT;
+      break;
+    }
+    if (!raced && now >= start + threshold) {
+      raced = true;
+      ++stats::queryPortfolioRaces;
+      for (unsigned i = 1; i < solvers.size(); ++i) {
+        if (!startWorker(i, timeout ? deadline - now : time::Span(),
+                         operation, query, arrays, workers))
+          break;
+        ++running;
+      }
+    }
+
+    int wait = -1;
+    if (!raced)
+      wait = (start + threshold - now).toMicroseconds() / 1000 + 1;
+    else if (timeout)
+      wait = (deadline - now).toMicroseconds() / 1000 + 1;
+    fds.resize(workers.size());
+    for (unsigned i = 0; i < workers.size(); ++i)
+      fds[i] = {workers[i].fd, POLLIN, 0};
+    if (poll(fds.data(), fds.size(), wait) < 0 && errno != EINTR)
+      break;
+
+    for (unsigned i = 0; i < workers.size() && winner < 0; ++i) {
+      if (workers[i].fd < 0 || !(fds[i].revents & (POLLIN | POLLHUP)))
+        continue;
+      char buffer[4096];
+      ssize_t size = read(workers[i].fd, buffer, sizeof(buffer));
+      if (size < 0 && errno == EINTR)
+        continue;
+      if (size > 0) {
+        workers[i].output.append(buffer, size);
+        continue;
+      }
+      close(workers[i].fd);
+      workers[i].fd = -1;
+      --running;
+      if (workers[i].output.size() < getHeaderSize()) {
+        runStatusCode = SOLVER_RUN_STATUS_UNEXPECTED_EXIT_CODE;
+        continue;
+      }
+      readStatIncrements(&workers[i].output[2]);
+      runStatusCode = static_cast<SolverRunStatus>(workers[i].output[1]);
+      if (workers[i].output[0])
+        winner = i;
+    }
+  }
+
+  for (Worker &worker : workers) {
+    if (worker.fd >= 0)
+      close(worker.fd);
+    kill(worker.pid, SIGKILL);
+    while (waitpid(worker.pid, nullptr, 0) < 0 && errno == EINTR)
+      ;
+  }
+
+  if (winner < 0)
+    return false;
+  if (raced && wins[workers[winner].solver])
+    ++*wins[workers[winner].solver];
+  result = workers[winner].output.substr(getHeaderSize());
+  return true;
+}
+
+bool PortfolioSolver::solve(SolverOperation operation, const Query &query,
+                            const std::vector<const Array *> &arrays,
+                            std::string &result) {
+  if (solvers.size() > 1 && (!timeout || threshold < timeout)) {
+    std::vector<Worker> workers;
+    if (startWorker(0, timeout, operation, query, arrays, workers))
+      return race(workers, operation, query, arrays, result);
+  }
+
+  // solve in this process if there is nothing to race
+  Solver &first = *solvers.front();
+  first.impl->setCoreSolverTimeout(timeout);
+  bool success = solveAndWrite(first, operation, query, arrays, result);
+  runStatusCode = first.impl->getOperationStatusCode();
+  return success;
+}
+
+bool PortfolioSolver::computeTruth(const Query &query, bool &isValid) {
+  std::string result;
+  return solve(SolverOperation::Truth, query, {}, result) &&
+         readTruth(result, isValid);
+}
+
+bool PortfolioSolver::computeValue(const Query &query, ref<Expr> &result) {
+  std::string value;
+  return solve(SolverOperation::Value, query, {}, value) &&
+         readValue(value, result);
+}
+
+bool PortfolioSolver::computeInitialValues(
+    const Query &query, std::shared_ptr<const Assignment> &result,
+    bool &hasSolution) {
+  std::vector<const Array *> arrays = getArrays(query);
+  std::string value;
+  return solve(SolverOperation::InitialValues, query, arrays, value) &&
+         readInitialValues(value, arrays, result, hasSolution);
+}
+
+} // namespace
+
+Solver *klee::createPortfolioSolver(std::vector<Solver *> solvers,
+                                    std::vector<Statistic *> wins,
+                                    time::Span threshold) {
+  return new Solver(
+      new PortfolioSolver(std::move(solvers), std::move(wins), threshold));
+}
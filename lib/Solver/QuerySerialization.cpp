@@ -0,0 +1,489 @@
+//===-- QuerySerialization.cpp --------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "QuerySerialization.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverStats.h"
+#include "klee/Statistics/Statistic.h"
+
+#include "llvm/ADT/StringExtras.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace klee;
+
+namespace {
+/// Marks a reference to an expression written before, no kind has the value
+const unsigned char ExprReference = 0xff;
+
+/// The number of the kids written after the width, the kids of reads and
+/// extracts are written after their other fields
+unsigned getNumKids(Expr::Kind kind) {
+  switch (kind) {
+  case Expr::Constant:
+  case Expr::Read:
+  case Expr::Extract:
+    return 0;
+  case Expr::NotOptimized:
+  case Expr::Not:
+  case Expr::ZExt:
+  case Expr::SExt:
+    return 1;
+  case Expr::Select:
+    return 3;
+  default:
+    return 2;
+  }
+}
+} // namespace
+
+void QueryWriter::writeNumber(uint64_t value) {
+  do {
+    out.push_back(
+        static_cast<char>((value & 0x7f) | (value > 0x7f ? 0x80 : 0)));
+    value >>= 7;
+  } while (value);
+}
+
+void QueryWriter::writeAPInt(const llvm::APInt &value) {
+  writeNumber(value.getBitWidth());
+  for (unsigned i = 0; i < value.getNumWords(); ++i)
+    writeNumber(value.getRawData()[i]);
+}
+
+void QueryWriter::writeArray(const Array *array) {
+  auto it = arrayIndices.find(array);
+  if (it != arrayIndices.end()) {
+    writeNumber(it->second);
+    return;
+  }
+  writeNumber(arrays.size());
+  arrayIndices.emplace(array, arrays.size());
+  arrays.push_back(array);
+  writeNumber(array->size);
+  writeNumber(array->domain);
+  writeNumber(array->range);
+  writeNumber(array->constantValues.size());
+  for (const ref<ConstantExpr> &value : array->constantValues)
+    writeAPInt(value->getAPValue());
+}
+
+void QueryWriter::writeUpdates(const UpdateNode *head) {
+  // the number of the updates not written yet, the number of the update
+  // they extend (zero for none), and the new updates from the oldest one
+  std::vector<const UpdateNode *> fresh;
+  const UpdateNode *un = head;
+  for (; un && !updates.count(un); un = un->next.get())
+    fresh.push_back(un);
+  writeNumber(fresh.size());
+  writeNumber(un ? updates[un] : 0);
+  for (auto it = fresh.rbegin(), ie = fresh.rend(); it != ie; ++it) {
+    write((*it)->index);
+    write((*it)->value);
+    updates.emplace(*it, updates.size() + 1);
+  }
+}
+
+void QueryWriter::write(const ref<Expr> &e) {
+  auto it = exprs.find(e.get());
+  if (it != exprs.end()) {
+    out.push_back(static_cast<char>(ExprReference));
+    writeNumber(it->second);
+    return;
+  }
+
+  out.push_back(static_cast<char>(e->getKind()));
+  writeNumber(e->getWidth());
+  switch (e->getKind()) {
+  case Expr::Constant:
+    writeAPInt(cast<ConstantExpr>(e)->getAPValue());
+    break;
+  case Expr::Read: {
+    const ReadExpr *re = cast<ReadExpr>(e);
+    writeArray(re->updates.root);
+    writeUpdates(re->updates.head.get());
+    write(re->index);
+    break;
+  }
+  case Expr::Extract:
+    writeNumber(cast<ExtractExpr>(e)->offset);
+    write(e->getKid(0));
+    break;
+  default:
+    for (unsigned i = 0; i < e->getNumKids(); ++i)
+      write(e->getKid(i));
+    break;
+  }
+  exprs.emplace(e.get(), exprs.size());
+}
+
+void QueryWriter::write(const Query &query) {
+  writeNumber(query.constraints.size());
+  for (const ref<Expr> &constraint : query.constraints)
+    write(constraint);
+  write(query.expr);
+}
+
+bool QueryReader::readNumber(uint64_t &value) {
+  value = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    if (position == end)
+      return false;
+    unsigned char byte = *position++;
+    value |= uint64_t(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+bool QueryReader::readAPInt(llvm::APInt &value) {
+  uint64_t width;
+  if (!readNumber(width) || !width)
+    return false;
+  std::vector<uint64_t> words((width + 63) / 64);
+  for (uint64_t &word : words)
+    if (!readNumber(word))
+      return false;
+  value = llvm::APInt(width, words);
+  return true;
+}
+
+bool QueryReader::readArray(const Array *&array) {
+  uint64_t index;
+  if (!readNumber(index) || index > arrays.size())
+    return false;
+  if (index < arrays.size()) {
+    array = arrays[index];
+    return true;
+  }
+
+  const char *description = position;
+  uint64_t size, domain, range, valueCount;
+  if (!readNumber(size) || !readNumber(domain) || !readNumber(range) ||
+      !readNumber(valueCount) || !domain || domain > Expr::MaxWidth ||
+      !range || range > Expr::MaxWidth || (valueCount && valueCount != size))
+    return false;
+  std::vector<ref<ConstantExpr>> values;
+  for (uint64_t i = 0; i < valueCount; ++i) {
+    llvm::APInt value;
+    if (!readAPInt(value) || value.getBitWidth() != range)
+      return false;
+    values.push_back(ConstantExpr::alloc(value));
+  }
+
+  // the arrays of the query read before with the same description
+  std::vector<const Array *> &candidates =
+      described[std::string(description, position)];
+  unsigned occurrence = std::count_if(
+      arrays.begin(), arrays.end(), [&](const Array *a) {
+        return std::find(candidates.begin(), candidates.end(), a) !=
+               candidates.end();
+      });
+  if (occurrence == candidates.size())
+    candidates.push_back(arrayCache.CreateArray(
+        "arr" + llvm::utostr(createdArrays++), size, values.data(),
+        values.data() + values.size(), domain, range));
+  array = candidates[occurrence];
+  arrays.push_back(array);
+  return true;
+}
+
+bool QueryReader::readUpdates(ref<UpdateNode> &head) {
+  uint64_t count, base;
+  if (!readNumber(count) || !readNumber(base) || base > updates.size())
+    return false;
+  head = base ? updates[base - 1] : nullptr;
+  for (uint64_t i = 0; i < count; ++i) {
+    ref<Expr> index, value;
+    if (!read(index) || !read(value))
+      return false;
+    head = new UpdateNode(head, index, value);
+    updates.push_back(head);
+  }
+  return true;
+}
+
+bool QueryReader::read(ref<Expr> &e) {
+  if (position == end)
+    return false;
+  unsigned char kind = *position++;
+  if (kind == ExprReference) {
+    uint64_t index;
+    if (!readNumber(index) || index >= exprs.size())
+      return false;
+    e = exprs[index];
+    return true;
+  }
+
+  uint64_t width;
+  if (!readNumber(width) || !width || kind > Expr::LastKind)
+    return false;
+  ref<Expr> kids[3];
+  for (unsigned i = 0, n = getNumKids(static_cast<Expr::Kind>(kind)); i < n;
+       ++i)
+    if (!read(kids[i]))
+      return false;
+
+  switch (kind) {
+  case Expr::Constant: {
+    llvm::APInt value;
+    if (!readAPInt(value))
+      return false;
+    e = ConstantExpr::alloc(value);
+    break;
+  }
+  case Expr::Read: {
+    const Array *array;
+    ref<UpdateNode> head;
+    ref<Expr> index;
+    if (!readArray(array) || !readUpdates(head) || !read(index))
+      return false;
+    e = ReadExpr::alloc(UpdateList(array, head), index);
+    break;
+  }
+  case Expr::Extract: {
+    uint64_t offset;
+    if (!readNumber(offset) || !read(kids[0]) ||
+        offset + width > kids[0]->getWidth())
+      return false;
+    e = ExtractExpr::alloc(kids[0], offset, width);
+    break;
+  }
+  case Expr::NotOptimized:
+    e = NotOptimizedExpr::alloc(kids[0]);
+    break;
+  case Expr::Select:
+    e = SelectExpr::alloc(kids[0], kids[1], kids[2]);
+    break;
+  case Expr::Concat:
+    e = ConcatExpr::alloc(kids[0], kids[1]);
+    break;
+  case Expr::Not:
+    e = NotExpr::alloc(kids[0]);
+    break;
+  case Expr::ZExt:
+    e = ZExtExpr::alloc(kids[0], width);
+    break;
+  case Expr::SExt:
+    e = SExtExpr::alloc(kids[0], width);
+    break;
+
+#define BINARY_EXPR_CASE(T)                                                    \
+  case Expr::T:                                                                \
+    e = T##Expr::alloc(kids[0], kids[1]);                                      \
+    break;
+
+    BINARY_EXPR_CASE(Add)
+    BINARY_EXPR_CASE(Sub)
+    BINARY_EXPR_CASE(Mul)
+    BINARY_EXPR_CASE(UDiv)
+    BINARY_EXPR_CASE(SDiv)
+    BINARY_EXPR_CASE(URem)
+    BINARY_EXPR_CASE(SRem)
+    BINARY_EXPR_CASE(And)
+    BINARY_EXPR_CASE(Or)
+    BINARY_EXPR_CASE(Xor)
+    BINARY_EXPR_CASE(Shl)
+    BINARY_EXPR_CASE(LShr)
+    BINARY_EXPR_CASE(AShr)
+    BINARY_EXPR_CASE(Eq)
+    BINARY_EXPR_CASE(Ne)
+    BINARY_EXPR_CASE(Ult)
+    BINARY_EXPR_CASE(Ule)
+    BINARY_EXPR_CASE(Ugt)
+    BINARY_EXPR_CASE(Uge)
+    BINARY_EXPR_CASE(Slt)
+    BINARY_EXPR_CASE(Sle)
+    BINARY_EXPR_CASE(Sgt)
+    BINARY_EXPR_CASE(Sge)
+#undef BINARY_EXPR_CASE
+
+  default:
+    return false;
+  }
+  if (e->getWidth() != width)
+    return false;
+  exprs.push_back(e);
+  return true;
+}
+
+bool QueryReader::read(const char *begin, const char *end,
+                       ConstraintSet &constraints, ref<Expr> &expr) {
+  position = begin;
+  this->end = end;
+  exprs.clear();
+  updates.clear();
+  arrays.clear();
+
+  uint64_t count;
+  if (!readNumber(count))
+    return false;
+  for (uint64_t i = 0; i < count; ++i) {
+    ref<Expr> constraint;
+    if (!read(constraint))
+      return false;
+    constraints.push_back(constraint);
+  }
+  return read(expr);
+}
+
+bool klee::solveAndWrite(Solver &solver, SolverOperation operation,
+                         const Query &query,
+                         const std::vector<const Array *> &arrays,
+                         std::string &result) {
+  switch (operation) {
+  case SolverOperation::Truth: {
+    bool isValid;
+    if (!solver.impl->computeTruth(query, isValid))
+      return false;
+    result.assign(1, isValid);
+    return true;
+  }
+  case SolverOperation::Value: {
+    ref<Expr> value;
+    if (!solver.impl->computeValue(query, value))
+      return false;
+    const llvm::APInt &apValue = cast<ConstantExpr>(value)->getAPValue();
+    uint32_t width = apValue.getBitWidth();
+    result.assign(reinterpret_cast<const char *>(&width), sizeof(width));
+    result.append(reinterpret_cast<const char *>(apValue.getRawData()),
+                  apValue.getNumWords() * sizeof(uint64_t));
+    return true;
+  }
+  case SolverOperation::InitialValues: {
+    // whether there is a solution, and the size and the bytes of the binding
+    // of each array, the size is UINT64_MAX if it is not bound
+    std::shared_ptr<const Assignment> assignment;
+    bool hasSolution;
+    if (!solver.impl->computeInitialValues(query, assignment, hasSolution))
+      return false;
+    result.assign(1, hasSolution);
+    if (!hasSolution)
+      return true;
+    for (const Array *array : arrays) {
+      const CompactArrayModel *model =
+          assignment ? assignment->getBindingsOrNull(array) : nullptr;
+      std::vector<uint8_t> bytes;
+      if (model)
+        bytes = model->asVector();
+      uint64_t size = model ? bytes.size() : UINT64_MAX;
+      result.append(reinterpret_cast<const char *>(&size), sizeof(size));
+      result.append(bytes.begin(), bytes.end());
+    }
+    return true;
+  }
+  }
+  return false;
+}
+
+bool klee::readTruth(const std::string &result, bool &isValid) {
+  if (result.size() != 1)
+    return false;
+  isValid = result[0];
+  return true;
+}
+
+bool klee::readValue(const std::string &result, ref<Expr> &value) {
+  uint32_t width;
+  if (result.size() < sizeof(width))
+    return false;
+  memcpy(&width, result.data(), sizeof(width));
+  std::vector<uint64_t> words((result.size() - sizeof(width)) /
+                              sizeof(uint64_t));
+  if (!width || words.size() != (width + 63) / 64 ||
+      result.size() != sizeof(width) + words.size() * sizeof(uint64_t))
+    return false;
+  memcpy(words.data(), result.data() + sizeof(width),
+         words.size() * sizeof(uint64_t));
+  value = ConstantExpr::alloc(llvm::APInt(width, words));
+  return true;
+}
+
+bool klee::readInitialValues(const std::string &result,
+                             const std::vector<const Array *> &arrays,
+                             std::shared_ptr<const Assignment> &assignment,
+                             bool &hasSolution) {
+  if (result.empty())
+    return false;
+  hasSolution = result[0];
+  if (!hasSolution) {
+    assignment = nullptr;
+    return result.size() == 1;
+  }
+
+  auto bindings = std::make_shared<Assignment>();
+  size_t position = 1;
+  for (const Array *array : arrays) {
+    uint64_t size;
+    if (result.size() - position < sizeof(size))
+      return false;
+    memcpy(&size, result.data() + position, sizeof(size));
+    position += sizeof(size);
+    if (size == UINT64_MAX)
+      continue;
+    if (result.size() - position < size)
+      return false;
+    bindings->addBinding(
+        array, std::vector<unsigned char>(result.begin() + position,
+                                          result.begin() + position + size));
+    position += size;
+  }
+  if (position != result.size())
+    return false;
+  assignment = bindings;
+  return true;
+}
+
+namespace {
+Statistic *const ForwardedStats[] = {
+    &stats::queries,
+    &stats::queriesInvalid,
+    &stats::queriesValid,
+    &stats::queryCounterexamples,
+    &stats::queryPortfolioRaces,
+    &stats::queryPortfolioWinsMetaSMT,
+    &stats::queryPortfolioWinsSTP,
+    &stats::queryPortfolioWinsZ3,
+    &stats::queryTime,
+};
+const size_t ForwardedStatCount =
+    sizeof(ForwardedStats) / sizeof(ForwardedStats[0]);
+} // namespace
+
+const size_t klee::StatIncrementsSize = ForwardedStatCount * sizeof(uint64_t);
+
+std::vector<uint64_t> klee::getForwardedStats() {
+  std::vector<uint64_t> values;
+  for (Statistic *stat : ForwardedStats)
+    values.push_back(stat->getValue());
+  return values;
+}
+
+void klee::writeStatIncrements(const std::vector<uint64_t> &before,
+                               char *data) {
+  for (size_t i = 0; i < ForwardedStatCount; ++i) {
+    uint64_t increment = ForwardedStats[i]->getValue() - before[i];
+    memcpy(data + i * sizeof(increment), &increment, sizeof(increment));
+  }
+}
+
+void klee::readStatIncrements(const char *data) {
+  for (size_t i = 0; i < ForwardedStatCount; ++i) {
+    uint64_t increment;
+    memcpy(&increment, data + i * sizeof(increment), sizeof(increment));
+    *ForwardedStats[i] += increment;
+  }
+}
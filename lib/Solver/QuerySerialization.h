@@ -0,0 +1,117 @@
+//===-- QuerySerialization.h ------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_QUERYSERIALIZATION_H
+#define KLEE_QUERYSERIALIZATION_H
+
+#include "klee/Expr/Expr.h"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace llvm {
+class APInt;
+}
+
+namespace klee {
+class ArrayCache;
+class Assignment;
+class ConstraintSet;
+class Solver;
+struct Query;
+
+/// Writes queries in a form that does not depend on the names of the arrays
+/// or on the addresses of the expressions, so that equal queries of
+/// different runs are written the same. Arrays are numbered in the order in
+/// which they first appear, and so are the shared expressions and updates.
+class QueryWriter {
+  std::string &out;
+  std::unordered_map<const Expr *, uint64_t> exprs;
+  std::unordered_map<const UpdateNode *, uint64_t> updates;
+  std::unordered_map<const Array *, uint64_t> arrayIndices;
+
+  void writeNumber(uint64_t value);
+  void writeAPInt(const llvm::APInt &value);
+  void writeArray(const Array *array);
+  void writeUpdates(const UpdateNode *head);
+
+public:
+  /// The arrays of the written queries in the order of their numbers
+  std::vector<const Array *> arrays;
+
+  explicit QueryWriter(std::string &out) : out(out) {}
+
+  void write(const ref<Expr> &e);
+  void write(const Query &query);
+};
+
+/// Reads the queries written by a QueryWriter. The arrays are created in the
+/// cache once for each description, so the queries read by a reader share
+/// the arrays that are described the same. The arrays of a query that are
+/// described the same are distinct arrays of the description.
+class QueryReader {
+  ArrayCache &arrayCache;
+  std::unordered_map<std::string, std::vector<const Array *>> described;
+  unsigned createdArrays = 0;
+
+  const char *position = nullptr, *end = nullptr;
+  std::vector<ref<Expr>> exprs;
+  std::vector<ref<UpdateNode>> updates;
+
+  bool readNumber(uint64_t &value);
+  bool readAPInt(llvm::APInt &value);
+  bool readArray(const Array *&array);
+  bool readUpdates(ref<UpdateNode> &head);
+  bool read(ref<Expr> &e);
+
+public:
+  /// The arrays of the last query read in the order of their numbers
+  std::vector<const Array *> arrays;
+
+  explicit QueryReader(ArrayCache &arrayCache) : arrayCache(arrayCache) {}
+
+  /// Read the query written at the beginning of the data, false if it is
+  /// malformed
+  bool read(const char *begin, const char *end, ConstraintSet &constraints,
+            ref<Expr> &expr);
+};
+
+/// The operations of the solvers whose results are passed as bytes
+enum class SolverOperation : char { Truth, Value, InitialValues };
+
+/// Solve the query with the solver and write the result, a model as the
+/// bindings of the given arrays
+bool solveAndWrite(Solver &solver, SolverOperation operation,
+                   const Query &query, const std::vector<const Array *> &arrays,
+                   std::string &result);
+
+/// Read the results written by solveAndWrite, false if they are malformed
+bool readTruth(const std::string &result, bool &isValid);
+bool readValue(const std::string &result, ref<Expr> &value);
+bool readInitialValues(const std::string &result,
+                       const std::vector<const Array *> &arrays,
+                       std::shared_ptr<const Assignment> &assignment,
+                       bool &hasSolution);
+
+/// The number of bytes written by writeStatIncrements
+extern const size_t StatIncrementsSize;
+
+/// The values of the statistics that solvers update in other processes,
+/// whose increments are passed back with the results
+std::vector<uint64_t> getForwardedStats();
+/// Write the increments of the forwarded statistics since `before`
+void writeStatIncrements(const std::vector<uint64_t> &before, char *data);
+/// Add the increments written by writeStatIncrements to the statistics
+void readStatIncrements(const char *data);
+
+} // namespace klee
+
+#endif /* KLEE_QUERYSERIALIZATION_H */
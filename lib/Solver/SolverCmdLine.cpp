@@ -56,6 +56,25 @@ cl::opt<bool>
                          cl::desc("Use constraint independence (default=true)"),
                          cl::cat(SolvingCat));
 
+cl::opt<bool> UseNarrowingSolver(
+    "use-narrowing-solver", cl::init(false),
+    cl::desc("Compare terms that provably fit in fewer bits, like pointer "
+             "segments, with narrower terms in queries reaching the core "
+             "solver (default=false)"),
+    cl::cat(SolvingCat));
+
+cl::opt<std::string> PersistentQueryCache(
+    "persistent-query-cache",
+    cl::desc("Reuse the results of queries stored in this file, which can be "
+             "shared by several runs and processes (default=off)"),
+    cl::cat(SolvingCat));
+
+cl::opt<unsigned> PersistentQueryCacheSize(
+    "persistent-query-cache-size", cl::init(256),
+    cl::desc("Size in MiB of the results stored in a new persistent query "
+             "cache, the oldest results are overwritten (default=256)"),
+    cl::cat(SolvingCat));
+
 cl::opt<bool> DebugValidateSolver(
     "debug-validate-solver", cl::init(false),
     cl::desc("Crosscheck the results of the solver chain above the core solver "
@@ -201,6 +220,43 @@ cl::opt<CoreSolverType> DebugCrossCheckCoreSolverWith(
                clEnumValN(Z3_SOLVER, "z3", "Z3"),
                clEnumValN(NO_SOLVER, "none", "Do not crosscheck (default)")),
     cl::init(NO_SOLVER), cl::cat(SolvingCat));
+
+cl::list<CoreSolverType> SolverPortfolio(
+    "solver-portfolio", cl::CommaSeparated,
+    cl::desc("Race these solvers against the core solver on the queries it "
+             "does not solve within --solver-portfolio-threshold, with every "
+             "solver in a forked process, and take the first result "
+             "(default=off)"),
+    cl::values(clEnumValN(STP_SOLVER, "stp", "STP"),
+               clEnumValN(METASMT_SOLVER, "metasmt", "metaSMT"),
+               clEnumValN(Z3_SOLVER, "z3", "Z3")),
+    cl::cat(SolvingCat));
+
+cl::opt<std::string> SolverPortfolioThreshold(
+    "solver-portfolio-threshold", cl::init("100ms"),
+    cl::desc("Time after which the solvers of --solver-portfolio race on a "
+             "query (default=100ms)"),
+    cl::cat(SolvingCat));
+
+cl::opt<unsigned> SolverWorkers(
+    "solver-workers", cl::init(0),
+    cl::desc("Number of worker processes that solve the queries of the core "
+             "solver, restarted when they crash or time out (default=0, "
+             "solve in the KLEE process)"),
+    cl::cat(SolvingCat));
+
+cl::opt<unsigned> SolverWorkerMemory(
+    "solver-worker-memory", cl::init(0),
+    cl::desc("Memory in MiB that a solver worker may allocate before it "
+             "fails (default=0, unlimited)"),
+    cl::cat(SolvingCat));
+
+cl::opt<unsigned> Z3IncrementalSolvers(
+    "z3-incremental-solvers", cl::init(0),
+    cl::desc("Number of Z3 solvers that keep the constraints of recent "
+             "queries asserted and only assert the constraints that differ "
+             "in the next query (default=0, off)"),
+    cl::cat(SolvingCat));
 } // namespace klee
 
 #undef STP_IS_DEFAULT_STR
@@ -19,9 +19,25 @@ Statistic stats::queryCacheHits("QueryCacheHits", "QChits") ;
 Statistic stats::queryCacheMisses("QueryCacheMisses", "QCmisses");
 Statistic stats::queryCexCacheHits("QueryCexCacheHits", "QCexHits") ;
 Statistic stats::queryCexCacheMisses("QueryCexCacheMisses", "QCexMisses");
+Statistic stats::queryCexCacheEvictions("QueryCexCacheEvictions",
+                                        "QCexEvictions");
+Statistic stats::queryCexCacheNodeVisits("QueryCexCacheNodeVisits",
+                                         "QCexNodes");
 Statistic stats::queryConstructs("QueryConstructs", "QB");
 Statistic stats::queryCounterexamples("QueriesCEX", "Qcex");
+Statistic stats::queryNarrowedComparisons("QueryNarrowedComparisons",
+                                          "QNcmps");
+Statistic stats::queryPersistentCacheHits("QueryPersistentCacheHits",
+                                          "QPChits");
+Statistic stats::queryPersistentCacheMisses("QueryPersistentCacheMisses",
+                                            "QPCmisses");
+Statistic stats::queryPortfolioRaces("QueryPortfolioRaces", "QPraces");
+Statistic stats::queryPortfolioWinsMetaSMT("QueryPortfolioWinsMetaSMT",
+                                           "QPwinsMetaSMT");
+Statistic stats::queryPortfolioWinsSTP("QueryPortfolioWinsSTP", "QPwinsSTP");
+Statistic stats::queryPortfolioWinsZ3("QueryPortfolioWinsZ3", "QPwinsZ3");
 Statistic stats::queryTime("QueryTime", "Qtime");
+Statistic stats::solverWorkerRestarts("SolverWorkerRestarts", "SWrestarts");
 
 #ifdef KLEE_ARRAY_DEBUG
 Statistic stats::arrayHashTime("ArrayHashTime", "AHtime");
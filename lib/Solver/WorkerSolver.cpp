@@ -0,0 +1,419 @@
+//===-- WorkerSolver.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "QuerySerialization.h"
+
+#include "klee/Solver/Solver.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverStats.h"
+#include "klee/Statistics/Statistic.h"
+#include "klee/Support/ErrorHandling.h"
+
+#include "llvm/Support/Errno.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+
+/// The size of the header of a request, the operation and the timeout
+const size_t RequestHeaderSize = 1 + sizeof(uint64_t);
+/// The size of the header of a reply, whether the solver succeeded, its
+/// status and the increments of the statistics
+const size_t ReplyHeaderSize = 2 + StatIncrementsSize;
+
+/// The time a worker is given past the timeout of the solver before it is
+/// killed
+const time::Span TimeoutGrace = time::seconds(1);
+
+bool writeAll(int fd, const char *data, size_t size) {
+  while (size) {
+    ssize_t written = send(fd, data, size, MSG_NOSIGNAL);
+    if (written < 0 && errno == EINTR)
+      continue;
+    if (written <= 0)
+      return false;
+    data += written;
+    size -= written;
+  }
+  return true;
+}
+
+bool readAll(int fd, char *data, size_t size) {
+  while (size) {
+    ssize_t bytes = read(fd, data, size);
+    if (bytes < 0 && errno == EINTR)
+      continue;
+    if (bytes <= 0)
+      return false;
+    data += bytes;
+    size -= bytes;
+  }
+  return true;
+}
+
+/// Messages are framed by their size
+bool writeMessage(int fd, const std::string &message) {
+  uint64_t size = message.size();
+  return writeAll(fd, reinterpret_cast<const char *>(&size), sizeof(size)) &&
+         writeAll(fd, message.data(), message.size());
+}
+
+bool readMessage(int fd, std::string &message) {
+  uint64_t size;
+  if (!readAll(fd, reinterpret_cast<char *>(&size), sizeof(size)))
+    return false;
+  message.resize(size);
+  return readAll(fd, &message[0], size);
+}
+
+/// Send the pid of a worker and its socket, or a negative pid if it could
+/// not be started
+bool sendWorker(int fd, pid_t pid, int workerFd) {
+  char control[CMSG_SPACE(sizeof(int))];
+  memset(control, 0, sizeof(control));
+  iovec data = {&pid, sizeof(pid)};
+  msghdr message = {};
+  message.msg_iov = &data;
+  message.msg_iovlen = 1;
+  if (workerFd >= 0) {
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(header), &workerFd, sizeof(int));
+  }
+  ssize_t sent;
+  while ((sent = sendmsg(fd, &message, MSG_NOSIGNAL)) < 0 && errno == EINTR)
+    ;
+  return sent == sizeof(pid);
+}
+
+bool receiveWorker(int fd, pid_t &pid, int &workerFd) {
+  char control[CMSG_SPACE(sizeof(int))];
+  iovec data = {&pid, sizeof(pid)};
+  msghdr message = {};
+  message.msg_iov = &data;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+  ssize_t received;
+  while ((received = recvmsg(fd, &message, 0)) < 0 && errno == EINTR)
+    ;
+  if (received != sizeof(pid))
+    return false;
+  workerFd = -1;
+  cmsghdr *header = CMSG_FIRSTHDR(&message);
+  if (header && header->cmsg_level == SOL_SOCKET &&
+      header->cmsg_type == SCM_RIGHTS)
+    memcpy(&workerFd, CMSG_DATA(header), sizeof(int));
+  return pid > 0 && workerFd >= 0;
+}
+
+/// The size of the address space of the process, zero if it is unknown
+uint64_t getAddressSpaceSize() {
+  std::ifstream statm("/proc/self/statm");
+  uint64_t pages = 0;
+  statm >> pages;
+  return pages * sysconf(_SC_PAGESIZE);
+}
+
+/// Solve the queries received on the socket until it is closed
+[[noreturn]] void work(Solver &solver, int fd, uint64_t memoryLimit) {
+  // the solver may fork and wait for its processes
+  signal(SIGCHLD, SIG_DFL);
+  rlimit limit = {0, 0};
+  setrlimit(RLIMIT_CORE, &limit);
+  if (memoryLimit) {
+    // the limit applies to what the worker allocates, not what it inherits
+    limit.rlim_cur = limit.rlim_max = getAddressSpaceSize() + memoryLimit;
+    setrlimit(RLIMIT_AS, &limit);
+  }
+
+  ArrayCache arrayCache;
+  QueryReader reader(arrayCache);
+  std::string request;
+  while (readMessage(fd, request)) {
+    std::string reply(ReplyHeaderSize, 0), result;
+    reply[1] = SolverImpl::SOLVER_RUN_STATUS_FAILURE;
+    ConstraintSet constraints;
+    ref<Expr> expr;
+    if (request.size() >= RequestHeaderSize &&
+        reader.read(request.data() + RequestHeaderSize,
+                    request.data() + request.size(), constraints, expr)) {
+      uint64_t timeout;
+      memcpy(&timeout, request.data() + 1, sizeof(timeout));
+      std::vector<uint64_t> before = getForwardedStats();
+
+      solver.impl->setCoreSolverTimeout(time::microseconds(timeout));
+      reply[0] = solveAndWrite(solver,
+                               static_cast<SolverOperation>(request[0]),
+                               Query(constraints, expr), reader.arrays, result);
+      reply[1] = solver.impl->getOperationStatusCode();
+      writeStatIncrements(before, &reply[2]);
+    }
+    reply += result;
+    if (!writeMessage(fd, reply))
+      break;
+  }
+  _exit(0);
+}
+
+/// Start a worker for each byte received on the socket and send it back,
+/// until the socket is closed. The workers are forked from this process, so
+/// each of them starts with the solver in the state it was before the first
+/// query.
+[[noreturn]] void serve(Solver &solver, int fd, uint64_t memoryLimit) {
+  // interrupting KLEE must not kill the queries it waits for, and the
+  // workers are reaped by the system
+  signal(SIGINT, SIG_IGN);
+  signal(SIGCHLD, SIG_IGN);
+  char request;
+  while (readAll(fd, &request, 1)) {
+    int fds[2];
+    pid_t pid = -1;
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0) {
+      pid = fork();
+      if (pid == 0) {
+        close(fd);
+        close(fds[0]);
+        work(solver, fds[1], memoryLimit);
+      }
+      close(fds[1]);
+    } else {
+      fds[0] = -1;
+    }
+    bool sent = sendWorker(fd, pid, pid > 0 ? fds[0] : -1);
+    if (fds[0] >= 0)
+      close(fds[0]);
+    if (!sent)
+      break;
+  }
+  _exit(0);
+}
+
+/// Solves the queries in worker processes that a fork server starts, so
+/// that a solver that crashes or exhausts its memory does not take KLEE
+/// down with it. The queries and their results are passed serialized over
+/// sockets. A worker that crashes or does not answer within its timeout is
+/// killed and replaced, and the other workers are kept ready to take over
+/// while the replacement starts.
+class WorkerSolver : public SolverImpl {
+  struct Worker {
+    pid_t pid;
+    int fd;
+  };
+
+  /// The solver in the state the workers are forked with
+  Solver *solver;
+  unsigned count;
+  pid_t server;
+  int serverFd;
+  /// The workers started but not received from the server yet
+  unsigned pendingWorkers = 0;
+  std::deque<Worker> workers;
+  time::Span timeout;
+  SolverRunStatus runStatusCode = SOLVER_RUN_STATUS_FAILURE;
+
+  /// Ask the server for the workers missing from the pool
+  void requestWorkers();
+  /// Receive the started workers, waiting for one if there is none
+  bool acquireWorker();
+  void killWorker();
+  bool solve(SolverOperation operation, const Query &query,
+             std::vector<const Array *> &arrays, std::string &result);
+
+public:
+  WorkerSolver(Solver *solver, unsigned count, pid_t server, int serverFd)
+      : solver(solver), count(count), server(server), serverFd(serverFd) {
+    requestWorkers();
+  }
+  ~WorkerSolver();
+
+  bool computeTruth(const Query &, bool &isValid);
+  bool computeValue(const Query &, ref<Expr> &result);
+  bool computeInitialValues(const Query &,
+                            std::shared_ptr<const Assignment> &result,
+                            bool &hasSolution);
+  SolverRunStatus getOperationStatusCode() { return runStatusCode; }
+  char *getConstraintLog(const Query &query) {
+    return solver->impl->getConstraintLog(query);
+  }
+  void setCoreSolverTimeout(time::Span timeout) { this->timeout = timeout; }
+};
+
+WorkerSolver::~WorkerSolver() {
+  while (!workers.empty())
+    killWorker();
+  // the server and the workers it has not passed yet exit once it is closed
+  close(serverFd);
+  while (waitpid(server, nullptr, 0) < 0 && errno == EINTR)
+    ;
+  delete solver;
+}
+
+void WorkerSolver::requestWorkers() {
+  char request = 0;
+  while (workers.size() + pendingWorkers < count &&
+         writeAll(serverFd, &request, 1))
+    ++pendingWorkers;
+}
+
+bool WorkerSolver::acquireWorker() {
+  while (pendingWorkers) {
+    if (!workers.empty()) {
+      pollfd ready = {serverFd, POLLIN, 0};
+      if (poll(&ready, 1, 0) <= 0)
+        break;
+    }
+    --pendingWorkers;
+    Worker worker;
+    if (receiveWorker(serverFd, worker.pid, worker.fd))
+      workers.push_back(worker);
+    else
+      klee_warning("unable to start a solver worker");
+  }
+  return !workers.empty();
+}
+
+void WorkerSolver::killWorker() {
+  Worker &worker = workers.front();
+  kill(worker.pid, SIGKILL);
+  close(worker.fd);
+  workers.pop_front();
+}
+
+bool WorkerSolver::solve(SolverOperation operation, const Query &query,
+                         std::vector<const Array *> &arrays,
+                         std::string &result) {
+  // the operation, the timeout, and the query
+  std::string request(1, static_cast<char>(operation));
+  uint64_t microseconds = timeout.toMicroseconds();
+  request.append(reinterpret_cast<const char *>(&microseconds),
+                 sizeof(microseconds));
+  QueryWriter writer(request);
+  writer.write(query);
+  arrays = std::move(writer.arrays);
+
+  if (!acquireWorker()) {
+    runStatusCode = SOLVER_RUN_STATUS_FORK_FAILED;
+    return false;
+  }
+
+  // the last worker that answered keeps solving, it has the state of the
+  // recent queries
+  const Worker &worker = workers.front();
+  bool timedOut = false;
+  std::string reply;
+  if (writeMessage(worker.fd, request)) {
+    time::Point deadline = time::getWallTime() + timeout + TimeoutGrace;
+    pollfd ready = {worker.fd, POLLIN, 0};
+    int polled;
+    do {
+      int wait = -1;
+      if (timeout) {
+        time::Point now = time::getWallTime();
+        wait = now < deadline ? (deadline - now).toMicroseconds() / 1000 + 1
+                              : 0;
+      }
+      polled = poll(&ready, 1, wait);
+    } while (polled < 0 && errno == EINTR);
+    timedOut = polled == 0;
+    if (polled > 0 && readMessage(worker.fd, reply) &&
+        reply.size() >= ReplyHeaderSize) {
+      readStatIncrements(&reply[2]);
+      runStatusCode = static_cast<SolverRunStatus>(reply[1]);
+      result = reply.substr(ReplyHeaderSize);
+      return reply[0];
+    }
+  }
+
+  if (!timedOut)
+    klee_warning("solver worker %d failed, restarting it", worker.pid);
+  killWorker();
+  ++stats::solverWorkerRestarts;
+  requestWorkers();
+  runStatusCode =
+      timedOut ? SOLVER_RUN_STATUS_TIMEOUT : SOLVER_RUN_STATUS_FAILURE;
+  return false;
+}
+
+bool WorkerSolver::computeTruth(const Query &query, bool &isValid) {
+  std::vector<const Array *> arrays;
+  std::string result;
+  return solve(SolverOperation::Truth, query, arrays, result) &&
+         readTruth(result, isValid);
+}
+
+bool WorkerSolver::computeValue(const Query &query, ref<Expr> &result) {
+  std::vector<const Array *> arrays;
+  std::string value;
+  return solve(SolverOperation::Value, query, arrays, value) &&
+         readValue(value, result);
+}
+
+bool WorkerSolver::computeInitialValues(
+    const Query &query, std::shared_ptr<const Assignment> &result,
+    bool &hasSolution) {
+  std::vector<const Array *> arrays;
+  std::string value;
+  return solve(SolverOperation::InitialValues, query, arrays, value) &&
+         readInitialValues(value, arrays, result, hasSolution);
+}
+
+} // namespace
+
+Solver *klee::createWorkerSolver(Solver *s, unsigned workers,
+                                 uint64_t memoryLimit) {
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+    klee_warning("unable to start the solver workers: %s",
+                 llvm::sys::StrError(errno).c_str());
+    return s;
+  }
+  fflush(stdout);
+  fflush(stderr);
+  pid_t server = fork();
+  if (server < 0) {
+    klee_warning("unable to start the solver workers: %s",
+                 llvm::sys::StrError(errno).c_str());
+    close(fds[0]);
+    close(fds[1]);
+    // the queries are solved in this process instead
+    return s;
+  }
+  if (server == 0) {
+    close(fds[0]);
+    serve(*s, fds[1], memoryLimit);
+  }
+  close(fds[1]);
+  return new Solver(new WorkerSolver(s, std::max(workers, 1u), server, fds[0]));
+}
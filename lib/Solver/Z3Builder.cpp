@@ -72,6 +72,7 @@ Z3ArrayExprHash::~Z3ArrayExprHash() {}
 
 void Z3ArrayExprHash::clear() {
   _update_node_hash.clear();
+  _update_nodes.clear();
   _array_hash.clear();
 }
 
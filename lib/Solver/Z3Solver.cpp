@@ -13,6 +13,8 @@
 #include "klee/Support/OptionCategories.h"
 
 #include <csignal>
+#include <unordered_set>
+#include <vector>
 
 #ifdef ENABLE_Z3
 
@@ -23,6 +25,7 @@
 #include "klee/Expr/Assignment.h"
 #include "klee/Expr/ExprUtil.h"
 #include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverCmdLine.h"
 #include "klee/Solver/SolverImpl.h"
 
 #include "llvm/Support/CommandLine.h"
@@ -66,6 +69,28 @@ private:
   // Parameter symbols
   ::Z3_symbol timeoutParamStrSymbol;
 
+  /// A solver that keeps the constraints of the last query it solved
+  /// asserted, each in its own scope, so that a query sharing a prefix of the
+  /// constraints only asserts the rest of them
+  struct IncrementalSolver {
+    ::Z3_solver solver = nullptr;
+    std::vector<ref<Expr>> constraints;
+    /// The constant arrays whose values are asserted in each scope
+    std::vector<std::vector<const Array *>> constantArrays;
+    std::unordered_set<const Array *> assertedArrays;
+    uint64_t lastUse = 0;
+  };
+  std::vector<IncrementalSolver> incrementalSolvers;
+  uint64_t incrementalQueries = 0;
+
+  /// Get the incremental solver sharing the longest prefix of constraints
+  /// with the query, with the constraints of the query asserted
+  IncrementalSolver &getIncrementalSolver(const Query &);
+  /// Assert the values of the constant arrays of the constructed expression
+  /// that are not asserted yet
+  void assertConstantArrays(IncrementalSolver &, const ref<Expr> &e,
+                            std::vector<const Array *> &asserted);
+
   bool internalRunSolver(const Query &,
                          std::shared_ptr<const Assignment> &result,
                          bool &hasSolution,
@@ -112,6 +137,7 @@ Z3SolverImpl::Z3SolverImpl()
   Z3_params_inc_ref(builder->ctx, solverParameters);
   timeoutParamStrSymbol = Z3_mk_string_symbol(builder->ctx, "timeout");
   setCoreSolverTimeout(timeout);
+  incrementalSolvers.resize(Z3IncrementalSolvers);
 
   if (!Z3QueryDumpFile.empty()) {
     std::string error;
@@ -134,6 +160,9 @@ Z3SolverImpl::Z3SolverImpl()
 }
 
 Z3SolverImpl::~Z3SolverImpl() {
+  for (IncrementalSolver &incremental : incrementalSolvers)
+    if (incremental.solver)
+      Z3_solver_dec_ref(builder->ctx, incremental.solver);
   Z3_params_dec_ref(builder->ctx, solverParameters);
   delete builder;
 }
@@ -243,6 +272,75 @@ bool Z3SolverImpl::computeInitialValues(
   return internalRunSolver(query, result, hasSolution, true);
 }
 
+Z3SolverImpl::IncrementalSolver &
+Z3SolverImpl::getIncrementalSolver(const Query &query) {
+  // reuse the solver sharing the most constraints, or the least recently used
+  // one if none shares any
+  IncrementalSolver *best = nullptr;
+  size_t bestPrefix = 0;
+  for (IncrementalSolver &incremental : incrementalSolvers) {
+    size_t prefix = 0;
+    auto it = query.constraints.begin(), ie = query.constraints.end();
+    while (prefix < incremental.constraints.size() && it != ie &&
+           incremental.constraints[prefix] == *it) {
+      ++prefix;
+      ++it;
+    }
+    if (!best || prefix > bestPrefix ||
+        (prefix == bestPrefix && !bestPrefix &&
+         incremental.lastUse < best->lastUse)) {
+      best = &incremental;
+      bestPrefix = prefix;
+    }
+  }
+
+  IncrementalSolver &incremental = *best;
+  incremental.lastUse = ++incrementalQueries;
+  if (!incremental.solver) {
+    incremental.solver = Z3_mk_solver(builder->ctx);
+    Z3_solver_inc_ref(builder->ctx, incremental.solver);
+  }
+  // the timeout may have changed since the solver was created
+  Z3_solver_set_params(builder->ctx, incremental.solver, solverParameters);
+
+  if (size_t scopes = incremental.constraints.size() - bestPrefix) {
+    Z3_solver_pop(builder->ctx, incremental.solver, scopes);
+    for (size_t i = bestPrefix; i < incremental.constraints.size(); ++i)
+      for (const Array *array : incremental.constantArrays[i])
+        incremental.assertedArrays.erase(array);
+    incremental.constraints.resize(bestPrefix);
+    incremental.constantArrays.resize(bestPrefix);
+  }
+
+  auto it = query.constraints.begin(), ie = query.constraints.end();
+  std::advance(it, bestPrefix);
+  for (; it != ie; ++it) {
+    Z3_solver_push(builder->ctx, incremental.solver);
+    Z3_solver_assert(builder->ctx, incremental.solver, builder->construct(*it));
+    incremental.constraints.push_back(*it);
+    incremental.constantArrays.emplace_back();
+    assertConstantArrays(incremental, *it, incremental.constantArrays.back());
+  }
+  return incremental;
+}
+
+void Z3SolverImpl::assertConstantArrays(IncrementalSolver &incremental,
+                                        const ref<Expr> &e,
+                                        std::vector<const Array *> &asserted) {
+  ConstantArrayFinder constant_arrays;
+  constant_arrays.visit(e);
+  for (const Array *array : constant_arrays.results) {
+    if (!incremental.assertedArrays.insert(array).second)
+      continue;
+    assert(builder->constant_array_assertions.count(array) == 1 &&
+           "Constant array found in query, but not handled by Z3Builder");
+    for (auto const &arrayIndexValueExpr :
+         builder->constant_array_assertions[array])
+      Z3_solver_assert(builder->ctx, incremental.solver, arrayIndexValueExpr);
+    asserted.push_back(array);
+  }
+}
+
 bool Z3SolverImpl::internalRunSolver(
     const Query &query,
     std::shared_ptr<const Assignment> &result,
@@ -252,37 +350,50 @@ bool Z3SolverImpl::internalRunSolver(
   TimerStatIncrementer t(stats::queryTime);
   // NOTE: Z3 will switch to using a slower solver internally if push/pop are
   // used so for now it is likely that creating a new solver each time is the
-  // right way to go until Z3 changes its behaviour.
+  // right way to go until Z3 changes its behaviour. The incremental solvers
+  // trade that for not asserting the shared constraints of deep paths again.
   //
   // TODO: Investigate using a custom tactic as described in
   // https://github.com/klee/klee/issues/653
-  Z3_solver theSolver = Z3_mk_solver(builder->ctx);
-  Z3_solver_inc_ref(builder->ctx, theSolver);
-  Z3_solver_set_params(builder->ctx, theSolver, solverParameters);
+  Z3_solver theSolver;
+  IncrementalSolver *incremental = nullptr;
+  std::vector<const Array *> queryArrays;
 
   runStatusCode = SOLVER_RUN_STATUS_FAILURE;
 
-  ConstantArrayFinder constant_arrays_in_query;
-  for (auto const &constraint : query.constraints) {
-    Z3_solver_assert(builder->ctx, theSolver, builder->construct(constraint));
-    constant_arrays_in_query.visit(constraint);
-  }
-  ++stats::queries;
-  if (needsModel)
-    ++stats::queryCounterexamples;
-
   Z3ASTHandle z3QueryExpr =
       Z3ASTHandle(builder->construct(query.expr), builder->ctx);
-  constant_arrays_in_query.visit(query.expr);
 
-  for (auto const &constant_array : constant_arrays_in_query.results) {
-    assert(builder->constant_array_assertions.count(constant_array) == 1 &&
-           "Constant array found in query, but not handled by Z3Builder");
-    for (auto const &arrayIndexValueExpr :
-         builder->constant_array_assertions[constant_array]) {
-      Z3_solver_assert(builder->ctx, theSolver, arrayIndexValueExpr);
+  if (!incrementalSolvers.empty()) {
+    incremental = &getIncrementalSolver(query);
+    theSolver = incremental->solver;
+    // the query expression is asserted in a scope of its own
+    Z3_solver_push(builder->ctx, theSolver);
+    assertConstantArrays(*incremental, query.expr, queryArrays);
+  } else {
+    theSolver = Z3_mk_solver(builder->ctx);
+    Z3_solver_inc_ref(builder->ctx, theSolver);
+    Z3_solver_set_params(builder->ctx, theSolver, solverParameters);
+
+    ConstantArrayFinder constant_arrays_in_query;
+    for (auto const &constraint : query.constraints) {
+      Z3_solver_assert(builder->ctx, theSolver, builder->construct(constraint));
+      constant_arrays_in_query.visit(constraint);
+    }
+    constant_arrays_in_query.visit(query.expr);
+
+    for (auto const &constant_array : constant_arrays_in_query.results) {
+      assert(builder->constant_array_assertions.count(constant_array) == 1 &&
+             "Constant array found in query, but not handled by Z3Builder");
+      for (auto const &arrayIndexValueExpr :
+           builder->constant_array_assertions[constant_array]) {
+        Z3_solver_assert(builder->ctx, theSolver, arrayIndexValueExpr);
+      }
     }
   }
+  ++stats::queries;
+  if (needsModel)
+    ++stats::queryCounterexamples;
 
   // KLEE Queries are validity queries i.e.
   // ∀ X Constraints(X) → query(X)
@@ -306,7 +417,13 @@ bool Z3SolverImpl::internalRunSolver(
   runStatusCode = handleSolverResponse(query, theSolver, satisfiable, result,
                                        hasSolution, needsModel);
 
-  Z3_solver_dec_ref(builder->ctx, theSolver);
+  if (incremental) {
+    Z3_solver_pop(builder->ctx, theSolver, 1);
+    for (const Array *array : queryArrays)
+      incremental->assertedArrays.erase(array);
+  } else {
+    Z3_solver_dec_ref(builder->ctx, theSolver);
+  }
   // Clear the builder's cache to prevent memory usage exploding.
   // By using ``autoClearConstructCache=false`` and clearning now
   // we allow Z3_ast expressions to be shared from an entire
@@ -0,0 +1,43 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out %t.klee-out-resumed
+// RUN: %klee --output-dir=%t.klee-out --search=dfs --max-instructions=20000 --checkpoint-interval=1h --dump-states-on-halt=false %t.bc > %t.log 2>&1
+// RUN: FileCheck -check-prefix=CHECK-FIRST -input-file=%t.log %s
+// RUN: test -f %t.klee-out/checkpoint
+// RUN: %klee --output-dir=%t.klee-out-resumed --search=dfs --resume-from=%t.klee-out/checkpoint %t.bc > %t.resumed.log 2>&1
+// RUN: FileCheck -check-prefix=CHECK-RESUMED -input-file=%t.resumed.log %s
+// RUN: test -f %t.klee-out-resumed/test000016.ktest
+// RUN: not test -f %t.klee-out-resumed/test000017.ktest
+
+// Checks that an interrupted run continues from its checkpoint with the
+// states, memory and counters it had when it was interrupted.
+
+#include "klee/klee.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+int main(void) {
+  unsigned char bits[4];
+  klee_make_symbolic(bits, sizeof(bits), "bits");
+
+  unsigned path = 0;
+  for (int i = 0; i < 4; ++i) {
+    if (bits[i] < 100)
+      path |= 1u << i;
+  }
+
+  unsigned *values = malloc(1000 * sizeof(unsigned));
+  for (unsigned j = 0; j < 1000; ++j)
+    values[j] = path + j;
+  assert(values[999] == path + 999);
+  free(values);
+  return 0;
+}
+
+// CHECK-FIRST: wrote checkpoint of {{[0-9]+}} states
+// CHECK-FIRST: KLEE: done: partially completed paths = {{[1-9][0-9]*}}
+
+// CHECK-RESUMED: resumed {{[0-9]+}} states
+// CHECK-RESUMED-NOT: ASSERTION FAIL
+// CHECK-RESUMED: KLEE: done: completed paths = 16
+// CHECK-RESUMED: KLEE: done: partially completed paths = 0
@@ -0,0 +1,29 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out %t.klee-out-hash-consed
+// RUN: %klee --output-dir=%t.klee-out --search=dfs %t.bc > %t.log 2>&1
+// RUN: %klee --output-dir=%t.klee-out-hash-consed --search=dfs --hash-cons-exprs %t.bc > %t.hash-consed.log 2>&1
+// RUN: FileCheck -input-file=%t.hash-consed.log %s
+// RUN: FileCheck -check-prefix=CHECK-INFO -input-file=%t.klee-out-hash-consed/info %s
+// RUN: cmp %t.klee-out/test000001.ktest %t.klee-out-hash-consed/test000001.ktest
+// RUN: cmp %t.klee-out/test000008.ktest %t.klee-out-hash-consed/test000008.ktest
+
+// Checks that hash-consed expressions do not change the explored paths and
+// that equal expressions built on different paths are shared.
+
+#include "klee/klee.h"
+
+int main(void) {
+  int x[3];
+  klee_make_symbolic(x, sizeof(x), "x");
+
+  int sum = 0;
+  for (int i = 0; i < 3; ++i) {
+    if (x[i] * 3 + 1 > 10)
+      sum += x[i] * 3 + 1;
+  }
+  return sum;
+}
+
+// CHECK: KLEE: done: completed paths = 8
+// CHECK-INFO: expr hash-consing hit rate = {{[1-9][0-9]*}}%
+// CHECK-INFO-NOT: bytes saved = 0
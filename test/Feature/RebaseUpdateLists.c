@@ -0,0 +1,53 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --rebase-update-lists=8 %t.bc > %t.log 2>&1
+// RUN: FileCheck -input-file=%t.log %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --rebase-update-lists=0 %t.bc > %t.off.log 2>&1
+// RUN: FileCheck -input-file=%t.off.log %s
+
+// Checks that objects written at symbolic offsets and then overwritten with
+// concrete bytes keep their contents when the writes no read can see are
+// dropped from their update lists, whether all bytes are overwritten or only
+// some of them.
+
+#include "klee/klee.h"
+
+#include <assert.h>
+
+int main(void) {
+  unsigned char buf[16] = {0};
+  unsigned i;
+  klee_make_symbolic(&i, sizeof(i), "i");
+  klee_assume(i < 16);
+
+  for (unsigned round = 0; round < 10; ++round) {
+    for (unsigned k = 0; k < 4; ++k)
+      buf[(i + k) & 15] = i + k;
+    for (unsigned k = 0; k < 16; ++k)
+      buf[k] = round + k;
+  }
+
+  // the last round overwrote all bytes with concrete values
+  assert(buf[i] == 9 + i);
+  assert(buf[(i + 3) & 15] == 9 + ((i + 3) & 15));
+
+  unsigned char half[16] = {0};
+  for (unsigned round = 0; round < 10; ++round) {
+    half[8 + (i & 7)] = round + 1;
+    for (unsigned k = 0; k < 8; ++k)
+      half[k] = round + k;
+  }
+
+  // the writes at symbolic offsets to the second half are kept
+  assert(half[8 + (i & 7)] == 10);
+  assert(half[3] == 12);
+
+  buf[i] = 100;
+  if (buf[(i + 1) & 15] == 100)
+    return 1;
+  return 0;
+}
+
+// CHECK-NOT: ASSERTION FAIL
+// CHECK: KLEE: done: completed paths = 1
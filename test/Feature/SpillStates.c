@@ -0,0 +1,43 @@
+// REQUIRES: not-msan
+// MSan adds additional memory that overflows the counter
+//
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --max-memory=20 --spill-states --search=random-state %t.bc > %t.log 2>&1
+// RUN: FileCheck -input-file=%t.log %s
+// RUN: FileCheck -check-prefix=CHECK-INFO -input-file=%t.klee-out/info %s
+// RUN: not test -e %t.klee-out/spilled-states
+
+// Checks that states over the memory cap are spilled to disk and finish once
+// they are loaded back instead of being terminated.
+
+#include "klee/klee.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+#define SIZE (4 << 20)
+
+int main(void) {
+  unsigned char bits[5];
+  klee_make_symbolic(bits, sizeof(bits), "bits");
+
+  unsigned path = 0;
+  for (int i = 0; i < 5; ++i) {
+    if (bits[i] < 100)
+      path |= 1u << i;
+  }
+
+  // 32 states with 4MB of their own each
+  unsigned char *buf = malloc(SIZE);
+  for (unsigned j = 0; j < SIZE; j += 64)
+    buf[j] = path;
+  assert(buf[SIZE - 64] == path);
+  return 0;
+}
+
+// CHECK: spilled {{[0-9]+}} states to disk
+// CHECK-NOT: killing
+// CHECK-NOT: ASSERTION FAIL
+// CHECK: KLEE: done: completed paths = 32
+// CHECK-INFO-NOT: states spilled = 0
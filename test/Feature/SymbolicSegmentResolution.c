@@ -0,0 +1,46 @@
+// RUN: %clang %s -emit-llvm %O0opt -c -o %t.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t.bc > %t.log 2>&1
+// RUN: FileCheck -input-file=%t.log %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --segment-enumeration-limit=3 %t.bc > %t.limit.log 2>&1
+// RUN: FileCheck -input-file=%t.limit.log %s
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --segment-interval-limit=1 %t.bc > %t.interval.log 2>&1
+// RUN: FileCheck -input-file=%t.interval.log %s
+
+// Checks that a pointer with a symbolic segment is resolved to exactly
+// the objects it may point to, regardless of how the feasible segments
+// are enumerated.
+
+#include "klee/klee.h"
+
+#include <stdlib.h>
+
+#define N 10
+
+int main() {
+  int *buf[N];
+  int *unused[N];
+
+  for (int i = 0; i < N; i++) {
+    buf[i] = malloc(sizeof(int));
+    *buf[i] = i;
+    // interleave objects that the pointer can never refer to
+    unused[i] = malloc(sizeof(int));
+  }
+
+  unsigned s = klee_range(0, N, "s");
+  int x = *buf[s];
+  if (x != (int)s)
+    abort();
+
+  for (int i = 0; i < N; i++) {
+    free(buf[i]);
+    free(unused[i]);
+  }
+  return 0;
+}
+
+// CHECK-NOT: KLEE: ERROR
+// CHECK: KLEE: done: completed paths = 10
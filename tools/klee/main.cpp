@@ -296,6 +296,14 @@ namespace {
              cl::desc("Directory with .ktest files to be used as seeds"),
              cl::cat(SeedingCat));
 
+  cl::opt<std::string>
+  ResumeFrom("resume-from",
+             cl::desc("Continue the run saved in a checkpoint (see "
+                      "--checkpoint-interval) instead of starting it anew.  "
+                      "The module and its arguments must be the same"),
+             cl::value_desc("checkpoint file"),
+             cl::cat(TerminationCat));
+
   cl::opt<unsigned>
   MakeConcreteSymbolic("make-concrete-symbolic",
                        cl::desc("Probabilistic rate at which to make concrete reads symbolic, "
@@ -365,6 +373,9 @@ public:
   void incPathsExplored(std::uint32_t num = 1) {
     m_pathsExplored += num; }
 
+  OutputCounters getOutputCounters() const;
+  void setOutputCounters(const OutputCounters &counters);
+
   void setInterpreter(Interpreter *i);
 
   std::string dumpPath(const ExecutionState& state);
@@ -951,6 +962,22 @@ void KleeHandler::processTestCase(const ExecutionState &state,
   }
 }
 
+InterpreterHandler::OutputCounters KleeHandler::getOutputCounters() const {
+  OutputCounters counters;
+  counters.numTotalTests = m_numTotalTests;
+  counters.numGeneratedTests = m_numGeneratedTests;
+  counters.pathsCompleted = m_pathsCompleted;
+  counters.pathsExplored = m_pathsExplored;
+  return counters;
+}
+
+void KleeHandler::setOutputCounters(const OutputCounters &counters) {
+  m_numTotalTests = counters.numTotalTests;
+  m_numGeneratedTests = counters.numGeneratedTests;
+  m_pathsCompleted = counters.pathsCompleted;
+  m_pathsExplored = counters.pathsExplored;
+}
+
   // load a .path file
 void KleeHandler::loadPathFile(std::string name,
                                      std::vector<bool> &buffer) {
@@ -1814,6 +1841,13 @@ int main(int argc, char **argv, char **envp) {
     handler->getInfoStream().flush();
   }
 
+  if (!ResumeFrom.empty()) {
+    if (!ReplayKTestDir.empty() || !ReplayKTestFile.empty() ||
+        ReplayPathFile != "" || !SeedOutFile.empty() || !SeedOutDir.empty())
+      klee_error("--resume-from cannot be used with replaying or seeds");
+    interpreter->setResumeCheckpoint(ResumeFrom);
+  }
+
   if (!ReplayKTestDir.empty() || !ReplayKTestFile.empty()) {
     assert(SeedOutFile.empty());
     assert(SeedOutDir.empty());
@@ -1950,6 +1984,42 @@ int main(int argc, char **argv, char **envp) {
     *theStatisticManager->getStatisticByName("Instructions");
   uint64_t forks =
     *theStatisticManager->getStatisticByName("Forks");
+  uint64_t boundsCheckQueriesAvoided =
+    *theStatisticManager->getStatisticByName("BoundsCheckQueriesAvoided");
+  uint64_t queriesDecidedByBounds =
+    *theStatisticManager->getStatisticByName("QueriesDecidedByBounds");
+  uint64_t objectBytesShared =
+    *theStatisticManager->getStatisticByName("ObjectBytesShared");
+  uint64_t objectBytesCopied =
+    *theStatisticManager->getStatisticByName("ObjectBytesCopied");
+  uint64_t stateSpills =
+    *theStatisticManager->getStatisticByName("StateSpills");
+  uint64_t exprHashConsHits =
+    *theStatisticManager->getStatisticByName("ExprHashConsHits");
+  uint64_t exprHashConsMisses =
+    *theStatisticManager->getStatisticByName("ExprHashConsMisses");
+  uint64_t exprHashConsBytesSaved =
+    *theStatisticManager->getStatisticByName("ExprHashConsBytesSaved");
+  uint64_t simplificationCacheHits =
+    *theStatisticManager->getStatisticByName("SimplificationCacheHits");
+  uint64_t simplificationCacheMisses =
+    *theStatisticManager->getStatisticByName("SimplificationCacheMisses");
+  uint64_t exprJITCompilations =
+    *theStatisticManager->getStatisticByName("ExprJITCompilations");
+  uint64_t exprJITEvaluations =
+    *theStatisticManager->getStatisticByName("ExprJITEvaluations");
+  uint64_t queryPersistentCacheHits =
+    *theStatisticManager->getStatisticByName("QueryPersistentCacheHits");
+  uint64_t queryPersistentCacheMisses =
+    *theStatisticManager->getStatisticByName("QueryPersistentCacheMisses");
+  uint64_t queryPortfolioRaces =
+    *theStatisticManager->getStatisticByName("QueryPortfolioRaces");
+  uint64_t queryCexCacheNodeVisits =
+    *theStatisticManager->getStatisticByName("QueryCexCacheNodeVisits");
+  uint64_t queryCexCacheEvictions =
+    *theStatisticManager->getStatisticByName("QueryCexCacheEvictions");
+  uint64_t solverWorkerRestarts =
+    *theStatisticManager->getStatisticByName("SolverWorkerRestarts");
 
   handler->getInfoStream()
     << "KLEE: done: explored paths = " << 1 + forks << "\n";
@@ -1964,7 +2034,57 @@ int main(int argc, char **argv, char **envp) {
     << "KLEE: done: total queries = " << queries << "\n"
     << "KLEE: done: valid queries = " << queriesValid << "\n"
     << "KLEE: done: invalid queries = " << queriesInvalid << "\n"
-    << "KLEE: done: query cex = " << queryCounterexamples << "\n";
+    << "KLEE: done: query cex = " << queryCounterexamples << "\n"
+    << "KLEE: done: bounds check queries avoided = "
+    << boundsCheckQueriesAvoided << "\n"
+    << "KLEE: done: queries decided by bounds = " << queriesDecidedByBounds
+    << "\n"
+    << "KLEE: done: object bytes shared = " << objectBytesShared << "\n"
+    << "KLEE: done: object bytes copied = " << objectBytesCopied << "\n"
+    << "KLEE: done: states spilled = " << stateSpills << "\n";
+  if (exprHashConsHits + exprHashConsMisses)
+    handler->getInfoStream()
+      << "KLEE: done: expr hash-consing hit rate = "
+      << 100 * exprHashConsHits / (exprHashConsHits + exprHashConsMisses)
+      << "%\n"
+      << "KLEE: done: expr hash-consing bytes saved = "
+      << exprHashConsBytesSaved << "\n";
+  if (simplificationCacheHits + simplificationCacheMisses)
+    handler->getInfoStream()
+      << "KLEE: done: simplification cache hit rate = "
+      << 100 * simplificationCacheHits /
+             (simplificationCacheHits + simplificationCacheMisses)
+      << "%\n";
+  if (exprJITCompilations)
+    handler->getInfoStream()
+      << "KLEE: done: expr JIT compilations = " << exprJITCompilations << "\n"
+      << "KLEE: done: expr JIT evaluations = " << exprJITEvaluations << "\n";
+  if (queryCexCacheNodeVisits)
+    handler->getInfoStream()
+      << "KLEE: done: cex cache nodes visited = " << queryCexCacheNodeVisits
+      << "\n"
+      << "KLEE: done: cex cache evictions = " << queryCexCacheEvictions
+      << "\n";
+  if (queryPersistentCacheHits + queryPersistentCacheMisses)
+    handler->getInfoStream()
+      << "KLEE: done: persistent query cache hits = "
+      << queryPersistentCacheHits << "\n"
+      << "KLEE: done: persistent query cache misses = "
+      << queryPersistentCacheMisses << "\n";
+  if (queryPortfolioRaces) {
+    handler->getInfoStream()
+      << "KLEE: done: solver portfolio races = " << queryPortfolioRaces << "\n";
+    for (const char *backend : {"STP", "MetaSMT", "Z3"})
+      handler->getInfoStream()
+        << "KLEE: done: solver portfolio wins of " << backend << " = "
+        << *theStatisticManager->getStatisticByName(
+               std::string("QueryPortfolioWins") + backend)
+        << "\n";
+  }
+  if (solverWorkerRestarts)
+    handler->getInfoStream()
+      << "KLEE: done: solver worker restarts = " << solverWorkerRestarts
+      << "\n";
 
   std::stringstream stats;
   stats << '\n'
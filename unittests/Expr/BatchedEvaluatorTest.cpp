@@ -0,0 +1,209 @@
+//===-- BatchedEvaluatorTest.cpp ------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/BatchedEvaluator.h"
+#include "klee/Expr/Expr.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <chrono>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+struct Inputs {
+  ArrayCache cache;
+  const Array *a = cache.CreateArray("a", 8);
+  const Array *b = cache.CreateArray("b", 4);
+  ref<Expr> x = Expr::createTempRead(a, Expr::Int32);
+  ref<Expr> y = Expr::createTempRead(b, Expr::Int16);
+  ref<Expr> z = ReadExpr::create(UpdateList(a, nullptr),
+                                 ConstantExpr::create(4, Expr::Int32));
+  ref<Expr> w = Expr::createTempRead(a, Expr::Int64);
+
+  std::vector<std::unique_ptr<Assignment>> assignments;
+
+  explicit Inputs(unsigned count, unsigned seed = 1) {
+    std::mt19937 rng(seed);
+    for (unsigned i = 0; i < count; ++i) {
+      auto assignment = std::unique_ptr<Assignment>(new Assignment());
+      std::vector<unsigned char> as(8), bs(4);
+      for (auto &byte : as)
+        byte = rng() % 4 ? rng() : (rng() % 2 ? 0 : 0xff);
+      for (auto &byte : bs)
+        byte = rng();
+      assignment->addBinding(a, as);
+      // some assignments leave `b` free
+      if (i % 5)
+        assignment->addBinding(b, bs);
+      assignments.push_back(std::move(assignment));
+    }
+  }
+
+  std::vector<const Assignment *> getBatch() const {
+    std::vector<const Assignment *> batch;
+    for (const auto &assignment : assignments)
+      batch.push_back(assignment.get());
+    return batch;
+  }
+
+  /// Terms of all kinds, built without the simplifications of create
+  std::vector<ref<Expr>> getTerms() const {
+    ref<Expr> y32 = ZExtExpr::create(y, Expr::Int32);
+    ref<Expr> z32 = SExtExpr::create(z, Expr::Int32);
+    ref<Expr> byteIndex =
+        ZExtExpr::create(ExtractExpr::create(x, 0, 3), Expr::Int32);
+    UpdateList updates(a, nullptr);
+    updates.extend(ConstantExpr::create(2, Expr::Int32), z);
+    updates.extend(ZExtExpr::create(ExtractExpr::create(y, 0, 2), Expr::Int32),
+                   ConstantExpr::create(7, Expr::Int8));
+    std::vector<ref<Expr>> terms = {
+        x, y, z, w,
+        ReadExpr::create(UpdateList(a, nullptr), byteIndex),
+        ReadExpr::create(updates, byteIndex),
+        ReadExpr::create(UpdateList(b, nullptr),
+                         ConstantExpr::create(9, Expr::Int32)),
+        SelectExpr::alloc(UltExpr::alloc(x, y32), x, y32),
+        ConcatExpr::alloc(y, z),
+        ExtractExpr::alloc(w, 13, Expr::Int32),
+        AddExpr::alloc(x, y32),
+        SubExpr::alloc(y32, x),
+        MulExpr::alloc(x, z32),
+        UDivExpr::alloc(x, y32),
+        SDivExpr::alloc(x, z32),
+        URemExpr::alloc(w, ZExtExpr::create(x, Expr::Int64)),
+        SRemExpr::alloc(z32, y32),
+        SDivExpr::alloc(ConstantExpr::create(0x80000000, Expr::Int32),
+                        SExtExpr::create(ExtractExpr::create(y, 0, 1),
+                                         Expr::Int32)),
+        NotExpr::alloc(x),
+        AndExpr::alloc(x, y32),
+        OrExpr::alloc(w, ZExtExpr::create(x, Expr::Int64)),
+        XorExpr::alloc(x, z32),
+        ShlExpr::alloc(x, ZExtExpr::create(z, Expr::Int32)),
+        LShrExpr::alloc(x, ZExtExpr::create(z, Expr::Int32)),
+        AShrExpr::alloc(x, ZExtExpr::create(z, Expr::Int32)),
+        AShrExpr::alloc(w, ConstantExpr::create(63, Expr::Int64)),
+        EqExpr::alloc(z, ConstantExpr::create(0, Expr::Int8)),
+        NeExpr::alloc(x, y32),
+        UltExpr::alloc(x, y32),
+        UleExpr::alloc(z32, x),
+        UgtExpr::alloc(x, z32),
+        UgeExpr::alloc(y32, z32),
+        SltExpr::alloc(x, z32),
+        SleExpr::alloc(z, ExtractExpr::create(y, 8, Expr::Int8)),
+        SgtExpr::alloc(w, ZExtExpr::create(y, Expr::Int64)),
+        SgeExpr::alloc(z32, y32),
+        // only the selected value may divide by zero
+        SelectExpr::alloc(EqExpr::alloc(y, ConstantExpr::create(0, Expr::Int16)),
+                          ConstantExpr::create(1, Expr::Int16),
+                          UDivExpr::alloc(ConstantExpr::create(1, Expr::Int16),
+                                          y)),
+        NotOptimizedExpr::create(AddExpr::alloc(x, x)),
+    };
+    return terms;
+  }
+};
+
+TEST(BatchedEvaluatorTest, AgreesWithAssignments) {
+  Inputs inputs(BatchedEvaluator::MaxBatchSize);
+  BatchedEvaluator evaluator(inputs.getBatch());
+
+  for (const ref<Expr> &term : inputs.getTerms()) {
+    const std::uint64_t *values;
+    BatchedEvaluator::lanes_ty defined = evaluator.evaluate(term, values);
+    for (unsigned i = 0; i < inputs.assignments.size(); ++i) {
+      ref<Expr> expected = inputs.assignments[i]->evaluate(term);
+      if (auto *CE = dyn_cast<ConstantExpr>(expected)) {
+        ASSERT_TRUE(defined & (BatchedEvaluator::lanes_ty(1) << i))
+            << term << " for assignment " << i;
+        EXPECT_EQ(values[i], CE->getZExtValue())
+            << term << " for assignment " << i;
+      } else {
+        EXPECT_FALSE(defined & (BatchedEvaluator::lanes_ty(1) << i))
+            << term << " for assignment " << i;
+      }
+    }
+  }
+}
+
+TEST(BatchedEvaluatorTest, Satisfies) {
+  Inputs inputs(10);
+  ref<Expr> y32 = ZExtExpr::create(inputs.y, Expr::Int32);
+  std::vector<ref<Expr>> constraints = {
+      UltExpr::create(inputs.z, ConstantExpr::create(200, Expr::Int8)),
+      // undefined for the assignments with a zero `y`
+      EqExpr::create(ConstantExpr::create(0, Expr::Int32),
+                     UDivExpr::create(inputs.x, y32)),
+  };
+  BatchedEvaluator evaluator(inputs.getBatch());
+  BatchedEvaluator::lanes_ty lanes =
+      evaluator.satisfies(constraints.begin(), constraints.end());
+  for (unsigned i = 0; i < inputs.assignments.size(); ++i)
+    EXPECT_EQ(bool(lanes & (BatchedEvaluator::lanes_ty(1) << i)),
+              inputs.assignments[i]->satisfies(constraints.begin(),
+                                               constraints.end()));
+}
+
+// Compares the throughput of the batched evaluator with evaluating the
+// assignments one by one, like the counterexample cache did before, run
+// with --gtest_also_run_disabled_tests.
+TEST(BatchedEvaluatorTest, DISABLED_Throughput) {
+  Inputs inputs(BatchedEvaluator::MaxBatchSize);
+  std::vector<ref<Expr>> terms = inputs.getTerms();
+  std::vector<ref<Expr>> constraints;
+  for (const ref<Expr> &term : terms)
+    if (term->getWidth() == Expr::Bool)
+      constraints.push_back(OrExpr::create(
+          term, EqExpr::create(inputs.w, ConstantExpr::create(0, Expr::Int64))));
+  const unsigned rounds = 200;
+
+  for (unsigned batchSize : {1u, 8u, 64u}) {
+    std::vector<const Assignment *> batch = inputs.getBatch();
+    batch.resize(batchSize);
+    unsigned satisfied = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned round = 0; round < rounds; ++round) {
+      for (unsigned i = 0; i < BatchedEvaluator::MaxBatchSize;
+           i += batchSize) {
+        BatchedEvaluator evaluator(batch);
+        satisfied += __builtin_popcountll(
+            evaluator.satisfies(constraints.begin(), constraints.end()));
+      }
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    llvm::outs() << "batches of " << batchSize << ": "
+                 << uint64_t(rounds) * BatchedEvaluator::MaxBatchSize *
+                        1000000 / (elapsed.count() + 1)
+                 << " assignments per second (" << satisfied << ")\n";
+  }
+
+  unsigned satisfied = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned round = 0; round < rounds; ++round)
+    for (const auto &assignment : inputs.assignments)
+      satisfied += assignment->satisfies(constraints.begin(), constraints.end());
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start);
+  llvm::outs() << "one by one: "
+               << uint64_t(rounds) * BatchedEvaluator::MaxBatchSize * 1000000 /
+                      (elapsed.count() + 1)
+               << " assignments per second (" << satisfied << ")\n";
+}
+
+} // namespace
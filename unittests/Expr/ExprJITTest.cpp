@@ -0,0 +1,224 @@
+//===-- ExprJITTest.cpp ---------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprJIT.h"
+#include "klee/Expr/ExprStats.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+class ExprJITTest : public ::testing::Test {
+protected:
+  ArrayCache cache;
+  const Array *a = cache.CreateArray("a", 8);
+  const Array *b = cache.CreateArray("b", 4);
+  const Array *table;
+  ref<Expr> x = Expr::createTempRead(a, Expr::Int32);
+  ref<Expr> y = Expr::createTempRead(b, Expr::Int16);
+  ref<Expr> z = ReadExpr::create(UpdateList(a, nullptr),
+                                 ConstantExpr::create(4, Expr::Int32));
+  ref<Expr> w = Expr::createTempRead(a, Expr::Int64);
+  std::vector<Assignment> assignments;
+
+  ExprJITTest() {
+    std::vector<ref<ConstantExpr>> values;
+    for (unsigned i = 0; i < 6; ++i)
+      values.push_back(ConstantExpr::create(3 * i + 1, Expr::Int8));
+    table = cache.CreateArray("table", values.size(), &values.front(),
+                              &values.back() + 1);
+
+    std::mt19937 rng(1);
+    for (unsigned i = 0; i < 64; ++i) {
+      std::vector<unsigned char> as(8), bs(4);
+      for (auto &byte : as)
+        byte = rng() % 4 ? rng() : (rng() % 2 ? 0 : 0xff);
+      for (auto &byte : bs)
+        byte = rng();
+      Assignment assignment;
+      // skipped and missing bytes read as zero
+      if (i % 7) {
+        assignment.addBinding(a, as);
+      } else {
+        Assignment::map_bindings_ty models;
+        models[a].add(1, as[1]);
+        models[a].add(6, as[6]);
+        assignment = Assignment(models);
+      }
+      if (i % 5)
+        assignment.addBinding(b, bs);
+      assignments.push_back(assignment);
+    }
+  }
+
+  std::vector<ref<Expr>> getTerms() const {
+    ref<Expr> y32 = ZExtExpr::create(y, Expr::Int32);
+    ref<Expr> z32 = SExtExpr::create(z, Expr::Int32);
+    ref<Expr> byteIndex =
+        ZExtExpr::create(ExtractExpr::create(x, 0, 3), Expr::Int32);
+    UpdateList updates(a, nullptr);
+    updates.extend(ConstantExpr::create(2, Expr::Int32), z);
+    updates.extend(ZExtExpr::create(ExtractExpr::create(y, 0, 2), Expr::Int32),
+                   ConstantExpr::create(7, Expr::Int8));
+    UpdateList undefinedUpdates(a, nullptr);
+    undefinedUpdates.extend(
+        UDivExpr::alloc(ConstantExpr::create(5, Expr::Int32), y32),
+        ConstantExpr::create(1, Expr::Int8));
+    return {
+        x, y, z, w,
+        ReadExpr::create(UpdateList(a, nullptr), byteIndex),
+        ReadExpr::create(updates, byteIndex),
+        ReadExpr::create(undefinedUpdates, byteIndex),
+        ReadExpr::create(UpdateList(b, nullptr),
+                         ConstantExpr::create(9, Expr::Int32)),
+        ReadExpr::create(UpdateList(table, nullptr), byteIndex),
+        SelectExpr::alloc(UltExpr::alloc(x, y32), x, y32),
+        ConcatExpr::alloc(y, z),
+        ExtractExpr::alloc(w, 13, Expr::Int32),
+        AddExpr::alloc(x, y32),
+        SubExpr::alloc(y32, x),
+        MulExpr::alloc(x, z32),
+        UDivExpr::alloc(x, y32),
+        SDivExpr::alloc(x, z32),
+        URemExpr::alloc(w, ZExtExpr::create(x, Expr::Int64)),
+        SRemExpr::alloc(z32, y32),
+        SDivExpr::alloc(ConstantExpr::create(0x80000000, Expr::Int32),
+                        SExtExpr::create(ExtractExpr::create(y, 0, 1),
+                                         Expr::Int32)),
+        NotExpr::alloc(x),
+        AndExpr::alloc(x, y32),
+        OrExpr::alloc(w, ZExtExpr::create(x, Expr::Int64)),
+        XorExpr::alloc(x, z32),
+        ShlExpr::alloc(x, ZExtExpr::create(z, Expr::Int32)),
+        LShrExpr::alloc(x, ZExtExpr::create(z, Expr::Int32)),
+        AShrExpr::alloc(x, ZExtExpr::create(z, Expr::Int32)),
+        EqExpr::alloc(z, ConstantExpr::create(0, Expr::Int8)),
+        NeExpr::alloc(x, y32),
+        UleExpr::alloc(z32, x),
+        UgtExpr::alloc(x, z32),
+        UgeExpr::alloc(y32, z32),
+        SltExpr::alloc(x, z32),
+        SleExpr::alloc(z, ExtractExpr::create(y, 8, Expr::Int8)),
+        SgtExpr::alloc(w, ZExtExpr::create(y, Expr::Int64)),
+        SgeExpr::alloc(z32, y32),
+        SelectExpr::alloc(EqExpr::alloc(y, ConstantExpr::create(0, Expr::Int16)),
+                          ConstantExpr::create(1, Expr::Int16),
+                          UDivExpr::alloc(ConstantExpr::create(1, Expr::Int16),
+                                          y)),
+        NotOptimizedExpr::create(AddExpr::alloc(x, x)),
+        // wider than the compiled code supports
+        ConcatExpr::create(w, w),
+    };
+  }
+};
+
+TEST_F(ExprJITTest, AgreesWithAssignments) {
+  ExprJIT jit(1, 0);
+  for (const ref<Expr> &term : getTerms()) {
+    for (unsigned i = 0; i < assignments.size(); ++i) {
+      ref<Expr> expected = assignments[i].evaluate(term);
+      ref<Expr> actual = jit.evaluate(assignments[i], term);
+      EXPECT_EQ(expected, actual) << term << " for assignment " << i;
+    }
+  }
+}
+
+TEST_F(ExprJITTest, InterpretsColdExpressions) {
+  ExprJIT jit(3, 0);
+  ref<Expr> e = UltExpr::create(x, ZExtExpr::create(y, Expr::Int32));
+  for (const Assignment &assignment : assignments) {
+    EXPECT_EQ(jit.satisfies(assignment, &e, &e + 1),
+              assignment.satisfies(&e, &e + 1));
+  }
+}
+
+TEST_F(ExprJITTest, EvictsLeastRecentlyUsed) {
+  ExprJIT jit(1, 4);
+  uint64_t evictions = stats::exprJITEvictions.getValue();
+  std::vector<ref<Expr>> terms = getTerms();
+  for (unsigned round = 0; round < 2; ++round) {
+    for (const ref<Expr> &term : terms) {
+      for (unsigned i = 0; i < assignments.size(); i += 7)
+        EXPECT_EQ(jit.evaluate(assignments[i], term),
+                  assignments[i].evaluate(term))
+            << term << " for assignment " << i;
+    }
+  }
+  EXPECT_GT(stats::exprJITEvictions.getValue(), evictions);
+}
+
+TEST_F(ExprJITTest, SatisfiesBatches) {
+  std::vector<const Assignment *> batch;
+  for (const Assignment &assignment : assignments)
+    batch.push_back(&assignment);
+  std::vector<ref<Expr>> constraints;
+  for (const ref<Expr> &term : getTerms())
+    if (term->getWidth() == Expr::Bool)
+      constraints.push_back(term);
+
+  // the constraints are interpreted for the batch in the first round and
+  // compiled in the second one
+  ExprJIT jit(2 * batch.size(), 0);
+  for (unsigned round = 0; round < 2; ++round) {
+    for (unsigned i = 0; i < constraints.size(); ++i) {
+      auto begin = constraints.begin(), end = begin + i + 1;
+      EXPECT_EQ(jit.satisfies(batch, begin, end),
+                BatchedEvaluator(batch).satisfies(begin, end))
+          << "constraints up to " << constraints[i];
+    }
+  }
+}
+
+// Compares the compiled constraints with the interpreter, run with
+// --gtest_also_run_disabled_tests.
+TEST_F(ExprJITTest, DISABLED_Throughput) {
+  std::vector<ref<Expr>> constraints;
+  for (const ref<Expr> &term : getTerms())
+    if (term->getWidth() == Expr::Bool)
+      constraints.push_back(OrExpr::create(
+          term, EqExpr::create(w, ConstantExpr::create(0, Expr::Int64))));
+  const unsigned rounds = 200;
+  ExprJIT jit(1, 0);
+
+  auto measure = [&](const char *name, bool compiled) {
+    unsigned satisfied = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned round = 0; round < rounds; ++round) {
+      for (const Assignment &assignment : assignments) {
+        for (const ref<Expr> &constraint : constraints)
+          satisfied += compiled ? jit.satisfies(assignment, &constraint,
+                                                &constraint + 1)
+                                : assignment.satisfies(&constraint,
+                                                       &constraint + 1);
+      }
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    llvm::outs() << name << ": "
+                 << uint64_t(rounds) * assignments.size() * constraints.size() *
+                        1000000 / (elapsed.count() + 1)
+                 << " constraint evaluations per second (" << satisfied
+                 << ")\n";
+  };
+  measure("interpreted", false);
+  measure("compiled", true);
+}
+
+} // namespace
@@ -11,7 +11,16 @@
 #include "gtest/gtest.h"
 
 #include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Assignment.h"
+#include "klee/Expr/Constraints.h"
 #include "klee/Expr/Expr.h"
+#include "klee/Expr/ExprStats.h"
+#include "klee/Module/KValue.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <chrono>
+#include <random>
 
 using namespace klee;
 
@@ -264,4 +273,372 @@ TEST(ExprTest, ReadExprFoldingSymbolicIndexUpdate) {
     EXPECT_EQ(Expr::Read, read.get()->getKind());
   }
 }
+
+TEST(ExprTest, HashConsing) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 256);
+  uint64_t hits = stats::exprHashConsHits.getValue();
+  unsigned hashConsed = Expr::hashConsedCount;
+
+  Expr::hashConsing = true;
+  {
+    ref<Expr> read = Expr::createTempRead(array, Expr::Int32);
+    ref<Expr> a = AddExpr::create(read, getConstant(7, Expr::Int32));
+    ref<Expr> b = AddExpr::create(Expr::createTempRead(array, Expr::Int32),
+                                  getConstant(7, Expr::Int32));
+    ref<Expr> c = AddExpr::create(read, getConstant(8, Expr::Int32));
+    // equal expressions are the same object, different ones are not
+    EXPECT_EQ(a.get(), b.get());
+    EXPECT_NE(a.get(), c.get());
+    EXPECT_EQ(a, b);
+    EXPECT_NE(a, c);
+    EXPECT_EQ(ExtractExpr::create(a, 0, Expr::Int8).get(),
+              ExtractExpr::create(b, 0, Expr::Int8).get());
+    EXPECT_NE(ExtractExpr::create(a, 0, Expr::Int8).get(),
+              ExtractExpr::create(a, 8, Expr::Int8).get());
+    EXPECT_GT(stats::exprHashConsHits.getValue(), hits);
+    EXPECT_GT(stats::exprHashConsBytesSaved.getValue(), 0u);
+  }
+  Expr::hashConsing = false;
+
+  // the table keeps only live expressions
+  EXPECT_EQ(Expr::hashConsedCount, hashConsed);
+  EXPECT_NE(AddExpr::create(Expr::createTempRead(array, Expr::Int32),
+                            getConstant(7, Expr::Int32)).get(),
+            AddExpr::create(Expr::createTempRead(array, Expr::Int32),
+                            getConstant(7, Expr::Int32)).get());
+}
+
+TEST(ExprTest, SmallConstantsAreShared) {
+  EXPECT_EQ(ConstantExpr::create(0, Expr::Int64).get(),
+            ConstantExpr::alloc(llvm::APInt(64, 0)).get());
+  EXPECT_EQ(ConstantExpr::create(255, Expr::Int32).get(),
+            SubExpr::create(getConstant(256, Expr::Int32),
+                            getConstant(1, Expr::Int32)).get());
+  EXPECT_EQ(getConstant(-16, Expr::Int16).get(),
+            getConstant(-16, Expr::Int16).get());
+  EXPECT_EQ(ConstantExpr::create(1, Expr::Bool).get(),
+            ConstantExpr::alloc(llvm::APInt(1, 1)).get());
+  // other constants, widths and the same value in other widths are not
+  EXPECT_NE(getConstant(256, Expr::Int32).get(),
+            getConstant(256, Expr::Int32).get());
+  EXPECT_NE(getConstant(-17, Expr::Int64).get(),
+            getConstant(-17, Expr::Int64).get());
+  EXPECT_NE(ConstantExpr::create(1, 24).get(),
+            ConstantExpr::create(1, 24).get());
+  EXPECT_NE(ref<Expr>(ConstantExpr::create(1, Expr::Int8)),
+            ref<Expr>(ConstantExpr::create(1, Expr::Int16)));
+  EXPECT_EQ(ConstantExpr::create(UINT64_MAX, Expr::Int64)->getZExtValue(),
+            UINT64_MAX);
+}
+
+TEST(ExprTest, PlainKValues) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 256);
+  KValue plain(Expr::createTempRead(array, Expr::Int32));
+  KValue pointer(ConstantExpr::create(FIRST_ORDINARY_SEGMENT, Expr::Int32),
+                 getConstant(4, Expr::Int32));
+  EXPECT_TRUE(plain.isPlain());
+  EXPECT_FALSE(pointer.isPlain());
+  EXPECT_EQ(plain.getSegment(), getConstant(0, Expr::Int32));
+
+  // a zero segment makes a plain value
+  EXPECT_TRUE(KValue(getConstant(0, Expr::Int32), plain.getValue()).isPlain());
+  EXPECT_TRUE(KValue(VALUES_SEGMENT, plain.getValue()).isPlain());
+
+  EXPECT_TRUE(plain.Add(plain).isPlain());
+  EXPECT_EQ(pointer.Add(plain).getSegment(), pointer.getSegment());
+  EXPECT_EQ(plain.And(pointer).getSegment(), pointer.getSegment());
+  EXPECT_TRUE(plain.Extract(0, Expr::Int8).ZExt(Expr::Int64).isPlain());
+  EXPECT_TRUE(KValue::concatValues(std::vector<KValue>{plain, plain}).isPlain());
+  EXPECT_FALSE(
+      KValue::concatValues(std::vector<KValue>{plain, pointer}).isPlain());
+
+  // comparisons of plain values compare only the values
+  EXPECT_EQ(plain.Eq(plain).getValue(), getConstant(1, Expr::Bool));
+  KValue zero(getConstant(0, Expr::Int32));
+  EXPECT_TRUE(zero.isZero());
+  EXPECT_TRUE(zero.isConstant());
+  EXPECT_EQ(pointer.Ne(zero).getValue(), getConstant(1, Expr::Bool));
+  EXPECT_EQ(pointer.Ult(zero).getValue(), getConstant(0, Expr::Bool));
+}
+
+TEST(ExprTest, SimplificationCache) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 256);
+  ref<Expr> x = Expr::createTempRead(array, Expr::Int32);
+  ref<Expr> y = ReadExpr::create(UpdateList(array, nullptr),
+                                 getConstant(8, Expr::Int32));
+  ref<Expr> e = AddExpr::create(x, ZExtExpr::create(y, Expr::Int32));
+
+  ConstraintSet constraints;
+  ConstraintManager manager(constraints);
+  manager.addConstraint(EqExpr::create(getConstant(5, Expr::Int32), x));
+  uint64_t hits = stats::simplificationCacheHits.getValue();
+  ref<Expr> simplified = ConstraintManager::simplifyExpr(constraints, e);
+  EXPECT_EQ(simplified,
+            AddExpr::create(getConstant(5, Expr::Int32),
+                            ZExtExpr::create(y, Expr::Int32)));
+  EXPECT_EQ(stats::simplificationCacheHits.getValue(), hits);
+  EXPECT_EQ(ConstraintManager::simplifyExpr(constraints, e), simplified);
+  EXPECT_EQ(stats::simplificationCacheHits.getValue(), hits + 1);
+
+  // a copy shares the cache until an equality is added to it
+  ConstraintSet copy(constraints);
+  EXPECT_EQ(ConstraintManager::simplifyExpr(copy, e), simplified);
+  EXPECT_EQ(stats::simplificationCacheHits.getValue(), hits + 2);
+  ref<Expr> other = AddExpr::create(
+      x, ZExtExpr::create(ReadExpr::create(UpdateList(array, nullptr),
+                                           getConstant(9, Expr::Int32)),
+                          Expr::Int32));
+  ref<Expr> otherSimplified = ConstraintManager::simplifyExpr(copy, other);
+  ConstraintManager(copy).addConstraint(
+      EqExpr::create(getConstant(3, Expr::Int8), y));
+  EXPECT_EQ(ConstraintManager::simplifyExpr(copy, e),
+            getConstant(8, Expr::Int32));
+  EXPECT_EQ(ConstraintManager::simplifyExpr(constraints, e), simplified);
+
+  // the equality drops only the expressions that read the byte it reads
+  hits = stats::simplificationCacheHits.getValue();
+  EXPECT_EQ(ConstraintManager::simplifyExpr(copy, other), otherSimplified);
+  EXPECT_EQ(stats::simplificationCacheHits.getValue(), hits + 1);
+}
+
+// Measures repeated simplification of the same expressions on a path with
+// a rebuilt constraint set, like every simplification did before the cache,
+// and with the cached one, run with --gtest_also_run_disabled_tests.
+TEST(ExprTest, DISABLED_SimplificationCacheThroughput) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 1024);
+  const unsigned length = 1000, exprs = 100, rounds = 20;
+  std::vector<ref<Expr>> path, queries;
+  for (unsigned i = 0; i < length; ++i) {
+    ref<Expr> read = ReadExpr::create(UpdateList(array, nullptr),
+                                      getConstant(i, Expr::Int32));
+    path.push_back(i % 4 ? UltExpr::create(read, getConstant(200, Expr::Int8))
+                         : EqExpr::create(getConstant(i % 256, Expr::Int8),
+                                          read));
+  }
+  for (unsigned i = 0; i < exprs; ++i) {
+    ref<Expr> e = getConstant(0, Expr::Int32);
+    for (unsigned j = 0; j < 8; ++j)
+      e = AddExpr::create(
+          e, ZExtExpr::create(ReadExpr::create(UpdateList(array, nullptr),
+                                               getConstant((i * 8 + j) % length,
+                                                           Expr::Int32)),
+                              Expr::Int32));
+    queries.push_back(e);
+  }
+
+  for (bool cached : {false, true}) {
+    ConstraintSet constraints(path);
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned round = 0; round < rounds; ++round) {
+      for (const ref<Expr> &e : queries) {
+        if (cached) {
+          ConstraintManager::simplifyExpr(constraints, e);
+        } else {
+          ConstraintSet rebuilt(path);
+          ConstraintManager::simplifyExpr(rebuilt, e);
+        }
+      }
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start);
+    llvm::outs() << (cached ? "cached" : "rebuilt") << " (path length "
+                 << length << "): " << elapsed.count() / (rounds * exprs)
+                 << " ns per simplification\n";
+  }
+}
+TEST(ExprTest, BoundsDecideComparisons) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 4);
+  ref<Expr> x = Expr::createTempRead(array, Expr::Int32);
+  ref<Expr> byte = ReadExpr::create(UpdateList(array, nullptr),
+                                    getConstant(1, Expr::Int32));
+
+  // (x & 0xF0) == 3
+  ref<Expr> masked = AndExpr::create(x, getConstant(0xF0, Expr::Int32));
+  EXPECT_EQ(masked->getBounds().max, 0xF0u);
+  ref<Expr> e = EqExpr::create(getConstant(3, Expr::Int32), masked);
+  ASSERT_FALSE(isa<ConstantExpr>(e));
+  EXPECT_TRUE(e->getBounds().isConstant());
+  EXPECT_EQ(e->getBounds().min, 0u);
+
+  // a zero extended byte is below the size of an object of 1024 bytes
+  ref<Expr> offset = ZExtExpr::create(byte, Expr::Int64);
+  e = UltExpr::create(offset, getConstant(1024, Expr::Int64));
+  ASSERT_FALSE(isa<ConstantExpr>(e));
+  EXPECT_TRUE(e->getBounds().isConstant());
+  EXPECT_EQ(e->getBounds().min, 1u);
+
+  // the byte may still be 255
+  e = UltExpr::create(offset, getConstant(255, Expr::Int64));
+  EXPECT_FALSE(e->getBounds().isConstant());
+
+  // reads of a constant table are bounded by the values read
+  std::vector<ref<ConstantExpr>> values;
+  for (unsigned value : {1, 4, 7, 10, 200})
+    values.push_back(ConstantExpr::create(value, Expr::Int8));
+  const Array *table =
+      ac.CreateArray("table", values.size(), &values.front(),
+                     &values.back() + 1);
+  ref<Expr> index =
+      ZExtExpr::create(ExtractExpr::create(x, 0, 2), Expr::Int32);
+  ref<Expr> read = ReadExpr::create(UpdateList(table, nullptr), index);
+  EXPECT_EQ(read->getBounds().min, 1u);
+  EXPECT_EQ(read->getBounds().max, 10u);
+  EXPECT_EQ(read->getBounds().knownZero, 0xF0u);
+}
+
+/// Random expressions of the given width over the bytes of `array`
+class RandomExprs {
+  std::mt19937 &rng;
+  const Array *array, *table;
+
+  ref<Expr> leaf(Expr::Width width) {
+    ref<Expr> byte = ReadExpr::create(UpdateList(array, nullptr),
+                                      getConstant(rng() % 4, Expr::Int32));
+    switch (rng() % 4) {
+    case 0:
+      return ConstantExpr::create(rng() % 3 ? rng() % 300 : rng(), width)
+          ->ZExt(width);
+    case 1: {
+      ref<Expr> index = ZExtExpr::create(
+          ExtractExpr::create(byte, 0, Expr::Int8 / 2), Expr::Int32);
+      return ZExtExpr::create(ReadExpr::create(UpdateList(table, nullptr),
+                                               index),
+                              width);
+    }
+    case 2:
+      return ZExtExpr::create(byte, width);
+    default:
+      return Expr::createTempRead(array, width);
+    }
+  }
+
+public:
+  RandomExprs(std::mt19937 &rng, const Array *array, const Array *table)
+      : rng(rng), array(array), table(table) {}
+
+  ref<Expr> get(Expr::Width width, unsigned depth) {
+    if (width == Expr::Bool) {
+      Expr::Width kidWidth = rng() % 2 ? Expr::Int8 : Expr::Int32;
+      ref<Expr> a = get(kidWidth, depth ? depth - 1 : 0);
+      ref<Expr> b = get(kidWidth, depth ? depth - 1 : 0);
+      switch (rng() % 6) {
+      case 0:
+        return EqExpr::create(a, b);
+      case 1:
+        return UltExpr::create(a, b);
+      case 2:
+        return UleExpr::create(a, b);
+      case 3:
+        return SltExpr::create(a, b);
+      case 4:
+        return SleExpr::create(a, b);
+      default:
+        return NeExpr::create(a, b);
+      }
+    }
+    if (!depth)
+      return leaf(width);
+
+    ref<Expr> a = get(width, depth - 1), b = get(width, depth - 1);
+    // the evaluator folds divisions whose divisor is a constant zero
+    if (b->isZero())
+      b = ConstantExpr::create(1, width);
+    switch (rng() % 18) {
+    case 0:
+      return AddExpr::create(a, b);
+    case 1:
+      return SubExpr::create(a, b);
+    case 2:
+      return MulExpr::create(a, b);
+    case 3:
+      return UDivExpr::create(a, b);
+    case 4:
+      return URemExpr::create(a, b);
+    case 5:
+      return AndExpr::create(a, b);
+    case 6:
+      return OrExpr::create(a, b);
+    case 7:
+      return XorExpr::create(a, b);
+    case 8:
+      return ShlExpr::create(a, ConstantExpr::create(rng() % width, width));
+    case 9:
+      return LShrExpr::create(a, b);
+    case 10:
+      return AShrExpr::create(a, ConstantExpr::create(rng() % width, width));
+    case 11:
+      return SelectExpr::create(get(Expr::Bool, depth - 1), a, b);
+    case 12:
+      return NotExpr::create(a);
+    case 13:
+      return width > Expr::Int8
+                 ? SExtExpr::create(get(Expr::Int8, depth - 1), width)
+                 : a;
+    case 14:
+      return width < Expr::Int32
+                 ? ExtractExpr::create(get(Expr::Int32, depth - 1),
+                                       rng() % (Expr::Int32 - width + 1), width)
+                 : a;
+    case 15:
+      return width == Expr::Int32
+                 ? ConcatExpr::create(get(Expr::Int8, depth - 1),
+                                      ExtractExpr::create(a, 0, 24))
+                 : a;
+    case 16:
+      return LShrExpr::create(a, ConstantExpr::create(rng() % width, width));
+    default:
+      return AndExpr::create(a, ConstantExpr::create(rng() % 256, width));
+    }
+  }
+};
+
+TEST(ExprTest, BoundsAreSound) {
+  ArrayCache ac;
+  const Array *array = ac.CreateArray("arr", 4);
+  std::vector<ref<ConstantExpr>> values;
+  for (unsigned value : {3, 5, 9, 17, 33, 65, 129, 2, 4, 8, 16, 32, 64, 128,
+                         0, 1})
+    values.push_back(ConstantExpr::create(value, Expr::Int8));
+  const Array *table = ac.CreateArray("table", values.size(), &values.front(),
+                                      &values.back() + 1);
+  std::mt19937 rng(7);
+  RandomExprs exprs(rng, array, table);
+
+  std::vector<Assignment> assignments;
+  for (unsigned i = 0; i < 32; ++i) {
+    std::vector<unsigned char> bytes(4);
+    for (auto &byte : bytes)
+      byte = rng() % 3 ? rng() : (rng() % 2 ? 0 : 0xff);
+    Assignment assignment;
+    assignment.addBinding(array, bytes);
+    assignments.push_back(assignment);
+  }
+
+  unsigned decided = 0;
+  for (unsigned i = 0; i < 2000; ++i) {
+    Expr::Width width = std::vector<Expr::Width>{
+        Expr::Bool, Expr::Int8, Expr::Int16, Expr::Int32}[rng() % 4];
+    ref<Expr> e = exprs.get(width, 1 + rng() % 3);
+    const ExprBounds &bounds = e->getBounds();
+    decided += width == Expr::Bool && bounds.isConstant() &&
+               !isa<ConstantExpr>(e);
+    for (const Assignment &assignment : assignments) {
+      ref<Expr> value = assignment.evaluate(e);
+      // divisions by zero
+      if (!isa<ConstantExpr>(value))
+        continue;
+      uint64_t v = cast<ConstantExpr>(value)->getZExtValue();
+      ASSERT_LE(bounds.min, v) << e;
+      ASSERT_GE(bounds.max, v) << e;
+      ASSERT_EQ(v & bounds.knownZero, 0u) << e;
+      ASSERT_EQ(v & bounds.knownOne, bounds.knownOne) << e;
+    }
+  }
+  EXPECT_GT(decided, 0u);
+}
 }
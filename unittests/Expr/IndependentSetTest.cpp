@@ -0,0 +1,114 @@
+//===-- IndependentSetTest.cpp --------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Expr/Expr.h"
+#include "klee/Expr/IndependentSet.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <chrono>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+ref<Expr> readByte(const Array *array, unsigned index) {
+  return ReadExpr::create(UpdateList(array, nullptr),
+                          ConstantExpr::create(index, Expr::Int32));
+}
+
+ref<Expr> lessThan(const ref<Expr> &e, unsigned bound) {
+  return UltExpr::create(e, ConstantExpr::create(bound, e->getWidth()));
+}
+
+TEST(IndependentSetTest, FactorsAreMergedByConstraints) {
+  ArrayCache cache;
+  const Array *a = cache.CreateArray("a", 4);
+  const Array *b = cache.CreateArray("b", 4);
+
+  ConstraintSet constraints;
+  constraints.push_back(lessThan(readByte(a, 0), 10));
+  constraints.push_back(lessThan(readByte(a, 1), 10));
+  constraints.push_back(lessThan(readByte(b, 0), 10));
+  EXPECT_EQ(constraints.getIndependentFactors().getFactors().size(), 3u);
+
+  // a copy shares the factors of the common constraints
+  ConstraintSet copy(constraints);
+  EXPECT_EQ(&copy.getIndependentFactors(), &constraints.getIndependentFactors());
+
+  // a symbolic read of `a` joins both of its factors
+  ref<Expr> index = ZExtExpr::create(readByte(a, 3), Expr::Int32);
+  constraints.push_back(
+      lessThan(ReadExpr::create(UpdateList(a, nullptr), index), 3));
+  const IndependentFactors &factors = constraints.getIndependentFactors();
+  EXPECT_EQ(factors.getConstraintCount(), 4u);
+  EXPECT_EQ(factors.getFactors().size(), 2u);
+  EXPECT_EQ(copy.getIndependentFactors().getFactors().size(), 3u);
+
+  std::vector<ref<Expr>> required;
+  factors.getIndependentConstraints(lessThan(readByte(a, 2), 5), required);
+  EXPECT_EQ(required.size(), 3u);
+  required.clear();
+  factors.getIndependentConstraints(lessThan(readByte(b, 1), 5), required);
+  EXPECT_TRUE(required.empty());
+  copy.getIndependentFactors().getIndependentConstraints(
+      lessThan(readByte(a, 1), 5), required);
+  ASSERT_EQ(required.size(), 1u);
+  EXPECT_EQ(required[0], lessThan(readByte(a, 1), 10));
+}
+
+// Measures slicing the constraints of a growing path for a query after
+// every constraint with the factors built from scratch, like every query
+// did before the factors were kept with the constraints, and with the
+// extended ones, run with --gtest_also_run_disabled_tests.
+TEST(IndependentSetTest, DISABLED_SlicingByPathLength) {
+  ArrayCache cache;
+  const unsigned inputs = 64;
+  std::vector<const Array *> arrays;
+  for (unsigned i = 0; i < inputs; ++i)
+    arrays.push_back(cache.CreateArray("in" + std::to_string(i), 16));
+
+  for (unsigned length : {1000u, 4000u}) {
+    for (bool extended : {false, true}) {
+      ConstraintSet constraints;
+      std::vector<ref<Expr>> path;
+      auto start = std::chrono::steady_clock::now();
+      for (unsigned i = 0; i < length; ++i) {
+        const Array *array = arrays[i % inputs];
+        ref<Expr> sum = AddExpr::create(readByte(array, i % 16),
+                                        readByte(array, (i + 1) % 16));
+        path.push_back(lessThan(sum, 200 + i % 50));
+        constraints.push_back(path.back());
+
+        std::vector<ref<Expr>> required;
+        ref<Expr> query = lessThan(readByte(array, (i + 2) % 16), 100);
+        if (extended) {
+          constraints.getIndependentFactors().getIndependentConstraints(
+              query, required);
+        } else {
+          ConstraintSet rebuilt(path);
+          rebuilt.getIndependentFactors().getIndependentConstraints(query,
+                                                                    required);
+        }
+      }
+      auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start);
+      llvm::outs() << (extended ? "extended" : "rebuilt")
+                   << " factors (path length " << length
+                   << "): " << elapsed.count() / length << " us per query\n";
+    }
+  }
+}
+
+} // namespace
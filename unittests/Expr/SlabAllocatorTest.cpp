@@ -0,0 +1,161 @@
+//===-- SlabAllocatorTest.cpp ---------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/ADT/SlabAllocator.h"
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Expr.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <chrono>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+#ifndef KLEE_SLAB_ALLOCATOR_DISABLED
+TEST(SlabAllocatorTest, ReusesFreedObjects) {
+  SlabAllocator allocator;
+  void *a = allocator.allocate(40);
+  void *b = allocator.allocate(36);
+  void *c = allocator.allocate(24);
+  EXPECT_EQ(allocator.getUsedSize(), 104u);
+  EXPECT_EQ(allocator.getReservedSize(),
+            SlabAllocator::SlabSize - SlabAllocator::Granularity);
+
+  // objects of the same size class are reused
+  allocator.deallocate(a, 40);
+  allocator.deallocate(c, 24);
+  EXPECT_EQ(allocator.getUsedSize(), 40u);
+  EXPECT_EQ(allocator.allocate(33), a);
+  EXPECT_EQ(allocator.allocate(24), c);
+  EXPECT_NE(allocator.allocate(40), b);
+
+  // large objects do not take space of the slabs
+  void *large = allocator.allocate(SlabAllocator::MaxSize + 1);
+  EXPECT_EQ(allocator.getUsedSize(), 144u);
+  allocator.deallocate(large, SlabAllocator::MaxSize + 1);
+
+  allocator.release();
+  EXPECT_EQ(allocator.getReservedSize(), 0u);
+}
+
+TEST(SlabAllocatorTest, FillsSlabs) {
+  SlabAllocator allocator;
+  std::vector<void *> objects;
+  const std::size_t perSlab =
+      (SlabAllocator::SlabSize - SlabAllocator::Granularity) / 48;
+  for (std::size_t i = 0; i < 3 * perSlab; ++i) {
+    void *p = allocator.allocate(48);
+    *static_cast<std::size_t *>(p) = i;
+    objects.push_back(p);
+  }
+  EXPECT_EQ(allocator.getReservedSize(),
+            3 * (SlabAllocator::SlabSize - SlabAllocator::Granularity));
+  for (std::size_t i = 0; i < objects.size(); ++i)
+    EXPECT_EQ(*static_cast<std::size_t *>(objects[i]), i);
+
+  // the rest of a full slab is used for smaller objects
+  allocator.allocate(SlabAllocator::SlabSize % 48 - SlabAllocator::Granularity);
+  EXPECT_EQ(allocator.getReservedSize(),
+            3 * (SlabAllocator::SlabSize - SlabAllocator::Granularity));
+
+  for (void *p : objects)
+    allocator.deallocate(p, 48);
+  allocator.release();
+}
+
+TEST(SlabAllocatorTest, ExprsAreAccounted) {
+  ArrayCache cache;
+  const Array *array = cache.CreateArray("arr", 256);
+  // the small constants used below live until exit
+  Expr::createTempRead(array, Expr::Int32);
+  std::size_t used = exprAllocator.getUsedSize();
+  {
+    ref<Expr> read = Expr::createTempRead(array, Expr::Int8);
+    UpdateList updates(array, nullptr);
+    updates.extend(Expr::createTempRead(array, Expr::Int32), read);
+    EXPECT_GT(exprAllocator.getUsedSize(), used);
+  }
+  EXPECT_EQ(exprAllocator.getUsedSize(), used);
+}
+#endif
+
+// The sizes of the most common nodes: binary, constant, read and select
+// expressions and update nodes
+const std::size_t sizes[] = {sizeof(AddExpr), sizeof(ConstantExpr),
+                             sizeof(ReadExpr), sizeof(SelectExpr),
+                             sizeof(UpdateNode)};
+
+struct GlobalNew {
+  void *allocate(std::size_t size) { return ::operator new(size); }
+  void deallocate(void *p, std::size_t) { ::operator delete(p); }
+};
+
+template <typename Allocator>
+void benchmarkAllocator(const char *name, Allocator &allocator,
+                        unsigned rounds) {
+  const unsigned count = 100000;
+  std::vector<void *> objects(count);
+
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned round = 0; round < rounds; ++round) {
+    for (unsigned i = 0; i < count; ++i)
+      objects[i] = allocator.allocate(sizes[i % 5]);
+    // free every other object first to scatter the free lists
+    for (unsigned i = 0; i < count; i += 2)
+      allocator.deallocate(objects[i], sizes[i % 5]);
+    for (unsigned i = 0; i < count; i += 2)
+      objects[i] = allocator.allocate(sizes[i % 5]);
+    for (unsigned i = 0; i < count; ++i)
+      allocator.deallocate(objects[i], sizes[i % 5]);
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start);
+  llvm::outs() << name << ": "
+               << elapsed.count() / (uint64_t(rounds) * count * 3 / 2)
+               << " ns per allocation and free\n";
+}
+
+// Compares the slab allocator with the global operator new used before,
+// and measures the throughput of creating and destroying expressions, run
+// with --gtest_also_run_disabled_tests.
+TEST(SlabAllocatorTest, DISABLED_CreateDestroyThroughput) {
+  GlobalNew globalNew;
+  SlabAllocator slabAllocator;
+  benchmarkAllocator("global new", globalNew, 100);
+  benchmarkAllocator("slab allocator", slabAllocator, 100);
+  slabAllocator.release();
+
+  ArrayCache cache;
+  const Array *array = cache.CreateArray("arr", 256);
+  const unsigned rounds = 100, count = 10000;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned round = 0; round < rounds; ++round) {
+    UpdateList initial(array, nullptr), updates(array, nullptr);
+    ref<Expr> previous = ConstantExpr::create(0, Expr::Int8);
+    for (unsigned i = 0; i < count; ++i) {
+      ref<Expr> index = ConstantExpr::create(i, Expr::Int32);
+      ref<Expr> read = ReadExpr::create(initial, index);
+      updates.extend(index, AddExpr::create(read, previous));
+      previous = read;
+    }
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start);
+  // a constant, a read, an addition and an update node per iteration
+  llvm::outs() << "expressions: "
+               << elapsed.count() / (uint64_t(rounds) * count * 4)
+               << " ns per node created and destroyed\n";
+}
+
+} // namespace
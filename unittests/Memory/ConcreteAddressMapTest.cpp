@@ -0,0 +1,139 @@
+//===-- ConcreteAddressMapTest.cpp ------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "Core/ConcreteAddressMap.h"
+#include "Core/Context.h"
+#include "Core/Memory.h"
+
+#include "klee/Expr/ArrayCache.h"
+
+#include <random>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+class ConcreteAddressMapTest : public ::testing::Test {
+protected:
+  std::vector<ref<MemoryObject>> objects;
+
+  const MemoryObject *create(uint64_t segment, ref<Expr> size) {
+    objects.emplace_back(
+        new MemoryObject(segment, size, 0, false, true, false, nullptr,
+                         nullptr));
+    return objects.back().get();
+  }
+
+  const MemoryObject *create(uint64_t segment, uint64_t size) {
+    return create(segment, ConstantExpr::create(size, Expr::Int64));
+  }
+
+  std::vector<uint64_t> segmentsAt(const ConcreteAddressMap &map,
+                                   uint64_t address) {
+    std::vector<ConcreteAddressMap::Entry> entries;
+    map.findObjects(address, entries);
+    std::vector<uint64_t> segments;
+    for (const auto &entry : entries)
+      segments.push_back(entry.segment);
+    return segments;
+  }
+};
+
+TEST_F(ConcreteAddressMapTest, FindAddress) {
+  ConcreteAddressMap map;
+  EXPECT_TRUE(map.emplace(0x1000, create(1, 16)));
+  EXPECT_TRUE(map.emplace(0x2000, create(2, 16)));
+  // the first object at an address wins
+  EXPECT_FALSE(map.emplace(0x2000, create(3, 16)));
+  EXPECT_EQ(map.size(), 2u);
+
+  uint64_t address = 0;
+  EXPECT_TRUE(map.findAddress(2, address));
+  EXPECT_EQ(address, 0x2000u);
+  EXPECT_FALSE(map.findAddress(3, address));
+}
+
+TEST_F(ConcreteAddressMapTest, FindObjects) {
+  ConcreteAddressMap map;
+  map.emplace(0x1000, create(1, 16));
+  map.emplace(0x1010, create(2, 0));
+  map.emplace(0x2000, create(3, 0x100));
+
+  EXPECT_TRUE(segmentsAt(map, 0xfff).empty());
+  EXPECT_EQ(segmentsAt(map, 0x1000), std::vector<uint64_t>{1});
+  EXPECT_EQ(segmentsAt(map, 0x100f), std::vector<uint64_t>{1});
+  // zero-sized objects own their address only
+  EXPECT_EQ(segmentsAt(map, 0x1010), std::vector<uint64_t>{2});
+  EXPECT_TRUE(segmentsAt(map, 0x1011).empty());
+  EXPECT_EQ(segmentsAt(map, 0x20ff), std::vector<uint64_t>{3});
+  EXPECT_TRUE(segmentsAt(map, 0x2100).empty());
+
+  // insertions after a lookup are visible
+  map.emplace(0x2100, create(4, 8));
+  EXPECT_EQ(segmentsAt(map, 0x2100), std::vector<uint64_t>{4});
+}
+
+TEST_F(ConcreteAddressMapTest, Overlapping) {
+  ConcreteAddressMap map;
+  map.emplace(0x1000, create(1, 0x1000));
+  map.emplace(0x1100, create(2, 0x10));
+  map.emplace(0x1200, create(3, 0x10));
+  map.emplace(0x3000, create(4, 0x10));
+
+  EXPECT_EQ(segmentsAt(map, 0x1105), (std::vector<uint64_t>{1, 2}));
+  EXPECT_EQ(segmentsAt(map, 0x1150), std::vector<uint64_t>{1});
+  EXPECT_EQ(segmentsAt(map, 0x1200), (std::vector<uint64_t>{1, 3}));
+  EXPECT_EQ(segmentsAt(map, 0x3000), std::vector<uint64_t>{4});
+}
+
+TEST_F(ConcreteAddressMapTest, SymbolicSize) {
+  ArrayCache cache;
+  const Array *array = cache.CreateArray("size", Expr::Int64);
+  ConcreteAddressMap map;
+  map.emplace(0x1000, create(1, Expr::createTempRead(array, Expr::Int64)));
+  map.emplace(0x2000, create(2, 16));
+
+  EXPECT_TRUE(segmentsAt(map, 0xfff).empty());
+  EXPECT_EQ(segmentsAt(map, 0x1500), std::vector<uint64_t>{1});
+  EXPECT_EQ(segmentsAt(map, 0x2000), (std::vector<uint64_t>{1, 2}));
+}
+
+TEST_F(ConcreteAddressMapTest, InterleavedWithLookups) {
+  ConcreteAddressMap map;
+  std::vector<std::pair<uint64_t, uint64_t>> extents;
+  // an early large object spanning the addresses of all later ones
+  map.emplace(0, create(0, 0x100000));
+  extents.emplace_back(0, 0x100000);
+
+  std::mt19937 rng(0);
+  for (uint64_t segment = 1; segment != 2000; ++segment) {
+    uint64_t address = rng() % 0x100000, size = rng() % 0x100;
+    if (map.emplace(address, create(segment, size)))
+      extents.emplace_back(address, address + std::max<uint64_t>(size, 1));
+
+    uint64_t lookup = rng() % 0x100000;
+    std::vector<std::pair<uint64_t, uint64_t>> expected;
+    for (const auto &extent : extents)
+      if (extent.first <= lookup && lookup < extent.second)
+        expected.push_back(extent);
+    std::sort(expected.begin(), expected.end());
+
+    std::vector<ConcreteAddressMap::Entry> entries;
+    map.findObjects(lookup, entries);
+    std::vector<std::pair<uint64_t, uint64_t>> found;
+    for (const auto &entry : entries)
+      found.emplace_back(entry.address, entry.end);
+    ASSERT_EQ(found, expected);
+  }
+}
+
+} // namespace
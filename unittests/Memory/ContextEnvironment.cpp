@@ -0,0 +1,28 @@
+//===-- ContextEnvironment.cpp ----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "Core/Context.h"
+
+using namespace klee;
+
+namespace {
+
+// The context may be initialized only once, so it is shared by all the
+// test suites of this binary.
+class ContextEnvironment : public ::testing::Environment {
+public:
+  void SetUp() override { Context::initialize(true, Expr::Int64); }
+};
+
+const ::testing::Environment *const environment =
+    ::testing::AddGlobalTestEnvironment(new ContextEnvironment);
+
+} // namespace
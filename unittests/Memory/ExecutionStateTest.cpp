@@ -0,0 +1,221 @@
+//===-- ExecutionStateTest.cpp ----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+#define KLEE_UNITTEST
+
+#include "gtest/gtest.h"
+
+#include "Core/ExecutionState.h"
+#include "Core/Memory.h"
+
+#include "klee/ADT/PersistentVector.h"
+#include "klee/Expr/ArrayCache.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+ref<Expr> constraint(const Array *array, unsigned i) {
+  return UltExpr::create(Expr::createTempRead(array, Expr::Int32),
+                         ConstantExpr::create(i + 1, Expr::Int32));
+}
+
+TEST(ExecutionStateTest, PersistentVectorCopiesAreIndependent) {
+  PersistentVector<ref<Expr>> original;
+  for (unsigned i = 0; i < 1000; ++i)
+    original.push_back(ConstantExpr::create(i, Expr::Int32));
+
+  PersistentVector<ref<Expr>> copy(original);
+  EXPECT_EQ(copy, original);
+  copy.push_back(ConstantExpr::create(1000, Expr::Int32));
+  original.push_back(ConstantExpr::create(2000, Expr::Int32));
+  EXPECT_NE(copy, original);
+
+  ASSERT_EQ(original.size(), 1001u);
+  ASSERT_EQ(copy.size(), 1001u);
+  unsigned i = 0;
+  for (const ref<Expr> &e : original) {
+    EXPECT_EQ(e, ConstantExpr::create(i == 1000 ? 2000 : i, Expr::Int32));
+    ++i;
+  }
+  EXPECT_EQ(i, 1001u);
+  EXPECT_EQ(copy.back(), ConstantExpr::create(1000, Expr::Int32));
+  EXPECT_EQ(copy[999], original[999]);
+
+  copy.clear();
+  EXPECT_TRUE(copy.empty());
+  EXPECT_EQ(copy.begin(), copy.end());
+  EXPECT_EQ(original.size(), 1001u);
+}
+
+TEST(ExecutionStateTest, CowSharedPtrOriginalDoesNotWriteCopy) {
+  cow_shared_ptr<std::vector<int>> original;
+  EXPECT_TRUE(original->empty());
+  original.getWriteable()->push_back(1);
+
+  cow_shared_ptr<std::vector<int>> copy(original);
+  EXPECT_EQ(copy.get(), original.get());
+  original.getWriteable()->push_back(2);
+  copy.getWriteable()->push_back(3);
+
+  EXPECT_EQ(*original, (std::vector<int>{1, 2}));
+  EXPECT_EQ(*copy, (std::vector<int>{1, 3}));
+}
+
+TEST(ExecutionStateTest, BranchSharesUntilWritten) {
+  ArrayCache cache;
+  const Array *array = cache.CreateArray("x", 4);
+  const std::string file = "test.c";
+
+  ExecutionState state;
+  for (unsigned i = 0; i < 100; ++i)
+    state.constraints.push_back(constraint(array, i));
+  state.arrayNames = state.arrayNames.insert("x");
+  state.addNondetValue(KValue(Expr::createTempRead(array, Expr::Int32)), false,
+                       nullptr, "x");
+  (*state.coveredLines.getWriteable())[&file].insert(1);
+
+  std::unique_ptr<ExecutionState> branched(state.branch());
+  // the nondet values are not copied
+  EXPECT_EQ(&branched->nondetValues[0], &state.nondetValues[0]);
+  EXPECT_EQ(branched->constraints, state.constraints);
+  // the lines covered before the branch stay with the original state
+  EXPECT_TRUE(branched->coveredLines->empty());
+  EXPECT_EQ(state.coveredLines->size(), 1u);
+
+  branched->constraints.push_back(constraint(array, 100));
+  branched->arrayNames = branched->arrayNames.insert("y");
+  branched->addNondetValue(KValue(Expr::createTempRead(array, Expr::Int32)),
+                           false, nullptr, "y");
+  state.constraints.push_back(constraint(array, 200));
+
+  EXPECT_EQ(state.arrayNames.size(), 1u);
+  EXPECT_EQ(branched->arrayNames.size(), 2u);
+  EXPECT_EQ(state.nondetValues.size(), 1u);
+  ASSERT_EQ(branched->nondetValues.size(), 2u);
+  EXPECT_EQ(branched->nondetValues[1].name, "y");
+  ASSERT_EQ(state.constraints.size(), 101u);
+  ASSERT_EQ(branched->constraints.size(), 101u);
+  auto it = state.constraints.begin();
+  auto bit = branched->constraints.begin();
+  for (unsigned i = 0; i < 100; ++i, ++it, ++bit)
+    EXPECT_EQ(*it, *bit);
+  EXPECT_EQ(*it, constraint(array, 200));
+  EXPECT_EQ(*bit, constraint(array, 100));
+}
+
+// The members of ExecutionState that grow with the length of a path as
+// they were stored before they were shared between states, kept as the
+// baseline of the benchmark below.
+struct FlatState {
+  std::vector<ref<Expr>> constraints;
+  std::vector<std::pair<ref<const MemoryObject>, const Array *>> symbolics;
+  std::vector<ExecutionState::NondetValue> nondetValues;
+  std::set<std::string> arrayNames;
+  std::map<const std::string *, std::set<std::uint32_t>> coveredLines;
+
+  FlatState *branch() const {
+    auto *falseState = new FlatState(*this);
+    falseState->coveredLines.clear();
+    return falseState;
+  }
+  void addConstraint(const ref<Expr> &e) { constraints.push_back(e); }
+  void addNondetValue(const ref<Expr> &e, const std::string &name) {
+    arrayNames.insert(name);
+    nondetValues.emplace_back(e, false, name);
+  }
+};
+
+struct SharedState {
+  std::unique_ptr<ExecutionState> state{new ExecutionState()};
+
+  SharedState *branch() const {
+    auto *falseState = new SharedState();
+    falseState->state.reset(state->branch());
+    return falseState;
+  }
+  void addConstraint(const ref<Expr> &e) { state->constraints.push_back(e); }
+  void addNondetValue(const ref<Expr> &e, const std::string &name) {
+    state->arrayNames = state->arrayNames.insert(name);
+    state->addNondetValue(KValue(e), false, nullptr, name);
+  }
+};
+
+// Build a state with a path of the given length, then fork it and extend
+// both states by a branch condition, like Executor::fork does, and by a
+// nondet value, like a call to a nondet function after the branch.
+template <typename State, typename Build>
+void benchmark(const char *name, unsigned length, unsigned forks,
+               Build build) {
+  ArrayCache cache;
+  const Array *array = cache.CreateArray("x", 4);
+  State state;
+  build(state, cache, length);
+
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned i = 0; i < forks; ++i) {
+    std::unique_ptr<State> falseState(state.branch());
+    falseState->addConstraint(constraint(array, length + i));
+    state.addConstraint(constraint(array, length + forks + i));
+    std::string name = "n" + std::to_string(i);
+    falseState->addNondetValue(constraint(array, i), name);
+    state.addNondetValue(constraint(array, i), name);
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start);
+  llvm::outs() << name << " (path length " << length
+               << "): " << elapsed.count() / forks << " us per fork\n";
+}
+
+// Compares the cost of a fork with the deep copies of the state used before
+// and with the shared members, run with --gtest_also_run_disabled_tests.
+TEST(ExecutionStateTest, DISABLED_ForkCostByPathLength) {
+  static const std::string file = "test.c";
+  for (unsigned length : {100u, 1000u, 10000u, 100000u}) {
+    benchmark<FlatState>(
+        "deep copies", length, 1000,
+        [](FlatState &s, ArrayCache &cache, unsigned length) {
+          const Array *array = cache.CreateArray("x", 4);
+          for (unsigned i = 0; i < length; ++i) {
+            s.constraints.push_back(constraint(array, i));
+            s.coveredLines[&file].insert(i);
+            if (i % 16 == 0) {
+              std::string name = "x" + std::to_string(i);
+              s.addNondetValue(constraint(array, i), name);
+              s.symbolics.emplace_back(nullptr, cache.CreateArray(name, 4));
+            }
+          }
+        });
+    benchmark<SharedState>(
+        "shared members", length, 1000,
+        [](SharedState &s, ArrayCache &cache, unsigned length) {
+          ExecutionState &state = *s.state;
+          const Array *array = cache.CreateArray("x", 4);
+          for (unsigned i = 0; i < length; ++i) {
+            state.constraints.push_back(constraint(array, i));
+            (*state.coveredLines.getWriteable())[&file].insert(i);
+            if (i % 16 == 0) {
+              std::string name = "x" + std::to_string(i);
+              s.addNondetValue(constraint(array, i), name);
+              state.addSymbolic(nullptr, cache.CreateArray(name, 4));
+            }
+          }
+        });
+  }
+}
+
+} // namespace
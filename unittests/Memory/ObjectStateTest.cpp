@@ -0,0 +1,321 @@
+//===-- ObjectStateTest.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+#define KLEE_UNITTEST
+
+#include "gtest/gtest.h"
+
+#include "Core/ExecutionState.h"
+#include "Core/Memory.h"
+#include "Core/MemoryManager.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Constraints.h"
+#include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverCmdLine.h"
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+class ObjectStateTest : public ::testing::Test {
+protected:
+  static ArrayCache *cache;
+  static MemoryManager *memory;
+
+  std::vector<ref<MemoryObject>> objects;
+
+  static void SetUpTestSuite() {
+    cache = new ArrayCache();
+    memory = new MemoryManager(cache);
+  }
+
+  static void TearDownTestSuite() {
+    setRebaseLimit(0);
+    delete memory;
+    delete cache;
+  }
+
+  static void setRebaseLimit(unsigned limit) {
+    std::string option = "--rebase-update-lists=" + std::to_string(limit);
+    const char *argv[] = {"MemoryTest", option.c_str()};
+    llvm::cl::ResetAllOptionOccurrences();
+    llvm::cl::ParseCommandLineOptions(2, argv);
+  }
+
+  ref<ObjectState> create(uint64_t size) {
+    objects.emplace_back(new MemoryObject(
+        objects.size() + 1, ConstantExpr::create(size, Expr::Int64), size,
+        false, true, false, nullptr, memory));
+    ref<ObjectState> os = new ObjectState(objects.back().get());
+    os->initializeToZero();
+    return os;
+  }
+
+  ref<Expr> symbolicValue(const std::string &name, Expr::Width width) {
+    const Array *array = cache->CreateArray(name, width / 8);
+    return Expr::createTempRead(array, width);
+  }
+
+  // write integers, a symbolic value and pointers to an object
+  ref<ObjectState> writeSequence() {
+    auto os = create(32);
+    ref<Expr> x = symbolicValue("x", Expr::Int64);
+    os->write64(0, 0, 0x1122334455667788ULL);
+    os->write(8, KValue(ConstantExpr::create(0, Expr::Int64), x));
+    // the first pointer creates the segment plane
+    os->write(16, KValue(ConstantExpr::create(7, Expr::Int64),
+                         ConstantExpr::create(4, Expr::Int64)));
+    os->write32(24, 3, 0xdeadbeef);
+    os->write(28, KValue(ExtractExpr::create(x, 0, Expr::Int32),
+                         ConstantExpr::create(1, Expr::Int32)));
+    os->write8(3, 0, 0xff);
+    return os;
+  }
+};
+
+ArrayCache *ObjectStateTest::cache = nullptr;
+MemoryManager *ObjectStateTest::memory = nullptr;
+
+TEST_F(ObjectStateTest, SegmentsAndOffsets) {
+  auto os = writeSequence();
+  EXPECT_EQ(os->getSizeBound(), 32u);
+
+  KValue integer = os->read(0, Expr::Int64);
+  EXPECT_TRUE(integer.getSegment()->isZero());
+  EXPECT_EQ(cast<ConstantExpr>(integer.getOffset())->getZExtValue(),
+            0x11223344ff667788ULL);
+
+  KValue pointer = os->read(16, Expr::Int64);
+  ASSERT_TRUE(isa<ConstantExpr>(pointer.getSegment()));
+  EXPECT_EQ(cast<ConstantExpr>(pointer.getSegment())->getZExtValue(), 7u);
+  EXPECT_EQ(cast<ConstantExpr>(pointer.getOffset())->getZExtValue(), 4u);
+
+  KValue symbolic = os->read(28, Expr::Int32);
+  EXPECT_FALSE(isa<ConstantExpr>(symbolic.getSegment()));
+  EXPECT_EQ(cast<ConstantExpr>(symbolic.getOffset())->getZExtValue(), 1u);
+}
+
+TEST_F(ObjectStateTest, CopyIsIndependent) {
+  auto original = writeSequence();
+  ref<ObjectState> copy = new ObjectState(*original);
+  copy->write64(16, 9, 0);
+
+  KValue a = original->read(16, Expr::Int64);
+  KValue b = copy->read(16, Expr::Int64);
+  EXPECT_EQ(cast<ConstantExpr>(a.getSegment())->getZExtValue(), 7u);
+  EXPECT_EQ(cast<ConstantExpr>(b.getSegment())->getZExtValue(), 9u);
+  EXPECT_EQ(copy->getSizeBound(), 32u);
+}
+
+TEST_F(ObjectStateTest, SymbolicSizeGrows) {
+  objects.emplace_back(new MemoryObject(
+      objects.size() + 1, symbolicValue("n", Expr::Int64), 64, false, true,
+      false, nullptr, memory));
+  ref<ObjectState> os = new ObjectState(objects.back().get());
+  os->initializeToZero();
+  os->write64(0, 5, 8);
+  os->write64(8, 0, 1);
+
+  KValue a = os->read(0, Expr::Int64);
+  KValue b = os->read(8, Expr::Int64);
+  EXPECT_EQ(cast<ConstantExpr>(a.getSegment())->getZExtValue(), 5u);
+  EXPECT_EQ(cast<ConstantExpr>(a.getOffset())->getZExtValue(), 8u);
+  EXPECT_TRUE(b.getSegment()->isZero());
+  EXPECT_EQ(os->getSizeBound(), 16u);
+}
+
+TEST_F(ObjectStateTest, RebaseLongUpdateList) {
+  setRebaseLimit(8);
+  std::unique_ptr<Solver> solver(createCoreSolver(CoreSolverToUse));
+  auto os = create(8);
+  ref<Expr> index = symbolicValue("index", Expr::Int32);
+  ref<Expr> x = symbolicValue("x", Expr::Int8);
+  ref<Expr> offset =
+      AndExpr::create(symbolicValue("offset", Expr::Int32),
+                      ConstantExpr::create(7, Expr::Int32));
+  for (unsigned i = 0; i < 20; ++i)
+    os->write(AddExpr::create(index, ConstantExpr::create(i, Expr::Int32)),
+              KValue(ConstantExpr::create(0, Expr::Int8),
+                     AddExpr::create(x, ConstantExpr::create(i, Expr::Int8))));
+  for (unsigned round = 0; round < 3; ++round) {
+    for (unsigned i = 0; i < 7; ++i)
+      os->write8(i, 0, round + i);
+    os->read(offset, Expr::Int8);
+  }
+  ref<ObjectState> unrebased = new ObjectState(*os);
+
+  // only the last writes of bytes 0 to 6 are kept, as byte 7 still depends
+  // on the writes at symbolic offsets
+  os->rebaseUpdateLists();
+  ref<Expr> byte = os->read(offset, Expr::Int8).getOffset();
+  ASSERT_TRUE(isa<ReadExpr>(byte));
+  EXPECT_EQ(cast<ReadExpr>(byte)->updates.getSize(), 27u);
+  ASSERT_TRUE(cast<ReadExpr>(byte)->updates.root->isConstantArray());
+  ref<Expr> old = unrebased->read(offset, Expr::Int8).getOffset();
+  EXPECT_EQ(cast<ReadExpr>(old)->updates.getSize(), 41u);
+  bool result;
+  ASSERT_TRUE(solver->mustBeTrue(
+      Query(ConstraintSet(), EqExpr::create(byte, old)), result));
+  EXPECT_TRUE(result);
+
+  // the list is rebased again once it grew by more than the limit, and
+  // nothing older than concrete writes of all bytes is kept
+  for (unsigned round = 0; round < 2; ++round) {
+    for (unsigned i = 0; i < 8; ++i)
+      os->write8(i, 0, round + i);
+    os->read(offset, Expr::Int8);
+  }
+  os->rebaseUpdateLists();
+  byte = os->read(offset, Expr::Int8).getOffset();
+  ASSERT_TRUE(isa<ReadExpr>(byte));
+  const ReadExpr *re = cast<ReadExpr>(byte);
+  EXPECT_EQ(re->updates.getSize(), 0u);
+  ASSERT_TRUE(re->updates.root->isConstantArray());
+  for (unsigned i = 0; i < 8; ++i)
+    EXPECT_EQ(re->updates.root->constantValues[i]->getZExtValue(), i + 1);
+  EXPECT_EQ(os->read8(3).getOffset(), ConstantExpr::create(4, Expr::Int8));
+  setRebaseLimit(0);
+}
+
+TEST_F(ObjectStateTest, MemoryUsageCountsOwnedObjects) {
+  ExecutionState state;
+  std::uint64_t empty = state.getApproximateMemoryUsage();
+  ref<ObjectState> os = create(1 << 16);
+  os->write8(0, 0, 1);
+  state.addressSpace.bindObject(os->getObject(), os.get());
+  std::uint64_t owned = state.getApproximateMemoryUsage();
+  EXPECT_GE(owned - empty, 1u << 16);
+
+  // a branched state shares the object until it writes it
+  ExecutionState branched(state);
+  EXPECT_EQ(branched.getApproximateMemoryUsage(), empty);
+  // and then shares all pages of the copy but the written ones
+  ObjectState *wos =
+      branched.addressSpace.getWriteable(os->getObject(), os.get());
+  EXPECT_LT(branched.getApproximateMemoryUsage() - empty, 1024u);
+  wos->write8(1, 0, 1);
+  std::uint64_t written = branched.getApproximateMemoryUsage() - empty;
+  EXPECT_GE(written, std::uint64_t(PagedArray<uint8_t>::PageSize));
+  EXPECT_LT(written, 1u << 15);
+  // the original state now shares the pages the branched one did not write
+  EXPECT_LT(state.getApproximateMemoryUsage(), owned);
+}
+
+// Measures the cost of pointer-heavy accesses at concrete and at symbolic
+// offsets, run with --gtest_also_run_disabled_tests.
+TEST_F(ObjectStateTest, DISABLED_PointerBenchmark) {
+  const unsigned size = 4096, rounds = 200, symbolicRounds = 20;
+  auto os = create(size);
+  ref<Expr> x = symbolicValue("bench", Expr::Int64);
+
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned round = 0; round < rounds; ++round) {
+    for (unsigned offset = 0; offset < size; offset += 8) {
+      if (offset % 64 == 0)
+        os->write(offset, KValue(ConstantExpr::create(round + 1, Expr::Int64),
+                                 x));
+      else
+        os->write64(offset, round % 3, offset);
+    }
+    ref<ObjectState> copy = new ObjectState(*os);
+    for (unsigned offset = 0; offset < size; offset += 8)
+      copy->read(offset, Expr::Int64);
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start);
+  llvm::outs() << "concrete offsets: " << elapsed.count() << " ms\n";
+
+  // pointers stored and loaded at offsets that depend on index go through
+  // the update lists
+  auto sos = create(size);
+  ref<Expr> index = symbolicValue("bench_index", Expr::Int64);
+  auto offsetOf = [&](ref<Expr> i) {
+    return MulExpr::create(
+        AndExpr::create(i, ConstantExpr::create(size / 8 - 1, Expr::Int64)),
+        ConstantExpr::create(8, Expr::Int64));
+  };
+  start = std::chrono::steady_clock::now();
+  for (unsigned round = 0; round < symbolicRounds; ++round) {
+    for (unsigned i = 0; i < 16; ++i)
+      sos->write(offsetOf(AddExpr::create(index,
+                                          ConstantExpr::create(i, Expr::Int64))),
+                 KValue(ConstantExpr::create(round + 1, Expr::Int64), x));
+    ref<ObjectState> copy = new ObjectState(*sos);
+    for (unsigned i = 0; i < 16; ++i)
+      copy->read(offsetOf(SubExpr::create(index,
+                                          ConstantExpr::create(i, Expr::Int64))),
+                 Expr::Int64);
+  }
+  elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start);
+  llvm::outs() << "symbolic offsets: " << elapsed.count() << " ms\n";
+}
+
+// Compares solving symbolic reads of a buffer that is written at a symbolic
+// offset and then overwritten by concrete values in every round, with and
+// without rebasing, run with --gtest_also_run_disabled_tests. The first loop
+// overwrites the whole buffer, the second one only its first half, so that
+// none of the writes at symbolic offsets can be dropped.
+TEST_F(ObjectStateTest, DISABLED_RebaseBenchmark) {
+  const unsigned size = 64, rounds = 200;
+  std::unique_ptr<Solver> solver(createCoreSolver(CoreSolverToUse));
+  for (unsigned overwritten : {size, size / 2}) {
+    for (unsigned limit : {0u, 32u}) {
+      setRebaseLimit(limit);
+      auto os = create(size);
+      std::string suffix =
+          std::to_string(limit) + "_" + std::to_string(overwritten);
+      ref<Expr> index = symbolicValue("rebase_index" + suffix, Expr::Int32);
+      ref<Expr> readOffset =
+          AndExpr::create(symbolicValue("rebase_read" + suffix, Expr::Int32),
+                          ConstantExpr::create(size - 1, Expr::Int32));
+      uint64_t listSizes = 0;
+
+      auto start = std::chrono::steady_clock::now();
+      for (unsigned round = 0; round < rounds; ++round) {
+        ref<Expr> offset = AndExpr::create(
+            AddExpr::create(index, ConstantExpr::create(round, Expr::Int32)),
+            ConstantExpr::create(size - 1, Expr::Int32));
+        os->write(offset, KValue(ConstantExpr::create(0, Expr::Int8),
+                                 ConstantExpr::create(round, Expr::Int8)));
+        os->rebaseUpdateLists();
+        for (unsigned i = 0; i < overwritten; ++i) {
+          os->write8(i, 0, round + i);
+          os->rebaseUpdateLists();
+        }
+        ref<Expr> byte = os->read(readOffset, Expr::Int8).getOffset();
+        if (const ReadExpr *re = dyn_cast<ReadExpr>(byte))
+          listSizes += re->updates.getSize();
+        bool result;
+        ASSERT_TRUE(solver->mayBeTrue(
+            Query(ConstraintSet(),
+                  EqExpr::create(byte, ConstantExpr::create(round + 5,
+                                                            Expr::Int8))),
+            result));
+        EXPECT_TRUE(result);
+      }
+      auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now() - start);
+      llvm::outs() << overwritten << " of " << size
+                   << " bytes overwritten, --rebase-update-lists=" << limit
+                   << ": " << elapsed.count() << " ms, " << listSizes / rounds
+                   << " updates per read\n";
+    }
+  }
+  setRebaseLimit(0);
+}
+
+} // namespace
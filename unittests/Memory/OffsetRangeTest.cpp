@@ -0,0 +1,119 @@
+//===-- OffsetRangeTest.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "Core/OffsetRange.h"
+
+#include "klee/Expr/ArrayCache.h"
+#include "klee/Expr/Constraints.h"
+
+using namespace klee;
+
+namespace {
+
+ArrayCache ac;
+
+ref<Expr> symbolicInt(const char *name, Expr::Width width) {
+  const Array *array = ac.CreateArray(name, width / 8);
+  return Expr::createTempRead(array, width);
+}
+
+ref<Expr> constant(uint64_t value, Expr::Width width) {
+  return ConstantExpr::create(value, width);
+}
+
+TEST(OffsetRangeTest, Structure) {
+  ConstraintSet constraints;
+  OffsetRangeEvaluator eval(constraints);
+
+  ref<Expr> byte = symbolicInt("byte", Expr::Int8);
+  ref<Expr> offset = ZExtExpr::create(byte, Expr::Int64);
+  UnsignedRange range = eval.evaluate(offset);
+  EXPECT_EQ(range.min, 0u);
+  EXPECT_EQ(range.max, 255u);
+
+  range = eval.evaluate(MulExpr::create(offset, constant(4, Expr::Int64)));
+  EXPECT_EQ(range.max, 1020u);
+
+  range = eval.evaluate(AddExpr::create(offset, constant(16, Expr::Int64)));
+  EXPECT_EQ(range.min, 16u);
+  EXPECT_EQ(range.max, 271u);
+
+  range = eval.evaluate(AndExpr::create(symbolicInt("x", Expr::Int64),
+                                        constant(0xF0, Expr::Int64)));
+  EXPECT_EQ(range.max, 0xF0u);
+
+  range = eval.evaluate(URemExpr::create(symbolicInt("y", Expr::Int64),
+                                         constant(10, Expr::Int64)));
+  EXPECT_EQ(range.max, 9u);
+
+  // a sign extended byte may be negative
+  range = eval.evaluate(SExtExpr::create(byte, Expr::Int64));
+  EXPECT_EQ(range.max, UINT64_MAX);
+}
+
+TEST(OffsetRangeTest, Constraints) {
+  ref<Expr> i = symbolicInt("i", Expr::Int32);
+  ref<Expr> offset = MulExpr::create(SExtExpr::create(i, Expr::Int64),
+                                     constant(4, Expr::Int64));
+
+  ConstraintSet constraints;
+  ConstraintManager cm(constraints);
+  // i < 10 alone does not bound the sign extension, only the multiple of 4
+  // is known to be aligned
+  cm.addConstraint(SltExpr::create(i, constant(10, Expr::Int32)));
+  EXPECT_EQ(OffsetRangeEvaluator(constraints).evaluate(offset).max,
+            UINT64_MAX - 3);
+
+  // !(i < 0)
+  cm.addConstraint(Expr::createIsZero(
+      SltExpr::create(i, constant(0, Expr::Int32))));
+  UnsignedRange range = OffsetRangeEvaluator(constraints).evaluate(offset);
+  EXPECT_EQ(range.min, 0u);
+  EXPECT_EQ(range.max, 36u);
+
+  ref<Expr> j = symbolicInt("j", Expr::Int64);
+  ConstraintSet other;
+  ConstraintManager(other).addConstraint(
+      UltExpr::create(constant(3, Expr::Int64), j));
+  ConstraintManager(other).addConstraint(
+      UleExpr::create(j, constant(7, Expr::Int64)));
+  range = OffsetRangeEvaluator(other).evaluate(j);
+  EXPECT_EQ(range.min, 4u);
+  EXPECT_EQ(range.max, 7u);
+
+  // a copy extends the bounds without changing those of the original
+  ConstraintSet copy(other);
+  ConstraintManager(copy).addConstraint(
+      UltExpr::create(j, constant(6, Expr::Int64)));
+  EXPECT_EQ(OffsetRangeEvaluator(copy).evaluate(j).max, 5u);
+  EXPECT_EQ(OffsetRangeEvaluator(other).evaluate(j).max, 7u);
+}
+
+TEST(OffsetRangeTest, RemainderByZero) {
+  ref<Expr> x = symbolicInt("x", Expr::Int64);
+  ref<Expr> d = symbolicInt("d", Expr::Int64);
+  ConstraintSet constraints;
+  ConstraintManager cm(constraints);
+  cm.addConstraint(UleExpr::create(x, constant(100, Expr::Int64)));
+  cm.addConstraint(UleExpr::create(d, constant(8, Expr::Int64)));
+
+  // the remainder of a division by zero is the dividend, not below d
+  UnsignedRange range =
+      OffsetRangeEvaluator(constraints).evaluate(URemExpr::create(x, d));
+  EXPECT_EQ(range.min, 0u);
+  EXPECT_EQ(range.max, 100u);
+
+  cm.addConstraint(UltExpr::create(constant(0, Expr::Int64), d));
+  range = OffsetRangeEvaluator(constraints).evaluate(URemExpr::create(x, d));
+  EXPECT_EQ(range.max, 7u);
+}
+
+} // namespace
@@ -0,0 +1,125 @@
+//===-- PagedArrayTest.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "Core/CoreStats.h"
+#include "Core/PagedArray.h"
+
+#include "klee/ADT/BitArray.h"
+
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+const unsigned PageSize = PagedArray<uint8_t>::PageSize;
+
+TEST(PagedArrayTest, Resize) {
+  PagedArray<uint8_t> array;
+  EXPECT_TRUE(array.empty());
+
+  array.resize(10, 7);
+  EXPECT_EQ(array.size(), 10u);
+  EXPECT_EQ(array[9], 7);
+
+  // grow over a page boundary, the old elements are kept
+  array.set(9, 1);
+  array.resize(2 * PageSize + 3, 5);
+  EXPECT_EQ(array[9], 1);
+  EXPECT_EQ(array[10], 5);
+  EXPECT_EQ(array[PageSize], 5);
+  EXPECT_EQ(array[2 * PageSize + 2], 5);
+
+  array.resize(PageSize + 1);
+  EXPECT_EQ(array.size(), PageSize + 1);
+  EXPECT_EQ(array[PageSize], 5);
+
+  array.resize(0);
+  EXPECT_TRUE(array.empty());
+}
+
+TEST(PagedArrayTest, CopyOnWrite) {
+  PagedArray<uint8_t> original;
+  original.resize(4 * PageSize, 0);
+  original.set(PageSize, 1);
+
+  uint64_t copiedBefore = stats::objectBytesCopied.getValue();
+  PagedArray<uint8_t> copy(original);
+  copy.set(PageSize + 1, 2);
+  // writing the same value does not clone a page
+  copy.set(3 * PageSize, 0);
+
+  EXPECT_EQ(original[PageSize + 1], 0);
+  EXPECT_EQ(copy[PageSize + 1], 2);
+  EXPECT_EQ(copy[PageSize], 1);
+  EXPECT_EQ(stats::objectBytesCopied.getValue() - copiedBefore, PageSize);
+
+  // the cloned page is not shared anymore
+  copy.set(PageSize + 2, 3);
+  EXPECT_EQ(stats::objectBytesCopied.getValue() - copiedBefore, PageSize);
+
+  // growing a copy leaves the original intact
+  copy.resize(4 * PageSize + 1, 9);
+  EXPECT_EQ(original.size(), 4 * PageSize);
+  EXPECT_EQ(copy[4 * PageSize], 9);
+}
+
+TEST(PagedArrayTest, BulkCopies) {
+  const unsigned size = 2 * PageSize + 100;
+  std::vector<uint8_t> bytes(size);
+  for (unsigned i = 0; i < size; ++i)
+    bytes[i] = i % 251;
+
+  PagedArray<uint8_t> array;
+  array.resize(size, 0);
+  array.copyFrom(bytes.data(), 0, size);
+  EXPECT_TRUE(array.equals(bytes.data(), 0, size));
+  EXPECT_TRUE(array.equals(bytes.data() + 50, 50, PageSize));
+
+  std::vector<uint8_t> out(size);
+  array.copyTo(out.data(), 0, size);
+  EXPECT_EQ(out, bytes);
+
+  // pages that do not change stay shared
+  PagedArray<uint8_t> copy(array);
+  uint64_t copiedBefore = stats::objectBytesCopied.getValue();
+  bytes[PageSize + 5] = 255;
+  copy.copyFrom(bytes.data(), 0, size);
+  EXPECT_EQ(stats::objectBytesCopied.getValue() - copiedBefore, PageSize);
+  EXPECT_FALSE(array.equals(bytes.data(), 0, size));
+  EXPECT_TRUE(copy.equals(bytes.data(), 0, size));
+}
+
+TEST(PagedArrayTest, BitsMatchBitArray) {
+  PagedBitArray paged;
+  BitArray plain;
+  const unsigned sizes[] = {5, 33, 40000, 70000};
+  bool value = true;
+  for (unsigned size : sizes) {
+    paged.resize(size, value);
+    plain.resize(size, value);
+    for (unsigned i = 0; i < size; i += 7) {
+      paged.set(i, i % 3 == 0);
+      plain.set(i, i % 3 == 0);
+    }
+    value = !value;
+  }
+
+  PagedBitArray copy(paged);
+  copy.unset(0);
+  EXPECT_TRUE(paged.get(0));
+
+  ASSERT_EQ(paged.size(), 70000u);
+  for (unsigned i = 0; i < paged.size(); ++i)
+    ASSERT_EQ(paged.get(i), plain.get(i)) << "bit " << i;
+}
+
+} // namespace
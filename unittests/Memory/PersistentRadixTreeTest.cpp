@@ -0,0 +1,213 @@
+//===-- PersistentRadixTreeTest.cpp -----------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "Core/PersistentRadixTree.h"
+
+#include "klee/ADT/Ref.h"
+#include "klee/Expr/Expr.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <chrono>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+// The container previously used for known symbolics, kept as the baseline
+// of the benchmark below.
+//
+// up to some offset this container is implemented
+// as a vector and from some offset as a map
+// (leveraging the assumption that large offsets will
+// be sparse). Threshold is the maximal number of elements
+// in the vector.
+// This class is specialized for our needs, it is not generic...
+template <typename T, const size_t Threshold = (1 << 18)>
+class SparseVector {
+    std::vector<T> _vector;
+    std::unordered_map<size_t, T> _map;
+
+public:
+    const T& operator[](size_t n) const {
+        if (n < Threshold) {
+            assert(n < _vector.size());
+            assert(_vector[n].get() != nullptr && "Use has() before");
+            return _vector[n];
+        } else {
+            auto it = _map.find(n);
+            if (it == _map.end()) {
+                assert(false && "Cannot happen, must use has() before");
+                abort();
+            }
+            assert(it->second.get() != nullptr);
+            return it->second;
+        }
+    }
+
+    void set(size_t n, const T& val) {
+        if (n < Threshold) {
+            if (_vector.size() <= n) {
+              if (val.get() == nullptr) {
+                return;
+              }
+              // make sure the access will be valid
+              _vector.resize(n + 1);
+            }
+
+            assert(_vector.size() > n);
+            _vector[n] = val;
+        } else {
+            if (val.get() == nullptr) {
+                _map.erase(n);
+            } else
+                _map[n] = val;
+        }
+    }
+
+    void clear() {
+        _vector.clear();
+        _map.clear();
+    }
+
+    bool has(size_t n) const {
+        return (_vector.size() > n && _vector[n].get())
+               || (_map.find(n) != _map.end());
+    }
+};
+
+typedef PersistentRadixTree<ref<Expr>> Tree;
+
+ref<Expr> value(unsigned v) { return ConstantExpr::create(v, Expr::Int8); }
+
+void expectEqual(const Tree &tree, const std::map<unsigned, unsigned> &model,
+                 unsigned bound) {
+  for (unsigned key = 0; key < bound; ++key) {
+    auto it = model.find(key);
+    ASSERT_EQ(tree.has(key), it != model.end()) << "key " << key;
+    if (it != model.end()) {
+      EXPECT_EQ(tree[key], value(it->second)) << "key " << key;
+    }
+  }
+}
+
+TEST(PersistentRadixTreeTest, SetAndErase) {
+  Tree tree;
+  std::map<unsigned, unsigned> model;
+  EXPECT_TRUE(tree.empty());
+  EXPECT_FALSE(tree.has(0));
+  EXPECT_FALSE(tree.has(1u << 30));
+
+  const unsigned keys[] = {0, 31, 32, 1000, 33000, 5, 1024, 32};
+  for (unsigned i = 0; i < sizeof(keys) / sizeof(keys[0]); ++i) {
+    tree.set(keys[i], value(i));
+    model[keys[i]] = i;
+  }
+  expectEqual(tree, model, 34000);
+
+  tree.set(1000, nullptr);
+  model.erase(1000);
+  tree.set(77, nullptr);
+  expectEqual(tree, model, 34000);
+
+  for (auto &entry : model)
+    tree.set(entry.first, nullptr);
+  EXPECT_TRUE(tree.empty());
+}
+
+TEST(PersistentRadixTreeTest, HighKeys) {
+  Tree tree;
+  tree.set(0xfffffff0u, value(1));
+  EXPECT_TRUE(tree.has(0xfffffff0u));
+  EXPECT_FALSE(tree.has(0xfffffff1u));
+  EXPECT_FALSE(tree.has(0));
+  tree.set(3, value(2));
+  EXPECT_EQ(tree[3], value(2));
+  EXPECT_EQ(tree[0xfffffff0u], value(1));
+}
+
+TEST(PersistentRadixTreeTest, CopiesAreIndependent) {
+  Tree original;
+  for (unsigned key = 0; key < 2000; key += 3)
+    original.set(key, value(key % 256));
+
+  Tree copy(original);
+  copy.set(3, value(7));
+  copy.set(4, value(8));
+  copy.set(6, nullptr);
+  copy.set(100000, value(9));
+
+  EXPECT_EQ(original[3], value(3));
+  EXPECT_FALSE(original.has(4));
+  EXPECT_TRUE(original.has(6));
+  EXPECT_FALSE(original.has(100000));
+
+  EXPECT_EQ(copy[3], value(7));
+  EXPECT_EQ(copy[4], value(8));
+  EXPECT_FALSE(copy.has(6));
+  EXPECT_EQ(copy[100000], value(9));
+  EXPECT_EQ(copy[1998], value(1998 % 256));
+
+  copy.clear();
+  EXPECT_TRUE(copy.empty());
+  EXPECT_EQ(original[9], value(9));
+}
+
+// Compares the persistent radix tree with the previously used SparseVector
+// on fork-like workloads, run with --gtest_also_run_disabled_tests.
+template <typename Container>
+unsigned runWorkload(const std::vector<unsigned> &keys, unsigned copies) {
+  Container base;
+  for (unsigned key : keys)
+    base.set(key, value(key % 256));
+
+  unsigned found = 0;
+  for (unsigned i = 0; i < copies; ++i) {
+    Container copy(base);
+    unsigned key = keys[i % keys.size()];
+    copy.set(key, value(i % 256));
+    found += copy.has(key + 1);
+  }
+  return found;
+}
+
+template <typename Container>
+void benchmark(const char *name, const std::vector<unsigned> &keys,
+               unsigned copies) {
+  auto start = std::chrono::steady_clock::now();
+  unsigned found = runWorkload<Container>(keys, copies);
+  auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start);
+  llvm::outs() << name << ": " << elapsed.count() << " ms (" << found
+               << ")\n";
+}
+
+TEST(PersistentRadixTreeTest, DISABLED_CompareWithSparseVector) {
+  std::vector<unsigned> dense, sparse, high;
+  for (unsigned key = 0; key < 4096; ++key)
+    dense.push_back(key);
+  for (unsigned key = 0; key < 64; ++key)
+    sparse.push_back(key * 997);
+  for (unsigned key = 0; key < 16; ++key)
+    high.push_back((1u << 18) - 8 + key * 4096);
+
+  benchmark<SparseVector<ref<Expr>>>("dense/sparse-vector", dense, 10000);
+  benchmark<Tree>("dense/radix-tree", dense, 10000);
+  benchmark<SparseVector<ref<Expr>>>("sparse/sparse-vector", sparse, 10000);
+  benchmark<Tree>("sparse/radix-tree", sparse, 10000);
+  benchmark<SparseVector<ref<Expr>>>("high/sparse-vector", high, 1000);
+  benchmark<Tree>("high/radix-tree", high, 1000);
+}
+
+} // namespace
@@ -0,0 +1,159 @@
+//===-- StateSpillerTest.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+#define KLEE_UNITTEST
+
+#include "gtest/gtest.h"
+
+#include "Core/ExecutionState.h"
+#include "Core/Memory.h"
+#include "Core/MemoryManager.h"
+#include "Core/StateSerializer.h"
+#include "Core/StateSpiller.h"
+
+#include "klee/Expr/ArrayCache.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+
+#include <sstream>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+class StateSpillerTest : public ::testing::Test {
+protected:
+  ArrayCache cache;
+  MemoryManager memory{&cache};
+  std::vector<ref<MemoryObject>> objects;
+
+  ref<Expr> symbolicValue(const std::string &name, Expr::Width width) {
+    return Expr::createTempRead(cache.CreateArray(name, width / 8), width);
+  }
+
+  // an object with concrete, symbolic and pointer bytes and a write at a
+  // symbolic offset
+  ref<ObjectState> createObject(ref<Expr> x, ref<Expr> index) {
+    objects.emplace_back(new MemoryObject(
+        objects.size() + 1, ConstantExpr::create(16, Expr::Int64), 16, false,
+        true, false, nullptr, &memory));
+    ref<ObjectState> os = new ObjectState(objects.back().get());
+    os->initializeToZero();
+    os->write32(0, 0, 0xcafe);
+    os->write(4, KValue(ConstantExpr::create(0, Expr::Int32),
+                        ExtractExpr::create(x, 0, Expr::Int32)));
+    os->write(8, KValue(ConstantExpr::create(12, Expr::Int64),
+                        ConstantExpr::create(3, Expr::Int64)));
+    os->write(index, KValue(ConstantExpr::create(0, Expr::Int8),
+                            ConstantExpr::create(1, Expr::Int8)));
+    // create the constant arrays of the update lists, so that the reads of
+    // a copy use the same arrays
+    os->read(index, Expr::Int32);
+    return os;
+  }
+
+  static void expectSameContents(const ObjectState &a, const ObjectState &b,
+                                 ref<Expr> index) {
+    ASSERT_EQ(a.getSizeBound(), b.getSizeBound());
+    for (unsigned offset = 0; offset < a.getSizeBound(); ++offset) {
+      EXPECT_EQ(a.read8(offset).getSegment(), b.read8(offset).getSegment());
+      EXPECT_EQ(a.read8(offset).getOffset(), b.read8(offset).getOffset());
+    }
+    EXPECT_EQ(a.read(index, Expr::Int32).getOffset(),
+              b.read(index, Expr::Int32).getOffset());
+  }
+};
+
+TEST_F(StateSpillerTest, ExpressionsKeepSharing) {
+  ref<Expr> x = symbolicValue("x", Expr::Int32);
+  ref<Expr> sum = AddExpr::create(x, ConstantExpr::create(7, Expr::Int32));
+  ref<Expr> wide = ConstantExpr::alloc(llvm::APInt(128, 5).shl(100));
+  ref<Expr> e = SelectExpr::create(UltExpr::create(sum, x),
+                                   ZExtExpr::create(sum, Expr::Int64),
+                                   SExtExpr::create(x, Expr::Int64));
+
+  std::stringstream stream;
+  StateWriter writer(stream);
+  writer.writeExpr(e);
+  writer.writeExpr(sum);
+  writer.writeExpr(nullptr);
+  writer.writeExpr(wide);
+  ASSERT_TRUE(writer.good());
+
+  StateReader reader(stream);
+  ref<Expr> e2 = reader.readExpr();
+  ref<Expr> sum2 = reader.readExpr();
+  EXPECT_TRUE(reader.readExpr().isNull());
+  ref<Expr> wide2 = reader.readExpr();
+  ASSERT_TRUE(reader.good());
+
+  EXPECT_EQ(e, e2);
+  EXPECT_EQ(wide, wide2);
+  // the sum is read once and shared by both of its uses
+  EXPECT_EQ(sum2.get(), e2->getKid(1)->getKid(0).get());
+}
+
+TEST_F(StateSpillerTest, ObjectStateRoundTrip) {
+  ref<Expr> x = symbolicValue("x", Expr::Int64);
+  ref<Expr> index = symbolicValue("index", Expr::Int32);
+  ref<ObjectState> os = createObject(x, index);
+
+  std::stringstream stream;
+  StateWriter writer(stream);
+  os->serialize(writer);
+  ASSERT_TRUE(writer.good());
+
+  StateReader reader(stream);
+  ref<ObjectState> copy = new ObjectState(os->getObject(), reader);
+  ASSERT_TRUE(reader.good());
+  expectSameContents(*os, *copy, index);
+}
+
+TEST_F(StateSpillerTest, SpillAndRestore) {
+  llvm::SmallString<128> directory;
+  ASSERT_FALSE(llvm::sys::fs::createUniqueDirectory("klee-spill", directory));
+
+  ref<Expr> x = symbolicValue("x", Expr::Int64);
+  ref<Expr> index = symbolicValue("index", Expr::Int32);
+  ref<ObjectState> owned = createObject(x, index);
+  ref<ObjectState> original = new ObjectState(*owned);
+  const MemoryObject *mo = owned->getObject();
+
+  ExecutionState state;
+  state.addressSpace.bindObject(mo, owned.get());
+  state.addConstraint(
+      UltExpr::create(index, ConstantExpr::create(12, Expr::Int32)));
+  state.addNondetValue(KValue(x), false, nullptr, "x");
+  owned = nullptr;
+
+  {
+    StateSpiller spiller(directory.str().str());
+    EXPECT_GT(spiller.spill(state), 0u);
+    EXPECT_TRUE(spiller.isSpilled(state));
+    EXPECT_EQ(state.addressSpace.findObject(mo), nullptr);
+    EXPECT_TRUE(state.constraints.empty());
+    EXPECT_TRUE(state.nondetValues[0].value.getValue().isNull());
+
+    spiller.restore(state);
+    EXPECT_FALSE(spiller.isSpilled(state));
+  }
+  EXPECT_FALSE(llvm::sys::fs::exists(directory));
+
+  const ObjectState *restored = state.addressSpace.findObject(mo);
+  ASSERT_NE(restored, nullptr);
+  EXPECT_TRUE(state.addressSpace.isOwned(restored));
+  expectSameContents(*original, *restored, index);
+  ASSERT_EQ(state.constraints.size(), 1u);
+  EXPECT_EQ(*state.constraints.begin(),
+            UltExpr::create(index, ConstantExpr::create(12, Expr::Int32)));
+  EXPECT_EQ(state.nondetValues[0].value.getValue(), x);
+}
+
+} // namespace
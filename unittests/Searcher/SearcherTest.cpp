@@ -14,9 +14,13 @@
 #include "Core/ExecutionState.h"
 #include "Core/PTree.h"
 #include "Core/Searcher.h"
+#include "Core/StateSerializer.h"
 
 #include "llvm/Support/raw_ostream.h"
 
+#include <map>
+#include <sstream>
+
 using namespace klee;
 
 namespace {
@@ -201,6 +205,74 @@ TEST(SearcherTest, TwoRandomPathDot) {
   processTree.remove(es1.ptreeNode);
   processTree.remove(root.ptreeNode);
 }
+TEST(SearcherTest, RandomPathResumedTree) {
+  ExecutionState root;
+  root.setID();
+  PTree processTree(&root);
+  ExecutionState es(root);
+  es.setID();
+  processTree.attach(root.ptreeNode, &es, &root, BranchType::NONE);
+  ExecutionState es1(es);
+  es1.setID();
+  processTree.attach(es.ptreeNode, &es1, &es, BranchType::NONE);
+
+  std::stringstream stream;
+  StateWriter writer(stream);
+  processTree.serialize(writer);
+  ASSERT_TRUE(writer.good());
+
+  // the states of the resumed run, with the ids of the original ones
+  ExecutionState resumedRoot, resumedEs, resumedEs1;
+  resumedRoot.id = root.getID();
+  resumedEs.id = es.getID();
+  resumedEs1.id = es1.getID();
+  std::map<std::uint32_t, ExecutionState *> states{
+      {root.getID(), &resumedRoot},
+      {es.getID(), &resumedEs},
+      {es1.getID(), &resumedEs1}};
+
+  StateReader reader(stream);
+  PTree resumedTree(reader, states);
+  ASSERT_TRUE(reader.good());
+
+  PTreeNode *node = resumedTree.root.getPointer();
+  EXPECT_EQ(node->right.getPointer(), resumedRoot.ptreeNode);
+  PTreeNode *esParent = node->left.getPointer();
+  ASSERT_NE(esParent, nullptr);
+  EXPECT_EQ(esParent->parent, node);
+  EXPECT_EQ(esParent->left.getPointer(), resumedEs1.ptreeNode);
+  EXPECT_EQ(esParent->right.getPointer(), resumedEs.ptreeNode);
+  EXPECT_EQ(resumedEs.ptreeNode->state, &resumedEs);
+
+  RNG rng;
+  RandomPathSearcher rp(resumedTree, rng);
+  rp.update(nullptr, {&resumedRoot, &resumedEs, &resumedEs1}, {});
+  EXPECT_FALSE(rp.empty());
+  rp.update(nullptr, {}, {&resumedRoot, &resumedEs, &resumedEs1});
+  EXPECT_TRUE(rp.empty());
+
+  resumedTree.remove(resumedEs1.ptreeNode);
+  resumedTree.remove(resumedEs.ptreeNode);
+  resumedTree.remove(resumedRoot.ptreeNode);
+  processTree.remove(es1.ptreeNode);
+  processTree.remove(es.ptreeNode);
+  processTree.remove(root.ptreeNode);
+}
+
+TEST(SearcherTest, RandomPathMalformedTree) {
+  ExecutionState es;
+  std::stringstream stream;
+  StateWriter writer(stream);
+  // a leaf of an unknown state
+  writer.writeInt(0);
+  writer.writeInt(es.getID() + 1);
+
+  StateReader reader(stream);
+  PTree tree(reader, {{es.getID(), &es}});
+  EXPECT_FALSE(reader.good());
+  EXPECT_EQ(es.ptreeNode, nullptr);
+}
+
 TEST(SearcherDeathTest, TooManyRandomPaths) {
   // First state
   ExecutionState es;
@@ -0,0 +1,103 @@
+#include "klee/ADT/SetTrie.h"
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+typedef std::set<int> Set;
+
+bool includes(const Set &a, const Set &b) {
+  return std::includes(a.begin(), a.end(), b.begin(), b.end());
+}
+
+struct Any {
+  bool operator()(int) const { return true; }
+};
+
+/// Holds for the given value only
+struct Equals {
+  int value;
+  bool operator()(int v) const { return v == value; }
+};
+
+TEST(SetTrieTest, LooksUpSets) {
+  SetTrie<int, int> trie;
+  trie.insert({1, 2, 3}, 1);
+  trie.insert({1, 2}, 2);
+  trie.insert({}, 3);
+
+  ASSERT_TRUE(trie.lookup({1, 2, 3}));
+  EXPECT_EQ(*trie.lookup({1, 2, 3}), 1);
+  EXPECT_EQ(*trie.lookup({1, 2}), 2);
+  EXPECT_EQ(*trie.lookup({}), 3);
+  EXPECT_FALSE(trie.lookup({1}));
+  EXPECT_FALSE(trie.lookup({1, 3}));
+
+  EXPECT_EQ(trie.insert({1, 2}, 4), 2);
+  EXPECT_EQ(*trie.lookup({1, 2}), 4);
+  EXPECT_EQ(trie.size(), 3u);
+}
+
+TEST(SetTrieTest, FindsSubsetsAndSupersets) {
+  std::mt19937 rng(0);
+  std::vector<Set> sets;
+  SetTrie<int, int> trie;
+  for (int i = 0; i < 300; ++i) {
+    Set set;
+    for (int n = rng() % 6; n > 0; --n)
+      set.insert(rng() % 12);
+    if (!trie.lookup(set)) {
+      trie.insert(set, sets.size());
+      sets.push_back(set);
+    }
+  }
+
+  for (int i = 0; i < 300; ++i) {
+    Set query;
+    for (int n = rng() % 8; n > 0; --n)
+      query.insert(rng() % 12);
+
+    for (unsigned j = 0; j < sets.size(); ++j) {
+      int *subset = trie.findSubset(query, Equals{static_cast<int>(j)});
+      EXPECT_EQ(subset != nullptr, includes(query, sets[j]));
+      int *superset = trie.findSuperset(query, Equals{static_cast<int>(j)});
+      EXPECT_EQ(superset != nullptr, includes(sets[j], query));
+    }
+    int *subset = trie.findSubset(query, Any());
+    EXPECT_EQ(subset != nullptr,
+              std::any_of(sets.begin(), sets.end(), [&](const Set &set) {
+                return includes(query, set);
+              }));
+  }
+  EXPECT_GT(trie.getVisitedNodes(), 0u);
+}
+
+TEST(SetTrieTest, EvictsLeastRecentlyUsedSets) {
+  SetTrie<int, int> trie(3);
+  trie.insert({1}, 1);
+  trie.insert({1, 2}, 2);
+  trie.insert({3}, 3);
+
+  // the clock passes all the sets once, then evicts the first one not used
+  // since
+  EXPECT_EQ(trie.insert({4}, 4), 1);
+  EXPECT_FALSE(trie.lookup({1}));
+  ASSERT_TRUE(trie.lookup({1, 2}));
+  EXPECT_EQ(trie.insert({5}, 5), 3);
+  EXPECT_FALSE(trie.lookup({3}));
+  EXPECT_EQ(trie.size(), 3u);
+  EXPECT_EQ(trie.getEvictions(), 2u);
+
+  // the evicted sets are neither subsets nor supersets
+  EXPECT_FALSE(trie.findSubset({1, 3}, Any()));
+  EXPECT_EQ(*trie.findSuperset({2}, Any()), 2);
+  EXPECT_FALSE(trie.findSuperset({3}, Any()));
+}
+
+} // namespace
@@ -14,10 +14,20 @@
 #include "klee/Expr/Expr.h"
 #include "klee/Solver/Solver.h"
 #include "klee/Solver/SolverCmdLine.h"
+#include "klee/Solver/SolverImpl.h"
+#include "klee/Solver/SolverStats.h"
+#include "klee/Statistics/Statistic.h"
 
+#include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
 
+#include <chrono>
 #include <iostream>
+#include <memory>
+
+#include <unistd.h>
 
 using namespace klee;
 
@@ -169,4 +179,487 @@ TEST(SolverTest, Evaluation) {
   delete solver;
 }
 
+TEST(SolverTest, NarrowedEvaluation) {
+  Solver *solver = klee::createCoreSolver(CoreSolverToUse);
+  solver = createNarrowingSolver(solver);
+
+  testOpcode<SelectExpr>(*solver);
+  testOpcode<ZExtExpr>(*solver);
+  testOpcode<SExtExpr>(*solver);
+  testOpcode<AddExpr>(*solver);
+  testOpcode<LShrExpr>(*solver, false);
+  testOpcode<AndExpr>(*solver);
+  testOpcode<OrExpr>(*solver);
+  testOpcode<EqExpr>(*solver);
+  testOpcode<UltExpr>(*solver);
+  testOpcode<UleExpr>(*solver);
+
+  delete solver;
+}
+
+// Records the last query instead of solving it.
+class RecordingSolver : public SolverImpl {
+public:
+  std::vector<ref<Expr>> constraints;
+  ref<Expr> expr;
+
+  bool computeTruth(const Query &query, bool &isValid) override {
+    constraints.assign(query.constraints.begin(), query.constraints.end());
+    expr = query.expr;
+    isValid = false;
+    return true;
+  }
+  bool computeValue(const Query &, ref<Expr> &) override { return false; }
+  bool computeInitialValues(const Query &,
+                            std::shared_ptr<const Assignment> &,
+                            bool &) override {
+    return false;
+  }
+  SolverRunStatus getOperationStatusCode() override {
+    return SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+  }
+};
+
+TEST(SolverTest, NarrowsBoundedComparisons) {
+  auto *recording = new RecordingSolver();
+  std::unique_ptr<Solver> solver(
+      createNarrowingSolver(new Solver(recording)));
+
+  const Array *array = ac.CreateArray("narrow", 8);
+  ref<Expr> byte = Expr::createTempRead(array, Expr::Int8);
+  ref<Expr> word = Expr::createTempRead(array, Expr::Int64);
+  ref<Expr> cond = UltExpr::create(byte, getConstant(4, Expr::Int8));
+  // the segment of a pointer that points to one of two objects
+  ref<Expr> segment = SelectExpr::create(cond, getConstant(5, Expr::Int64),
+                                         getConstant(17, Expr::Int64));
+
+  ConstraintSet constraints;
+  constraints.push_back(EqExpr::create(getConstant(17, Expr::Int64), segment));
+  bool result;
+  ASSERT_TRUE(solver->mustBeTrue(
+      Query(constraints, UltExpr::create(ZExtExpr::create(byte, Expr::Int64),
+                                         segment)),
+      result));
+
+  ASSERT_EQ(recording->constraints.size(), 1u);
+  EXPECT_EQ(recording->constraints[0],
+            EqExpr::create(getConstant(17, 5),
+                           SelectExpr::create(cond, getConstant(5, 5),
+                                              getConstant(17, 5))));
+  EXPECT_EQ(recording->expr,
+            UltExpr::create(byte, SelectExpr::create(cond, getConstant(5, 8),
+                                                     getConstant(17, 8))));
+
+  // terms that may use all bits are left alone
+  ref<Expr> wide = EqExpr::create(word, segment);
+  ASSERT_TRUE(solver->mustBeTrue(Query(ConstraintSet(), wide), result));
+  EXPECT_EQ(recording->expr, wide);
+}
+
+/// Forwards the queries to the core solver and counts them
+class CountingSolver : public SolverImpl {
+  std::unique_ptr<Solver> solver{createCoreSolver(CoreSolverToUse)};
+
+public:
+  unsigned queries = 0;
+
+  bool computeTruth(const Query &query, bool &isValid) override {
+    ++queries;
+    return solver->impl->computeTruth(query, isValid);
+  }
+  bool computeValue(const Query &query, ref<Expr> &result) override {
+    ++queries;
+    return solver->impl->computeValue(query, result);
+  }
+  bool computeInitialValues(const Query &query,
+                            std::shared_ptr<const Assignment> &result,
+                            bool &hasSolution) override {
+    ++queries;
+    return solver->impl->computeInitialValues(query, result, hasSolution);
+  }
+  SolverRunStatus getOperationStatusCode() override {
+    return solver->impl->getOperationStatusCode();
+  }
+};
+
+std::string createCacheFile() {
+  int fd;
+  llvm::SmallString<128> path;
+  if (llvm::sys::fs::createTemporaryFile("klee-query-cache", "qc", fd, path))
+    return "";
+  close(fd);
+  return path.str().str();
+}
+
+TEST(SolverTest, PersistentCacheReusesResultsOfOtherRuns) {
+  std::string path = createCacheFile();
+  ASSERT_FALSE(path.empty());
+
+  // the queries of a run and of a later run that names its arrays otherwise
+  CountingSolver *counting[2];
+  std::unique_ptr<Solver> solvers[2];
+  const Array *arrays[2];
+  for (unsigned run = 0; run < 2; ++run) {
+    counting[run] = new CountingSolver();
+    solvers[run].reset(createPersistentCachingSolver(
+        new Solver(counting[run]), path, 1 << 20));
+    arrays[run] = ac.CreateArray("run" + llvm::utostr(run), 4);
+  }
+
+  std::shared_ptr<const Assignment> models[2];
+  bool truths[2];
+  for (unsigned run = 0; run < 2; ++run) {
+    ref<Expr> word = Expr::createTempRead(arrays[run], Expr::Int32);
+    ConstraintSet constraints;
+    constraints.push_back(UltExpr::create(word, getConstant(100, Expr::Int32)));
+    ASSERT_TRUE(solvers[run]->mustBeTrue(
+        Query(constraints, UltExpr::create(word, getConstant(50, Expr::Int32))),
+        truths[run]));
+    constraints.push_back(EqExpr::create(word, getConstant(42, Expr::Int32)));
+    ASSERT_TRUE(solvers[run]->getInitialValues(
+        Query(constraints, ConstantExpr::alloc(0, Expr::Bool)), models[run]));
+  }
+  EXPECT_FALSE(truths[0]);
+  EXPECT_FALSE(truths[1]);
+  EXPECT_EQ(counting[0]->queries, 2u);
+  EXPECT_EQ(counting[1]->queries, 0u);
+
+  // the model of the later run binds its own array
+  ASSERT_TRUE(models[1]);
+  ref<Expr> word = Expr::createTempRead(arrays[1], Expr::Int32);
+  EXPECT_EQ(models[1]->evaluate(word), getConstant(42, Expr::Int32));
+  EXPECT_EQ(models[1]->getBindingsOrNull(arrays[0]), nullptr);
+
+  solvers[0].reset();
+  solvers[1].reset();
+  llvm::sys::fs::remove(path);
+}
+
+TEST(SolverTest, PersistentCacheOverwritesOldestResults) {
+  std::string path = createCacheFile();
+  ASSERT_FALSE(path.empty());
+
+  auto *counting = new CountingSolver();
+  std::unique_ptr<Solver> solver(
+      createPersistentCachingSolver(new Solver(counting), path, 16 << 10));
+  uint64_t size;
+  ASSERT_FALSE(llvm::sys::fs::file_size(path, size));
+
+  const Array *array = ac.CreateArray("oldest", 4);
+  ref<Expr> word = Expr::createTempRead(array, Expr::Int32);
+  auto query = [&](unsigned value) {
+    bool result;
+    EXPECT_TRUE(solver->mustBeTrue(
+        Query(ConstraintSet(),
+              NeExpr::create(word, getConstant(value, Expr::Int32))),
+        result));
+  };
+
+  const unsigned queries = 600;
+  for (unsigned i = 0; i < queries; ++i)
+    query(i);
+  EXPECT_EQ(counting->queries, queries);
+  uint64_t finalSize;
+  ASSERT_FALSE(llvm::sys::fs::file_size(path, finalSize));
+  EXPECT_EQ(finalSize, size);
+
+  // the newest results are kept, the oldest ones are overwritten
+  query(queries - 1);
+  EXPECT_EQ(counting->queries, queries);
+  query(0);
+  EXPECT_EQ(counting->queries, queries + 1);
+
+  solver.reset();
+  llvm::sys::fs::remove(path);
+}
+
+/// Answers queries with the given byte after the given delay, or times out
+/// if the timeout is shorter
+class DelayedSolver : public SolverImpl {
+  const Array *array;
+  unsigned char value;
+  uint64_t delay;
+  time::Span timeout;
+  SolverRunStatus status = SOLVER_RUN_STATUS_FAILURE;
+
+  bool wait() {
+    ++stats::queries;
+    if (timeout && timeout.toMicroseconds() < delay) {
+      usleep(timeout.toMicroseconds());
+      status = SOLVER_RUN_STATUS_TIMEOUT;
+      return false;
+    }
+    usleep(delay);
+    status = SOLVER_RUN_STATUS_SUCCESS_SOLVABLE;
+    return true;
+  }
+
+public:
+  DelayedSolver(const Array *array, unsigned char value, time::Span delay)
+      : array(array), value(value), delay(delay.toMicroseconds()) {}
+
+  bool computeTruth(const Query &, bool &isValid) override {
+    isValid = false;
+    return wait();
+  }
+  bool computeValue(const Query &, ref<Expr> &result) override {
+    result = ConstantExpr::alloc(value, Expr::Int8);
+    return wait();
+  }
+  bool computeInitialValues(const Query &,
+                            std::shared_ptr<const Assignment> &result,
+                            bool &hasSolution) override {
+    auto assignment = std::make_shared<Assignment>();
+    assignment->addBinding(array, std::vector<unsigned char>(1, value));
+    result = assignment;
+    hasSolution = true;
+    return wait();
+  }
+  SolverRunStatus getOperationStatusCode() override { return status; }
+  void setCoreSolverTimeout(time::Span timeout) override {
+    this->timeout = timeout;
+  }
+};
+
+Statistic slowSolverWins("SlowSolverWins", "SSwins");
+Statistic fastSolverWins("FastSolverWins", "FSwins");
+
+TEST(SolverTest, PortfolioRacesSlowQueries) {
+  const Array *array = ac.CreateArray("portfolio", 1);
+  ref<Expr> byte = Expr::createTempRead(array, Expr::Int8);
+  std::unique_ptr<Solver> solver(createPortfolioSolver(
+      {new Solver(new DelayedSolver(array, 1, time::Span("20s"))),
+       new Solver(new DelayedSolver(array, 2, time::Span("0s")))},
+      {&slowSolverWins, &fastSolverWins}, time::Span("50ms")));
+  solver->setCoreSolverTimeout(time::Span("30s"));
+
+  uint64_t races = stats::queryPortfolioRaces;
+  auto start = std::chrono::steady_clock::now();
+  std::shared_ptr<const Assignment> assignment;
+  ConstraintSet constraints;
+  constraints.push_back(UltExpr::create(byte, getConstant(10, Expr::Int8)));
+  ASSERT_TRUE(solver->getInitialValues(
+      Query(constraints, ConstantExpr::alloc(0, Expr::Bool)), assignment));
+  EXPECT_EQ(assignment->evaluate(byte), getConstant(2, Expr::Int8));
+  ref<ConstantExpr> value;
+  ASSERT_TRUE(solver->getValue(Query(constraints, byte), value));
+  EXPECT_EQ(value->getZExtValue(), 2u);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(10));
+
+  EXPECT_EQ(stats::queryPortfolioRaces - races, 2u);
+  EXPECT_EQ(fastSolverWins.getValue(), 2u);
+  EXPECT_EQ(slowSolverWins.getValue(), 0u);
+}
+
+Statistic thirdSolverWins("ThirdSolverWins", "TSwins");
+
+TEST(SolverTest, PortfolioRacesTheOtherSolvers) {
+  const Array *array = ac.CreateArray("race", 1);
+  ref<Expr> byte = Expr::createTempRead(array, Expr::Int8);
+  std::unique_ptr<Solver> solver(createPortfolioSolver(
+      {new Solver(new DelayedSolver(array, 1, time::Span("20s"))),
+       new Solver(new DelayedSolver(array, 2, time::Span("20s"))),
+       new Solver(new DelayedSolver(array, 3, time::Span("0s")))},
+      {nullptr, nullptr, &thirdSolverWins}, time::Span("50ms")));
+  solver->setCoreSolverTimeout(time::Span("30s"));
+
+  uint64_t queries = stats::queries;
+  auto start = std::chrono::steady_clock::now();
+  ref<ConstantExpr> value;
+  ASSERT_TRUE(solver->getValue(Query(ConstraintSet(), byte), value));
+  EXPECT_EQ(value->getZExtValue(), 3u);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(10));
+
+  // only the winner reports its query, the killed processes do not
+  EXPECT_EQ(stats::queries - queries, 1u);
+  EXPECT_EQ(thirdSolverWins.getValue(), 1u);
+}
+
+Statistic firstSolverWins("FirstSolverWins", "1Swins");
+
+TEST(SolverTest, PortfolioKeepsTheFirstSolverRunning) {
+  const Array *array = ac.CreateArray("running", 1);
+  ref<Expr> byte = Expr::createTempRead(array, Expr::Int8);
+  std::unique_ptr<Solver> solver(createPortfolioSolver(
+      {new Solver(new DelayedSolver(array, 1, time::Span("300ms"))),
+       new Solver(new DelayedSolver(array, 2, time::Span("20s")))},
+      {&firstSolverWins, nullptr}, time::Span("50ms")));
+  solver->setCoreSolverTimeout(time::Span("10s"));
+
+  uint64_t races = stats::queryPortfolioRaces;
+  auto start = std::chrono::steady_clock::now();
+  ref<ConstantExpr> value;
+  ASSERT_TRUE(solver->getValue(Query(ConstraintSet(), byte), value));
+  EXPECT_EQ(value->getZExtValue(), 1u);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+
+  EXPECT_EQ(stats::queryPortfolioRaces - races, 1u);
+  EXPECT_EQ(firstSolverWins.getValue(), 1u);
+}
+
+TEST(SolverTest, PortfolioDoesNotRaceFastQueries) {
+  const Array *array = ac.CreateArray("fast", 1);
+  ref<Expr> byte = Expr::createTempRead(array, Expr::Int8);
+  std::unique_ptr<Solver> solver(createPortfolioSolver(
+      {new Solver(new DelayedSolver(array, 1, time::Span("0s"))),
+       new Solver(new DelayedSolver(array, 2, time::Span("0s")))},
+      {nullptr, nullptr}, time::Span("1s")));
+
+  uint64_t races = stats::queryPortfolioRaces;
+  ref<ConstantExpr> value;
+  ASSERT_TRUE(solver->getValue(Query(ConstraintSet(), byte), value));
+  EXPECT_EQ(value->getZExtValue(), 1u);
+  EXPECT_EQ(stats::queryPortfolioRaces - races, 0u);
+}
+
+TEST(SolverTest, WorkerSolverAgreesWithCoreSolver) {
+  std::unique_ptr<Solver> core(createCoreSolver(CoreSolverToUse));
+  std::unique_ptr<Solver> worker(
+      createWorkerSolver(createCoreSolver(CoreSolverToUse), 2, 0));
+
+  // a constant table written at a symbolic index and read at another one
+  std::vector<ref<ConstantExpr>> values;
+  for (unsigned i = 0; i < 4; ++i)
+    values.push_back(ConstantExpr::alloc(3 * i, Expr::Int8));
+  const Array *table = ac.CreateArray("table", 4, &values.front(),
+                                      &values.back() + 1, Expr::Int32,
+                                      Expr::Int8);
+  const Array *input = ac.CreateArray("input", 2);
+  ref<Expr> first = Expr::createTempRead(input, Expr::Int8);
+  ref<Expr> second = ReadExpr::create(
+      UpdateList(input, nullptr), ConstantExpr::alloc(1, Expr::Int32));
+  UpdateList updates(table, nullptr);
+  updates.extend(ZExtExpr::create(first, Expr::Int32),
+                 getConstant(100, Expr::Int8));
+  ref<Expr> read =
+      ReadExpr::create(updates, ZExtExpr::create(second, Expr::Int32));
+
+  // distinct arrays that are described the same
+  ref<Expr> left = Expr::createTempRead(ac.CreateArray("left", 1), Expr::Int8);
+  ref<Expr> right =
+      Expr::createTempRead(ac.CreateArray("right", 1), Expr::Int8);
+
+  ConstraintSet constraints;
+  constraints.push_back(UltExpr::create(first, getConstant(4, Expr::Int8)));
+  constraints.push_back(UltExpr::create(second, getConstant(4, Expr::Int8)));
+  constraints.push_back(EqExpr::create(read, getConstant(100, Expr::Int8)));
+
+  auto check = [&](Solver *solver) {
+    bool result;
+    ASSERT_TRUE(solver->mustBeTrue(
+        Query(constraints, EqExpr::create(first, second)), result));
+    EXPECT_TRUE(result);
+    ASSERT_TRUE(solver->mustBeTrue(
+        Query(ConstraintSet(), EqExpr::create(left, right)), result));
+    EXPECT_FALSE(result);
+    ref<ConstantExpr> value;
+    ASSERT_TRUE(solver->getValue(Query(constraints, read), value));
+    EXPECT_EQ(value->getZExtValue(), 100u);
+    std::shared_ptr<const Assignment> assignment;
+    ASSERT_TRUE(solver->getInitialValues(
+        Query(constraints, ConstantExpr::alloc(0, Expr::Bool)), assignment));
+    ASSERT_TRUE(assignment);
+    EXPECT_EQ(assignment->evaluate(first), assignment->evaluate(second));
+    EXPECT_TRUE(assignment->satisfies(constraints.begin(), constraints.end()));
+  };
+  check(core.get());
+  uint64_t queries = stats::queries;
+  check(worker.get());
+  // the queries of the workers are counted in this process
+  EXPECT_GT(stats::queries - queries, 0u);
+}
+
+/// Kills the process that solves a truth query
+class CrashingSolver : public DelayedSolver {
+public:
+  using DelayedSolver::DelayedSolver;
+  bool computeTruth(const Query &, bool &) override { abort(); }
+};
+
+/// Ignores the timeout it is given
+class HangingSolver : public DelayedSolver {
+public:
+  using DelayedSolver::DelayedSolver;
+  void setCoreSolverTimeout(time::Span) override {}
+};
+
+TEST(SolverTest, WorkerSolverRestartsCrashedWorkers) {
+  const Array *array = ac.CreateArray("crashing", 1);
+  ref<Expr> byte = Expr::createTempRead(array, Expr::Int8);
+  std::unique_ptr<Solver> solver(createWorkerSolver(
+      new Solver(new CrashingSolver(array, 7, time::Span("0s"))), 1, 0));
+
+  uint64_t restarts = stats::solverWorkerRestarts;
+  bool result;
+  EXPECT_FALSE(solver->mustBeTrue(
+      Query(ConstraintSet(), EqExpr::create(byte, getConstant(7, Expr::Int8))),
+      result));
+  EXPECT_EQ(solver->impl->getOperationStatusCode(),
+            SolverImpl::SOLVER_RUN_STATUS_FAILURE);
+  EXPECT_EQ(stats::solverWorkerRestarts - restarts, 1u);
+
+  // the next query is solved by the replacement
+  ref<ConstantExpr> value;
+  ASSERT_TRUE(solver->getValue(Query(ConstraintSet(), byte), value));
+  EXPECT_EQ(value->getZExtValue(), 7u);
+}
+
+TEST(SolverTest, WorkerSolverKillsWorkersPastTheTimeout) {
+  const Array *array = ac.CreateArray("hanging", 1);
+  ref<Expr> byte = Expr::createTempRead(array, Expr::Int8);
+  std::unique_ptr<Solver> solver(createWorkerSolver(
+      new Solver(new HangingSolver(array, 7, time::Span("20s"))), 2, 0));
+  solver->setCoreSolverTimeout(time::Span("100ms"));
+
+  uint64_t restarts = stats::solverWorkerRestarts;
+  auto start = std::chrono::steady_clock::now();
+  ref<ConstantExpr> value;
+  EXPECT_FALSE(solver->getValue(Query(ConstraintSet(), byte), value));
+  EXPECT_EQ(solver->impl->getOperationStatusCode(),
+            SolverImpl::SOLVER_RUN_STATUS_TIMEOUT);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(10));
+  EXPECT_EQ(stats::solverWorkerRestarts - restarts, 1u);
+}
+
+// Measures the core solver on bounds checks of pointers that may point to
+// many objects with pointer-width and narrowed segments, run with
+// --gtest_also_run_disabled_tests.
+TEST(SolverTest, DISABLED_NarrowedSegmentQueries) {
+  const unsigned objects = 32, queries = 200;
+  const Array *array = ac.CreateArray("segments", objects);
+
+  for (bool narrow : {false, true}) {
+    Solver *solver = klee::createCoreSolver(CoreSolverToUse);
+    if (narrow)
+      solver = createNarrowingSolver(solver);
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < queries; ++i) {
+      // the segment of a pointer selected by a chain of branches
+      ref<Expr> segment = ConstantExpr::create(3, Expr::Int64);
+      for (unsigned j = 0; j < objects; ++j) {
+        ref<Expr> byte = ReadExpr::create(
+            UpdateList(array, nullptr), ConstantExpr::create(j, Expr::Int32));
+        segment = SelectExpr::create(
+            EqExpr::create(byte, ConstantExpr::create(i % 256, Expr::Int8)),
+            ConstantExpr::create(4 + j, Expr::Int64), segment);
+      }
+      ConstraintSet constraints;
+      for (unsigned j = 0; j < 8; ++j)
+        constraints.push_back(NotExpr::create(EqExpr::create(
+            ConstantExpr::create(4 + (i + j) % objects, Expr::Int64),
+            segment)));
+      ref<Expr> query = EqExpr::create(
+          ConstantExpr::create(4 + (i + 8) % objects, Expr::Int64), segment);
+      Solver::Validity validity;
+      ASSERT_TRUE(solver->evaluate(Query(constraints, query), validity));
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    llvm::outs() << (narrow ? "narrowed" : "pointer-width") << " segments: "
+                 << elapsed.count() / queries << " us per query\n";
+    delete solver;
+  }
+}
+
 }
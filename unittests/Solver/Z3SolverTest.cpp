@@ -9,6 +9,7 @@
 //===----------------------------------------------------------------------===//
 
 #include <algorithm>
+#include <chrono>
 #include <iterator>
 #include <vector>
 
@@ -18,6 +19,9 @@
 #include "klee/Expr/Constraints.h"
 #include "klee/Expr/Expr.h"
 #include "klee/Solver/Solver.h"
+#include "klee/Solver/SolverCmdLine.h"
+
+#include "llvm/Support/raw_ostream.h"
 
 using namespace klee;
 
@@ -69,3 +73,101 @@ TEST_F(Z3SolverTest, GetConstraintLog) {
   ASSERT_STRNE(Occurence, nullptr);
   free(ConstraintsString);
 }
+
+namespace {
+/// Create a core solver with the given number of incremental Z3 solvers
+Solver *createZ3Solver(unsigned incrementalSolvers) {
+  unsigned saved = Z3IncrementalSolvers;
+  Z3IncrementalSolvers = incrementalSolvers;
+  Solver *solver = createCoreSolver(CoreSolverType::Z3_SOLVER);
+  Z3IncrementalSolvers = saved;
+  return solver;
+}
+
+ref<Expr> readByte(const Array *array, unsigned index) {
+  return ReadExpr::create(UpdateList(array, nullptr),
+                          ConstantExpr::create(index, Expr::Int32));
+}
+
+/// The branch condition at the given depth of a path on the bytes of the
+/// array
+ref<Expr> getBranch(const Array *array, unsigned depth, bool taken) {
+  ref<Expr> sum = AddExpr::create(
+      ZExtExpr::create(readByte(array, depth % array->size), Expr::Int32),
+      ZExtExpr::create(readByte(array, (depth + 1) % array->size),
+                       Expr::Int32));
+  ref<Expr> branch = UltExpr::create(
+      sum, ConstantExpr::create(200 + depth % 100, Expr::Int32));
+  return taken ? branch : Expr::createIsZero(branch);
+}
+} // namespace
+
+TEST_F(Z3SolverTest, IncrementalSolversAgree) {
+  std::unique_ptr<Solver> incremental(createZ3Solver(2));
+  const Array *array = AC.CreateArray("path", 16);
+  const std::vector<ref<ConstantExpr>> values{ConstantExpr::alloc(3, 8),
+                                              ConstantExpr::alloc(5, 8)};
+  const Array *table =
+      AC.CreateArray("table", 2, values.data(), values.data() + 2);
+
+  // paths that share prefixes of different lengths, interleaved
+  std::vector<bool> paths[2];
+  for (unsigned step = 0; step < 60; ++step) {
+    std::vector<bool> &path = paths[step % 2];
+    if (step % 7 == 3)
+      path.resize(path.size() / 2);
+    path.push_back((step * 5) % 3 != 0);
+
+    ConstraintSet constraints;
+    for (unsigned depth = 0; depth < path.size(); ++depth)
+      constraints.push_back(getBranch(array, depth, path[depth]));
+    // a read of a constant array in the query expression only
+    ref<Expr> index = AndExpr::create(
+        readByte(array, step % array->size), ConstantExpr::alloc(1, 8));
+    ref<Expr> query = EqExpr::create(
+        readByte(array, 0),
+        ReadExpr::create(UpdateList(table, nullptr),
+                         ZExtExpr::create(index, Expr::Int32)));
+
+    bool expected, result;
+    ASSERT_TRUE(Z3Solver_->mustBeTrue(Query(constraints, query), expected));
+    ASSERT_TRUE(incremental->mustBeTrue(Query(constraints, query), result));
+    EXPECT_EQ(expected, result);
+
+    ASSERT_TRUE(Z3Solver_->mayBeTrue(Query(constraints, query), expected));
+    ASSERT_TRUE(incremental->mayBeTrue(Query(constraints, query), result));
+    EXPECT_EQ(expected, result);
+
+    std::shared_ptr<const Assignment> assignment;
+    ASSERT_TRUE(incremental->getInitialValues(
+        Query(constraints, ConstantExpr::alloc(0, Expr::Bool)), assignment));
+    EXPECT_TRUE(assignment->satisfies(constraints.begin(), constraints.end()));
+  }
+}
+
+// Measures the queries of a deep path with and without incremental solvers,
+// run with --gtest_also_run_disabled_tests.
+TEST_F(Z3SolverTest, DISABLED_DeepPathQueries) {
+  const unsigned depth = 400;
+  const Array *array = AC.CreateArray("deep", 64);
+
+  for (unsigned incrementalSolvers : {0u, 4u}) {
+    std::unique_ptr<Solver> solver(createZ3Solver(incrementalSolvers));
+    auto start = std::chrono::steady_clock::now();
+    ConstraintSet constraints;
+    for (unsigned i = 0; i < depth; ++i) {
+      // both sides of the branch, then follow the taken one
+      bool result;
+      ASSERT_TRUE(solver->mayBeTrue(
+          Query(constraints, getBranch(array, i, true)), result));
+      ASSERT_TRUE(solver->mayBeTrue(
+          Query(constraints, getBranch(array, i, false)), result));
+      constraints.push_back(getBranch(array, i, true));
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    llvm::outs() << (incrementalSolvers ? "incremental" : "non-incremental")
+                 << ": " << elapsed.count() << " ms for " << 2 * depth
+                 << " queries of a path of depth " << depth << "\n";
+  }
+}